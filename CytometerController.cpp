@@ -1,5 +1,6 @@
 #include "CytometerController.h"
 #include <QDebug>
+#include <QDir>
 #include "EventDataManager.h"
 #include "DetectorSettingsModel.h"
 #include "WorkSheetWidget.h"
@@ -7,10 +8,15 @@
 #include "SortingWidget.h"
 #include "WaveformWidget.h"
 #include "SpeedMeasureWidget.h"
+#include "AppSettings.h"
 
 CytometerController::CytometerController(QObject *parent)
     : QObject{parent}, m_udpClientThread(new QThread(this)), m_udpClient(new UdpCommClient())
 {
+    UdpReceiveConfig receiveConfig;
+    receiveConfig.cpuAffinity = AppSettings::instance().receiveCpu();
+    receiveConfig.realtimePriority = AppSettings::instance().receivePriority();
+    m_udpClient->setReceiveConfig(receiveConfig);
     m_udpClient->moveToThread(m_udpClientThread);
 
     connect(m_udpClientThread, &QThread::started, m_udpClient, &UdpCommClient::doInitialize);
@@ -54,6 +60,7 @@ CytometerController::CytometerController(QObject *parent)
 
     connect(WaveformWidget::instance(), &WaveformWidget::waveformStateChanged, m_udpClient, &UdpCommClient::sendWaveformRequest);
     connect(m_udpClient, &UdpCommClient::waveformDataReceived, WaveformWidget::instance(), &WaveformWidget::onReceivedWaveform);
+    connect(WaveformWidget::instance(), &WaveformWidget::displayModeChanged, m_udpClient, &UdpCommClient::setWaveformMillivolts, Qt::DirectConnection);
 
 
     unconnectedState->addTransition(this, &CytometerController::connected, idleState);
@@ -145,7 +152,9 @@ void CytometerController::onEnterAccquiringState()
     TestDataGenerator::instance().startGenerateData();
 #else
     // connect(m_udpClient, &UdpCommClient::sampleDataReady, &DataManager::instance(), &DataManager::addSamples);
-    connect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents);
+    // Runs addEvents() on the receive thread, it hands the batch to the event queue without blocking
+    connect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents, Qt::DirectConnection);
+    startDatagramCapture();
 #endif
     WorkSheetWidget::instance()->setActive(true);
 }
@@ -160,8 +169,10 @@ void CytometerController::onExitAccquiringState()
     disconnect(&TestDataGenerator::instance(), &TestDataGenerator::eventDataGenerated, &EventDataManager::instance(), &EventDataManager::addEvents);
 #else
     // disconnect(m_udpClient, &UdpCommClient::sampleDataReady, &DataManager::instance(), &DataManager::addSamples);
+    stopDatagramCapture();
     disconnect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents);
 #endif
+    EventDataManager::instance().closeEventDataManager();
     WorkSheetWidget::instance()->setActive(false);
 }
 
@@ -178,8 +189,8 @@ void CytometerController::onEnterSortingState()
     TestDataGenerator::instance().startGenerateData();
 #else
     // connect(m_udpClient, &UdpCommClient::sampleDataReady, &DataManager::instance(), &DataManager::addSamples);
-    connect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents, Qt::QueuedConnection);
-
+    connect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents, Qt::DirectConnection);
+    startDatagramCapture();
 #endif
     WorkSheetWidget::instance()->setActive(true);
 
@@ -195,12 +206,38 @@ void CytometerController::onExitSortingState()
     disconnect(&TestDataGenerator::instance(), &TestDataGenerator::eventDataGenerated, &EventDataManager::instance(), &EventDataManager::addEvents);
 #else
     // disconnect(m_udpClient, &UdpCommClient::sampleDataReady, &DataManager::instance(), &DataManager::addSamples);
+    stopDatagramCapture();
     disconnect(m_udpClient, &UdpCommClient::eventDataReady, &EventDataManager::instance(), &EventDataManager::addEvents);
 #endif
+    EventDataManager::instance().closeEventDataManager();
     WorkSheetWidget::instance()->setActive(false);
 
 }
 
+/*
+ * With a replay file in the preferences the capture is fed through the
+ * parser instead of the socket, otherwise the received datagrams are
+ * journaled next to the pulse data if capturing is enabled.
+ */
+void CytometerController::startDatagramCapture()
+{
+    const AppSettings &settings = AppSettings::instance();
+    if (!settings.replayFile().isEmpty()) {
+        if (!m_udpClient->startReplay(settings.replayFile(), settings.replaySpeed())) {
+            qWarning() << "[CytometerController] Replay of" << settings.replayFile() << "failed to start";
+        }
+    } else if (settings.captureDatagrams()) {
+        QDir dir(EventDataManager::instance().dataSaveDirectory());
+        m_udpClient->startRecording(dir.absoluteFilePath("datagrams.seekcap"));
+    }
+}
+
+void CytometerController::stopDatagramCapture()
+{
+    m_udpClient->stopReplay();
+    m_udpClient->stopRecording();
+}
+
 void CytometerController::onEnterErrorState()
 {
     qDebug() << "Entering Error State";
@@ -50,6 +50,8 @@ private slots:
     void onEnterErrorState();
     void onExitErrorState();
 
+    void startDatagramCapture();
+    void stopDatagramCapture();
 
     // void initUdpClient();
 
@@ -0,0 +1,736 @@
+#include "AcquisitionFile.h"
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace AcquisitionFormat;
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "Acquisition columns are written in host order");
+
+
+const void *AcquisitionFormat::batchColumn(const EventBatch &batch, int column)
+{
+    switch (column) {
+    case ColumnEventId:         return batch.eventIds();
+    case ColumnDiffTime:        return batch.diffTimesUs();
+    case ColumnPostTime:        return batch.postTimesUs();
+    case ColumnFlags:           return batch.flags();
+    case ColumnChPulseValid:    return batch.chPulseValid();
+    default:
+        column -= FixedColumnNum;
+        return batch.columnAt(column / EventBatch::MEASUREMENT_NUM, column % EventBatch::MEASUREMENT_NUM);
+    }
+}
+
+void *AcquisitionFormat::batchColumn(EventBatch &batch, int column)
+{
+    switch (column) {
+    case ColumnEventId:         return batch.eventIdData();
+    case ColumnDiffTime:        return batch.diffTimeData();
+    case ColumnPostTime:        return batch.postTimeData();
+    case ColumnFlags:           return batch.flagData();
+    case ColumnChPulseValid:    return batch.chPulseValidData();
+    default:
+        column -= FixedColumnNum;
+        return batch.columnData(column / EventBatch::MEASUREMENT_NUM, column % EventBatch::MEASUREMENT_NUM);
+    }
+}
+
+
+namespace {
+
+template <typename T>
+void columnRange(const T *values, int count, qint64 &min, qint64 &max)
+{
+    qint64 lo = std::numeric_limits<qint64>::max();
+    qint64 hi = std::numeric_limits<qint64>::min();
+    for (int i = 0; i < count; ++i) {
+        const qint64 v = values[i];
+        lo = qMin(lo, v);
+        hi = qMax(hi, v);
+    }
+    min = count ? lo : 0;
+    max = count ? hi : 0;
+}
+
+// Raw blocks are read in place, a block shorter than its rows would be read past its end
+bool blockHoldsRows(const AcquisitionColumnBlock &block, quint32 rows, int column)
+{
+    return block.codec != ColumnCodec::Raw
+           || block.size >= static_cast<quint64>(rows) * columnValueSize(column);
+}
+
+qint64 columnValue(const void *data, int column, int row)
+{
+    switch (column) {
+    case ColumnEventId:
+    case ColumnDiffTime:
+    case ColumnPostTime:
+        return static_cast<const quint32 *>(data)[row];
+    case ColumnFlags:
+    case ColumnChPulseValid:
+        return static_cast<const quint8 *>(data)[row];
+    default:
+        return static_cast<const qint32 *>(data)[row];
+    }
+}
+
+} // namespace
+
+
+AcquisitionFileWriter::AcquisitionFileWriter(int chunkRows)
+    : m_chunkRows(qMax(1, chunkRows)), m_compression(ColumnCodec::Mode::None), m_eventCount(0), m_bytesWritten(0)
+{
+}
+
+AcquisitionFileWriter::~AcquisitionFileWriter()
+{
+    close();
+}
+
+bool AcquisitionFileWriter::open(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = m_file.errorString();
+        qWarning() << "[AcquisitionFileWriter] Open file failed:" << filePath << m_errorString;
+        return false;
+    }
+    m_channels = channels;
+    m_chunk.reset(m_channels, m_chunkRows);
+    m_sketchPairs = ChunkSketch::defaultPairs(m_channels.size());
+    m_index.clear();
+    m_eventCount = 0;
+    m_bytesWritten = 0;
+    m_errorString.clear();
+
+    QJsonArray pairs;
+    for (const SketchPair &pair : m_sketchPairs) {
+        pairs.append(QJsonArray{pair.valueX, pair.valueY});
+    }
+    QJsonObject sketch;
+    sketch["columnBins"] = ChunkSketch::COLUMN_BINS;
+    sketch["pairBins"] = ChunkSketch::PAIR_BINS;
+    sketch["pairs"] = pairs;
+    QJsonObject fileMetadata = metadata;
+    fileMetadata["sketch"] = sketch;
+
+    const QByteArray json = QJsonDocument(fileMetadata).toJson(QJsonDocument::Compact);
+    QByteArray header(sizeof(MAGIC) + 16, '\0');
+    std::memcpy(header.data(), MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint32>(VERSION, header.data() + 8);
+    qToLittleEndian<quint32>(json.size(), header.data() + 12);
+    qToLittleEndian<quint32>(m_channels.size(), header.data() + 16);
+    qToLittleEndian<quint32>(m_chunkRows, header.data() + 20);
+    for (int ch : m_channels) {
+        quint32 id = qToLittleEndian<quint32>(ch);
+        header.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    }
+    header.append(json);
+    if (!write(header.constData(), header.size()) || !writePadding(padded(header.size()) - header.size())) {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool AcquisitionFileWriter::append(const EventBatch &batch)
+{
+    if (!m_file.isOpen() || batch.channelCount() != m_channels.size()) {
+        return false;
+    }
+
+    const int columnNum = columnCount(m_channels.size());
+    int row = 0;
+    while (row < batch.size()) {
+        const int count = qMin(batch.size() - row, m_chunkRows - m_chunk.size());
+        const int offset = m_chunk.size();
+        m_chunk.resize(offset + count);
+        for (int col = 0; col < columnNum; ++col) {
+            const int valueSize = columnValueSize(col);
+            std::memcpy(static_cast<char *>(batchColumn(m_chunk, col)) + offset * valueSize,
+                        static_cast<const char *>(batchColumn(batch, col)) + row * valueSize,
+                        static_cast<size_t>(count) * valueSize);
+        }
+        row += count;
+        if (m_chunk.size() == m_chunkRows && !flushChunk()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Writes the rows gathered so far as one chunk, one block per column.
+ */
+bool AcquisitionFileWriter::flushChunk()
+{
+    if (!m_file.isOpen() || m_chunk.isEmpty()) {
+        return true;
+    }
+
+    const int rows = m_chunk.size();
+    const int columnNum = columnCount(m_channels.size());
+    AcquisitionChunkInfo info;
+    info.offset = m_bytesWritten;
+    info.rows = rows;
+    info.firstRow = m_eventCount;
+    info.columns.resize(columnNum);
+
+    quint32 chunkHeader[2] = {qToLittleEndian(CHUNK_MAGIC), qToLittleEndian<quint32>(rows)};
+    if (!write(chunkHeader, sizeof(chunkHeader))) {
+        return false;
+    }
+    for (int col = 0; col < columnNum; ++col) {
+        const void *data = batchColumn(m_chunk, col);
+        AcquisitionColumnBlock &block = info.columns[col];
+        if (col == ColumnEventId || col == ColumnDiffTime || col == ColumnPostTime) {
+            columnRange(static_cast<const quint32 *>(data), rows, block.min, block.max);
+        } else if (col == ColumnFlags || col == ColumnChPulseValid) {
+            columnRange(static_cast<const quint8 *>(data), rows, block.min, block.max);
+        } else {
+            columnRange(static_cast<const qint32 *>(data), rows, block.min, block.max);
+        }
+
+        block.codec = ColumnCodec::encode(data, rows, columnValueSize(col), isSignedColumn(col), m_compression, m_encoded);
+        const void *payload = block.codec == ColumnCodec::Raw ? data : m_encoded.constData();
+        const qint64 size = block.codec == ColumnCodec::Raw ? static_cast<qint64>(rows) * columnValueSize(col) : m_encoded.size();
+        block.size = static_cast<quint32>(size);
+        const quint32 blockHeader[2] = {qToLittleEndian(block.codec), qToLittleEndian(block.size)};
+        if (!write(blockHeader, sizeof(blockHeader))) {
+            return false;
+        }
+        block.offset = m_bytesWritten;
+        if (!write(payload, size) || !writePadding(padded(size) - size)) {
+            return false;
+        }
+    }
+
+    ChunkSketch::build(m_chunk, m_sketchPairs, m_sketch);
+    const quint32 sketchHeader[2] = {qToLittleEndian(ChunkSketch::MAGIC), qToLittleEndian<quint32>(m_sketch.size())};
+    if (!write(sketchHeader, sizeof(sketchHeader))) {
+        return false;
+    }
+    info.sketchOffset = m_bytesWritten;
+    if (!write(m_sketch.constData(), m_sketch.size()) || !writePadding(padded(m_sketch.size()) - m_sketch.size())) {
+        return false;
+    }
+
+    m_index.append(info);
+    m_eventCount += rows;
+    m_chunk.clear();
+    return true;
+}
+
+/*
+ * Forces the written chunks to the disk. With writePartialChunk the rows
+ * gathered so far are written as a chunk first, everything appended
+ * survives a crash afterwards.
+ */
+bool AcquisitionFileWriter::sync(bool writePartialChunk)
+{
+    if (!m_file.isOpen()) {
+        return true;
+    }
+    if (writePartialChunk && !flushChunk()) {
+        return false;
+    }
+    if (!m_file.flush()) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+#ifdef Q_OS_WIN
+    const bool synced = _commit(m_file.handle()) == 0;
+#else
+    const bool synced = ::fsync(m_file.handle()) == 0;
+#endif
+    if (!synced) {
+        m_errorString = QStringLiteral("Syncing to the disk failed");
+    }
+    return synced;
+}
+
+bool AcquisitionFileWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return true;
+    }
+    bool ok = flushChunk();
+
+    const int columnNum = columnCount(m_channels.size());
+    const quint64 footerOffset = m_bytesWritten;
+    QByteArray footer(16, '\0');
+    qToLittleEndian<quint32>(INDEX_MAGIC, footer.data());
+    qToLittleEndian<quint32>(m_index.size(), footer.data() + 4);
+    qToLittleEndian<quint32>(columnNum, footer.data() + 8);
+    footer.reserve(16 + m_index.size() * (16 + columnNum * 32) + TRAILER_SIZE);
+    for (const AcquisitionChunkInfo &info : m_index) {
+        char entry[16] = {};
+        qToLittleEndian<quint64>(info.offset, entry);
+        qToLittleEndian<quint32>(info.rows, entry + 8);
+        footer.append(entry, sizeof(entry));
+        for (const AcquisitionColumnBlock &block : info.columns) {
+            char column[32];
+            qToLittleEndian<quint64>(block.offset, column);
+            qToLittleEndian<qint64>(block.min, column + 8);
+            qToLittleEndian<qint64>(block.max, column + 16);
+            qToLittleEndian<quint32>(block.codec, column + 24);
+            qToLittleEndian<quint32>(block.size, column + 28);
+            footer.append(column, sizeof(column));
+        }
+    }
+    char trailer[TRAILER_SIZE];
+    qToLittleEndian<quint64>(footerOffset, trailer);
+    std::memcpy(trailer + 8, END_MAGIC, sizeof(END_MAGIC));
+    footer.append(trailer, sizeof(trailer));
+    ok = ok && write(footer.constData(), footer.size()) && sync();
+
+    m_file.close();
+    qDebug() << "[AcquisitionFileWriter] Wrote" << m_eventCount << "events in" << m_index.size()
+             << "chunks," << m_bytesWritten << "bytes to" << m_file.fileName();
+    return ok;
+}
+
+bool AcquisitionFileWriter::write(const void *data, qint64 size)
+{
+    if (m_file.write(static_cast<const char *>(data), size) != size) {
+        m_errorString = m_file.errorString();
+        qWarning() << "[AcquisitionFileWriter] Write failed:" << m_file.fileName() << m_errorString;
+        return false;
+    }
+    m_bytesWritten += size;
+    return true;
+}
+
+bool AcquisitionFileWriter::writePadding(qint64 size)
+{
+    static const char zeros[8] = {};
+    return size <= 0 || write(zeros, size);
+}
+
+
+bool AcquisitionFileReader::open(const QString &filePath)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < 24) {
+        m_errorString = "Acquisition file too short";
+        close();
+        return false;
+    }
+    m_map = m_file.map(0, m_size);
+    if (!m_map) {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    const char *header = reinterpret_cast<const char *>(m_map);
+    if (std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 || qFromLittleEndian<quint32>(header + 8) != VERSION) {
+        m_errorString = "Not an acquisition file";
+        close();
+        return false;
+    }
+    const quint32 jsonSize = qFromLittleEndian<quint32>(header + 12);
+    const quint32 channelNum = qFromLittleEndian<quint32>(header + 16);
+    const qint64 headerSize = 24 + static_cast<qint64>(channelNum) * 4 + jsonSize;
+    if (channelNum > EventBatch::MAX_CHANNELS || headerSize > m_size) {
+        m_errorString = "Broken acquisition file header";
+        close();
+        return false;
+    }
+    for (quint32 i = 0; i < channelNum; ++i) {
+        m_channels.append(static_cast<int>(qFromLittleEndian<quint32>(header + 24 + i * 4)));
+    }
+    m_metadata = QJsonDocument::fromJson(QByteArray::fromRawData(header + 24 + channelNum * 4, jsonSize)).object();
+    const QJsonObject sketch = m_metadata.value("sketch").toObject();
+    if (sketch.value("columnBins").toInt() == ChunkSketch::COLUMN_BINS
+        && sketch.value("pairBins").toInt() == ChunkSketch::PAIR_BINS) {
+        const int valueColumns = static_cast<int>(channelNum) * EventBatch::MEASUREMENT_NUM;
+        for (const QJsonValue &value : sketch.value("pairs").toArray()) {
+            const QJsonArray pair = value.toArray();
+            const int x = pair.at(0).toInt(-1), y = pair.at(1).toInt(-1);
+            if (x >= 0 && x < valueColumns && y >= 0 && y < valueColumns) {
+                m_sketchPairs.append({x, y});
+            }
+        }
+    }
+
+    const char *trailer = header + m_size - TRAILER_SIZE;
+    const qint64 footerOffset = static_cast<qint64>(qFromLittleEndian<quint64>(trailer));
+    const bool hasFooter = m_size >= padded(headerSize) + TRAILER_SIZE
+                           && std::memcmp(trailer + 8, END_MAGIC, sizeof(END_MAGIC)) == 0;
+    if (!(hasFooter && readIndex(footerOffset)) && !recoverIndex(padded(headerSize))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AcquisitionFileReader::close()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_channels.clear();
+    m_metadata = QJsonObject();
+    m_sketchPairs.clear();
+    m_chunks.clear();
+    m_eventCount = 0;
+    m_recovered = false;
+}
+
+bool AcquisitionFileReader::readIndex(qint64 footerOffset)
+{
+    const int columnNum = columnCount();
+    const int entrySize = 32;
+    if (footerOffset < 0 || footerOffset + 16 > m_size - TRAILER_SIZE) {
+        return false;
+    }
+    const char *footer = reinterpret_cast<const char *>(m_map + footerOffset);
+    const quint32 chunkNum = qFromLittleEndian<quint32>(footer + 4);
+    if (qFromLittleEndian<quint32>(footer) != INDEX_MAGIC
+        || qFromLittleEndian<quint32>(footer + 8) != static_cast<quint32>(columnNum)
+        || footerOffset + 16 + static_cast<qint64>(chunkNum) * (16 + columnNum * entrySize) > m_size - TRAILER_SIZE) {
+        return false;
+    }
+
+    const char *entry = footer + 16;
+    m_chunks.resize(chunkNum);
+    m_eventCount = 0;
+    for (AcquisitionChunkInfo &info : m_chunks) {
+        info.offset = qFromLittleEndian<quint64>(entry);
+        info.rows = qFromLittleEndian<quint32>(entry + 8);
+        info.firstRow = m_eventCount;
+        entry += 16;
+        info.columns.resize(columnNum);
+        for (int col = 0; col < columnNum; ++col) {
+            AcquisitionColumnBlock &block = info.columns[col];
+            block.offset = qFromLittleEndian<quint64>(entry);
+            block.min = qFromLittleEndian<qint64>(entry + 8);
+            block.max = qFromLittleEndian<qint64>(entry + 16);
+            block.codec = qFromLittleEndian<quint32>(entry + 24);
+            block.size = qFromLittleEndian<quint32>(entry + 28);
+            if (static_cast<qint64>(block.offset) + block.size > footerOffset
+                || !blockHoldsRows(block, info.rows, col)) {
+                m_chunks.clear();
+                return false;
+            }
+            entry += entrySize;
+        }
+        if (columnNum > 0) {
+            const AcquisitionColumnBlock &last = info.columns.last();
+            info.sketchOffset = sketchOffset(padded(static_cast<qint64>(last.offset) + last.size));
+        }
+        m_eventCount += info.rows;
+    }
+    return true;
+}
+
+/*
+ * The writer did not get to write the footer, walk the chunks from the
+ * header on and rebuild the index, a chunk cut short by the crash ends it.
+ */
+bool AcquisitionFileReader::recoverIndex(qint64 firstChunk)
+{
+    const int columnNum = columnCount();
+    m_chunks.clear();
+    m_eventCount = 0;
+    qint64 offset = firstChunk;
+    QByteArray buffer;
+    while (offset + CHUNK_HEADER_SIZE <= m_size) {
+        const char *chunkHeader = reinterpret_cast<const char *>(m_map + offset);
+        const quint32 rows = qFromLittleEndian<quint32>(chunkHeader + 4);
+        if (qFromLittleEndian<quint32>(chunkHeader) != CHUNK_MAGIC) {
+            break;
+        }
+        AcquisitionChunkInfo info;
+        info.offset = offset;
+        info.rows = rows;
+        info.firstRow = m_eventCount;
+        info.columns.resize(columnNum);
+        qint64 columnOffset = offset + CHUNK_HEADER_SIZE;
+        bool complete = true;
+        for (int col = 0; col < columnNum && complete; ++col) {
+            AcquisitionColumnBlock &block = info.columns[col];
+            if (columnOffset + BLOCK_HEADER_SIZE > m_size) {
+                complete = false;
+                break;
+            }
+            block.codec = qFromLittleEndian<quint32>(m_map + columnOffset);
+            block.size = qFromLittleEndian<quint32>(m_map + columnOffset + 4);
+            columnOffset += BLOCK_HEADER_SIZE;
+            block.offset = columnOffset;
+            columnOffset += padded(block.size);
+            complete = columnOffset <= m_size && blockHoldsRows(block, rows, col);
+        }
+        if (!complete) {
+            break;
+        }
+        if (columnOffset + BLOCK_HEADER_SIZE <= m_size
+            && qFromLittleEndian<quint32>(m_map + columnOffset) == ChunkSketch::MAGIC) {
+            // Stepped over by its own size, also when it does not match the sketch layout of the metadata
+            info.sketchOffset = sketchOffset(columnOffset);
+            columnOffset += BLOCK_HEADER_SIZE + padded(qFromLittleEndian<quint32>(m_map + columnOffset + 4));
+        }
+        m_chunks.append(info);
+
+        // Column ranges are only in the footer, compute them again
+        const int chunkIndex = m_chunks.size() - 1;
+        for (int col = 0; col < columnNum && complete; ++col) {
+            const void *data = chunkColumn(chunkIndex, col, buffer);
+            complete = data != nullptr;
+            qint64 lo = std::numeric_limits<qint64>::max(), hi = std::numeric_limits<qint64>::min();
+            for (quint32 row = 0; complete && row < rows; ++row) {
+                const qint64 v = columnValue(data, col, row);
+                lo = qMin(lo, v);
+                hi = qMax(hi, v);
+            }
+            m_chunks[chunkIndex].columns[col].min = rows ? lo : 0;
+            m_chunks[chunkIndex].columns[col].max = rows ? hi : 0;
+        }
+        if (!complete) {
+            m_chunks.removeLast();
+            break;
+        }
+        m_eventCount += rows;
+        offset = columnOffset;
+    }
+    m_recovered = true;
+    qWarning() << "[AcquisitionFileReader] No footer index in" << m_file.fileName()
+               << "recovered" << m_chunks.size() << "chunks," << m_eventCount << "events";
+    return true;
+}
+
+int AcquisitionFileReader::valueColumn(int channelId, MeasurementType type) const
+{
+    const int index = m_channels.indexOf(channelId);
+    if (index < 0 || !MeasurementTypeHelper::isValidMeasurementType(type)) {
+        return -1;
+    }
+    return AcquisitionFormat::valueColumn(index, EventBatch::measurementIndex(type));
+}
+
+const void *AcquisitionFileReader::columnData(int chunkIndex, int column) const
+{
+    if (!m_map || chunkIndex < 0 || chunkIndex >= m_chunks.size() || column < 0 || column >= columnCount()) {
+        return nullptr;
+    }
+    const AcquisitionColumnBlock &block = m_chunks.at(chunkIndex).columns.at(column);
+    return block.codec == ColumnCodec::Raw ? m_map + block.offset : nullptr;
+}
+
+bool AcquisitionFileReader::readChunkColumn(int chunkIndex, int column, void *out) const
+{
+    if (!m_map || chunkIndex < 0 || chunkIndex >= m_chunks.size() || column < 0 || column >= columnCount()) {
+        return false;
+    }
+    const AcquisitionChunkInfo &info = m_chunks.at(chunkIndex);
+    const AcquisitionColumnBlock &block = info.columns.at(column);
+    return ColumnCodec::decode(static_cast<ColumnCodec::Codec>(block.codec), m_map + block.offset, block.size,
+                               info.rows, columnValueSize(column), out);
+}
+
+const void *AcquisitionFileReader::chunkColumn(int chunkIndex, int column, QByteArray &buffer) const
+{
+    const void *data = columnData(chunkIndex, column);
+    if (data) {
+        return data;
+    }
+    if (chunkIndex < 0 || chunkIndex >= m_chunks.size()) {
+        return nullptr;
+    }
+    buffer.resize(static_cast<qsizetype>(m_chunks.at(chunkIndex).rows) * columnValueSize(column));
+    return readChunkColumn(chunkIndex, column, buffer.data()) ? buffer.constData() : nullptr;
+}
+
+int AcquisitionFileReader::readColumn(int column, quint64 firstRow, int count, qint64 *out) const
+{
+    if (column < 0 || column >= columnCount() || count <= 0 || firstRow >= m_eventCount) {
+        return 0;
+    }
+    // First chunk holding firstRow, chunks are in row order
+    auto it = std::upper_bound(m_chunks.cbegin(), m_chunks.cend(), firstRow,
+                               [](quint64 row, const AcquisitionChunkInfo &info) { return row < info.firstRow; });
+    if (it == m_chunks.cbegin()) {
+        return 0;
+    }
+    int chunkIndex = static_cast<int>(it - m_chunks.cbegin()) - 1;
+
+    QByteArray buffer;
+    int copied = 0;
+    quint64 row = firstRow;
+    for (; chunkIndex < m_chunks.size() && copied < count; ++chunkIndex) {
+        const AcquisitionChunkInfo &info = m_chunks.at(chunkIndex);
+        const void *data = chunkColumn(chunkIndex, column, buffer);
+        if (!data) {
+            break;
+        }
+        const int begin = static_cast<int>(row - info.firstRow);
+        const int n = qMin(count - copied, static_cast<int>(info.rows) - begin);
+        if (n <= 0) {
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            out[copied + i] = columnValue(data, column, begin + i);
+        }
+        copied += n;
+        row += n;
+    }
+    return copied;
+}
+
+bool AcquisitionFileReader::readBatch(quint64 firstRow, int count, EventBatch &batch) const
+{
+    batch.reset(m_channels, count);
+    if (firstRow >= m_eventCount) {
+        return count == 0;
+    }
+    count = static_cast<int>(qMin<quint64>(count, m_eventCount - firstRow));
+    batch.resize(count);
+
+    auto it = std::upper_bound(m_chunks.cbegin(), m_chunks.cend(), firstRow,
+                               [](quint64 row, const AcquisitionChunkInfo &info) { return row < info.firstRow; });
+    int chunkIndex = static_cast<int>(it - m_chunks.cbegin()) - 1;
+    const int columnNum = columnCount();
+    QByteArray buffer;
+    int copied = 0;
+    for (; chunkIndex < m_chunks.size() && copied < count; ++chunkIndex) {
+        const AcquisitionChunkInfo &info = m_chunks.at(chunkIndex);
+        const int begin = static_cast<int>(firstRow + copied - info.firstRow);
+        const int n = qMin(count - copied, static_cast<int>(info.rows) - begin);
+        for (int col = 0; col < columnNum; ++col) {
+            const int valueSize = columnValueSize(col);
+            char *dst = static_cast<char *>(batchColumn(batch, col)) + copied * valueSize;
+            const AcquisitionColumnBlock &block = info.columns.at(col);
+            if (block.codec != ColumnCodec::Raw && begin == 0 && n == static_cast<int>(info.rows)) {
+                // Whole block, decode in place
+                if (!readChunkColumn(chunkIndex, col, dst)) {
+                    return false;
+                }
+                continue;
+            }
+            const void *data = chunkColumn(chunkIndex, col, buffer);
+            if (!data) {
+                return false;
+            }
+            std::memcpy(dst, static_cast<const char *>(data) + begin * valueSize, static_cast<size_t>(n) * valueSize);
+        }
+        copied += n;
+    }
+    return true;
+}
+
+bool AcquisitionFileReader::exportCsv(const QString &csvPath) const
+{
+    if (!m_map) {
+        return false;
+    }
+    QFile csvFile(csvPath);
+    if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        qWarning() << "[AcquisitionFileReader] Export csv failed:" << csvPath << csvFile.errorString();
+        return false;
+    }
+
+    QTextStream textStream(&csvFile);
+    textStream << "Event ID" << ",";
+    textStream << "Valid Speed" << ",";
+    textStream << "Start Time(s)" << ",";
+    textStream << QString("Speed (us for %1um)").arg(m_metadata.value("speedMeasureDist").toInt()) << ",";
+    textStream << "Sort Triggered" << ",";
+    textStream << "Sorted" << ",";
+    textStream << "Pulse Ch" << ",";
+    for (int ch : m_channels) {
+        for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
+            textStream << QString("Channel-%1(%2)").arg(ch).arg(MeasurementTypeHelper::measurementTypeToString(type)) << ",";
+        }
+    }
+    textStream << "\n";
+
+    EventBatch batch;
+    const int columnNum = m_channels.size() * EventBatch::MEASUREMENT_NUM;
+    for (const AcquisitionChunkInfo &info : m_chunks) {
+        if (!readBatch(info.firstRow, info.rows, batch)) {
+            qWarning() << "[AcquisitionFileReader] Export csv failed: chunk at row" << info.firstRow << "could not be read";
+            csvFile.remove();
+            return false;
+        }
+        for (int row = 0; row < batch.size(); ++row) {
+            textStream << batch.eventIds()[row] << ",";
+            textStream << batch.isValidSpeedMeasure(row) << ',';
+            textStream << batch.postTimesUs()[row] << ",";
+            textStream << batch.diffTimesUs()[row] << ",";
+            textStream << (batch.isEnabledSort(row) ? "true" : "false") << ",";
+            textStream << (batch.isRealSorted(row) ? "true" : "false") << ",";
+            textStream << QString::number(batch.chPulseValid()[row]) << ",";
+            for (int col = 0; col < columnNum; ++col) {
+                textStream << batch.columnAt(col / EventBatch::MEASUREMENT_NUM, col % EventBatch::MEASUREMENT_NUM)[row] << ",";
+            }
+            textStream << "\n";
+        }
+    }
+    textStream.flush();
+    return csvFile.error() == QFile::NoError;
+}
+
+/*
+ * Sketch payload of the block at blockOffset, 0 if there is no sketch of
+ * the layout the metadata announces.
+ */
+quint64 AcquisitionFileReader::sketchOffset(qint64 blockOffset) const
+{
+    const qint64 size = ChunkSketch::payloadSize(m_channels.size(), m_sketchPairs.size());
+    if (blockOffset + BLOCK_HEADER_SIZE + size > m_size
+        || qFromLittleEndian<quint32>(m_map + blockOffset) != ChunkSketch::MAGIC
+        || qFromLittleEndian<quint32>(m_map + blockOffset + 4) != size) {
+        return 0;
+    }
+    return blockOffset + BLOCK_HEADER_SIZE;
+}
+
+int AcquisitionFileReader::sketchPair(int columnX, int columnY) const
+{
+    for (int i = 0; i < m_sketchPairs.size(); ++i) {
+        if (m_sketchPairs.at(i).valueX == columnX - FixedColumnNum && m_sketchPairs.at(i).valueY == columnY - FixedColumnNum) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool AcquisitionFileReader::columnSketch(int chunkIndex, int column, ColumnSketch &sketch) const
+{
+    if (chunkIndex < 0 || chunkIndex >= m_chunks.size() || column < FixedColumnNum || column >= columnCount()
+        || !m_chunks.at(chunkIndex).sketchOffset) {
+        return false;
+    }
+    return ChunkSketch::readColumn(m_map + m_chunks.at(chunkIndex).sketchOffset, column - FixedColumnNum, sketch);
+}
+
+bool AcquisitionFileReader::pairSketch(int chunkIndex, int pairIndex, PairSketch &sketch) const
+{
+    if (chunkIndex < 0 || chunkIndex >= m_chunks.size() || pairIndex < 0 || pairIndex >= m_sketchPairs.size()
+        || !m_chunks.at(chunkIndex).sketchOffset) {
+        return false;
+    }
+    return ChunkSketch::readPair(m_map + m_chunks.at(chunkIndex).sketchOffset, m_channels.size(), pairIndex, sketch);
+}
@@ -0,0 +1,224 @@
+#ifndef ACQUISITIONFILE_H
+#define ACQUISITIONFILE_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QVector>
+#include "EventBatch.h"
+#include "ColumnCodec.h"
+#include "ChunkSketch.h"
+
+
+/*
+ * Acquisition file layout, little endian, every block starts 8-byte aligned:
+ *
+ *   Header:  magic "SEEKACQ\0" | version u32 | metadata size u32 | channel count u32
+ *            | chunk rows u32 | channel ids u32 * channel count | metadata JSON, padded
+ *   Chunk:   magic "CHNK" u32 | rows u32
+ *            | column blocks, one per column: codec u32 | encoded size u32
+ *              | payload, padded to 8 bytes
+ *            | sketch block: magic "SKT1" u32 | size u32 | payload (ChunkSketch.h)
+ *   Footer:  magic "IDX1" u32 | chunk count u32 | column count u32 | reserved u32
+ *            | per chunk: offset u64 | rows u32 | reserved u32
+ *                         | per column: payload offset u64 | min i64 | max i64
+ *                                       | codec u32 | encoded size u32
+ *   Trailer: footer offset u64 | magic "SEEKEND\0"
+ *
+ * Columns: event id u32, diff time u32, post time u32, flags u8, pulse valid
+ * u8, then one i32 column per (channel, measurement) in channel order. Raw
+ * payloads are the values themselves, the other codecs are described in
+ * ColumnCodec.h. The "sketch" object of the metadata lists the column pairs
+ * the sketch blocks summarize. A file without trailer (writer killed) is
+ * still readable, the reader walks the chunks and rebuilds the index.
+ */
+namespace AcquisitionFormat {
+constexpr char      MAGIC[8] = {'S', 'E', 'E', 'K', 'A', 'C', 'Q', '\0'};
+constexpr char      END_MAGIC[8] = {'S', 'E', 'E', 'K', 'E', 'N', 'D', '\0'};
+constexpr quint32   CHUNK_MAGIC = 0x4B4E4843;   // "CHNK"
+constexpr quint32   INDEX_MAGIC = 0x31584449;   // "IDX1"
+constexpr quint32   VERSION = 1;
+constexpr int       CHUNK_HEADER_SIZE = 8;
+constexpr int       BLOCK_HEADER_SIZE = 8;
+constexpr int       TRAILER_SIZE = 16;
+
+enum Column {
+    ColumnEventId = 0,
+    ColumnDiffTime,
+    ColumnPostTime,
+    ColumnFlags,
+    ColumnChPulseValid,
+    FixedColumnNum,
+};
+
+inline int columnCount(int channelNum) { return FixedColumnNum + channelNum * EventBatch::MEASUREMENT_NUM; }
+inline int valueColumn(int channelIndex, int measurementIndex) { return FixedColumnNum + channelIndex * EventBatch::MEASUREMENT_NUM + measurementIndex; }
+inline int columnValueSize(int column) { return (column == ColumnFlags || column == ColumnChPulseValid) ? 1 : 4; }
+inline bool isSignedColumn(int column) { return column >= FixedColumnNum; }
+inline qint64 padded(qint64 size) { return (size + 7) & ~qint64(7); }
+
+// Column of a batch by file column index, columnValueSize() bytes per row
+const void *batchColumn(const EventBatch &batch, int column);
+void *batchColumn(EventBatch &batch, int column);
+}
+
+
+/**
+ * @brief Position and value range of one column inside a chunk.
+ */
+struct AcquisitionColumnBlock
+{
+    quint64 offset = 0;             ///< Payload offset in the file
+    qint64  min = 0;
+    qint64  max = 0;
+    quint32 codec = ColumnCodec::Raw;
+    quint32 size = 0;               ///< Payload bytes
+};
+
+struct AcquisitionChunkInfo
+{
+    quint64 offset = 0;
+    quint32 rows = 0;
+    quint64 firstRow = 0;           ///< Row of the file the chunk starts with
+    QVector<AcquisitionColumnBlock> columns;
+    quint64 sketchOffset = 0;       ///< Sketch payload offset, 0 without sketch
+};
+
+
+/**
+ * @brief Writes event batches into an acquisition file.
+ *
+ * Rows are gathered in a chunk of chunkRows events, a full chunk is written
+ * with one call per column, encoded with the codec setCompression() allows
+ * that gives the smallest block, followed by the chunk's sketch. sync() syncs
+ * the file to the disk, optionally writing the partial chunk first, close()
+ * also writes the footer index. Not thread safe,
+ * one thread appends.
+ */
+class AcquisitionFileWriter
+{
+public:
+    explicit AcquisitionFileWriter(int chunkRows = DefaultChunkRows);
+    ~AcquisitionFileWriter();
+
+    bool    open(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata);
+    void    setCompression(ColumnCodec::Mode mode) { m_compression = mode; }
+    bool    append(const EventBatch &batch);
+    bool    flushChunk();
+    bool    sync(bool writePartialChunk = true);
+    bool    close();
+
+    bool    isOpen() const { return m_file.isOpen(); }
+    QString filePath() const { return m_file.fileName(); }
+    QString errorString() const { return m_errorString; }
+    quint64 eventCount() const { return m_eventCount; }     ///< Rows in written chunks
+    int     pendingRows() const { return m_chunk.size(); }      ///< Rows gathered for the next chunk
+    int     chunkCount() const { return m_index.size(); }
+    qint64  bytesWritten() const { return m_bytesWritten; }
+
+    static constexpr int DefaultChunkRows = 65536;
+
+private:
+    bool    write(const void *data, qint64 size);
+    bool    writePadding(qint64 size);
+
+    QFile                           m_file;
+    QVector<int>                    m_channels;
+    int                             m_chunkRows;
+    ColumnCodec::Mode               m_compression;
+    EventBatch                      m_chunk;
+    QByteArray                      m_encoded;      ///< Payload of the column being written
+    QVector<SketchPair>             m_sketchPairs;
+    QByteArray                      m_sketch;       ///< Sketch payload of the chunk being written
+    QVector<AcquisitionChunkInfo>   m_index;
+    quint64                         m_eventCount;
+    qint64                          m_bytesWritten;
+    QString                         m_errorString;
+};
+
+
+/**
+ * @brief Memory maps an acquisition file and gives access to its columns.
+ *
+ * Raw column blocks are read straight from the mapping, so reading one
+ * column of a range of chunks touches only those pages, encoded blocks are
+ * decoded by readChunkColumn(). Chunk min/max allow skipping chunks
+ * without reading them.
+ */
+class AcquisitionFileReader
+{
+public:
+    AcquisitionFileReader() = default;
+    ~AcquisitionFileReader() { close(); }
+
+    bool    open(const QString &filePath);
+    void    close();
+
+    QString errorString() const { return m_errorString; }
+    const QJsonObject &metadata() const { return m_metadata; }
+    const QVector<int> &channels() const { return m_channels; }
+    int     columnCount() const { return AcquisitionFormat::columnCount(m_channels.size()); }
+    int     valueColumn(int channelId, MeasurementType type) const;
+    quint64 eventCount() const { return m_eventCount; }
+    bool    isRecovered() const { return m_recovered; }
+
+    int     chunkCount() const { return m_chunks.size(); }
+    const AcquisitionChunkInfo &chunk(int index) const { return m_chunks.at(index); }
+    /**
+     * @brief Payload of a raw column block in the mapping, nullptr for encoded blocks.
+     */
+    const void *columnData(int chunkIndex, int column) const;
+
+    /**
+     * @brief Decodes a column block into out, which has room for the chunk rows.
+     */
+    bool    readChunkColumn(int chunkIndex, int column, void *out) const;
+
+    /**
+     * @brief Column block of a chunk, raw blocks from the mapping, encoded ones decoded into buffer.
+     * @return The chunk rows of the column, nullptr on error.
+     */
+    const void *chunkColumn(int chunkIndex, int column, QByteArray &buffer) const;
+
+    bool    hasSketches() const { return !m_chunks.isEmpty() && m_chunks.first().sketchOffset; }
+    const QVector<SketchPair> &sketchPairs() const { return m_sketchPairs; }
+    /**
+     * @brief Index of the pair sketch of two value columns (file column indexes), -1 if not kept.
+     */
+    int     sketchPair(int columnX, int columnY) const;
+    bool    columnSketch(int chunkIndex, int column, ColumnSketch &sketch) const;
+    bool    pairSketch(int chunkIndex, int pairIndex, PairSketch &sketch) const;
+
+    /**
+     * @brief Copies count values of a column starting at row firstRow, widened to 64 bit.
+     * @return Number of values copied.
+     */
+    int     readColumn(int column, quint64 firstRow, int count, qint64 *out) const;
+
+    /**
+     * @brief Reads rows [firstRow, firstRow + count) back into a batch.
+     */
+    bool    readBatch(quint64 firstRow, int count, EventBatch &batch) const;
+
+    /**
+     * @brief Writes the file as CSV in the layout of the former pulsedata.csv.
+     */
+    bool    exportCsv(const QString &csvPath) const;
+
+private:
+    bool    readIndex(qint64 footerOffset);
+    bool    recoverIndex(qint64 firstChunk);
+    quint64 sketchOffset(qint64 blockOffset) const;
+
+    QFile                           m_file;
+    const uchar                     *m_map = nullptr;
+    qint64                          m_size = 0;
+    QVector<int>                    m_channels;
+    QJsonObject                     m_metadata;
+    QVector<SketchPair>             m_sketchPairs;
+    QVector<AcquisitionChunkInfo>   m_chunks;
+    quint64                         m_eventCount = 0;
+    bool                            m_recovered = false;
+    QString                         m_errorString;
+};
+
+#endif // ACQUISITIONFILE_H
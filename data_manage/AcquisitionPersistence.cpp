@@ -0,0 +1,262 @@
+#include "AcquisitionPersistence.h"
+#include <QDebug>
+
+
+AcquisitionPersistence::AcquisitionPersistence(QObject *parent)
+    : QThread{parent}, m_queue(QueueSize, EventBatchQueue::OverflowPolicy::DropNewest),
+    m_compression(ColumnCodec::Mode::None), m_flushBytes(DefaultFlushBytes), m_flushIntervalMs(DefaultFlushIntervalMs),
+    m_persisting(false), m_submitting(0), m_stopRequested(false), m_failed(false), m_fcsFailed(false),
+    m_writtenEvents(0), m_failedEvents(0), m_writtenBytes(0), m_bytesPerSecond(0), m_maxWriteLatencyUs(0), m_syncCount(0)
+{
+    setObjectName("AcquisitionPersistence");
+}
+
+AcquisitionPersistence::~AcquisitionPersistence()
+{
+    stopPersistence();
+}
+
+bool AcquisitionPersistence::startPersistence(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata,
+                                              const QString &fcsFilePath)
+{
+    stopPersistence();
+
+    m_fcsFailed = false;
+    {
+        QMutexLocker locker(&m_errorMutex);
+        m_fcsErrorString.clear();
+    }
+    m_writer.setCompression(m_compression);
+    if (!m_writer.open(filePath, channels, metadata)) {
+        fail(m_writer.errorString());
+        return false;
+    }
+    if (!fcsFilePath.isEmpty() && !m_fcsWriter.open(fcsFilePath, channels, metadata)) {
+        failFcs(m_fcsWriter.errorString());
+    }
+    // Producer is disconnected between acquisitions, so the queue is idle here
+    m_queue.reset();
+    m_queue.resetStatistics();
+    m_writtenEvents = 0;
+    m_failedEvents = 0;
+    m_failed = false;
+    {
+        QMutexLocker locker(&m_errorMutex);
+        m_errorString.clear();
+    }
+    m_writtenBytes = 0;
+    m_bytesPerSecond = 0;
+    m_maxWriteLatencyUs = 0;
+    m_syncCount = 0;
+    m_stopRequested = false;
+    m_persisting.store(true, std::memory_order_release);
+    start(QThread::LowPriority);
+    qDebug() << "[AcquisitionPersistence] Writing events to" << filePath;
+    return true;
+}
+
+/*
+ * The thread drains the queue before it exits, so everything submitted
+ * before this call is written, synced and indexed when it returns. A
+ * submit() that saw the persistence running is let finish its push first,
+ * the last drain then finds the batch.
+ */
+void AcquisitionPersistence::stopPersistence()
+{
+    if (!m_persisting.exchange(false)) {
+        return;
+    }
+    while (m_submitting.load(std::memory_order_acquire) != 0) {
+        QThread::yieldCurrentThread();
+    }
+    m_stopRequested = true;
+    wait();
+    qDebug() << "[AcquisitionPersistence] Wrote" << m_writtenEvents.load() << "events," << droppedEvents()
+             << "dropped, worst write" << m_maxWriteLatencyUs.load() << "us, high water" << m_queue.highWaterMark()
+             << "of" << m_queue.capacity() << "batches";
+    if (hasFailed()) {
+        qWarning() << "[AcquisitionPersistence] Persistence failed:" << errorString();
+    }
+}
+
+QString AcquisitionPersistence::errorString() const
+{
+    QMutexLocker locker(&m_errorMutex);
+    return m_errorString;
+}
+
+/*
+ * Ends the persistence of the session, the thread keeps emptying the queue
+ * and counts what it takes as dropped.
+ */
+void AcquisitionPersistence::fail(const QString &error)
+{
+    {
+        QMutexLocker locker(&m_errorMutex);
+        m_errorString = error;
+    }
+    if (!m_failed.exchange(true, std::memory_order_acq_rel)) {
+        qWarning() << "[AcquisitionPersistence] Write failed, no more events are saved:" << error;
+    }
+}
+
+QString AcquisitionPersistence::fcsErrorString() const
+{
+    QMutexLocker locker(&m_errorMutex);
+    return m_fcsErrorString;
+}
+
+/*
+ * The FCS file is a secondary export, its failure closes it and leaves the
+ * acquisition file running.
+ */
+void AcquisitionPersistence::failFcs(const QString &error)
+{
+    {
+        QMutexLocker locker(&m_errorMutex);
+        m_fcsErrorString = error;
+    }
+    m_fcsFailed.store(true, std::memory_order_release);
+    qWarning() << "[AcquisitionPersistence] FCS export stopped, the acquisition file is still written:" << error;
+    if (m_fcsWriter.isOpen()) {
+        m_fcsWriter.close();
+    }
+}
+
+void AcquisitionPersistence::setFlushPolicy(qint64 flushBytes, int flushIntervalMs)
+{
+    m_flushBytes = qMax<qint64>(0, flushBytes);
+    m_flushIntervalMs = qMax(0, flushIntervalMs);
+}
+
+bool AcquisitionPersistence::submit(const EventBatchPtr &batch)
+{
+    if (!batch || batch->isEmpty()) {
+        return false;
+    }
+    // Paired with stopPersistence(): either the stop waits for this push, or this sees the stop
+    m_submitting.fetch_add(1);
+    const bool accepted = m_persisting.load() && m_queue.push(batch);
+    m_submitting.fetch_sub(1, std::memory_order_release);
+    return accepted;
+}
+
+/*
+ * Appends what is in the queue to the writer, returns the batches taken.
+ */
+int AcquisitionPersistence::drain()
+{
+    EventBatchQueue::ReadSpans spans = m_queue.acquire();
+    if (spans.isEmpty()) {
+        return 0;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    quint64 events = 0;
+    quint64 failedEvents = 0;
+    for (const EventBatchQueue::Span &span : {spans.first, spans.second}) {
+        for (int i = 0; i < span.size; ++i) {
+            const EventBatch &batch = *span.data[i];
+            if (!hasFailed() && !m_writer.append(batch)) {
+                fail(m_writer.errorString());
+            }
+            if (m_fcsWriter.isOpen() && !m_fcsWriter.append(batch)) {
+                failFcs(m_fcsWriter.errorString());
+            }
+            if (hasFailed()) {
+                failedEvents += batch.size();
+            } else {
+                events += batch.size();
+            }
+        }
+    }
+    m_queue.release();
+    updateWriteLatency(timer.nsecsElapsed());
+    m_writtenEvents.fetch_add(events, std::memory_order_relaxed);
+    m_failedEvents.fetch_add(failedEvents, std::memory_order_relaxed);
+    m_writtenBytes.store(m_writer.bytesWritten(), std::memory_order_relaxed);
+    return spans.size();
+}
+
+bool AcquisitionPersistence::sync(bool writePartialChunk)
+{
+    if (hasFailed()) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = m_writer.sync(writePartialChunk);
+    if (!ok) {
+        fail(m_writer.errorString());
+    }
+    updateWriteLatency(timer.nsecsElapsed());
+    m_writtenBytes.store(m_writer.bytesWritten(), std::memory_order_relaxed);
+    m_syncCount.fetch_add(1, std::memory_order_relaxed);
+    return ok;
+}
+
+void AcquisitionPersistence::updateWriteLatency(qint64 ns)
+{
+    const qint64 us = ns / 1000;
+    if (us > m_maxWriteLatencyUs.load(std::memory_order_relaxed)) {
+        m_maxWriteLatencyUs.store(us, std::memory_order_relaxed);
+    }
+}
+
+void AcquisitionPersistence::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastSyncMs = 0;
+    qint64 lastChunkMs = 0;
+    int chunkCount = 0;
+    qint64 syncedBytes = 0;
+    qint64 rateStartMs = 0;
+    qint64 rateStartBytes = 0;
+
+    while (true) {
+        // Read before draining, a stop seen here means the queue is complete
+        const bool stopping = m_stopRequested.load(std::memory_order_acquire);
+        const int drained = drain();
+
+        const qint64 now = clock.elapsed();
+        const qint64 flushBytes = m_flushBytes.load(std::memory_order_relaxed);
+        const int flushIntervalMs = m_flushIntervalMs.load(std::memory_order_relaxed);
+        if (m_writer.chunkCount() != chunkCount) {
+            chunkCount = m_writer.chunkCount();
+            lastChunkMs = now;
+        }
+        if ((flushBytes > 0 && m_writer.bytesWritten() - syncedBytes >= flushBytes)
+            || (flushIntervalMs > 0 && now - lastSyncMs >= flushIntervalMs)) {
+            sync(m_writer.pendingRows() >= MinSyncChunkRows || now - lastChunkMs >= MaxChunkAgeMs);
+            syncedBytes = m_writer.bytesWritten();
+            lastSyncMs = now;
+        }
+        if (now - rateStartMs >= RateWindowMs) {
+            m_bytesPerSecond.store((m_writer.bytesWritten() - rateStartBytes) * 1000.0 / (now - rateStartMs),
+                                   std::memory_order_relaxed);
+            rateStartMs = now;
+            rateStartBytes = m_writer.bytesWritten();
+        }
+
+        if (stopping && drained == 0) {
+            break;
+        }
+        if (drained == 0) {
+            msleep(2);
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!m_writer.close()) {
+        qWarning() << "[AcquisitionPersistence] Closing" << m_writer.filePath() << "failed:" << m_writer.errorString();
+        fail(m_writer.errorString());
+    }
+    if (m_fcsWriter.isOpen() && !m_fcsWriter.close()) {
+        qWarning() << "[AcquisitionPersistence] Closing" << m_fcsWriter.filePath() << "failed:" << m_fcsWriter.errorString();
+        failFcs(m_fcsWriter.errorString());
+    }
+    updateWriteLatency(timer.nsecsElapsed());
+    m_writtenBytes.store(m_writer.bytesWritten(), std::memory_order_relaxed);
+}
@@ -0,0 +1,117 @@
+#ifndef ACQUISITIONPERSISTENCE_H
+#define ACQUISITIONPERSISTENCE_H
+
+#include <QThread>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
+#include "EventBatchPool.h"
+#include "AcquisitionFile.h"
+#include "FcsFile.h"
+
+
+/**
+ * @brief Writes the acquisition file on its own thread.
+ *
+ * submit() runs on the receive thread and only pushes the batch handle into
+ * a bounded SPSC queue. The queue is the front buffer the receiver fills
+ * while the persistence thread writes the back buffer, the writer's chunk,
+ * so ingest never waits for the disk. When the queue is full the batch is
+ * not persisted and counted in droppedEvents() instead of blocking.
+ *
+ * Written data is flushed and synced to the disk in groups, every
+ * flushBytes written or every flushIntervalMs, whichever comes first. A
+ * sync writes the partial chunk only once it holds MinSyncChunkRows rows
+ * or the last chunk is MaxChunkAgeMs old, so slow acquisitions do not
+ * fill the file with small chunks and their sketches. Rows younger than
+ * that are in memory only.
+ * stopPersistence() waits for a submit() already past its check, then
+ * returns once every accepted batch is written and synced.
+ * With an FCS path the same batches are streamed into an FCS file as well.
+ * A failed write of the acquisition file ends the persistence of the
+ * session: the batch and every later one count as dropped, hasFailed() and
+ * errorString() tell why. A failed FCS write only closes the FCS file, the
+ * acquisition file goes on, hasFcsFailed() and fcsErrorString() tell why.
+ */
+class AcquisitionPersistence : public QThread
+{
+    Q_OBJECT
+public:
+    explicit AcquisitionPersistence(QObject *parent = nullptr);
+    ~AcquisitionPersistence() override;
+
+    bool    startPersistence(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata,
+                             const QString &fcsFilePath = QString());
+    void    stopPersistence();
+    bool    isPersisting() const { return m_persisting.load(std::memory_order_acquire); }
+    QString filePath() const { return m_writer.filePath(); }
+    bool    hasFailed() const { return m_failed.load(std::memory_order_acquire); }
+    QString errorString() const;
+    bool    hasFcsFailed() const { return m_fcsFailed.load(std::memory_order_acquire); }
+    QString fcsErrorString() const;
+
+    /**
+     * @brief Group commit cadence, 0 disables the respective trigger.
+     */
+    void    setFlushPolicy(qint64 flushBytes, int flushIntervalMs);
+
+    /**
+     * @brief Column encoding of the acquisition file, used from the next startPersistence().
+     */
+    void    setCompression(ColumnCodec::Mode mode) { m_compression = mode; }
+
+    // Receive thread
+    bool    submit(const EventBatchPtr &batch);
+
+    int     queueDepth() const { return m_queue.size(); }
+    int     queueHighWaterMark() const { return m_queue.highWaterMark(); }
+    int     queueCapacity() const { return m_queue.capacity(); }
+    quint64 droppedEvents() const { return m_queue.droppedCount() + m_failedEvents.load(std::memory_order_relaxed); }
+    quint64 writtenEvents() const { return m_writtenEvents.load(std::memory_order_relaxed); }
+    quint64 writtenBytes() const { return m_writtenBytes.load(std::memory_order_relaxed); }
+    double  bytesPerSecond() const { return m_bytesPerSecond.load(std::memory_order_relaxed); }
+    qint64  maxWriteLatencyUs() const { return m_maxWriteLatencyUs.load(std::memory_order_relaxed); }
+    int     syncCount() const { return m_syncCount.load(std::memory_order_relaxed); }
+
+protected:
+    void run() override;
+
+private:
+    int     drain();
+    bool    sync(bool writePartialChunk);
+    void    updateWriteLatency(qint64 ns);
+    void    fail(const QString &error);
+    void    failFcs(const QString &error);
+
+    static constexpr int    QueueSize = 4096;
+    static constexpr qint64 DefaultFlushBytes = 8 << 20;
+    static constexpr int    DefaultFlushIntervalMs = 1000;
+    static constexpr int    RateWindowMs = 500;
+    static constexpr int    MinSyncChunkRows = 8192;
+    static constexpr int    MaxChunkAgeMs = 10000;
+
+    EventBatchQueue         m_queue;
+    AcquisitionFileWriter   m_writer;
+    FcsWriter               m_fcsWriter;
+    ColumnCodec::Mode       m_compression;
+    std::atomic<qint64>     m_flushBytes;
+    std::atomic<int>        m_flushIntervalMs;
+    std::atomic<bool>       m_persisting;
+    std::atomic<int>        m_submitting;       ///< submit() calls between the m_persisting check and the push
+    std::atomic<bool>       m_stopRequested;
+    std::atomic<bool>       m_failed;           ///< A write failed, nothing more is written this session
+    QString                 m_errorString;      ///< Set by the persistence thread before m_failed
+    std::atomic<bool>       m_fcsFailed;        ///< The FCS file was closed early, the acquisition file is still written
+    QString                 m_fcsErrorString;   ///< Set before m_fcsFailed, guarded by m_errorMutex
+    mutable QMutex          m_errorMutex;
+
+    std::atomic<quint64>    m_writtenEvents;
+    std::atomic<quint64>    m_failedEvents;     ///< Accepted, but not written because of the failure
+    std::atomic<quint64>    m_writtenBytes;
+    std::atomic<double>     m_bytesPerSecond;
+    std::atomic<qint64>     m_maxWriteLatencyUs;
+    std::atomic<int>        m_syncCount;
+};
+
+#endif // ACQUISITIONPERSISTENCE_H
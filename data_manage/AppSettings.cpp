@@ -0,0 +1,200 @@
+#include "AppSettings.h"
+#include <QSettings>
+
+
+AppSettings::AppSettings(QObject *parent)
+    : QObject{parent}
+{
+}
+
+QVariant AppSettings::value(const QString &group, const QString &key, const QVariant &defaultValue) const
+{
+    QSettings settings("SeekGene", "SeekCytometer");
+    settings.beginGroup(group);
+    QVariant result = settings.value(key, defaultValue);
+    settings.endGroup();
+    return result;
+}
+
+void AppSettings::setValue(const QString &group, const QString &key, const QVariant &value)
+{
+    QSettings settings("SeekGene", "SeekCytometer");
+    settings.beginGroup(group);
+    settings.setValue(key, value);
+    settings.endGroup();
+}
+
+/*
+ * Address and port of the SoC, and the local endpoint the client binds to.
+ * 127.0.0.1 for both runs against the SoC simulator.
+ */
+QString AppSettings::socAddress() const
+{
+    return value("Network", "socAddress", "192.168.8.10").toString();
+}
+
+void AppSettings::setSocAddress(const QString &address)
+{
+    setValue("Network", "socAddress", address);
+}
+
+int AppSettings::socPort() const
+{
+    return value("Network", "socPort", 5001).toInt();
+}
+
+void AppSettings::setSocPort(int port)
+{
+    setValue("Network", "socPort", port);
+}
+
+QString AppSettings::localAddress() const
+{
+    return value("Network", "localAddress", "192.168.8.35").toString();
+}
+
+void AppSettings::setLocalAddress(const QString &address)
+{
+    setValue("Network", "localAddress", address);
+}
+
+int AppSettings::localPort() const
+{
+    return value("Network", "localPort", 8080).toInt();
+}
+
+void AppSettings::setLocalPort(int port)
+{
+    setValue("Network", "localPort", port);
+}
+
+/*
+ * CPU the UDP receive thread is pinned to, -1 leaves it to the scheduler.
+ */
+int AppSettings::receiveCpu() const
+{
+    return value("Network", "receiveCpu", -1).toInt();
+}
+
+void AppSettings::setReceiveCpu(int cpu)
+{
+    setValue("Network", "receiveCpu", cpu);
+}
+
+/*
+ * SCHED_FIFO priority of the UDP receive thread, 0 keeps the normal
+ * scheduler. Needs CAP_SYS_NICE, the engine warns and goes on without it.
+ */
+int AppSettings::receivePriority() const
+{
+    return value("Network", "receivePriority", 0).toInt();
+}
+
+void AppSettings::setReceivePriority(int priority)
+{
+    setValue("Network", "receivePriority", priority);
+}
+
+/*
+ * Exports pulsedata.csv from the acquisition file when an acquisition
+ * stops. Slow for long acquisitions, so off by default.
+ */
+bool AppSettings::exportCsv() const
+{
+    return value("Acquisition", "exportCsv", false).toBool();
+}
+
+void AppSettings::setExportCsv(bool enable)
+{
+    setValue("Acquisition", "exportCsv", enable);
+}
+
+/*
+ * Streams events.fcs next to the acquisition file, for analysis in other
+ * FCS tools. A failure of it does not stop the acquisition file.
+ */
+bool AppSettings::writeFcs() const
+{
+    return value("Acquisition", "writeFcs", true).toBool();
+}
+
+void AppSettings::setWriteFcs(bool enable)
+{
+    setValue("Acquisition", "writeFcs", enable);
+}
+
+/*
+ * Column encoding of events.seekacq, stored as none, fast or strong. Fast
+ * bit packs the integer columns, strong also tries zlib on the rest.
+ */
+ColumnCodec::Mode AppSettings::compression() const
+{
+    const QString mode = value("Acquisition", "compression", "none").toString();
+    if (mode == "strong") {
+        return ColumnCodec::Mode::Strong;
+    }
+    return mode == "fast" ? ColumnCodec::Mode::Fast : ColumnCodec::Mode::None;
+}
+
+void AppSettings::setCompression(ColumnCodec::Mode mode)
+{
+    setValue("Acquisition", "compression", mode == ColumnCodec::Mode::Strong ? "strong"
+                                           : mode == ColumnCodec::Mode::Fast ? "fast" : "none");
+}
+
+/*
+ * Journals the received datagrams to datagrams.seekcap next to the pulse
+ * data, for replaying an acquisition through the parser later.
+ */
+bool AppSettings::captureDatagrams() const
+{
+    return value("Capture", "captureDatagrams", false).toBool();
+}
+
+void AppSettings::setCaptureDatagrams(bool enable)
+{
+    setValue("Capture", "captureDatagrams", enable);
+}
+
+/*
+ * Capture file fed through the parser instead of the socket, empty to
+ * receive from the SoC. Takes precedence over capturing.
+ */
+QString AppSettings::replayFile() const
+{
+    return value("Capture", "replayFile", QString()).toString();
+}
+
+void AppSettings::setReplayFile(const QString &filePath)
+{
+    setValue("Capture", "replayFile", filePath);
+}
+
+/*
+ * Replay rate relative to the recorded timing, 0 for as fast as possible.
+ */
+double AppSettings::replaySpeed() const
+{
+    return value("Capture", "replaySpeed", 1.0).toDouble();
+}
+
+void AppSettings::setReplaySpeed(double speed)
+{
+    setValue("Capture", "replaySpeed", speed);
+}
+
+/*
+ * Target refresh rate of the live plots. The worksheet frame scheduler
+ * lowers it on its own while frames run over their time budget.
+ */
+int AppSettings::frameRate() const
+{
+    return value("Display", "frameRate", 30).toInt();
+}
+
+void AppSettings::setFrameRate(int fps)
+{
+    if (fps == frameRate()) return;
+    setValue("Display", "frameRate", fps);
+    emit frameRateChanged(fps);
+}
@@ -0,0 +1,72 @@
+#ifndef APPSETTINGS_H
+#define APPSETTINGS_H
+
+#include <QObject>
+#include <QVariant>
+#include <QString>
+#include "ColumnCodec.h"
+
+
+/**
+ * @brief Application preferences kept in QSettings("SeekGene", "SeekCytometer").
+ *
+ * Each option has one getter holding its default, so the components and the
+ * preferences dialog agree on it. Values are read from the settings store on
+ * every call, components pick them up when they start.
+ */
+class AppSettings : public QObject
+{
+    Q_OBJECT
+public:
+    static AppSettings &instance() {
+        static AppSettings instance;
+        return instance;
+    }
+    AppSettings &operator=(const AppSettings &) = delete;
+    AppSettings(const AppSettings &) = delete;
+
+    // Network, applied when the UDP client initializes
+    QString socAddress() const;
+    void    setSocAddress(const QString &address);
+    int     socPort() const;
+    void    setSocPort(int port);
+    QString localAddress() const;
+    void    setLocalAddress(const QString &address);
+    int     localPort() const;
+    void    setLocalPort(int port);
+    int     receiveCpu() const;
+    void    setReceiveCpu(int cpu);
+    int     receivePriority() const;
+    void    setReceivePriority(int priority);
+
+    // Acquisition files, applied when an acquisition starts
+    bool    exportCsv() const;
+    void    setExportCsv(bool enable);
+    bool    writeFcs() const;
+    void    setWriteFcs(bool enable);
+    ColumnCodec::Mode compression() const;
+    void    setCompression(ColumnCodec::Mode mode);
+
+    // Datagram capture and replay, applied when an acquisition starts
+    bool    captureDatagrams() const;
+    void    setCaptureDatagrams(bool enable);
+    QString replayFile() const;
+    void    setReplayFile(const QString &filePath);
+    double  replaySpeed() const;
+    void    setReplaySpeed(double speed);
+
+    // Display, applied right away
+    int     frameRate() const;
+    void    setFrameRate(int fps);
+
+signals:
+    void    frameRateChanged(int fps);
+
+private:
+    explicit AppSettings(QObject *parent = nullptr);
+
+    QVariant value(const QString &group, const QString &key, const QVariant &defaultValue) const;
+    void     setValue(const QString &group, const QString &key, const QVariant &value);
+};
+
+#endif // APPSETTINGS_H
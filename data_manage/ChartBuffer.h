@@ -75,7 +75,8 @@ public:
         }
     }
 
-    void writeMultiple(const QVector<T> &data)
+    // overwritten, if given, receives the oldest values the data pushed out of a full buffer
+    void writeMultiple(const QVector<T> &data, QVector<T> *overwritten = nullptr)
     {
         QMutexLocker locker(&m_mutex);
 
@@ -84,6 +85,9 @@ public:
         for (const T& value : data) {
             if (m_size == m_capacity) {
                 const T& old = m_buffer[m_writeIndex];
+                if (overwritten) {
+                    overwritten->append(old);
+                }
                 if (m_hasMinMax && (m_minMax.equal(m_min, old) || m_minMax.equal(m_max, old))) {
                     needRecompute = true;
                 }
@@ -0,0 +1,477 @@
+#include "ChunkSketch.h"
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+using namespace ChunkSketch;
+
+
+namespace {
+
+constexpr int BOUNDARY_SUBBINS = 4;       ///< Per axis, for bins on a curved gate boundary
+
+inline qint64 ceilDiv(qint64 a, qint64 n)
+{
+    return (a + n - 1) / n;
+}
+
+/*
+ * Values of [min, max] fall into bins of equal width, bin b holds the
+ * integers [binLow(b), binHigh(b)], which keeps the coverage tests exact.
+ */
+struct BinLayout
+{
+    qint64  min;
+    qint64  range;
+    int     bins;
+
+    BinLayout(qint32 lo, qint32 hi, int binNum) : min(lo), range(static_cast<qint64>(hi) - lo + 1), bins(binNum) {}
+
+    int    binOf(qint32 v) const { return static_cast<int>((v - min) * bins / range); }
+    qint64 binLow(int b) const { return min + ceilDiv(b * range, bins); }
+    qint64 binHigh(int b) const { return min + ceilDiv((b + 1) * range, bins) - 1; }
+};
+
+/*
+ * Integers of [lo, hi] that are in [low, high], as count, mean and variance
+ * of an even spread over them.
+ */
+struct Overlap
+{
+    qint64  count = 0;
+    double  mean = 0;
+    double  variance = 0;
+
+    Overlap(qint64 lo, qint64 hi, qint64 low, qint64 high) {
+        const qint64 a = qMax(lo, low);
+        const qint64 b = qMin(hi, high);
+        if (b >= a) {
+            count = b - a + 1;
+            mean = (static_cast<double>(a) + b) / 2;
+            variance = (static_cast<double>(count) * count - 1) / 12;
+        }
+    }
+};
+
+template <typename T>
+void put(char *&dst, T value)
+{
+    std::memcpy(dst, &value, sizeof(T));
+    dst += sizeof(T);
+}
+
+template <typename T>
+T take(const uchar *&src)
+{
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    src += sizeof(T);
+    return value;
+}
+
+void buildColumn(const qint32 *values, const quint8 *valid, quint8 mask, int rows, char *dst)
+{
+    quint32 count = 0;
+    qint32 min = std::numeric_limits<qint32>::max();
+    qint32 max = std::numeric_limits<qint32>::min();
+    qint64 sum = 0;
+    for (int i = 0; i < rows; ++i) {
+        if ((valid[i] & mask) != mask) continue;
+        count++;
+        min = qMin(min, values[i]);
+        max = qMax(max, values[i]);
+        sum += values[i];
+    }
+    if (!count) {
+        return;
+    }
+    const double mean = static_cast<double>(sum) / count;
+    double m2 = 0;
+    quint32 bins[COLUMN_BINS] = {};
+    const BinLayout layout(min, max, COLUMN_BINS);
+    for (int i = 0; i < rows; ++i) {
+        if ((valid[i] & mask) != mask) continue;
+        const double d = values[i] - mean;
+        m2 += d * d;
+        bins[layout.binOf(values[i])]++;
+    }
+    put<quint32>(dst, count);
+    put<qint32>(dst, min);
+    put<qint32>(dst, max);
+    put<quint32>(dst, 0);
+    put<double>(dst, mean);
+    put<double>(dst, m2);
+    std::memcpy(dst, bins, sizeof(bins));
+}
+
+void buildPair(const qint32 *x, const qint32 *y, const quint8 *valid, quint8 mask, int rows, char *dst)
+{
+    quint32 count = 0;
+    qint32 minX = std::numeric_limits<qint32>::max(), maxX = std::numeric_limits<qint32>::min();
+    qint32 minY = std::numeric_limits<qint32>::max(), maxY = std::numeric_limits<qint32>::min();
+    qint64 sumX = 0, sumY = 0;
+    for (int i = 0; i < rows; ++i) {
+        if ((valid[i] & mask) != mask) continue;
+        count++;
+        minX = qMin(minX, x[i]);
+        maxX = qMax(maxX, x[i]);
+        minY = qMin(minY, y[i]);
+        maxY = qMax(maxY, y[i]);
+        sumX += x[i];
+        sumY += y[i];
+    }
+    if (!count) {
+        return;
+    }
+    const double meanX = static_cast<double>(sumX) / count;
+    const double meanY = static_cast<double>(sumY) / count;
+    double m2X = 0, m2Y = 0;
+    quint32 bins[PAIR_BINS * PAIR_BINS] = {};
+    const BinLayout layoutX(minX, maxX, PAIR_BINS);
+    const BinLayout layoutY(minY, maxY, PAIR_BINS);
+    for (int i = 0; i < rows; ++i) {
+        if ((valid[i] & mask) != mask) continue;
+        const double dx = x[i] - meanX;
+        const double dy = y[i] - meanY;
+        m2X += dx * dx;
+        m2Y += dy * dy;
+        bins[layoutY.binOf(y[i]) * PAIR_BINS + layoutX.binOf(x[i])]++;
+    }
+    put<quint32>(dst, count);
+    put<qint32>(dst, minX);
+    put<qint32>(dst, maxX);
+    put<qint32>(dst, minY);
+    put<qint32>(dst, maxY);
+    put<quint32>(dst, 0);
+    put<double>(dst, meanX);
+    put<double>(dst, m2X);
+    put<double>(dst, meanY);
+    put<double>(dst, m2Y);
+    std::memcpy(dst, bins, sizeof(bins));
+}
+
+quint8 channelMask(const EventBatch &chunk, int valueColumn)
+{
+    return EventBatch::channelBit(chunk.enabledChannels().at(valueColumn / EventBatch::MEASUREMENT_NUM));
+}
+
+const qint32 *valueData(const EventBatch &chunk, int valueColumn)
+{
+    return chunk.columnAt(valueColumn / EventBatch::MEASUREMENT_NUM, valueColumn % EventBatch::MEASUREMENT_NUM);
+}
+
+/*
+ * Quadrant of a quadrant gate holding the whole box, -1 if the box spans
+ * the origin.
+ */
+int quadrantOf(const CompiledGate &gate, double minX, double maxX, double minY, double maxY)
+{
+    const CompiledGate::Quadrant low = gate.quadrant(minX, minY);
+    return low == gate.quadrant(maxX, maxY) ? static_cast<int>(low) : -1;
+}
+
+} // namespace
+
+
+PairSketch PairSketch::transposed() const
+{
+    PairSketch t;
+    t.count = count;
+    t.minX = minY;
+    t.maxX = maxY;
+    t.minY = minX;
+    t.maxY = maxX;
+    t.meanX = meanY;
+    t.m2X = m2Y;
+    t.meanY = meanX;
+    t.m2Y = m2X;
+    if (bins.size() == PAIR_BINS * PAIR_BINS) {
+        t.bins.resize(bins.size());
+        for (int by = 0; by < PAIR_BINS; ++by) {
+            for (int bx = 0; bx < PAIR_BINS; ++bx) {
+                t.bins[bx * PAIR_BINS + by] = bins.at(by * PAIR_BINS + bx);
+            }
+        }
+    }
+    return t;
+}
+
+
+QVector<SketchPair> ChunkSketch::defaultPairs(int channelNum)
+{
+    const int height = EventBatch::measurementIndex(MeasurementType::Height);
+    const int area = EventBatch::measurementIndex(MeasurementType::Area);
+    QVector<SketchPair> pairs;
+    for (int ch = 0; ch < channelNum; ++ch) {
+        pairs.append({ch * EventBatch::MEASUREMENT_NUM + height, ch * EventBatch::MEASUREMENT_NUM + area});
+    }
+    for (int chX = 0; chX < channelNum; ++chX) {
+        for (int chY = chX + 1; chY < channelNum; ++chY) {
+            pairs.append({chX * EventBatch::MEASUREMENT_NUM + height, chY * EventBatch::MEASUREMENT_NUM + height});
+        }
+    }
+    return pairs;
+}
+
+void ChunkSketch::build(const EventBatch &chunk, const QVector<SketchPair> &pairs, QByteArray &out)
+{
+    const int channelNum = chunk.channelCount();
+    const int valueColumns = channelNum * EventBatch::MEASUREMENT_NUM;
+    out.resize(payloadSize(channelNum, pairs.size()));
+    out.fill('\0');
+
+    char *dst = out.data();
+    for (int v = 0; v < valueColumns; ++v) {
+        buildColumn(valueData(chunk, v), chunk.chPulseValid(), channelMask(chunk, v), chunk.size(), dst);
+        dst += COLUMN_RECORD_SIZE;
+    }
+    for (const SketchPair &pair : pairs) {
+        const quint8 mask = channelMask(chunk, pair.valueX) | channelMask(chunk, pair.valueY);
+        buildPair(valueData(chunk, pair.valueX), valueData(chunk, pair.valueY), chunk.chPulseValid(), mask, chunk.size(), dst);
+        dst += PAIR_RECORD_SIZE;
+    }
+}
+
+bool ChunkSketch::readColumn(const uchar *payload, int valueColumn, ColumnSketch &sketch)
+{
+    const uchar *src = payload + static_cast<qint64>(valueColumn) * COLUMN_RECORD_SIZE;
+    sketch.count = take<quint32>(src);
+    sketch.min = take<qint32>(src);
+    sketch.max = take<qint32>(src);
+    src += 4;
+    sketch.mean = take<double>(src);
+    sketch.m2 = take<double>(src);
+    sketch.bins.resize(COLUMN_BINS);
+    std::memcpy(sketch.bins.data(), src, COLUMN_BINS * 4);
+    return sketch.count == 0 || sketch.min <= sketch.max;
+}
+
+bool ChunkSketch::readPair(const uchar *payload, int channelNum, int pairIndex, PairSketch &sketch)
+{
+    const uchar *src = payload + payloadSize(channelNum, 0) + static_cast<qint64>(pairIndex) * PAIR_RECORD_SIZE;
+    sketch.count = take<quint32>(src);
+    sketch.minX = take<qint32>(src);
+    sketch.maxX = take<qint32>(src);
+    sketch.minY = take<qint32>(src);
+    sketch.maxY = take<qint32>(src);
+    src += 4;
+    sketch.meanX = take<double>(src);
+    sketch.m2X = take<double>(src);
+    sketch.meanY = take<double>(src);
+    sketch.m2Y = take<double>(src);
+    sketch.bins.resize(PAIR_BINS * PAIR_BINS);
+    std::memcpy(sketch.bins.data(), src, PAIR_BINS * PAIR_BINS * 4);
+    return sketch.count == 0 || (sketch.minX <= sketch.maxX && sketch.minY <= sketch.maxY);
+}
+
+/*
+ * The bounds decide most chunks, the bins the rest: a chunk whose
+ * non-empty bins all lie inside (outside) the range is Inside (Outside).
+ */
+Coverage ChunkSketch::coverage(const ColumnSketch &sketch, qint32 low, qint32 high)
+{
+    if (!sketch.count || sketch.max < low || sketch.min > high) {
+        return Coverage::Outside;
+    }
+    if (sketch.min >= low && sketch.max <= high) {
+        return Coverage::Inside;
+    }
+    const BinLayout layout(sketch.min, sketch.max, COLUMN_BINS);
+    bool inside = true, outside = true;
+    for (int b = 0; b < COLUMN_BINS; ++b) {
+        if (!sketch.bins.at(b)) continue;
+        const qint64 lo = layout.binLow(b), hi = layout.binHigh(b);
+        inside &= (lo >= low && hi <= high);
+        outside &= (hi < low || lo > high);
+    }
+    return inside ? Coverage::Inside : (outside ? Coverage::Outside : Coverage::Partial);
+}
+
+Coverage ChunkSketch::coverage(const PairSketch &sketch, const CompiledGate &gate)
+{
+    if (!sketch.count) {
+        return Coverage::Outside;
+    }
+    if (gate.isQuadrant()) {
+        return quadrantOf(gate, sketch.minX, sketch.maxX, sketch.minY, sketch.maxY) >= 0 ? Coverage::Inside : Coverage::Partial;
+    }
+    const Coverage bounds = gate.coverage(sketch.minX, sketch.maxX, sketch.minY, sketch.maxY);
+    if (bounds != Coverage::Partial) {
+        return bounds;
+    }
+    const BinLayout layoutX(sketch.minX, sketch.maxX, PAIR_BINS);
+    const BinLayout layoutY(sketch.minY, sketch.maxY, PAIR_BINS);
+    bool inside = true, outside = true;
+    for (int by = 0; by < PAIR_BINS && (inside || outside); ++by) {
+        const qint64 loY = layoutY.binLow(by), hiY = layoutY.binHigh(by);
+        for (int bx = 0; bx < PAIR_BINS; ++bx) {
+            if (!sketch.bins.at(by * PAIR_BINS + bx)) continue;
+            const Coverage bin = gate.coverage(layoutX.binLow(bx), layoutX.binHigh(bx), loY, hiY);
+            inside &= (bin == Coverage::Inside);
+            outside &= (bin == Coverage::Outside);
+        }
+    }
+    return inside ? Coverage::Inside : (outside ? Coverage::Outside : Coverage::Partial);
+}
+
+void ChunkSketch::addInside(const ColumnSketch &sketch, RangeStats &stats)
+{
+    if (!sketch.count) return;
+    const double d = sketch.mean - stats.origin[0];
+    stats.count += sketch.count;
+    stats.sum[0] += sketch.count * d;
+    stats.sumSq[0] += sketch.m2 + sketch.count * d * d;
+}
+
+void ChunkSketch::addInside(const PairSketch &sketch, RangeStats &stats)
+{
+    if (!sketch.count) return;
+    const double dx = sketch.meanX - stats.origin[0];
+    const double dy = sketch.meanY - stats.origin[1];
+    stats.count += sketch.count;
+    stats.sum[0] += sketch.count * dx;
+    stats.sum[1] += sketch.count * dy;
+    stats.sumSq[0] += sketch.m2X + sketch.count * dx * dx;
+    stats.sumSq[1] += sketch.m2Y + sketch.count * dy * dy;
+}
+
+void ChunkSketch::addEstimate(const ColumnSketch &sketch, qint32 low, qint32 high, RangeStats &stats)
+{
+    if (!sketch.count || sketch.bins.size() != COLUMN_BINS) return;
+    const BinLayout layout(sketch.min, sketch.max, COLUMN_BINS);
+    double n = 0, sum = 0, sumSq = 0;
+    for (int b = 0; b < COLUMN_BINS; ++b) {
+        if (!sketch.bins.at(b)) continue;
+        const qint64 lo = layout.binLow(b), hi = layout.binHigh(b);
+        const Overlap overlap(lo, hi, low, high);
+        if (!overlap.count) continue;
+        const double part = sketch.bins.at(b) * static_cast<double>(overlap.count) / (hi - lo + 1);
+        const double d = overlap.mean - stats.origin[0];
+        n += part;
+        sum += part * d;
+        sumSq += part * (d * d + overlap.variance);
+    }
+    const quint64 count = qRound64(n);
+    if (!count) return;
+    const double scale = count / n;
+    stats.count += count;
+    stats.sum[0] += sum * scale;
+    stats.sumSq[0] += sumSq * scale;
+}
+
+void ChunkSketch::addEstimate(const PairSketch &sketch, const CompiledGate &gate, RangeStats &stats)
+{
+    if (!sketch.count || sketch.bins.size() != PAIR_BINS * PAIR_BINS) return;
+    const BinLayout layoutX(sketch.minX, sketch.maxX, PAIR_BINS);
+    const BinLayout layoutY(sketch.minY, sketch.maxY, PAIR_BINS);
+    double n = 0, sumX = 0, sumY = 0, sumSqX = 0, sumSqY = 0;
+    const auto add = [&](double part, const Overlap &overlapX, const Overlap &overlapY) {
+        const double dx = overlapX.mean - stats.origin[0];
+        const double dy = overlapY.mean - stats.origin[1];
+        n += part;
+        sumX += part * dx;
+        sumY += part * dy;
+        sumSqX += part * (dx * dx + overlapX.variance);
+        sumSqY += part * (dy * dy + overlapY.variance);
+    };
+    for (int by = 0; by < PAIR_BINS; ++by) {
+        const qint64 loY = layoutY.binLow(by), hiY = layoutY.binHigh(by);
+        for (int bx = 0; bx < PAIR_BINS; ++bx) {
+            const quint32 cell = sketch.bins.at(by * PAIR_BINS + bx);
+            if (!cell) continue;
+            const qint64 loX = layoutX.binLow(bx), hiX = layoutX.binHigh(bx);
+            const Coverage coverage = gate.coverage(loX, hiX, loY, hiY);
+            if (coverage == Coverage::Outside) {
+                continue;
+            }
+            if (coverage == Coverage::Inside) {
+                add(cell, Overlap(loX, hiX, loX, hiX), Overlap(loY, hiY, loY, hiY));
+            } else if (gate.type() == GateType::RectangleGate) {
+                const Overlap overlapX(loX, hiX, gate.low().x(), gate.high().x());
+                const Overlap overlapY(loY, hiY, gate.low().y(), gate.high().y());
+                if (!overlapX.count || !overlapY.count) continue;
+                add(cell * (static_cast<double>(overlapX.count) / (hiX - loX + 1))
+                        * (static_cast<double>(overlapY.count) / (hiY - loY + 1)), overlapX, overlapY);
+            } else {
+                // Boundary bin of a curved or slanted gate: test the centres of a sub grid
+                const BinLayout subX(static_cast<qint32>(loX), static_cast<qint32>(hiX), BOUNDARY_SUBBINS);
+                const BinLayout subY(static_cast<qint32>(loY), static_cast<qint32>(hiY), BOUNDARY_SUBBINS);
+                for (int sy = 0; sy < BOUNDARY_SUBBINS; ++sy) {
+                    const Overlap overlapY(subY.binLow(sy), subY.binHigh(sy), subY.binLow(sy), subY.binHigh(sy));
+                    if (!overlapY.count) continue;
+                    for (int sx = 0; sx < BOUNDARY_SUBBINS; ++sx) {
+                        const Overlap overlapX(subX.binLow(sx), subX.binHigh(sx), subX.binLow(sx), subX.binHigh(sx));
+                        if (overlapX.count && gate.contains(overlapX.mean, overlapY.mean)) {
+                            add(cell * (static_cast<double>(overlapX.count) / (hiX - loX + 1))
+                                    * (static_cast<double>(overlapY.count) / (hiY - loY + 1)), overlapX, overlapY);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    const quint64 count = qRound64(n);
+    if (!count) return;
+    const double scale = count / n;
+    stats.count += count;
+    stats.sum[0] += sumX * scale;
+    stats.sum[1] += sumY * scale;
+    stats.sumSq[0] += sumSqX * scale;
+    stats.sumSq[1] += sumSqY * scale;
+}
+
+void ChunkSketch::addEstimate(const ColumnSketch &x, const ColumnSketch &y, const CompiledGate &gate, RangeStats &stats)
+{
+    if (!x.count || !y.count) return;
+    RangeStats estX, estY;
+    estX.origin[0] = stats.origin[0];
+    estY.origin[0] = stats.origin[1];
+    addEstimate(x, gate.low().x(), gate.high().x(), estX);
+    addEstimate(y, gate.low().y(), gate.high().y(), estY);
+    if (!estX.count || !estY.count) return;
+
+    const double fraction = (static_cast<double>(estX.count) / x.count) * (static_cast<double>(estY.count) / y.count)
+                            * gate.fillRatio();
+    const quint64 count = qRound64(qMin(x.count, y.count) * fraction);
+    if (!count) return;
+    stats.count += count;
+    stats.sum[0] += estX.sum[0] / estX.count * count;
+    stats.sum[1] += estY.sum[0] / estY.count * count;
+    stats.sumSq[0] += estX.sumSq[0] / estX.count * count;
+    stats.sumSq[1] += estY.sumSq[0] / estY.count * count;
+}
+
+void ChunkSketch::addQuadrants(const PairSketch &sketch, const CompiledGate &gate, QuadrantCounts &counts)
+{
+    if (!sketch.count || !gate.isQuadrant()) return;
+    const int whole = quadrantOf(gate, sketch.minX, sketch.maxX, sketch.minY, sketch.maxY);
+    if (whole >= 0) {
+        counts.count[whole] += sketch.count;
+        return;
+    }
+    if (sketch.bins.size() != PAIR_BINS * PAIR_BINS) return;
+
+    // Integers right of (above) the origin start at its ceiling
+    const qint64 right = static_cast<qint64>(std::ceil(gate.origin(0)));
+    const qint64 upper = static_cast<qint64>(std::ceil(gate.origin(1)));
+    const BinLayout layoutX(sketch.minX, sketch.maxX, PAIR_BINS);
+    const BinLayout layoutY(sketch.minY, sketch.maxY, PAIR_BINS);
+    double quadrants[4] = {0, 0, 0, 0};
+    for (int by = 0; by < PAIR_BINS; ++by) {
+        const qint64 loY = layoutY.binLow(by), hiY = layoutY.binHigh(by);
+        const double up = static_cast<double>(Overlap(loY, hiY, upper, hiY).count) / (hiY - loY + 1);
+        for (int bx = 0; bx < PAIR_BINS; ++bx) {
+            const quint32 cell = sketch.bins.at(by * PAIR_BINS + bx);
+            if (!cell) continue;
+            const qint64 loX = layoutX.binLow(bx), hiX = layoutX.binHigh(bx);
+            const double r = static_cast<double>(Overlap(loX, hiX, right, hiX).count) / (hiX - loX + 1);
+            quadrants[CompiledGate::LowerLeft] += cell * (1 - r) * (1 - up);
+            quadrants[CompiledGate::LowerRight] += cell * r * (1 - up);
+            quadrants[CompiledGate::UpperLeft] += cell * (1 - r) * up;
+            quadrants[CompiledGate::UpperRight] += cell * r * up;
+        }
+    }
+    for (int q = 0; q < 4; ++q) {
+        counts.count[q] += static_cast<quint64>(qRound64(quadrants[q]));
+    }
+}
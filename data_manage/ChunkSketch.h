@@ -0,0 +1,133 @@
+#ifndef CHUNKSKETCH_H
+#define CHUNKSKETCH_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QPoint>
+#include "EventBatch.h"
+#include "EventKernels.h"
+#include "CompiledGate.h"
+
+
+/**
+ * @brief Summary of one measurement column of a chunk, over the rows with a valid pulse on its channel.
+ *
+ * bins[] counts the values over COLUMN_BINS equal bins of [min, max].
+ */
+struct ColumnSketch
+{
+    quint32             count = 0;
+    qint32              min = 0;
+    qint32              max = 0;
+    double              mean = 0;
+    double              m2 = 0;             ///< Sum of squared deviations from mean
+    QVector<quint32>    bins;
+};
+
+/**
+ * @brief Summary of two measurement columns of a chunk, over the rows valid on both channels.
+ *
+ * bins[] is a PAIR_BINS x PAIR_BINS grid over [minX, maxX] x [minY, maxY], row y * PAIR_BINS + x.
+ */
+struct PairSketch
+{
+    quint32             count = 0;
+    qint32              minX = 0;
+    qint32              maxX = 0;
+    qint32              minY = 0;
+    qint32              maxY = 0;
+    double              meanX = 0;
+    double              m2X = 0;
+    double              meanY = 0;
+    double              m2Y = 0;
+    QVector<quint32>    bins;
+
+    PairSketch transposed() const;
+};
+
+/**
+ * @brief Measurement columns a pair sketch is kept for, indexes of the value columns (channel index * 3 + measurement).
+ */
+struct SketchPair
+{
+    int valueX;
+    int valueY;
+};
+
+
+/**
+ * @brief Per chunk sketches of the acquisition file.
+ *
+ * Every chunk carries the ColumnSketch of all measurement columns and the
+ * PairSketch of the configured column pairs. Gate statistics on a recorded
+ * file use them to take whole chunks as inside or outside a gate without
+ * reading their events, only chunks on the gate boundary are scanned.
+ * Until they are, the bins give an estimate of their part.
+ *
+ * Sketch payload: column records, one per measurement column, then pair
+ * records, one per pair, all little endian:
+ *   column: count u32 | min i32 | max i32 | reserved u32 | mean f64 | m2 f64 | COLUMN_BINS * u32
+ *   pair:   count u32 | minX i32 | maxX i32 | minY i32 | maxY i32 | reserved u32
+ *           | meanX f64 | m2X f64 | meanY f64 | m2Y f64 | PAIR_BINS * PAIR_BINS * u32
+ */
+namespace ChunkSketch {
+
+constexpr quint32   MAGIC = 0x31544B53;         // "SKT1"
+constexpr int       COLUMN_BINS = 32;
+constexpr int       PAIR_BINS = 16;
+constexpr int       COLUMN_RECORD_SIZE = 32 + COLUMN_BINS * 4;
+constexpr int       PAIR_RECORD_SIZE = 56 + PAIR_BINS * PAIR_BINS * 4;
+
+using Coverage = CompiledGate::Coverage;
+
+/**
+ * @brief Height/area of every channel and the heights of every two channels.
+ */
+QVector<SketchPair> defaultPairs(int channelNum);
+
+inline qint64 payloadSize(int channelNum, int pairNum) {
+    return static_cast<qint64>(channelNum) * EventBatch::MEASUREMENT_NUM * COLUMN_RECORD_SIZE
+           + static_cast<qint64>(pairNum) * PAIR_RECORD_SIZE;
+}
+
+void    build(const EventBatch &chunk, const QVector<SketchPair> &pairs, QByteArray &out);
+bool    readColumn(const uchar *payload, int valueColumn, ColumnSketch &sketch);
+bool    readPair(const uchar *payload, int channelNum, int pairIndex, PairSketch &sketch);
+
+Coverage coverage(const ColumnSketch &sketch, qint32 low, qint32 high);
+/*
+ * For a quadrant gate a chunk is Inside when all its events fall into one
+ * quadrant, the gate itself holds every event.
+ */
+Coverage coverage(const PairSketch &sketch, const CompiledGate &gate);
+
+/*
+ * Adds a chunk that is Inside the range to stats, exactly. stats.origin
+ * must be set to the origin the gate accumulates relative to.
+ */
+void    addInside(const ColumnSketch &sketch, RangeStats &stats);
+void    addInside(const PairSketch &sketch, RangeStats &stats);
+
+/*
+ * Adds the estimated part of a Partial chunk to stats, from the bins
+ * overlapping the range, assuming values spread evenly inside a bin.
+ * Bins on the boundary of a polygon or ellipse are sampled on a sub grid.
+ */
+void    addEstimate(const ColumnSketch &sketch, qint32 low, qint32 high, RangeStats &stats);
+void    addEstimate(const PairSketch &sketch, const CompiledGate &gate, RangeStats &stats);
+
+/*
+ * Estimate of a 2D gate without pair sketch, taking the two columns as
+ * independent and the gate as filling fillRatio() of its bounds.
+ */
+void    addEstimate(const ColumnSketch &x, const ColumnSketch &y, const CompiledGate &gate, RangeStats &stats);
+
+/*
+ * Adds the events of the chunk per quadrant of a quadrant gate, exact for
+ * an Inside chunk, bins across the origin are split evenly.
+ */
+void    addQuadrants(const PairSketch &sketch, const CompiledGate &gate, QuadrantCounts &counts);
+
+} // namespace ChunkSketch
+
+#endif // CHUNKSKETCH_H
@@ -0,0 +1,387 @@
+#include "ColumnCodec.h"
+#include <QVector>
+#include <array>
+#include <cstring>
+#include <utility>
+
+using namespace ColumnCodec;
+
+
+namespace {
+
+using PackFn = void (*)(const quint32 *in, quint32 *out);
+
+inline quint32 zigzag(quint32 delta)
+{
+    const qint32 d = static_cast<qint32>(delta);
+    return (static_cast<quint32>(d) << 1) ^ static_cast<quint32>(d >> 31);
+}
+
+inline quint32 unzigzag(quint32 z)
+{
+    return (z >> 1) ^ (0u - (z & 1u));
+}
+
+inline int bitWidth(quint32 v)
+{
+    return v ? 32 - qCountLeadingZeroBits(v) : 0;
+}
+
+inline int alignedWidths(int blocks)
+{
+    return (blocks + 3) & ~3;
+}
+
+/*
+ * Packs BLOCK_SIZE values of W bits into 4 * W words.
+ */
+template <int W>
+void pack(const quint32 *in, quint32 *out)
+{
+    if constexpr (W > 0) {
+        quint64 acc = 0;
+        int bits = 0;
+        for (int i = 0; i < BLOCK_SIZE; ++i) {
+            acc |= static_cast<quint64>(in[i]) << bits;
+            bits += W;
+            if (bits >= 32) {
+                *out++ = static_cast<quint32>(acc);
+                acc >>= 32;
+                bits -= 32;
+            }
+        }
+    }
+}
+
+/*
+ * Value I of a block of W bit values, read as one 64 bit window. Word index
+ * and shift are constants, so the unrolled block needs no shift counts.
+ */
+template <int W, int I>
+inline void unpackValue(const quint32 *in, quint32 *out)
+{
+    constexpr int bit = I * W;
+    constexpr quint64 mask = (W == 32) ? 0xFFFFFFFFull : ((1ull << W) - 1);
+    const quint64 window = static_cast<quint64>(in[bit >> 5]) | (static_cast<quint64>(in[(bit >> 5) + 1]) << 32);
+    out[I] = static_cast<quint32>((window >> (bit & 31)) & mask);
+}
+
+template <int W, std::size_t... I>
+inline void unpackValues(const quint32 *in, quint32 *out, std::index_sequence<I...>)
+{
+    (unpackValue<W, static_cast<int>(I)>(in, out), ...);
+}
+
+/*
+ * in holds 4 * W words plus one word of slack, so every value is read as
+ * one 64 bit window without a bounds check.
+ */
+template <int W>
+void unpack(const quint32 *in, quint32 *out)
+{
+    if constexpr (W == 0) {
+        std::fill(out, out + BLOCK_SIZE, 0u);
+    } else {
+        unpackValues<W>(in, out, std::make_index_sequence<BLOCK_SIZE>{});
+    }
+}
+
+template <std::size_t... W>
+constexpr std::array<PackFn, sizeof...(W)> packTable(std::index_sequence<W...>)
+{
+    return {{&pack<static_cast<int>(W)>...}};
+}
+
+template <std::size_t... W>
+constexpr std::array<PackFn, sizeof...(W)> unpackTable(std::index_sequence<W...>)
+{
+    return {{&unpack<static_cast<int>(W)>...}};
+}
+
+constexpr std::array<PackFn, 33> packKernels = packTable(std::make_index_sequence<33>{});
+constexpr std::array<PackFn, 33> unpackKernels = unpackTable(std::make_index_sequence<33>{});
+
+
+/*
+ * Block values relative to ref, the tail of a short block is zero.
+ */
+void transformBlock(const quint32 *values, int n, bool delta, quint32 ref, quint32 *block)
+{
+    if (delta) {
+        quint32 prev = ref;
+        for (int i = 0; i < n; ++i) {
+            block[i] = zigzag(values[i] - prev);
+            prev = values[i];
+        }
+    } else {
+        for (int i = 0; i < n; ++i) {
+            block[i] = values[i] - ref;
+        }
+    }
+    std::fill(block + n, block + BLOCK_SIZE, 0u);
+}
+
+quint32 blockReference(const quint32 *values, int n, bool delta, bool isSigned)
+{
+    if (delta) {
+        return values[0];
+    }
+    if (isSigned) {
+        qint32 min = static_cast<qint32>(values[0]);
+        for (int i = 1; i < n; ++i) {
+            min = qMin(min, static_cast<qint32>(values[i]));
+        }
+        return static_cast<quint32>(min);
+    }
+    quint32 min = values[0];
+    for (int i = 1; i < n; ++i) {
+        min = qMin(min, values[i]);
+    }
+    return min;
+}
+
+/*
+ * Bit width and reference of every block, returns the payload size.
+ */
+qint64 planPacked(const quint32 *values, int count, bool delta, bool isSigned, QVector<quint8> &widths, QVector<quint32> &refs)
+{
+    const int blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    widths.resize(blocks);
+    refs.resize(blocks);
+    quint32 block[BLOCK_SIZE];
+    qint64 size = alignedWidths(blocks) + static_cast<qint64>(blocks) * 4;
+    for (int b = 0; b < blocks; ++b) {
+        const quint32 *v = values + b * BLOCK_SIZE;
+        const int n = qMin(BLOCK_SIZE, count - b * BLOCK_SIZE);
+        refs[b] = blockReference(v, n, delta, isSigned);
+        transformBlock(v, n, delta, refs[b], block);
+        quint32 bits = 0;
+        for (int i = 0; i < n; ++i) {
+            bits |= block[i];
+        }
+        widths[b] = static_cast<quint8>(bitWidth(bits));
+        size += widths[b] * 16;
+    }
+    return size;
+}
+
+void encodePacked(const quint32 *values, int count, bool delta, const QVector<quint8> &widths,
+                  const QVector<quint32> &refs, qint64 size, QByteArray &out)
+{
+    const int blocks = widths.size();
+    out.resize(size);
+    out.fill('\0');
+    char *dst = out.data();
+    std::memcpy(dst, widths.constData(), blocks);
+    std::memcpy(dst + alignedWidths(blocks), refs.constData(), blocks * 4);
+    char *words = dst + alignedWidths(blocks) + blocks * 4;
+
+    quint32 block[BLOCK_SIZE];
+    quint32 packed[BLOCK_SIZE];
+    for (int b = 0; b < blocks; ++b) {
+        const int n = qMin(BLOCK_SIZE, count - b * BLOCK_SIZE);
+        transformBlock(values + b * BLOCK_SIZE, n, delta, refs.at(b), block);
+        packKernels[widths.at(b)](block, packed);
+        std::memcpy(words, packed, widths.at(b) * 16);
+        words += widths.at(b) * 16;
+    }
+}
+
+bool decodePacked(const uchar *data, qint64 size, int count, bool delta, quint32 *out)
+{
+    const int blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const qint64 headerSize = alignedWidths(blocks) + static_cast<qint64>(blocks) * 4;
+    if (size < headerSize) {
+        return false;
+    }
+    const uchar *widths = data;
+    const uchar *refs = data + alignedWidths(blocks);
+    const uchar *words = data + headerSize;
+    const uchar *end = data + size;
+
+    quint32 packed[BLOCK_SIZE + 1];
+    quint32 block[BLOCK_SIZE];
+    for (int b = 0; b < blocks; ++b) {
+        const int width = widths[b];
+        const int n = qMin(BLOCK_SIZE, count - b * BLOCK_SIZE);
+        if (width > 32 || words + width * 16 > end) {
+            return false;
+        }
+        std::memcpy(packed, words, width * 16);
+        packed[width * 4] = 0;
+        words += width * 16;
+        unpackKernels[width](packed, block);
+
+        quint32 ref;
+        std::memcpy(&ref, refs + b * 4, sizeof(ref));
+        quint32 *dst = out + b * BLOCK_SIZE;
+        if (delta) {
+            quint32 value = ref;
+            for (int i = 0; i < n; ++i) {
+                value += unzigzag(block[i]);
+                dst[i] = value;
+            }
+        } else {
+            for (int i = 0; i < n; ++i) {
+                dst[i] = block[i] + ref;
+            }
+        }
+    }
+    return true;
+}
+
+int runCount(const quint8 *values, int count)
+{
+    int runs = count > 0 ? 1 : 0;
+    for (int i = 1; i < count; ++i) {
+        runs += values[i] != values[i - 1];
+    }
+    return runs;
+}
+
+void encodeRunLength(const quint8 *values, int count, int runs, QByteArray &out)
+{
+    out.resize(4 + static_cast<qsizetype>(runs) * 5);
+    char *dst = out.data();
+    const quint32 runNum = runs;
+    std::memcpy(dst, &runNum, 4);
+    char *lengths = dst + 4;
+    char *runValues = lengths + runs * 4;
+    int run = 0;
+    int start = 0;
+    for (int i = 1; i <= count; ++i) {
+        if (i == count || values[i] != values[start]) {
+            const quint32 length = i - start;
+            std::memcpy(lengths + run * 4, &length, 4);
+            runValues[run] = static_cast<char>(values[start]);
+            run++;
+            start = i;
+        }
+    }
+}
+
+bool decodeRunLength(const uchar *data, qint64 size, int count, quint8 *out)
+{
+    quint32 runs;
+    if (size < 4) {
+        return false;
+    }
+    std::memcpy(&runs, data, 4);
+    if (size < 4 + static_cast<qint64>(runs) * 5) {
+        return false;
+    }
+    const uchar *lengths = data + 4;
+    const uchar *values = lengths + runs * 4;
+    int row = 0;
+    for (quint32 run = 0; run < runs; ++run) {
+        quint32 length;
+        std::memcpy(&length, lengths + run * 4, 4);
+        if (row + static_cast<qint64>(length) > count) {
+            return false;
+        }
+        std::memset(out + row, values[run], length);
+        row += length;
+    }
+    return row == count;
+}
+
+} // namespace
+
+
+Codec ColumnCodec::encode(const void *values, int count, int valueSize, bool isSigned, Mode mode, QByteArray &out)
+{
+    out.clear();
+    if (mode == Mode::None || count <= 0) {
+        return Raw;
+    }
+
+    const qint64 rawSize = static_cast<qint64>(count) * valueSize;
+    Codec codec = Raw;
+    qint64 best = rawSize;
+
+    QVector<quint8> deltaWidths, forWidths;
+    QVector<quint32> deltaRefs, forRefs;
+    int runs = 0;
+    if (valueSize == 1) {
+        runs = runCount(static_cast<const quint8 *>(values), count);
+        if (4 + static_cast<qint64>(runs) * 5 < best) {
+            codec = RunLength;
+            best = 4 + static_cast<qint64>(runs) * 5;
+        }
+    } else {
+        const quint32 *v = static_cast<const quint32 *>(values);
+        const qint64 deltaSize = planPacked(v, count, true, isSigned, deltaWidths, deltaRefs);
+        const qint64 forSize = planPacked(v, count, false, isSigned, forWidths, forRefs);
+        if (deltaSize < best) {
+            codec = DeltaPack;
+            best = deltaSize;
+        }
+        if (forSize < best) {
+            codec = ForPack;
+            best = forSize;
+        }
+    }
+
+    // The integer codecs barely help, let zlib try
+    if (mode == Mode::Strong && best > rawSize * 3 / 4) {
+        QByteArray compressed = qCompress(QByteArray::fromRawData(static_cast<const char *>(values), rawSize));
+        if (compressed.size() < best) {
+            out = compressed;
+            return Zlib;
+        }
+    }
+
+    switch (codec) {
+    case DeltaPack:
+        encodePacked(static_cast<const quint32 *>(values), count, true, deltaWidths, deltaRefs, best, out);
+        break;
+    case ForPack:
+        encodePacked(static_cast<const quint32 *>(values), count, false, forWidths, forRefs, best, out);
+        break;
+    case RunLength:
+        encodeRunLength(static_cast<const quint8 *>(values), count, runs, out);
+        break;
+    default:
+        break;
+    }
+    return codec;
+}
+
+bool ColumnCodec::decode(Codec codec, const uchar *data, qint64 size, int count, int valueSize, void *out)
+{
+    const qint64 rawSize = static_cast<qint64>(count) * valueSize;
+    switch (codec) {
+    case Raw:
+        if (size < rawSize) {
+            return false;
+        }
+        std::memcpy(out, data, rawSize);
+        return true;
+    case DeltaPack:
+    case ForPack:
+        return valueSize == 4 && decodePacked(data, size, count, codec == DeltaPack, static_cast<quint32 *>(out));
+    case RunLength:
+        return valueSize == 1 && decodeRunLength(data, size, count, static_cast<quint8 *>(out));
+    case Zlib: {
+        const QByteArray raw = qUncompress(data, static_cast<qsizetype>(size));
+        if (raw.size() != rawSize) {
+            return false;
+        }
+        std::memcpy(out, raw.constData(), rawSize);
+        return true;
+    }
+    }
+    return false;
+}
+
+const char *ColumnCodec::codecName(Codec codec)
+{
+    switch (codec) {
+    case Raw:       return "raw";
+    case DeltaPack: return "delta";
+    case ForPack:   return "for";
+    case RunLength: return "rle";
+    case Zlib:      return "zlib";
+    }
+    return "unknown";
+}
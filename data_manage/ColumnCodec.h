@@ -0,0 +1,62 @@
+#ifndef COLUMNCODEC_H
+#define COLUMNCODEC_H
+
+#include <QByteArray>
+
+
+/**
+ * @brief Encodings of one acquisition file column block.
+ *
+ * 32 bit columns are cut into blocks of 128 values, every block stores a
+ * reference value and a bit width and its values bit packed:
+ *   DeltaPack  zigzag encoded differences to the previous value, for the
+ *              monotonic event id and time columns
+ *   ForPack    offsets to the block minimum (frame of reference), for
+ *              measurements that cluster
+ * 8 bit columns (flags, pulse valid) are run length encoded. Zlib is the
+ * general purpose fallback for columns the integer codecs do not shrink.
+ *
+ * Payload of the packed codecs: bit width u8 per block, padded to 4 bytes
+ * | reference u32 per block | packed words, 4 * width words per block.
+ * Payload of RunLength: run count u32 | run lengths u32 | run values u8.
+ * Payload of Zlib: qCompress() of the raw values.
+ *
+ * The unpack kernels are scalar, one instantiation per bit width with the
+ * block fully unrolled so every word index and shift is a constant. There
+ * is no SIMD path, SSE2 has no per lane shift counts for this layout.
+ */
+namespace ColumnCodec {
+
+enum Codec : quint32 {
+    Raw         = 0,
+    DeltaPack   = 1,
+    ForPack     = 2,
+    RunLength   = 3,
+    Zlib        = 4,
+};
+
+enum class Mode {
+    None,       ///< Raw columns, mapped without decoding
+    Fast,       ///< Integer codecs only
+    Strong,     ///< Integer codecs, zlib for the columns they do not shrink
+};
+
+constexpr int BLOCK_SIZE = 128;
+
+/**
+ * @brief Encodes count values of valueSize (1 or 4) bytes into out.
+ * @param isSigned 4 byte values are qint32, the block minimum is taken signed
+ * @return The codec picked, Raw leaves out empty.
+ */
+Codec   encode(const void *values, int count, int valueSize, bool isSigned, Mode mode, QByteArray &out);
+
+/**
+ * @brief Decodes a payload of size bytes into count values of valueSize bytes.
+ */
+bool    decode(Codec codec, const uchar *data, qint64 size, int count, int valueSize, void *out);
+
+const char *codecName(Codec codec);
+
+} // namespace ColumnCodec
+
+#endif // COLUMNCODEC_H
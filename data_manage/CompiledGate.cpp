@@ -0,0 +1,469 @@
+#include "CompiledGate.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+
+
+namespace {
+
+constexpr int BlockRows = 64;
+constexpr double LogAxisMin = 0.1;      ///< Lowest value a log CustomAxis shows
+
+/*
+ * Position of a gate point, points drawn on a log axis are never below its minimum.
+ */
+double pointPosition(int value, bool log)
+{
+    return log ? std::log10(qMax(LogAxisMin, static_cast<double>(value))) : value;
+}
+
+void toPositions(const qint32 *values, int n, bool log, double *positions)
+{
+    if (log) {
+        for (int i = 0; i < n; ++i) {
+            positions[i] = values[i] > 0 ? std::log10(static_cast<double>(values[i])) : -std::numeric_limits<double>::infinity();
+        }
+    } else {
+        for (int i = 0; i < n; ++i) {
+            positions[i] = values[i];
+        }
+    }
+}
+
+/*
+ * Liang-Barsky clip of segment a-b against the closed box, true if any
+ * point of the segment is in the box.
+ */
+bool segmentTouchesBox(const QPointF &a, const QPointF &b, double minX, double maxX, double minY, double maxY)
+{
+    const double dx = b.x() - a.x();
+    const double dy = b.y() - a.y();
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {a.x() - minX, maxX - a.x(), a.y() - minY, maxY - a.y()};
+    double t0 = 0.0, t1 = 1.0;
+    for (int k = 0; k < 4; ++k) {
+        if (p[k] == 0.0) {
+            if (q[k] < 0.0) return false;
+            continue;
+        }
+        const double r = q[k] / p[k];
+        if (p[k] < 0.0) {
+            t0 = qMax(t0, r);
+        } else {
+            t1 = qMin(t1, r);
+        }
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+
+void GateBitmap::resize(int rows)
+{
+    m_size = qMax(0, rows);
+    m_words.resize(wordsFor(m_size));
+    m_words.fill(0);
+}
+
+int GateBitmap::count() const
+{
+    int n = 0;
+    for (quint64 word : m_words) {
+        n += qPopulationCount(word);
+    }
+    return n;
+}
+
+void GateBitmap::andWith(const GateBitmap &other)
+{
+    const int common = qMin(m_words.size(), other.m_words.size());
+    quint64 *dst = m_words.data();
+    const quint64 *src = other.m_words.constData();
+    for (int w = 0; w < common; ++w) {
+        dst[w] &= src[w];
+    }
+    for (int w = common; w < m_words.size(); ++w) {
+        dst[w] = 0;
+    }
+}
+
+
+CompiledGate::CompiledGate()
+    : m_gateId(0), m_parentId(0), m_type(GateType::UnknownGate), m_channelX(0), m_typeX(MeasurementType::Height), m_channelY(0),
+    m_typeY(MeasurementType::Height), m_logX(false), m_logY(false), m_validMask(0), m_valid(false), m_originX(0), m_originY(0),
+    m_centerX(0), m_centerY(0), m_qx(0), m_qy(0)
+{
+}
+
+CompiledGate::CompiledGate(const Gate &gate, bool logX, bool logY)
+    : CompiledGate(gate.id(), gate.gateType(), gate.points(), gate.xAxisDetectorId(), gate.xMeasurementType(),
+                   gate.yAxisDetectorId(), gate.yMeasurementType(), logX, logY)
+{
+    m_parentId = gate.parentId();
+}
+
+CompiledGate::CompiledGate(int gateId, GateType type, const QList<QPoint> &points, int channelX, MeasurementType typeX,
+                           int channelY, MeasurementType typeY, bool logX, bool logY)
+    : m_gateId(gateId), m_parentId(0), m_type(type), m_points(points), m_channelX(channelX), m_typeX(typeX), m_channelY(channelY),
+    m_typeY(typeY), m_logX(logX), m_logY(logY), m_validMask(0), m_valid(false), m_originX(0), m_originY(0),
+    m_centerX(0), m_centerY(0), m_qx(0), m_qy(0)
+{
+    compile();
+}
+
+void CompiledGate::compile()
+{
+    const auto validChannel = [](int channel) { return EventBatch::channelSlot(channel) >= 0; };
+    if (!validChannel(m_channelX) || (!is1D() && !validChannel(m_channelY))) {
+        return;
+    }
+    m_validMask = is1D() ? EventBatch::channelBit(m_channelX)
+                         : (EventBatch::channelBit(m_channelX) | EventBatch::channelBit(m_channelY));
+
+    const int minPoints = (m_type == GateType::QuadrantGate) ? 1 : (m_type == GateType::PolygonGate ? 3 : 2);
+    if (m_points.size() < minPoints) {
+        return;
+    }
+
+    int minX = m_points.first().x(), maxX = minX;
+    int minY = m_points.first().y(), maxY = minY;
+    for (const QPoint &point : m_points) {
+        minX = qMin(minX, point.x());
+        maxX = qMax(maxX, point.x());
+        minY = qMin(minY, point.y());
+        maxY = qMax(maxY, point.y());
+    }
+    m_low = QPoint(minX, minY);
+    m_high = QPoint(maxX, maxY);
+    m_originX = (static_cast<double>(minX) + maxX) / 2;
+    m_originY = (static_cast<double>(minY) + maxY) / 2;
+
+    switch (m_type) {
+    case GateType::IntervalGate:
+        m_low.setY(std::numeric_limits<int>::min());
+        m_high.setY(std::numeric_limits<int>::max());
+        m_originY = 0;
+        m_valid = true;
+        break;
+    case GateType::RectangleGate:
+        m_valid = true;
+        break;
+    case GateType::PolygonGate:
+        for (const QPoint &point : m_points) {
+            m_vertices.append(QPointF(pointPosition(point.x(), m_logX), pointPosition(point.y(), m_logY)));
+        }
+        for (int i = 0; i < m_vertices.size(); ++i) {
+            const QPointF &a = m_vertices.at(i);
+            const QPointF &b = m_vertices.at((i + 1) % m_vertices.size());
+            if (a.y() == b.y()) continue;   // Never crossed by the even-odd ray
+            m_edges.append(Edge{a.x(), a.y(), b.y(), (b.x() - a.x()) / (b.y() - a.y())});
+        }
+        m_valid = !m_edges.isEmpty();
+        break;
+    case GateType::EllipseGate: {
+        const double loX = pointPosition(minX, m_logX), hiX = pointPosition(maxX, m_logX);
+        const double loY = pointPosition(minY, m_logY), hiY = pointPosition(maxY, m_logY);
+        const double rx = (hiX - loX) / 2;
+        const double ry = (hiY - loY) / 2;
+        m_centerX = (loX + hiX) / 2;
+        m_centerY = (loY + hiY) / 2;
+        if (rx > 0 && ry > 0) {
+            m_qx = 1.0 / (rx * rx);
+            m_qy = 1.0 / (ry * ry);
+            m_valid = true;
+        }
+        break;
+    }
+    case GateType::QuadrantGate:
+        m_originX = m_points.first().x();
+        m_originY = m_points.first().y();
+        m_low = QPoint(std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
+        m_high = QPoint(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        m_valid = true;
+        break;
+    default:
+        break;
+    }
+}
+
+double CompiledGate::fillRatio() const
+{
+    switch (m_type) {
+    case GateType::EllipseGate:
+        return M_PI / 4;
+    case GateType::PolygonGate: {
+        // Of the bounding box in positions, where the polygon is drawn
+        double minX = m_vertices.first().x(), maxX = minX, minY = m_vertices.first().y(), maxY = minY;
+        for (const QPointF &vertex : m_vertices) {
+            minX = qMin(minX, vertex.x());
+            maxX = qMax(maxX, vertex.x());
+            minY = qMin(minY, vertex.y());
+            maxY = qMax(maxY, vertex.y());
+        }
+        const double box = (maxX - minX) * (maxY - minY);
+        if (box <= 0) return 0.0;
+        double area = 0;
+        for (int i = 0; i < m_vertices.size(); ++i) {
+            const QPointF &a = m_vertices.at(i);
+            const QPointF &b = m_vertices.at((i + 1) % m_vertices.size());
+            area += a.x() * b.y() - b.x() * a.y();
+        }
+        return qMin(1.0, std::abs(area) / 2 / box);
+    }
+    default:
+        return 1.0;
+    }
+}
+
+bool CompiledGate::contains(double x, double y) const
+{
+    if (!m_valid) return false;
+    switch (m_type) {
+    case GateType::IntervalGate:
+        return x >= m_low.x() && x <= m_high.x();
+    case GateType::RectangleGate:
+        return x >= m_low.x() && x <= m_high.x() && y >= m_low.y() && y <= m_high.y();
+    case GateType::PolygonGate:
+    case GateType::EllipseGate:
+        return containsPosition(position(x, m_logX), position(y, m_logY));
+    case GateType::QuadrantGate:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CompiledGate::containsPosition(double px, double py) const
+{
+    if (m_type == GateType::PolygonGate) {
+        bool inside = false;
+        for (const Edge &e : m_edges) {
+            inside ^= ((e.y0 > py) != (e.y1 > py)) && (px < e.x0 + (py - e.y0) * e.slope);
+        }
+        return inside;
+    }
+    const double dx = px - m_centerX;
+    const double dy = py - m_centerY;
+    return m_qx * dx * dx + m_qy * dy * dy <= 1.0;
+}
+
+CompiledGate::Quadrant CompiledGate::quadrant(double x, double y) const
+{
+    return static_cast<Quadrant>((x >= m_originX ? 1 : 0) | (y >= m_originY ? 2 : 0));
+}
+
+CompiledGate::Coverage CompiledGate::coverage(double minX, double maxX, double minY, double maxY) const
+{
+    if (!m_valid) {
+        return Coverage::Outside;
+    }
+    if (m_type == GateType::QuadrantGate) {
+        return Coverage::Inside;
+    }
+    if (maxX < m_low.x() || minX > m_high.x() || (!is1D() && (maxY < m_low.y() || minY > m_high.y()))) {
+        return Coverage::Outside;
+    }
+    const bool inBounds = minX >= m_low.x() && maxX <= m_high.x() && (is1D() || (minY >= m_low.y() && maxY <= m_high.y()));
+
+    switch (m_type) {
+    case GateType::IntervalGate:
+    case GateType::RectangleGate:
+        return inBounds ? Coverage::Inside : Coverage::Partial;
+    case GateType::EllipseGate:
+    case GateType::PolygonGate:
+        // The box is a box in positions too, its values <= 0 become -inf on a log axis
+        return coverageOfPositions(position(minX, m_logX), position(maxX, m_logX),
+                                   position(minY, m_logY), position(maxY, m_logY));
+    default:
+        return Coverage::Outside;
+    }
+}
+
+CompiledGate::Coverage CompiledGate::coverageOfPositions(double minX, double maxX, double minY, double maxY) const
+{
+    if (m_type == GateType::EllipseGate) {
+        // Nearest point of the box to the centre decides Outside, the corners Inside (convex)
+        const double dx = qBound(minX, m_centerX, maxX) - m_centerX;
+        const double dy = qBound(minY, m_centerY, maxY) - m_centerY;
+        if (m_qx * dx * dx + m_qy * dy * dy > 1.0) {
+            return Coverage::Outside;
+        }
+        const bool corners = containsPosition(minX, minY) && containsPosition(maxX, minY)
+                             && containsPosition(minX, maxY) && containsPosition(maxX, maxY);
+        return corners ? Coverage::Inside : Coverage::Partial;
+    }
+    // A box no edge touches is entirely on one side of the boundary
+    for (int i = 0; i < m_vertices.size(); ++i) {
+        if (segmentTouchesBox(m_vertices.at(i), m_vertices.at((i + 1) % m_vertices.size()), minX, maxX, minY, maxY)) {
+            return Coverage::Partial;
+        }
+    }
+    return containsPosition(minX, minY) ? Coverage::Inside : Coverage::Outside;
+}
+
+/*
+ * inside[i] = 1 for the rows of the block inside the gate shape, valid
+ * pulses are checked by the caller.
+ */
+void CompiledGate::fillBlock(const qint32 *x, const qint32 *y, int n, quint8 *inside) const
+{
+    switch (m_type) {
+    case GateType::IntervalGate: {
+        const qint32 lo = m_low.x(), hi = m_high.x();
+        for (int i = 0; i < n; ++i) {
+            inside[i] = (x[i] >= lo) & (x[i] <= hi);
+        }
+        break;
+    }
+    case GateType::RectangleGate: {
+        const qint32 loX = m_low.x(), hiX = m_high.x(), loY = m_low.y(), hiY = m_high.y();
+        for (int i = 0; i < n; ++i) {
+            inside[i] = (x[i] >= loX) & (x[i] <= hiX) & (y[i] >= loY) & (y[i] <= hiY);
+        }
+        break;
+    }
+    case GateType::PolygonGate: {
+        double px[BlockRows], py[BlockRows];
+        toPositions(x, n, m_logX, px);
+        toPositions(y, n, m_logY, py);
+        for (int i = 0; i < n; ++i) {
+            inside[i] = 0;
+        }
+        for (const Edge &e : m_edges) {
+            for (int i = 0; i < n; ++i) {
+                inside[i] ^= static_cast<quint8>(((e.y0 > py[i]) != (e.y1 > py[i])) & (px[i] < e.x0 + (py[i] - e.y0) * e.slope));
+            }
+        }
+        break;
+    }
+    case GateType::EllipseGate: {
+        double px[BlockRows], py[BlockRows];
+        toPositions(x, n, m_logX, px);
+        toPositions(y, n, m_logY, py);
+        const double cx = m_centerX, cy = m_centerY, qx = m_qx, qy = m_qy;
+        for (int i = 0; i < n; ++i) {
+            const double dx = px[i] - cx;
+            const double dy = py[i] - cy;
+            inside[i] = (qx * dx * dx + qy * dy * dy <= 1.0);
+        }
+        break;
+    }
+    case GateType::QuadrantGate:
+        for (int i = 0; i < n; ++i) {
+            inside[i] = 1;
+        }
+        break;
+    default:
+        for (int i = 0; i < n; ++i) {
+            inside[i] = 0;
+        }
+        break;
+    }
+}
+
+int CompiledGate::evaluate(const qint32 *x, const qint32 *y, const quint8 *chValid, int rows, quint64 *bits,
+                           const quint64 *parentBits) const
+{
+    if (!m_valid || !x || (!is1D() && !y) || !chValid) {
+        std::fill(bits, bits + GateBitmap::wordsFor(rows), 0);
+        return 0;
+    }
+    const quint8 mask = m_validMask;
+    quint8 inside[BlockRows];
+    int members = 0;
+    for (int begin = 0, w = 0; begin < rows; begin += BlockRows, ++w) {
+        const int n = qMin(BlockRows, rows - begin);
+        if (parentBits && !parentBits[w]) {
+            bits[w] = 0;
+            continue;
+        }
+        fillBlock(x + begin, y ? y + begin : nullptr, n, inside);
+        const quint8 *valid = chValid + begin;
+        quint64 word = 0;
+        for (int i = 0; i < n; ++i) {
+            word |= static_cast<quint64>(inside[i] & ((valid[i] & mask) == mask)) << i;
+        }
+        if (parentBits) {
+            word &= parentBits[w];
+        }
+        bits[w] = word;
+        members += qPopulationCount(word);
+    }
+    return members;
+}
+
+int CompiledGate::evaluate(const EventBatch &batch, GateBitmap &bits) const
+{
+    bits.resize(batch.size());
+    const qint32 *x = batch.column(m_channelX, m_typeX);
+    const qint32 *y = is1D() ? nullptr : batch.column(m_channelY, m_typeY);
+    return evaluate(x, y, batch.chPulseValid(), batch.size(), bits.words());
+}
+
+void CompiledGate::accumulate(const qint32 *x, const qint32 *y, const quint64 *bits, int rows, RangeStats &stats) const
+{
+    stats.origin[0] = m_originX;
+    stats.origin[1] = m_originY;
+    if (!x || (!is1D() && !y)) {
+        return;
+    }
+    quint64 n = 0;
+    double sumX = 0, sumSqX = 0, sumY = 0, sumSqY = 0;
+    if (is1D()) {
+        for (int i = 0; i < rows; ++i) {
+            const double inside = static_cast<double>((bits[i >> 6] >> (i & 63)) & 1);
+            const double dx = (x[i] - m_originX) * inside;
+            n += static_cast<quint64>(inside);
+            sumX += dx;
+            sumSqX += dx * dx;
+        }
+    } else {
+        for (int i = 0; i < rows; ++i) {
+            const double inside = static_cast<double>((bits[i >> 6] >> (i & 63)) & 1);
+            const double dx = (x[i] - m_originX) * inside;
+            const double dy = (y[i] - m_originY) * inside;
+            n += static_cast<quint64>(inside);
+            sumX += dx;
+            sumY += dy;
+            sumSqX += dx * dx;
+            sumSqY += dy * dy;
+        }
+    }
+    stats.count += n;
+    stats.sum[0] += sumX;
+    stats.sum[1] += sumY;
+    stats.sumSq[0] += sumSqX;
+    stats.sumSq[1] += sumSqY;
+}
+
+void CompiledGate::accumulate(const EventBatch &batch, const GateBitmap &bits, RangeStats &stats) const
+{
+    const qint32 *x = batch.column(m_channelX, m_typeX);
+    const qint32 *y = is1D() ? nullptr : batch.column(m_channelY, m_typeY);
+    accumulate(x, y, bits.words(), qMin(batch.size(), bits.size()), stats);
+}
+
+void CompiledGate::countQuadrants(const qint32 *x, const qint32 *y, const quint64 *bits, int rows, QuadrantCounts &counts) const
+{
+    if (!isQuadrant() || !x || !y) {
+        return;
+    }
+    const qint32 ox = m_points.first().x();
+    const qint32 oy = m_points.first().y();
+    quint64 quadrants[4] = {0, 0, 0, 0};
+    for (int i = 0; i < rows; ++i) {
+        const int label = (x[i] >= ox) | ((y[i] >= oy) << 1);
+        quadrants[label] += (bits[i >> 6] >> (i & 63)) & 1;
+    }
+    for (int q = 0; q < 4; ++q) {
+        counts.count[q] += quadrants[q];
+    }
+}
+
+void CompiledGate::countQuadrants(const EventBatch &batch, const GateBitmap &bits, QuadrantCounts &counts) const
+{
+    countQuadrants(batch.column(m_channelX, m_typeX), batch.column(m_channelY, m_typeY), bits.words(),
+                   qMin(batch.size(), bits.size()), counts);
+}
@@ -0,0 +1,200 @@
+#ifndef COMPILEDGATE_H
+#define COMPILEDGATE_H
+
+#include <QVector>
+#include <QPoint>
+#include <QList>
+#include <cmath>
+#include <limits>
+#include "Gate.h"
+#include "EventBatch.h"
+#include "EventKernels.h"
+
+
+/**
+ * @brief One bit per event row of a batch, set for the events of a gate.
+ *
+ * Row i is bit (i % 64) of word i / 64, bits past size() are zero.
+ */
+class GateBitmap
+{
+public:
+    void    resize(int rows);
+    int     size() const { return m_size; }
+    int     wordCount() const { return m_words.size(); }
+    quint64 *words() { return m_words.data(); }
+    const quint64 *words() const { return m_words.constData(); }
+
+    bool    test(int row) const { return (m_words.at(row >> 6) >> (row & 63)) & 1; }
+    int     count() const;
+    void    andWith(const GateBitmap &other);
+
+    static int wordsFor(int rows) { return (rows + 63) >> 6; }
+
+private:
+    QVector<quint64>    m_words;
+    int                 m_size = 0;
+};
+
+
+/**
+ * @brief Events per quadrant of a quadrant gate, indexed by CompiledGate::Quadrant.
+ */
+struct QuadrantCounts
+{
+    quint64 count[4] = {0, 0, 0, 0};
+
+    quint64 total() const { return count[0] + count[1] + count[2] + count[3]; }
+    void merge(const QuadrantCounts &other) {
+        for (int q = 0; q < 4; ++q) {
+            count[q] += other.count[q];
+        }
+    }
+};
+
+
+/**
+ * @brief A gate compiled into an exact membership test on its two measurement columns.
+ *
+ * The gate points are turned once into what the test needs: the bounds of
+ * an interval or rectangle, the edge equations of a polygon (even-odd
+ * rule), the quadratic form of the ellipse inscribed in its two corner
+ * points, or the origin splitting a quadrant gate. A quadrant gate holds
+ * every event of its plot and labels each with its quadrant.
+ *
+ * Polygons and ellipses are drawn in plot space, so on a logarithmic axis
+ * their edges and curve are straight and round in log10 of the value. They
+ * are compiled and tested on axis positions (see AxisState::position), a
+ * value <= 0 has no position on a log axis and is never inside them.
+ * Bounds and quadrants are the same in either space and use the values.
+ *
+ * evaluate() tests the rows of a block of columns and writes one bit per
+ * row. The interval and rectangle loops compare integers and vectorize at
+ * -O3; the polygon and ellipse loops are scalar, GCC does not vectorize a
+ * double compare stored to a byte. Events without a valid pulse on the
+ * gate channels are never members.
+ */
+class CompiledGate
+{
+public:
+    enum class Coverage {
+        Outside,        ///< No point of the box is in the gate
+        Inside,         ///< Every point of the box is in the gate
+        Partial,
+    };
+
+    enum Quadrant {
+        LowerLeft = 0,
+        LowerRight = 1,
+        UpperLeft = 2,
+        UpperRight = 3,
+    };
+
+    CompiledGate();
+    explicit CompiledGate(const Gate &gate, bool logX = false, bool logY = false);
+    CompiledGate(int gateId, GateType type, const QList<QPoint> &points, int channelX, MeasurementType typeX,
+                 int channelY = 0, MeasurementType typeY = MeasurementType::Height, bool logX = false, bool logY = false);
+
+    bool            isValid() const { return m_valid; }
+    int             gateId() const { return m_gateId; }
+    int             parentId() const { return m_parentId; }     ///< Parent gate, 0 for all events
+    void            setParentId(int parentId) { m_parentId = parentId; }
+    GateType        type() const { return m_type; }
+    bool            is1D() const { return m_type == GateType::IntervalGate; }
+    bool            isQuadrant() const { return m_type == GateType::QuadrantGate; }
+    const QList<QPoint> &points() const { return m_points; }
+    int             channelX() const { return m_channelX; }
+    MeasurementType typeX() const { return m_typeX; }
+    int             channelY() const { return m_channelY; }
+    MeasurementType typeY() const { return m_typeY; }
+    quint8          validMask() const { return m_validMask; }
+    bool            isLogX() const { return m_logX; }       ///< Shape compiled on log10 x positions
+    bool            isLogY() const { return m_logY; }
+
+    // Bounding box of the gate, the whole plane for quadrant gates
+    QPoint          low() const { return m_low; }
+    QPoint          high() const { return m_high; }
+    // Origin the gate statistics are accumulated relative to (see RangeStats)
+    double          origin(int dim) const { return dim == 0 ? m_originX : m_originY; }
+    // Part of the bounding box the gate covers
+    double          fillRatio() const;
+
+    bool            contains(double x, double y) const;
+    Quadrant        quadrant(double x, double y) const;
+    Coverage        coverage(double minX, double maxX, double minY, double maxY) const;
+
+    /*
+     * Sets bit i of bits for the rows i < rows inside the gate, bits must
+     * have room for GateBitmap::wordsFor(rows) words. y is not read by
+     * interval gates. With parentBits only the rows set there are tested,
+     * blocks of 64 rows the parent rejected entirely are skipped. Returns
+     * the members.
+     */
+    int     evaluate(const qint32 *x, const qint32 *y, const quint8 *chValid, int rows, quint64 *bits,
+                     const quint64 *parentBits = nullptr) const;
+    int     evaluate(const EventBatch &batch, GateBitmap &bits) const;
+
+    /*
+     * Adds the member rows to stats, relative to origin(). stats.origin is set.
+     */
+    void    accumulate(const qint32 *x, const qint32 *y, const quint64 *bits, int rows, RangeStats &stats) const;
+    void    accumulate(const EventBatch &batch, const GateBitmap &bits, RangeStats &stats) const;
+
+    /*
+     * Quadrant label of every member row of a quadrant gate, added to counts.
+     */
+    void    countQuadrants(const qint32 *x, const qint32 *y, const quint64 *bits, int rows, QuadrantCounts &counts) const;
+    void    countQuadrants(const EventBatch &batch, const GateBitmap &bits, QuadrantCounts &counts) const;
+
+    bool    operator==(const CompiledGate &other) const {
+        return m_gateId == other.m_gateId && m_parentId == other.m_parentId && m_type == other.m_type && m_points == other.m_points
+               && m_channelX == other.m_channelX && m_typeX == other.m_typeX
+               && m_channelY == other.m_channelY && m_typeY == other.m_typeY
+               && m_logX == other.m_logX && m_logY == other.m_logY;
+    }
+    bool    operator!=(const CompiledGate &other) const { return !(*this == other); }
+
+private:
+    struct Edge
+    {
+        double  x0, y0, y1;
+        double  slope;      ///< dx / dy
+    };
+
+    void    compile();
+    void    fillBlock(const qint32 *x, const qint32 *y, int n, quint8 *inside) const;
+    bool    containsPosition(double px, double py) const;
+    Coverage coverageOfPositions(double minX, double maxX, double minY, double maxY) const;
+
+    // Axis position of a value, -inf for values a log axis does not show
+    static double position(double value, bool log) {
+        return !log ? value : (value > 0 ? std::log10(value) : -std::numeric_limits<double>::infinity());
+    }
+
+    int             m_gateId;
+    int             m_parentId;
+    GateType        m_type;
+    QList<QPoint>   m_points;
+    int             m_channelX;
+    MeasurementType m_typeX;
+    int             m_channelY;
+    MeasurementType m_typeY;
+    bool            m_logX;
+    bool            m_logY;
+    quint8          m_validMask;
+    bool            m_valid;
+
+    QPoint          m_low;
+    QPoint          m_high;
+    double          m_originX;
+    double          m_originY;
+
+    QVector<Edge>   m_edges;            ///< Polygon, non horizontal edges, in positions
+    QVector<QPointF> m_vertices;        ///< Polygon, in positions
+    double          m_centerX;          ///< Ellipse centre, in positions
+    double          m_centerY;
+    double          m_qx;               ///< Ellipse: qx * dx^2 + qy * dy^2 <= 1 around the centre
+    double          m_qy;
+};
+
+#endif // COMPILEDGATE_H
@@ -0,0 +1,279 @@
+#include "ContourWorker.h"
+#include <QHash>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+ContourWorker::ContourWorker(QObject *parent)
+    : QThread{parent}, m_stop(false)
+{
+    qRegisterMetaType<ContourResult>("ContourResult");
+    setObjectName("ContourWorker");
+}
+
+ContourWorker::~ContourWorker()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_wake.wakeAll();
+    }
+    wait();
+}
+
+void ContourWorker::request(const ContourRequest &request)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = std::find_if(m_pending.begin(), m_pending.end(), [&request](const ContourRequest &pending) {
+            return pending.key == request.key;
+        });
+        if (it != m_pending.end()) {
+            *it = request;
+        } else {
+            m_pending.append(request);
+        }
+        m_wake.wakeOne();
+    }
+    if (!isRunning()) {
+        start(QThread::LowPriority);
+    }
+}
+
+void ContourWorker::run()
+{
+    forever {
+        ContourRequest request;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pending.isEmpty() && !m_stop) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_stop) {
+                return;
+            }
+            request = m_pending.takeFirst();
+        }
+        emit contoursReady(compute(request));
+    }
+}
+
+ContourResult ContourWorker::compute(const ContourRequest &request)
+{
+    ContourResult result;
+    result.key = request.key;
+    result.generation = request.generation;
+    result.size = request.size;
+    if (request.size.isEmpty() || request.counts.size() != request.size.width() * request.size.height()) {
+        return result;
+    }
+
+    const QVector<double> density = smooth(request.counts, request.size, request.sigma);
+    for (double probability : request.levels) {
+        ContourLevel level;
+        level.probability = probability;
+        level.density = levelDensity(density, probability);
+        if (level.density > 0.0) {
+            level.lines = trace(density, request.size, level.density);
+        }
+        result.levels.append(level);
+    }
+    return result;
+}
+
+/*
+ * Gaussian blur as a row pass and a column pass, outside the grid counts as empty.
+ */
+QVector<double> ContourWorker::smooth(const QVector<quint32> &counts, const QSize &size, double sigma)
+{
+    const int width = size.width();
+    const int height = size.height();
+    const int radius = qMax(1, static_cast<int>(std::ceil(3.0 * sigma)));
+    QVector<double> kernel(2 * radius + 1);
+    double weight = 0.0;
+    for (int k = -radius; k <= radius; ++k) {
+        kernel[k + radius] = std::exp(-0.5 * k * k / (sigma * sigma));
+        weight += kernel.at(k + radius);
+    }
+    for (double &w : kernel) {
+        w /= weight;
+    }
+
+    QVector<double> rows(width * height, 0.0);
+    for (int y = 0; y < height; ++y) {
+        const quint32 *in = counts.constData() + y * width;
+        double *out = rows.data() + y * width;
+        for (int x = 0; x < width; ++x) {
+            if (in[x] == 0) continue;
+            const int k0 = qMax(-radius, -x);
+            const int k1 = qMin(radius, width - 1 - x);
+            for (int k = k0; k <= k1; ++k) {
+                out[x + k] += in[x] * kernel.at(k + radius);
+            }
+        }
+    }
+
+    QVector<double> density(width * height, 0.0);
+    for (int y = 0; y < height; ++y) {
+        const int k0 = qMax(-radius, -y);
+        const int k1 = qMin(radius, height - 1 - y);
+        const double *in = rows.constData() + y * width;
+        for (int k = k0; k <= k1; ++k) {
+            double *out = density.data() + (y + k) * width;
+            const double w = kernel.at(k + radius);
+            for (int x = 0; x < width; ++x) {
+                out[x] += in[x] * w;
+            }
+        }
+    }
+    return density;
+}
+
+/*
+ * The density the cells holding the given fraction of all events lie above.
+ */
+double ContourWorker::levelDensity(const QVector<double> &density, double probability)
+{
+    QVector<double> sorted = density;
+    std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+    double total = 0.0;
+    for (double value : sorted) {
+        total += value;
+    }
+    if (total <= 0.0) {
+        return 0.0;
+    }
+    const double target = qBound(0.0, probability, 1.0) * total;
+    double sum = 0.0;
+    for (double value : sorted) {
+        sum += value;
+        if (sum >= target) {
+            return value;
+        }
+    }
+    return sorted.last();
+}
+
+/*
+ * Marching squares over the bin centres. The grid is framed by a ring of
+ * empty bins so every line closes. Each crossing sits on an edge between
+ * two centres, two segments meeting on an edge are joined into a line.
+ */
+QVector<QPolygonF> ContourWorker::trace(const QVector<double> &density, const QSize &size, double level)
+{
+    const int width = size.width();
+    const int height = size.height();
+    const int cornersX = width + 2;                 // Framed grid, corner (cx, cy) is bin (cx - 1, cy - 1)
+    auto value = [&](int cx, int cy) {
+        const int x = cx - 1;
+        const int y = cy - 1;
+        return (x < 0 || y < 0 || x >= width || y >= height) ? 0.0 : density.at(y * width + x);
+    };
+    auto horizontal = [cornersX](int cx, int cy) { return (static_cast<qint64>(cy) * cornersX + cx) * 2; };
+    auto vertical = [cornersX](int cx, int cy) { return (static_cast<qint64>(cy) * cornersX + cx) * 2 + 1; };
+
+    QHash<qint64, QPointF> points;                  // Crossing on each edge
+    auto crossing = [&](qint64 edge, int cx0, int cy0, int cx1, int cy1) {
+        if (!points.contains(edge)) {
+            const double v0 = value(cx0, cy0);
+            const double v1 = value(cx1, cy1);
+            const double t = (v1 != v0) ? qBound(0.0, (level - v0) / (v1 - v0), 1.0) : 0.5;
+            points.insert(edge, QPointF(cx0 - 0.5 + t * (cx1 - cx0), cy0 - 0.5 + t * (cy1 - cy0)));
+        }
+        return edge;
+    };
+
+    QVector<QPair<qint64, qint64>> segments;
+    for (int cy = 0; cy < height + 1; ++cy) {
+        for (int cx = 0; cx < width + 1; ++cx) {
+            // Corners a b on top, d c below
+            const double a = value(cx, cy);
+            const double b = value(cx + 1, cy);
+            const double c = value(cx + 1, cy + 1);
+            const double d = value(cx, cy + 1);
+            const int index = (a >= level ? 1 : 0) | (b >= level ? 2 : 0) | (c >= level ? 4 : 0) | (d >= level ? 8 : 0);
+            if (index == 0 || index == 15) continue;
+
+            auto top = [&]() { return crossing(horizontal(cx, cy), cx, cy, cx + 1, cy); };
+            auto right = [&]() { return crossing(vertical(cx + 1, cy), cx + 1, cy, cx + 1, cy + 1); };
+            auto bottom = [&]() { return crossing(horizontal(cx, cy + 1), cx, cy + 1, cx + 1, cy + 1); };
+            auto left = [&]() { return crossing(vertical(cx, cy), cx, cy, cx, cy + 1); };
+            const bool centreAbove = (a + b + c + d) / 4.0 >= level;
+
+            switch (index) {
+            case 1: case 14: segments.append({left(), top()}); break;
+            case 2: case 13: segments.append({top(), right()}); break;
+            case 3: case 12: segments.append({left(), right()}); break;
+            case 4: case 11: segments.append({right(), bottom()}); break;
+            case 6: case 9:  segments.append({top(), bottom()}); break;
+            case 7: case 8:  segments.append({left(), bottom()}); break;
+            case 5:
+                if (centreAbove) {
+                    segments.append({top(), right()});
+                    segments.append({bottom(), left()});
+                } else {
+                    segments.append({left(), top()});
+                    segments.append({right(), bottom()});
+                }
+                break;
+            case 10:
+                if (centreAbove) {
+                    segments.append({left(), top()});
+                    segments.append({right(), bottom()});
+                } else {
+                    segments.append({top(), right()});
+                    segments.append({bottom(), left()});
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Join the segments through the edges they share, an edge has at most two
+    QHash<qint64, QVector<int>> byEdge;
+    for (int s = 0; s < segments.size(); ++s) {
+        byEdge[segments.at(s).first].append(s);
+        byEdge[segments.at(s).second].append(s);
+    }
+    QVector<bool> used(segments.size(), false);
+    auto follow = [&](qint64 edge, QVector<qint64> &chain) {
+        forever {
+            int next = -1;
+            for (int s : byEdge.value(edge)) {
+                if (!used.at(s)) {
+                    next = s;
+                    break;
+                }
+            }
+            if (next < 0) return;
+            used[next] = true;
+            edge = (segments.at(next).first == edge) ? segments.at(next).second : segments.at(next).first;
+            chain.append(edge);
+        }
+    };
+
+    QVector<QPolygonF> lines;
+    for (int s = 0; s < segments.size(); ++s) {
+        if (used.at(s)) continue;
+        used[s] = true;
+        QVector<qint64> forward = {segments.at(s).first, segments.at(s).second};
+        follow(forward.last(), forward);
+        QVector<qint64> backward;
+        follow(forward.first(), backward);
+
+        QPolygonF line;
+        line.reserve(forward.size() + backward.size());
+        for (auto it = backward.crbegin(); it != backward.crend(); ++it) {
+            line.append(points.value(*it));
+        }
+        for (qint64 edge : forward) {
+            line.append(points.value(edge));
+        }
+        lines.append(line);
+    }
+    return lines;
+}
@@ -0,0 +1,90 @@
+#ifndef CONTOURWORKER_H
+#define CONTOURWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMetaType>
+#include <QPolygonF>
+#include <QSize>
+#include <QVector>
+
+
+/**
+ * @brief Event counts of a contour plot to draw contours for.
+ */
+struct ContourRequest
+{
+    quintptr            key = 0;            ///< Identifies the plot, only compared
+    quint64             generation = 0;     ///< Of the plot's requests, the result carries it back
+    QSize               size;               ///< Bins, counts are row major
+    QVector<quint32>    counts;
+    QVector<double>     levels;             ///< Probability levels, fraction of the events a contour encloses
+    double              sigma = 1.5;        ///< Gaussian smoothing, in bins
+};
+
+struct ContourLevel
+{
+    double              probability = 0.0;
+    double              density = 0.0;      ///< Smoothed count the contour follows
+    QVector<QPolygonF>  lines;              ///< In bin coordinates, bin (i, j) spans [i, i + 1) x [j, j + 1)
+};
+
+struct ContourResult
+{
+    quintptr                key = 0;
+    quint64                 generation = 0;
+    QSize                   size;
+    QVector<ContourLevel>   levels;
+};
+
+Q_DECLARE_METATYPE(ContourResult)
+
+
+/**
+ * @brief Computes the contours of contour plots off the GUI thread.
+ *
+ * The counts of a request are smoothed with a separable Gaussian kernel,
+ * the density every probability level stands for is found from the
+ * sorted smoothed counts (the cells above it hold that fraction of the
+ * events), and marching squares trace the iso-density lines, joined into
+ * polylines. A plot's request replaces the one it still has pending, so
+ * a busy worker skips the intermediate states. Results arrive with
+ * contoursReady() on the requester's thread.
+ */
+class ContourWorker : public QThread
+{
+    Q_OBJECT
+public:
+    static ContourWorker &instance() {
+        static ContourWorker instance;
+        return instance;
+    }
+    ContourWorker &operator=(const ContourWorker &) = delete;
+    ContourWorker(const ContourWorker &) = delete;
+    ~ContourWorker() override;
+
+    void    request(const ContourRequest &request);
+
+    static ContourResult compute(const ContourRequest &request);
+
+signals:
+    void    contoursReady(const ContourResult &result);
+
+protected:
+    void run() override;
+
+private:
+    explicit ContourWorker(QObject *parent = nullptr);
+
+    static QVector<double> smooth(const QVector<quint32> &counts, const QSize &size, double sigma);
+    static double levelDensity(const QVector<double> &density, double probability);
+    static QVector<QPolygonF> trace(const QVector<double> &density, const QSize &size, double level);
+
+    QMutex                  m_mutex;
+    QWaitCondition          m_wake;
+    QVector<ContourRequest> m_pending;      ///< At most one per plot, guarded by m_mutex
+    bool                    m_stop;         ///< Guarded by m_mutex
+};
+
+#endif // CONTOURWORKER_H
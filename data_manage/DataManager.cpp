@@ -169,7 +169,8 @@ void DataManager::processScatterData(PlotBase *plot, const QVector<SampleData> &
 
 void DataManager::processContourData(PlotBase *plot, const QVector<SampleData> &data)
 {
-    // To be implemented
+    // A contour plot counts the same events as a scatter plot, it only draws them differently
+    processScatterData(plot, data);
 }
 
 void DataManager::saveDataToCsvFile(const QVector<SampleData> &updateData)
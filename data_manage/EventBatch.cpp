@@ -0,0 +1,165 @@
+#include "EventBatch.h"
+#include <QDebug>
+#include <cstring>
+
+
+EventBatch::EventBatch()
+    : m_size(0), m_capacity(0)
+{
+    std::fill(std::begin(m_channelIndex), std::end(m_channelIndex), -1);
+}
+
+EventBatch::EventBatch(const QVector<int> &enabledChannels, int capacity)
+    : EventBatch()
+{
+    reset(enabledChannels, capacity);
+}
+
+/*
+ * With the same channel layout the columns are kept, so a pooled batch is
+ * refilled without allocating.
+ */
+void EventBatch::reset(const QVector<int> &enabledChannels, int capacity)
+{
+    if (enabledChannels == m_channels) {
+        m_size = 0;
+        reserve(capacity);
+        return;
+    }
+    m_channels = enabledChannels;
+    std::fill(std::begin(m_channelIndex), std::end(m_channelIndex), -1);
+    for (int i = 0; i < m_channels.size(); ++i) {
+        const int slot = channelSlot(m_channels.at(i));
+        if (slot >= 0) {
+            m_channelIndex[slot] = i;
+        } else {
+            qWarning() << "[EventBatch] Detector id out of range:" << m_channels.at(i);
+        }
+    }
+    m_size = 0;
+    m_capacity = 0;
+    m_values.clear();
+    m_eventIds.clear();
+    m_diffTimesUs.clear();
+    m_postTimesUs.clear();
+    m_flags.clear();
+    m_chPulseValid.clear();
+    reserve(capacity);
+}
+
+/*
+ * Growing the capacity changes the stride of the measurement block, so the
+ * columns are moved to their new offsets. Producers reserve once per batch.
+ */
+void EventBatch::reserve(int capacity)
+{
+    if (capacity <= m_capacity) {
+        return;
+    }
+
+    const int columnNum = m_channels.size() * MEASUREMENT_NUM;
+    QVector<qint32> values(columnNum * capacity);
+    for (int col = 0; col < columnNum; ++col) {
+        if (m_size > 0) {
+            std::memcpy(values.data() + col * capacity,
+                        m_values.constData() + col * m_capacity,
+                        m_size * sizeof(qint32));
+        }
+    }
+    m_values.swap(values);
+
+    m_eventIds.resize(capacity);
+    m_diffTimesUs.resize(capacity);
+    m_postTimesUs.resize(capacity);
+    m_flags.resize(capacity);
+    m_chPulseValid.resize(capacity);
+    m_capacity = capacity;
+}
+
+void EventBatch::resize(int size)
+{
+    if (size > m_capacity) {
+        reserve(qMax(size, m_capacity * 2));
+    }
+    m_size = qMax(0, size);
+}
+
+int EventBatch::appendEvent()
+{
+    resize(m_size + 1);
+    return m_size - 1;
+}
+
+void EventBatch::append(const EventData &event)
+{
+    int row = appendEvent();
+    m_eventIds[row] = event.getEventId();
+    m_diffTimesUs[row] = event.getDiffTimeUs();
+    m_postTimesUs[row] = event.getPostTimeUs();
+    m_flags[row] = (event.isEnabledSort() ? FlagEnableSort : 0)
+                   | (event.isRealSorted() ? FlagSorted : 0)
+                   | (event.isValidSpeedMeasure() ? FlagValidSpeed : 0);
+    m_chPulseValid[row] = event.validChPulse();
+    for (int i = 0; i < m_channels.size(); ++i) {
+        for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
+            columnData(i, measurementIndex(type))[row] = event.getData(m_channels.at(i), type);
+        }
+    }
+}
+
+int EventBatch::value(int row, int channelId, MeasurementType type) const
+{
+    const qint32 *col = column(channelId, type);
+    if (!col || row < 0 || row >= m_size) {
+        return 0;
+    }
+    return col[row];
+}
+
+EventData EventBatch::eventAt(int row) const
+{
+    EventData event(m_channels);
+    event.setEventId(m_eventIds.at(row));
+    event.setDiffTimeUs(m_diffTimesUs.at(row));
+    event.setPostTimeUs(m_postTimesUs.at(row));
+    event.setEnableSort(isEnabledSort(row));
+    event.setSorted(isRealSorted(row));
+    event.setValidSpeedMeasure(isValidSpeedMeasure(row));
+    event.setValidChPulse(m_chPulseValid.at(row));
+    for (int i = 0; i < m_channels.size(); ++i) {
+        for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
+            event.setData(m_channels.at(i), type, columnAt(i, measurementIndex(type))[row]);
+        }
+    }
+    return event;
+}
+
+int EventBatch::enableSortCount() const
+{
+    int count = 0;
+    const quint8 *f = m_flags.constData();
+    for (int i = 0; i < m_size; ++i) {
+        count += (f[i] & FlagEnableSort) ? 1 : 0;
+    }
+    return count;
+}
+
+int EventBatch::sortedCount() const
+{
+    int count = 0;
+    const quint8 *f = m_flags.constData();
+    for (int i = 0; i < m_size; ++i) {
+        count += (f[i] & FlagSorted) ? 1 : 0;
+    }
+    return count;
+}
+
+quint64 EventBatch::diffTimeSum() const
+{
+    quint64 sum = 0;
+    const quint32 *t = m_diffTimesUs.constData();
+    for (int i = 0; i < m_size; ++i) {
+        sum += t[i];
+    }
+    return sum;
+}
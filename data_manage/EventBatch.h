@@ -0,0 +1,140 @@
+#ifndef EVENTBATCH_H
+#define EVENTBATCH_H
+
+#include <QVector>
+#include <QMetaType>
+#include "MeasurementTypeHelper.h"
+#include "EventData.h"
+
+
+/**
+ * @brief Columnar (SoA) storage for a batch of pulse events.
+ *
+ * All measurement columns live in one contiguous block, one column per
+ * (enabled channel, measurement type), each 'capacity' values long. The
+ * per-event header fields are kept in parallel columns. Projecting a
+ * channel is therefore a pointer offset, and a batch of any size costs six
+ * allocations. The columns are implicitly shared, so passing a batch by
+ * value through a queued signal does not copy the events.
+ */
+class EventBatch
+{
+public:
+    enum EventFlag : quint8 {
+        FlagEnableSort  = 0x01,
+        FlagSorted      = 0x02,
+        FlagValidSpeed  = 0x04,
+    };
+
+    static constexpr int MAX_CHANNELS = 8;
+    static constexpr int MEASUREMENT_NUM = EventData::MEASUREMENT_WORDS;
+
+    EventBatch();
+    explicit EventBatch(const QVector<int> &enabledChannels, int capacity = 0);
+
+    void reset(const QVector<int> &enabledChannels, int capacity = 0);
+    void reserve(int capacity);
+    void resize(int size);
+    void clear() { m_size = 0; }
+    int  appendEvent();
+    void append(const EventData &event);
+
+    int  size() const { return m_size; }
+    int  capacity() const { return m_capacity; }
+    bool isEmpty() const { return m_size == 0; }
+
+    const QVector<int> &enabledChannels() const { return m_channels; }
+    int  channelCount() const { return m_channels.size(); }
+    int  channelIndex(int channelId) const;
+    static int channelSlot(int channelId);
+    static quint8 channelBit(int channelId);
+    static int measurementIndex(MeasurementType type) { return static_cast<int>(type); }
+
+    // Read access, column pointers are valid until the batch is modified
+    const qint32  *column(int channelId, MeasurementType type) const;
+    const qint32  *columnAt(int channelIndex, int measurementIndex) const;
+    const quint32 *eventIds() const { return m_eventIds.constData(); }
+    const quint32 *diffTimesUs() const { return m_diffTimesUs.constData(); }
+    const quint32 *postTimesUs() const { return m_postTimesUs.constData(); }
+    const quint8  *flags() const { return m_flags.constData(); }
+    const quint8  *chPulseValid() const { return m_chPulseValid.constData(); }
+
+    // Write access for producers filling rows in place
+    qint32  *columnData(int channelIndex, int measurementIndex);
+    quint32 *eventIdData() { return m_eventIds.data(); }
+    quint32 *diffTimeData() { return m_diffTimesUs.data(); }
+    quint32 *postTimeData() { return m_postTimesUs.data(); }
+    quint8  *flagData() { return m_flags.data(); }
+    quint8  *chPulseValidData() { return m_chPulseValid.data(); }
+
+    // Per-event helpers
+    int     value(int row, int channelId, MeasurementType type) const;
+    bool    isEnabledSort(int row) const { return (m_flags.at(row) & FlagEnableSort) != 0; }
+    bool    isRealSorted(int row) const { return (m_flags.at(row) & FlagSorted) != 0; }
+    bool    isValidSpeedMeasure(int row) const { return (m_flags.at(row) & FlagValidSpeed) != 0; }
+    bool    isValidChPulse(int row, int channelId) const { return (m_chPulseValid.at(row) & channelBit(channelId)) != 0; }
+    EventData eventAt(int row) const;
+
+    int     enableSortCount() const;
+    int     sortedCount() const;
+    quint64 diffTimeSum() const;
+
+private:
+    QVector<int>        m_channels;
+    int                 m_channelIndex[MAX_CHANNELS];   ///< column index per channel slot, -1 if not enabled
+    int                 m_size;
+    int                 m_capacity;
+
+    QVector<qint32>     m_values;           ///< channelCount * MEASUREMENT_NUM columns of m_capacity values
+    QVector<quint32>    m_eventIds;
+    QVector<quint32>    m_diffTimesUs;
+    QVector<quint32>    m_postTimesUs;
+    QVector<quint8>     m_flags;
+    QVector<quint8>     m_chPulseValid;
+};
+
+Q_DECLARE_METATYPE(EventBatch)
+
+
+/*
+ * Detector ids come from the DB and start at 1. The slot is the 0-based
+ * position used for m_channelIndex and for the chPulseValid bit, -1 for an
+ * id outside 1..MAX_CHANNELS.
+ */
+inline int EventBatch::channelSlot(int channelId)
+{
+    return (channelId >= 1 && channelId <= MAX_CHANNELS) ? channelId - 1 : -1;
+}
+
+inline quint8 EventBatch::channelBit(int channelId)
+{
+    const int slot = channelSlot(channelId);
+    return (slot < 0) ? 0 : static_cast<quint8>(0x01 << slot);
+}
+
+inline int EventBatch::channelIndex(int channelId) const
+{
+    const int slot = channelSlot(channelId);
+    return (slot < 0) ? -1 : m_channelIndex[slot];
+}
+
+inline const qint32 *EventBatch::columnAt(int channelIndex, int measurementIndex) const
+{
+    return m_values.constData() + (channelIndex * MEASUREMENT_NUM + measurementIndex) * m_capacity;
+}
+
+inline const qint32 *EventBatch::column(int channelId, MeasurementType type) const
+{
+    int idx = channelIndex(channelId);
+    if (idx < 0 || !MeasurementTypeHelper::isValidMeasurementType(type)) {
+        return nullptr;
+    }
+    return columnAt(idx, measurementIndex(type));
+}
+
+inline qint32 *EventBatch::columnData(int channelIndex, int measurementIndex)
+{
+    return m_values.data() + (channelIndex * MEASUREMENT_NUM + measurementIndex) * m_capacity;
+}
+
+#endif // EVENTBATCH_H
@@ -0,0 +1,62 @@
+#include "EventBatchPool.h"
+
+
+EventBatchPool::EventBatchPool()
+    : m_state(std::make_shared<State>())
+{
+    qRegisterMetaType<EventBatchPtr>("EventBatchPtr");
+}
+
+std::shared_ptr<EventBatch> EventBatchPool::acquire(const QVector<int> &enabledChannels, int capacity)
+{
+    EventBatch *batch = nullptr;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->freeList.isEmpty()) {
+            batch = m_state->freeList.takeLast();
+        }
+    }
+    if (batch) {
+        m_state->reused.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        batch = new EventBatch();
+        m_state->allocated.fetch_add(1, std::memory_order_relaxed);
+    }
+    batch->reset(enabledChannels, capacity);
+
+    std::shared_ptr<State> state = m_state;
+    return std::shared_ptr<EventBatch>(batch, [state](EventBatch *released) {
+        state->release(released);
+    });
+}
+
+void EventBatchPool::State::release(EventBatch *batch)
+{
+    QMutexLocker locker(&mutex);
+    if (freeList.size() < maxPooled) {
+        batch->clear();
+        freeList.append(batch);
+        return;
+    }
+    locker.unlock();
+    delete batch;
+}
+
+void EventBatchPool::setMaxPooled(int count)
+{
+    QVector<EventBatch *> surplus;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        m_state->maxPooled = qMax(0, count);
+        while (m_state->freeList.size() > m_state->maxPooled) {
+            surplus.append(m_state->freeList.takeLast());
+        }
+    }
+    qDeleteAll(surplus);
+}
+
+int EventBatchPool::pooledCount() const
+{
+    QMutexLocker locker(&m_state->mutex);
+    return m_state->freeList.size();
+}
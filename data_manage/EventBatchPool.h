@@ -0,0 +1,83 @@
+#ifndef EVENTBATCHPOOL_H
+#define EVENTBATCHPOOL_H
+
+#include <QMutex>
+#include <QVector>
+#include <memory>
+#include <atomic>
+#include "EventBatch.h"
+#include "SpscQueue.h"
+
+
+/**
+ * @brief Shared, read-only handle to a filled batch.
+ *
+ * Every consumer (plots, statistics, persistence, sort monitor) holds the
+ * same batch, the events are never copied. When the last handle goes away
+ * the batch returns to the EventBatchPool it came from.
+ */
+using EventBatchPtr = std::shared_ptr<const EventBatch>;
+
+Q_DECLARE_METATYPE(EventBatchPtr)
+
+
+struct EventBatchWeight
+{
+    quint64 operator()(const EventBatchPtr &batch) const { return batch ? batch->size() : 0; }
+};
+
+using EventBatchQueue = SpscQueue<EventBatchPtr, EventBatchWeight>;
+
+
+/**
+ * @brief Recycles EventBatch buffers between the receive path and the consumers.
+ *
+ * acquire() hands out a writable batch, the producer fills it and passes it
+ * on as EventBatchPtr. A released batch keeps its columns, so a batch with
+ * the same channel layout is refilled without touching the allocator.
+ * acquire() and the release from the last handle may run on any thread.
+ */
+class EventBatchPool
+{
+public:
+    static EventBatchPool &instance() {
+        static EventBatchPool instance;
+        return instance;
+    }
+    EventBatchPool(const EventBatchPool &) = delete;
+    EventBatchPool &operator=(const EventBatchPool &) = delete;
+
+    /**
+     * @brief Returns an empty batch for the channel layout with room for capacity events.
+     */
+    std::shared_ptr<EventBatch> acquire(const QVector<int> &enabledChannels, int capacity);
+
+    void    setMaxPooled(int count);
+    int     pooledCount() const;
+    quint64 allocatedCount() const { return m_state->allocated.load(std::memory_order_relaxed); }
+    quint64 reusedCount() const { return m_state->reused.load(std::memory_order_relaxed); }
+
+private:
+    EventBatchPool();
+
+    /*
+     * Kept alive by every outstanding handle, so batches released during
+     * static destruction do not outlive the free list.
+     */
+    struct State {
+        mutable QMutex          mutex;
+        QVector<EventBatch *>   freeList;
+        int                     maxPooled = DefaultMaxPooled;
+        std::atomic<quint64>    allocated{0};
+        std::atomic<quint64>    reused{0};
+
+        ~State() { qDeleteAll(freeList); }
+        void release(EventBatch *batch);
+    };
+
+    static constexpr int DefaultMaxPooled = 2048;
+
+    std::shared_ptr<State> m_state;
+};
+
+#endif // EVENTBATCHPOOL_H
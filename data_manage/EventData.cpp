@@ -1,4 +1,5 @@
 #include "EventData.h"
+#include "EventBatch.h"
 #include <QDebug>
 
 EventData::EventData() {
@@ -103,6 +104,38 @@ EventData::EventData(const QVector<int> &channels, QDataStream &stream)
     }
 }
 
+/*
+ * Build an event from host order words which are already byte swapped,
+ * the layout is the same as the event frame (see UdpCommClient::parseEventData).
+ */
+EventData::EventData(const QVector<int> &channels, const quint32 *words)
+{
+    enabledChannels = channels;
+    data.resize(channels.size(), QVector<int>(MEASUREMENT_WORDS, 0));
+    for (int i = 0; i < channels.size(); ++i) {
+        channelIndexMap.insert(channels[i], i);
+    }
+
+    const quint32 header = words[1];
+    diffTimeUs = words[2];
+    postTimeUs = words[3];
+    eventId = header & EVENT_ID_MASK;
+    enableSorted = ((header & ENABLE_SORT_BIT) != 0);
+    isSorted = ((header & SORTED_BIT) != 0);
+    isValidMeasure = ((header & VALID_MEASURE_BIT) != 0);
+    chPulseValid = static_cast<quint8>(header >> CH_PULSE_VALID_SHIFT);
+
+    const quint32 *measurement = words + 4;
+    for (int i = 0; i < channels.size(); i++) {
+        for (int j = 0; j < MEASUREMENT_WORDS; j++) {
+            data[i][j] = static_cast<int>(*measurement++);
+        }
+    }
+
+    const int lastWord = eventWordCount(channels.size()) - 1;
+    isValidData = (words[0] == HEAD_MAGIC && words[lastWord] == TAIL_MAGIC);
+}
+
 int EventData::getData(int channelId, MeasurementType type) const
 {
     int idx = channelIndexMap.value(channelId, -1);
@@ -134,3 +167,8 @@ void EventData::setData(int channelId, MeasurementType type, int val)
 
     data[idx][static_cast<int>(type)] = val;
 }
+
+bool EventData::isValidChPulse(int channelId) const
+{
+    return (chPulseValid & EventBatch::channelBit(channelId)) != 0;
+}
@@ -13,6 +13,7 @@ public:
     explicit EventData(const QVector<int> &enabledChannels);
     explicit EventData(const QVector<int> &enabledChannels, const QByteArray &bytes);
     explicit EventData(const QVector<int> &enabledChannels, QDataStream &stream);
+    explicit EventData(const QVector<int> &enabledChannels, const quint32 *words);
     int getWidth(int channelId) const;
     int getHeight(int channelId) const;
     int getArea(int channelId) const;
@@ -43,6 +44,18 @@ public:
 
     static constexpr quint32 HEAD_MAGIC = 0x55AA55AA;
     static constexpr quint32 TAIL_MAGIC = 0xAA55AA55;
+
+    // Bit fields of the event header word
+    static constexpr quint32 EVENT_ID_MASK          = 0x000FFFFF;
+    static constexpr quint32 ENABLE_SORT_BIT        = 0x00100000;
+    static constexpr quint32 SORTED_BIT             = 0x00200000;
+    static constexpr quint32 VALID_MEASURE_BIT      = 0x00400000;
+    static constexpr int     CH_PULSE_VALID_SHIFT   = 24;
+
+    // Words of one event: head magic, header, diff time, post time, tail magic
+    static constexpr int     EVENT_FIXED_WORDS      = 5;
+    static constexpr int     MEASUREMENT_WORDS      = 3;
+    static constexpr int eventWordCount(int channelNum) { return channelNum * MEASUREMENT_WORDS + EVENT_FIXED_WORDS; }
 private:
     quint32                 eventId;
     quint32                 diffTimeUs;
@@ -100,12 +113,6 @@ inline bool EventData::isValidSpeedMeasure() const
     return isValidMeasure;
 }
 
-inline bool EventData::isValidChPulse(int channelId) const
-{
-    bool isValid = ((chPulseValid & (0x01 << channelId)) != 0);
-    return isValid;
-}
-
 inline const QVector<int> &EventData::getEnabledChannels() const
 {
     return enabledChannels;
@@ -1,104 +1,99 @@
 #include "EventDataManager.h"
-#include "HistogramPlot.h"
-#include "ScatterPlot.h"
 #include <QFile>
 #include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include "ContinuityMonitor.h"
+#include "AppSettings.h"
 
 
 EventDataManager::EventDataManager(QObject *parent)
-    : QObject{parent}
+    : QObject{parent}, m_exportCsv(false),
+    m_writeFcs(true),
+    m_eventData(EventBatchQueueSize, EventBatchQueue::OverflowPolicy::DropOldest),
+    m_processedEvent(0), m_enableSortEvent(0), m_sortedEvent(0), m_discardEvent(0),
+    m_speedMeasureDist(0), m_speedMeasureTimeSpan(0), m_speedMeasured(0),
+    m_kernels(&EventKernels::table(0))
 {
     qRegisterMetaType<EventData>("EventData");
     qRegisterMetaType<QList<EventData>>("QList<EventData>");
     qRegisterMetaType<QList<EventData>*>("QList<EventData>*");
+    qRegisterMetaType<EventBatch>("EventBatch");
+    qRegisterMetaType<EventBatchPtr>("EventBatchPtr");
 }
 
-void EventDataManager::processHistogramData(PlotBase *plot, const QVector<EventData> &data)
+/*
+ * Detector settings and acquisition parameters stored in the header of the
+ * acquisition file, so the file can be read without the settings database.
+ */
+QJsonObject EventDataManager::acquisitionMetadata(const QVector<DetectorSettings> &settings) const
 {
-    HistogramPlot *histogramPlot = static_cast<HistogramPlot*>(plot);
-    if (!histogramPlot) return;
+    QJsonObject metadata;
+    metadata["startTime"] = m_startTime.toString(Qt::ISODateWithMs);
+    metadata["speedMeasureDist"] = m_speedMeasureDist;
 
-    int channelX = histogramPlot->axisXDetectorId();
-    MeasurementType xType = histogramPlot->xMeasurementType();
-
-
-    QVector<int> histogram;
-    for (const EventData &aData : data) {
-        if (aData.isValidChPulse(channelX)) {
-            histogram.append(aData.getData(channelX, xType));
-        }
+    QJsonArray measurements;
+    for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
+        measurements.append(MeasurementTypeHelper::measurementTypeToString(type));
     }
-    histogramPlot->updateData(histogram);
-}
+    metadata["measurements"] = measurements;
 
-void EventDataManager::processScatterData(PlotBase *plot, const QVector<EventData> &data)
-{
-    ScatterPlot *scatterPlot = static_cast<ScatterPlot*>(plot);
-    if (!scatterPlot) return;
-
-    int channelX = scatterPlot->axisXDetectorId();
-    MeasurementType xType = scatterPlot->xMeasurementType();
-    int channelY = scatterPlot->axisYDetectorId();
-    MeasurementType yType = scatterPlot->yMeasurementType();
-
-
-    QVector<QPoint> scatterData;
-    for (const EventData &aData : data) {
-        if (aData.isValidChPulse(channelX) && aData.isValidChPulse(channelY)) {
-            scatterData.append(QPoint(aData.getData(channelX, xType),
-                                       aData.getData(channelY, yType)));
-        }
+    QJsonArray detectors;
+    for (const DetectorSettings &setting : settings) {
+        QJsonObject detector;
+        detector["detectorId"] = setting.detectorId();
+        detector["parameter"] = setting.parameterName();
+        detector["gain"] = setting.detectorGain();
+        detector["offset"] = setting.detectorOffset();
+        detector["thresholdEnabled"] = setting.isEnabledThreshold();
+        detector["threshold"] = setting.thresholdValue();
+        detector["height"] = setting.isEnabledHeight();
+        detector["width"] = setting.isEnabledWidth();
+        detector["area"] = setting.isEenabledArea();
+        detectors.append(detector);
     }
-    scatterPlot->updateData(scatterData);
+    metadata["detectors"] = detectors;
+    return metadata;
 }
 
-void EventDataManager::processContourData(PlotBase *plot, const QVector<EventData> &data)
+/*
+ * CSV is only an export of the acquisition file, written once the
+ * acquisition is closed instead of per batch on the receive path.
+ */
+void EventDataManager::exportCsvFile()
 {
-    // To be implemented
-
-}
-
-
-
-void EventDataManager::saveEventToCsvFile(const QVector<EventData> &updateData)
-{
-    QFile dataFile(m_dataSavePath);
-    if (!dataFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append)) {
-        qDebug() << "Save Failed! Error: data file open failed!";
+    AcquisitionFileReader reader;
+    if (!reader.open(m_dataSavePath)) {
+        qWarning() << "Export csv failed! Error:" << reader.errorString();
         return;
     }
-
-    QTextStream dataStream(&dataFile);
-    for (const EventData &data : updateData) {
-        dataStream << data.getEventId() << ",";
-        dataStream << data.isValidSpeedMeasure() << ',';
-        dataStream << data.getPostTimeUs() << ",";
-        dataStream << data.getDiffTimeUs() << ",";
-        dataStream << (data.isEnabledSort() ? "true" : "false") << ",";
-        dataStream << (data.isRealSorted() ? "true" : "false") << ",";
-        dataStream << QString::number(data.validChPulse())<<",";
-        for (int ch : data.getEnabledChannels()) {
-            for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
-                dataStream << data.getData(ch, type) << ",";
-            }
-        }
-
-        dataStream << "\n";
+    const QString csvPath = QFileInfo(m_dataSavePath).absoluteDir().absoluteFilePath("pulsedata.csv");
+    if (reader.exportCsv(csvPath)) {
+        qDebug() << "Exported" << reader.eventCount() << "events to" << csvPath;
     }
 }
 
 void EventDataManager::initEventDataManager(const QVector<DetectorSettings> &settings)
 {
+    // A session that was not closed is completed on disk before the next one starts
+    m_persistence.stopPersistence();
     m_processedEvent = 0;
     m_enableSortEvent = 0;
     m_sortedEvent = 0;
     m_discardEvent = 0;
 
+    m_startTime = QDateTime::currentDateTime();
+    ContinuityMonitor::instance().reset();
+
     m_enabledChannels.clear();
     for (const DetectorSettings &setting : settings) {
         m_enabledChannels.append(setting.detectorId());
     }
-    m_eventData.init(EventData(m_enabledChannels));
+    m_kernels = &EventKernels::table(m_enabledChannels.size());
+    // Producer is disconnected between acquisitions, so the queue is idle here
+    m_eventData.reset();
+    m_gateEngine.clearStatistics();
 
 
     m_dataSavePath = QString("./SeekCytometerData/pulse_data_%1").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
@@ -111,83 +106,117 @@ void EventDataManager::initEventDataManager(const QVector<DetectorSettings> &set
             m_dataSavePath = ".";
         }
     }
-    m_dataSavePath = saveDir.absoluteFilePath("pulsedata.csv");
-    QFile dataFile(m_dataSavePath);
-    if (dataFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODeviceBase::Append)) {
-        QTextStream textStream(&dataFile);
-        textStream << "Event ID";
-        textStream << ",";
-        textStream << "Valid Speed";
-        textStream << ",";
-        textStream << "Start Time(s)";
-        textStream << ",";
-        textStream << QString("Speed (us for %1um)").arg(m_speedMeasureDist);
-        textStream << ",";
-        textStream << "Sort Triggered";
-        textStream << ",";
-        textStream << "Sorted";
-        textStream << ",";
-        textStream << "Pulse Ch";
-        textStream << ",";
-        for (int ch : m_enabledChannels) {
-            for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
-                textStream << QString("Channel-%1(%2)").arg(ch).arg(MeasurementTypeHelper::measurementTypeToString(type));
-                textStream << ",";
-            }
+    m_dataSavePath = saveDir.absoluteFilePath("events.seekacq");
+    m_exportCsv = AppSettings::instance().exportCsv();
+    m_writeFcs = AppSettings::instance().writeFcs();
+    m_persistence.setCompression(AppSettings::instance().compression());
+    if (!m_persistence.startPersistence(m_dataSavePath, m_enabledChannels, acquisitionMetadata(settings),
+                                        m_writeFcs ? saveDir.absoluteFilePath("events.fcs") : QString())) {
+        qWarning() << "[EventDataManager] Events of this acquisition are not saved:" << m_persistence.errorString();
+    }
+}
+
+QString EventDataManager::dataSaveDirectory() const
+{
+    return QFileInfo(m_dataSavePath).absolutePath();
+}
+
+void EventDataManager::closeEventDataManager()
+{
+    if (m_persistence.isPersisting()) {
+        m_persistence.stopPersistence();
+        if (m_exportCsv) {
+            exportCsvFile();
         }
-        textStream << "\n";
-        dataFile.close();
     }
+    saveLossReport();
 }
 
-void EventDataManager::addEvent(const EventData &data)
+/*
+ * Loss report of the acquisition, written next to the pulse data file.
+ */
+void EventDataManager::saveLossReport()
 {
-    m_processedEvent++;
-    if (data.isEnabledSort()) m_enableSortEvent++;
-    if (data.isRealSorted()) m_sortedEvent++;
-    if (data.isEnabledSort() && !data.isRealSorted()) m_discardEvent++;
+    if (m_dataSavePath.isEmpty()) {
+        return;
+    }
+    QJsonObject report = ContinuityMonitor::instance().report().toJson();
+    report["start"] = m_startTime.toString(Qt::ISODate);
+    report["end"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    report["processedEvents"] = m_processedEvent.load();
+
+    QJsonObject queue;
+    queue["droppedEvents"] = static_cast<qint64>(m_eventData.droppedCount());
+    queue["highWaterMark"] = m_eventData.highWaterMark();
+    queue["capacity"] = m_eventData.capacity();
+    report["eventQueue"] = queue;
+
+    QJsonObject persistence;
+    persistence["writtenEvents"] = static_cast<qint64>(m_persistence.writtenEvents());
+    persistence["droppedEvents"] = static_cast<qint64>(m_persistence.droppedEvents());
+    persistence["writtenBytes"] = static_cast<qint64>(m_persistence.writtenBytes());
+    persistence["maxWriteLatencyUs"] = m_persistence.maxWriteLatencyUs();
+    persistence["highWaterMark"] = m_persistence.queueHighWaterMark();
+    persistence["capacity"] = m_persistence.queueCapacity();
+    if (m_persistence.hasFailed()) {
+        persistence["error"] = m_persistence.errorString();
+    }
+    if (m_persistence.hasFcsFailed()) {
+        persistence["fcsError"] = m_persistence.fcsErrorString();
+    }
+    report["persistence"] = persistence;
 
-    m_eventData.write(data);
+    QFile reportFile(QFileInfo(m_dataSavePath).absoluteDir().absoluteFilePath("loss_report.json"));
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Save loss report failed! Error:" << reportFile.errorString();
+        return;
+    }
+    reportFile.write(QJsonDocument(report).toJson());
 }
 
-void EventDataManager::addEvents(const QVector<EventData> data, int enableSortNum, int sortedNum, double timeSpan)
+void EventDataManager::addEvents(const EventBatchPtr &data, int enableSortNum, int sortedNum, double timeSpan)
 {
-    m_processedEvent += data.size();
+    if (!data || data->isEmpty()) return;
+    m_processedEvent += data->size();
     m_enableSortEvent += enableSortNum;
     m_sortedEvent += sortedNum;
     m_discardEvent += (enableSortNum - sortedNum);
     m_speedMeasureTimeSpan = timeSpan;
     m_speedMeasured = m_speedMeasureDist / m_speedMeasureTimeSpan;
-    m_eventData.writeMultiple(data);
-    saveEventToCsvFile(data);
+    m_eventData.push(data);
+    m_persistence.submit(data);
 }
 
-const QVector<EventData> &EventDataManager::getEventData()
+QVector<EventBatchPtr> EventDataManager::getEventData()
 {
-    return m_eventData.readMultiple(m_eventData.avaiable());
+    QVector<EventBatchPtr> data;
+    EventBatchQueue::ReadSpans spans = m_eventData.acquire();
+    data.reserve(spans.size());
+    for (int i = 0; i < spans.first.size; ++i) {
+        data.append(std::move(spans.first.data[i]));
+    }
+    for (int i = 0; i < spans.second.size; ++i) {
+        data.append(std::move(spans.second.data[i]));
+    }
+    m_eventData.release();
+    return data;
 }
 
-void EventDataManager::processData(const QVector<PlotBase *> &plots)
+/*
+ * Hands the batches to the plot layers, which project and draw them on the
+ * render workers, and counts them into the gate statistics. Returns false
+ * when no events were waiting.
+ */
+bool EventDataManager::processData(const QVector<PlotBase *> &plots)
 {
-    if (m_eventData.isEmpty()) return;
-    QVector<EventData> data = m_eventData.readMultiple(m_eventData.avaiable());
+    if (m_eventData.isEmpty()) return false;
+    QVector<EventBatchPtr> data = getEventData();
 
     for (PlotBase *plot : plots) {
-        PlotType plotType = plot->plotType();
-        switch (plotType) {
-        case PlotType::HISTOGRAM_PLOT:
-            processHistogramData(plot, data);
-            break;
-        case PlotType::SCATTER_PLOT:
-            processScatterData(plot, data);
-            break;
-        case PlotType::CONTOUR_PLOT:
-            processContourData(plot, data);
-            break;
-        default:
-            break;
-        }
+        plot->addEvents(data);
     }
+    m_gateEngine.process(data);
+    return true;
 }
 
 
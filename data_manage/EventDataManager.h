@@ -2,16 +2,29 @@
 #define EVENTDATAMANAGER_H
 
 #include <QObject>
-#include "RingBuffer.h"
+#include <QDateTime>
+#include <atomic>
+#include "SpscQueue.h"
 
 #include "MeasurementTypeHelper.h"
 
 #include "PlotBase.h"
 #include "DetectorSettings.h"
 #include "EventData.h"
+#include "EventBatchPool.h"
+#include "EventKernels.h"
+#include "AcquisitionPersistence.h"
+#include "GateEngine.h"
 
 
 
+/**
+ * @brief Collects decoded events for plotting and saving.
+ *
+ * addEvents() is called directly on the UDP receive thread and is the only
+ * producer of the event queue, processData() on the GUI thread is the only
+ * consumer. The counters read by the widgets are atomics.
+ */
 class EventDataManager : public QObject
 {
     Q_OBJECT
@@ -24,21 +37,27 @@ public:
     EventDataManager(const EventDataManager &) = delete;
 
     void initEventDataManager(const QVector<DetectorSettings> &settings);
+    void closeEventDataManager();
     const QVector<int> &enabledChannels() const;
+    const EventKernels::Table &kernels() const { return *m_kernels; }
+    QString dataSaveDirectory() const;
+    AcquisitionPersistence &persistence() { return m_persistence; }
+    GateEngine &gateEngine() { return m_gateEngine; }
     void setSpeedMeasureDist(int dist);
     int sortedEventNum() const;
     int enableSortedEventNum() const;
     int processedEventNum() const;
     int discardedEventNum() const;
     double speedMeasured() const;
+    int queueHighWaterMark() const;
+    quint64 droppedEventNum() const;
 
 
 public slots:
-    void addEvent(const EventData &data);
-    void addEvents(const QVector<EventData> data, int enableSortNum, int sortedNum, double timeSpan);
-    const QVector<EventData> &getEventData();
+    void addEvents(const EventBatchPtr &data, int enableSortNum, int sortedNum, double timeSpan);
+    QVector<EventBatchPtr> getEventData();
 
-    void processData(const QVector<PlotBase*> &plots);
+    bool processData(const QVector<PlotBase*> &plots);
 
 signals:
 
@@ -46,27 +65,32 @@ signals:
 private:
     explicit EventDataManager(QObject *parent = nullptr);
 
-    void processHistogramData(PlotBase *plot, const QVector<EventData> &data);
-    void processScatterData(PlotBase *plot, const QVector<EventData> &data);
-    void processContourData(PlotBase *plot, const QVector<EventData> &data);
-
-    void saveEventToCsvFile(const QVector<EventData> &updateData);
+    QJsonObject acquisitionMetadata(const QVector<DetectorSettings> &settings) const;
+    void exportCsvFile();
+    void saveLossReport();
 
 
     QString         m_dataSavePath;
+    QDateTime       m_startTime;
+    AcquisitionPersistence  m_persistence;         ///< Fed from addEvents(), writes the acquisition file
+    bool            m_exportCsv;                    ///< Export pulsedata.csv from the acquisition file on close, read at start
+    bool            m_writeFcs;                     ///< Stream events.fcs next to the acquisition file, read at start
+    GateEngine      m_gateEngine;                   ///< Gate statistics, fed from processData()
 
-    RingBuffer<EventData>               m_eventData;
+    static constexpr int EventBatchQueueSize = 1024;
+    EventBatchQueue     m_eventData;        ///< Batches waiting for the plot update, the oldest dropped when full
 
-    int             m_processedEvent;
-    int             m_enableSortEvent;
-    int             m_sortedEvent;
-    int             m_discardEvent;
-    int             m_speedMeasureDist;
-    double          m_speedMeasureTimeSpan;
-    double          m_speedMeasured;
+    std::atomic<int>    m_processedEvent;
+    std::atomic<int>    m_enableSortEvent;
+    std::atomic<int>    m_sortedEvent;
+    std::atomic<int>    m_discardEvent;
+    int                 m_speedMeasureDist;
+    double              m_speedMeasureTimeSpan;
+    std::atomic<double> m_speedMeasured;
 
 
     QVector<int>                        m_enabledChannels;
+    const EventKernels::Table           *m_kernels;     ///< Picked for the channel count in initEventDataManager()
 
 };
 
@@ -105,6 +129,16 @@ inline double EventDataManager::speedMeasured() const
     return m_speedMeasured;
 }
 
+inline int EventDataManager::queueHighWaterMark() const
+{
+    return m_eventData.highWaterMark();
+}
+
+inline quint64 EventDataManager::droppedEventNum() const
+{
+    return m_eventData.droppedCount();
+}
+
 
 
 #endif // EVENTDATAMANAGER_H
@@ -0,0 +1,32 @@
+#include "EventKernels.h"
+
+
+namespace EventKernels {
+
+template <int Channels>
+static constexpr Table makeTable()
+{
+    return Table{Channels, &decode<Channels>};
+}
+
+static const Table kTables[] = {
+    makeTable<0>(),
+    makeTable<1>(),
+    makeTable<2>(),
+    makeTable<3>(),
+    makeTable<4>(),
+    makeTable<5>(),
+    makeTable<6>(),
+    makeTable<7>(),
+    makeTable<8>(),
+};
+
+const Table &table(int channelNum)
+{
+    if (channelNum < 1 || channelNum > EventBatch::MAX_CHANNELS) {
+        return kTables[0];
+    }
+    return kTables[channelNum];
+}
+
+} // namespace EventKernels
@@ -0,0 +1,171 @@
+#ifndef EVENTKERNELS_H
+#define EVENTKERNELS_H
+
+#include <QPoint>
+#include "EventData.h"
+#include "EventBatch.h"
+
+
+/**
+ * @brief Per-frame result of decoding a CMD_PULSE_DATA payload.
+ */
+struct EventFrameStats
+{
+    int     totalEvents = 0;        ///< Events contained in the payload
+    int     validEvents = 0;        ///< Events with matching head and tail magic
+    int     invalidEvents = 0;      ///< Events dropped because of a magic mismatch
+    int     enableSortNum = 0;      ///< Valid events with sort triggered
+    int     sortedNum = 0;          ///< Valid events really sorted
+    quint64 diffTimeSum = 0;        ///< Sum of diff time (us) over valid events
+    int     trailingBytes = 0;      ///< Bytes left over after the last whole event
+};
+
+
+/**
+ * @brief Column pointers of an EventBatch the decode kernel writes rows into.
+ */
+struct EventDecodeTarget
+{
+    quint32 *eventIds;
+    quint32 *diffTimes;
+    quint32 *postTimes;
+    quint8  *flags;
+    quint8  *chPulseValid;
+    qint32  *values;                ///< First measurement column
+    int     stride;                 ///< Batch capacity, distance between two columns
+    int     row;                    ///< Next row to write
+};
+
+
+/**
+ * @brief Count, sums and sums of squares of the values inside a range.
+ *
+ * Values are accumulated relative to 'origin', the centre of the range,
+ * so the single pass variance keeps its precision for large AD values.
+ */
+struct RangeStats
+{
+    quint64 count = 0;
+    double  origin[2] = {0, 0};
+    double  sum[2] = {0, 0};
+    double  sumSq[2] = {0, 0};
+
+    double mean(int dim) const { return count ? origin[dim] + sum[dim] / count : 0.0; }
+    double variance(int dim) const {
+        if (!count) return 0.0;
+        const double m = sum[dim] / count;
+        return qMax(0.0, sumSq[dim] / count - m * m);
+    }
+    // Adds stats gathered over other events of the same range (same origin)
+    void merge(const RangeStats &other) {
+        if (!other.count) return;
+        count += other.count;
+        for (int dim = 0; dim < 2; ++dim) {
+            origin[dim] = other.origin[dim];
+            sum[dim] += other.sum[dim];
+            sumSq[dim] += other.sumSq[dim];
+        }
+    }
+};
+
+
+/**
+ * @brief Event decode kernel specialized on the channel count, and the projection kernels.
+ *
+ * The event layout is channelCount * 3 + 5 words. Instantiating the decode
+ * kernel for 1..8 channels gives the per-event loop a constant trip count
+ * the compiler unrolls, table() picks the instance for the current detector
+ * settings once, when acquisition starts. Channel counts outside 1..8 use
+ * the generic instance, which reads the count at run time.
+ *
+ * The projections walk one column and a valid mask whatever the channel
+ * count or measurement, so they are plain functions outside the table.
+ */
+namespace EventKernels {
+
+using DecodeFn = int (*)(const quint32 *words, int eventNum, int channelNum,
+                         EventDecodeTarget &target, EventFrameStats &stats);
+
+struct Table
+{
+    int         channelNum;         ///< 0 for the generic instance
+    DecodeFn    decode;
+};
+
+const Table &table(int channelNum);
+
+
+/*
+ * Decodes eventNum events of host order words into the target columns,
+ * events with a broken head or tail magic are skipped. Returns the rows written.
+ */
+template <int Channels>
+int decode(const quint32 *words, int eventNum, int channelNum, EventDecodeTarget &target, EventFrameStats &stats)
+{
+    const int channels = Channels > 0 ? Channels : channelNum;
+    const int eventWords = EventData::eventWordCount(channels);
+    const int columnNum = channels * EventBatch::MEASUREMENT_NUM;
+    const int tailIndex = eventWords - 1;
+    const int stride = target.stride;
+    int row = target.row;
+
+    for (int i = 0; i < eventNum; ++i, words += eventWords) {
+        if (words[0] != EventData::HEAD_MAGIC || words[tailIndex] != EventData::TAIL_MAGIC) {
+            stats.invalidEvents++;
+            continue;
+        }
+        const quint32 header = words[1];
+        const quint8 flag = ((header & EventData::ENABLE_SORT_BIT) ? EventBatch::FlagEnableSort : 0)
+                            | ((header & EventData::SORTED_BIT) ? EventBatch::FlagSorted : 0)
+                            | ((header & EventData::VALID_MEASURE_BIT) ? EventBatch::FlagValidSpeed : 0);
+        stats.enableSortNum += (flag & EventBatch::FlagEnableSort) ? 1 : 0;
+        stats.sortedNum += (flag & EventBatch::FlagSorted) ? 1 : 0;
+        stats.validEvents++;
+        stats.diffTimeSum += words[2];
+
+        target.eventIds[row] = header & EventData::EVENT_ID_MASK;
+        target.diffTimes[row] = words[2];
+        target.postTimes[row] = words[3];
+        target.flags[row] = flag;
+        target.chPulseValid[row] = static_cast<quint8>(header >> EventData::CH_PULSE_VALID_SHIFT);
+
+        // Measurement words are already in column order: (H, W, A) per channel
+        const quint32 *measurements = words + 4;
+        qint32 *values = target.values + row;
+        for (int col = 0; col < columnNum; ++col) {
+            values[col * stride] = static_cast<qint32>(measurements[col]);
+        }
+        row++;
+    }
+    const int written = row - target.row;
+    target.row = row;
+    return written;
+}
+
+/*
+ * Branch free compaction of the values whose channels are all valid, out
+ * must have room for count values. Returns the values written.
+ */
+inline int project1D(const qint32 *x, const quint8 *chValid, quint8 mask, int count, qint32 *out)
+{
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        out[n] = x[i];
+        n += ((chValid[i] & mask) == mask);
+    }
+    return n;
+}
+
+inline int project2D(const qint32 *x, const qint32 *y, const quint8 *chValid, quint8 mask, int count, QPoint *out)
+{
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        out[n] = QPoint(x[i], y[i]);
+        n += ((chValid[i] & mask) == mask);
+    }
+    return n;
+}
+
+} // namespace EventKernels
+
+#endif // EVENTKERNELS_H
@@ -0,0 +1,520 @@
+#include "FcsFile.h"
+#include "AcquisitionFile.h"
+#include <QJsonArray>
+#include <QtEndian>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+using namespace AcquisitionFormat;
+
+
+namespace {
+
+QByteArray escaped(const QString &text)
+{
+    QByteArray value = text.toUtf8();
+    value.replace(FcsFormat::DELIMITER, QByteArray(2, FcsFormat::DELIMITER));
+    return value;
+}
+
+QByteArray headerOffset(qint64 offset)
+{
+    // Offsets beyond 8 digits are only given by the TEXT keywords
+    return QByteArray::number(offset > 99999999 ? 0 : offset).rightJustified(8, ' ');
+}
+
+/*
+ * FCS date format, dd-mmm-yyyy with an upper case English month.
+ */
+QString fcsDate(const QDate &date)
+{
+    static const char *months[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    return QString("%1-%2-%3").arg(date.day(), 2, 10, QChar('0')).arg(QLatin1String(months[date.month() - 1])).arg(date.year());
+}
+
+} // namespace
+
+
+FcsWriter::~FcsWriter()
+{
+    close();
+}
+
+bool FcsWriter::open(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        m_errorString = m_file.errorString();
+        qWarning() << "[FcsWriter] Open file failed:" << filePath << m_errorString;
+        return false;
+    }
+    m_channels = channels;
+    m_parameterNum = columnCount(m_channels.size());
+    m_buffer.clear();
+    m_placeholders.clear();
+    m_eventCount = 0;
+    m_errorString.clear();
+
+    QHash<int, QJsonObject> detectors;
+    for (const QJsonValue &value : metadata.value("detectors").toArray()) {
+        detectors.insert(value.toObject().value("detectorId").toInt(), value.toObject());
+    }
+    const QDateTime start = QDateTime::fromString(metadata.value("startTime").toString(), Qt::ISODateWithMs);
+    const QDateTime startTime = start.isValid() ? start : QDateTime::currentDateTime();
+
+    QByteArray text(1, FcsFormat::DELIMITER);
+    auto addKeyword = [&text](const QString &key, const QString &value) {
+        text += escaped(key) + FcsFormat::DELIMITER + escaped(value.isEmpty() ? QString(" ") : value) + FcsFormat::DELIMITER;
+    };
+    auto addPlaceholder = [&](const QString &key, const QByteArray &value) {
+        text += escaped(key) + FcsFormat::DELIMITER;
+        m_placeholders.insert(key, Placeholder{text.size(), static_cast<int>(value.size())});
+        text += value + FcsFormat::DELIMITER;
+    };
+    const QByteArray zeroOffset(FcsFormat::OFFSET_DIGITS, '0');
+
+    addKeyword("$BEGINANALYSIS", "0");
+    addKeyword("$ENDANALYSIS", "0");
+    addKeyword("$BEGINSTEXT", "0");
+    addKeyword("$ENDSTEXT", "0");
+    addPlaceholder("$BEGINDATA", zeroOffset);
+    addPlaceholder("$ENDDATA", zeroOffset);
+    addKeyword("$BYTEORD", Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? "1,2,3,4" : "4,3,2,1");
+    addKeyword("$DATATYPE", "D");
+    addKeyword("$MODE", "L");
+    addKeyword("$NEXTDATA", "0");
+    addKeyword("$PAR", QString::number(m_parameterNum));
+    addPlaceholder("$TOT", zeroOffset);
+    addKeyword("$CYT", FcsFormat::CYTOMETER);
+    addKeyword("$DATE", fcsDate(startTime.date()));
+    addKeyword("$BTIM", startTime.toString("hh:mm:ss"));
+    addPlaceholder("$ETIM", QByteArray("00:00:00"));
+
+    QStringList channelIds;
+    for (int ch : m_channels) {
+        channelIds << QString::number(ch);
+    }
+    addKeyword("SEEK_CHANNELS", channelIds.join(','));
+    addKeyword("SEEK_SPEED_MEASURE_DIST", QString::number(metadata.value("speedMeasureDist").toInt()));
+
+    auto addParameter = [&](int index, const QString &name, const QString &description, const QString &range) {
+        addKeyword(QString("$P%1N").arg(index), name);
+        addKeyword(QString("$P%1S").arg(index), description);
+        addKeyword(QString("$P%1B").arg(index), QString::number(FcsFormat::VALUE_SIZE * 8));
+        addKeyword(QString("$P%1E").arg(index), "0,0");
+        addKeyword(QString("$P%1R").arg(index), range);
+    };
+    int index = 1;
+    for (int ch : m_channels) {
+        const QJsonObject detector = detectors.value(ch);
+        QString parameter = detector.value("parameter").toString();
+        if (parameter.isEmpty()) {
+            parameter = QString("Ch%1").arg(ch);
+        }
+        for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
+            addParameter(index++, MeasurementTypeHelper::parameterMeasurementType(parameter, type),
+                         QString("%1 %2").arg(parameter, MeasurementTypeHelper::measurementTypeToString(type)), "2147483648");
+        }
+        if (!detector.isEmpty()) {
+            addKeyword(QString("SEEK_CH%1_GAIN").arg(ch), QString::number(detector.value("gain").toInt()));
+            addKeyword(QString("SEEK_CH%1_OFFSET").arg(ch), QString::number(detector.value("offset").toInt()));
+            if (detector.value("thresholdEnabled").toBool()) {
+                addKeyword(QString("SEEK_CH%1_THRESHOLD").arg(ch), QString::number(detector.value("threshold").toInt()));
+            }
+        }
+    }
+    addParameter(index++, "Time", "Post time (us)", "4294967296");
+    addKeyword("$TIMESTEP", "0.000001");     // required with a Time parameter, seconds per unit
+    addParameter(index++, "DiffTime", "Speed measure time (us)", "4294967296");
+    addParameter(index++, "EventID", "Event ID", "4294967296");
+    addParameter(index++, "Flags", "Sort triggered, sorted, valid speed", "256");
+    addParameter(index++, "PulseValid", "Channels with a valid pulse", "256");
+
+    // Placeholders were recorded relative to the TEXT segment
+    m_textBegin = FcsFormat::HEADER_SIZE;
+    for (Placeholder &placeholder : m_placeholders) {
+        placeholder.position += m_textBegin;
+    }
+    m_textEnd = m_textBegin + text.size() - 1;
+    m_dataBegin = m_textEnd + 1;
+
+    QByteArray header = QByteArray(FcsFormat::VERSION).leftJustified(10, ' ');
+    header += headerOffset(m_textBegin) + headerOffset(m_textEnd);
+    header += headerOffset(0) + headerOffset(0) + headerOffset(0) + headerOffset(0);
+    if (m_file.write(header) != FcsFormat::HEADER_SIZE || m_file.write(text) != text.size()) {
+        m_errorString = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_buffer.reserve(BufferBytes + m_parameterNum * FcsFormat::VALUE_SIZE * 1024);
+    return true;
+}
+
+/*
+ * Converts the batch into FCS rows, the buffer is written when it reaches
+ * BufferBytes.
+ */
+bool FcsWriter::append(const EventBatch &batch)
+{
+    if (!m_file.isOpen() || batch.channelCount() != m_channels.size()) {
+        return false;
+    }
+
+    const void *columns[FixedColumnNum + EventBatch::MAX_CHANNELS * EventBatch::MEASUREMENT_NUM];
+    for (int col = 0; col < m_parameterNum; ++col) {
+        columns[col] = batchColumn(batch, col);
+    }
+    const int valueNum = m_parameterNum - FixedColumnNum;
+    const int rowBytes = m_parameterNum * FcsFormat::VALUE_SIZE;
+
+    int row = 0;
+    while (row < batch.size()) {
+        const int count = qMin(batch.size() - row, qMax(1, (BufferBytes - static_cast<int>(m_buffer.size())) / rowBytes));
+        const qsizetype offset = m_buffer.size();
+        m_buffer.resize(offset + static_cast<qsizetype>(count) * rowBytes);
+        double *out = reinterpret_cast<double *>(m_buffer.data() + offset);
+        for (int i = row; i < row + count; ++i) {
+            for (int col = 0; col < valueNum; ++col) {
+                *out++ = static_cast<const qint32 *>(columns[FixedColumnNum + col])[i];
+            }
+            *out++ = static_cast<const quint32 *>(columns[ColumnPostTime])[i];
+            *out++ = static_cast<const quint32 *>(columns[ColumnDiffTime])[i];
+            *out++ = static_cast<const quint32 *>(columns[ColumnEventId])[i];
+            *out++ = static_cast<const quint8 *>(columns[ColumnFlags])[i];
+            *out++ = static_cast<const quint8 *>(columns[ColumnChPulseValid])[i];
+        }
+        row += count;
+        m_eventCount += count;
+        if (m_buffer.size() >= BufferBytes && !writeBuffer()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FcsWriter::writeBuffer()
+{
+    if (m_buffer.isEmpty()) {
+        return true;
+    }
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        m_errorString = m_file.errorString();
+        qWarning() << "[FcsWriter] Write failed:" << m_file.fileName() << m_errorString;
+        m_buffer.clear();
+        return false;
+    }
+    m_buffer.clear();
+    return true;
+}
+
+bool FcsWriter::patch(const Placeholder &placeholder, const QByteArray &value)
+{
+    const QByteArray field = value.rightJustified(placeholder.width, '0', true);
+    return m_file.seek(placeholder.position) && m_file.write(field) == field.size();
+}
+
+bool FcsWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return true;
+    }
+    bool ok = writeBuffer();
+
+    // No events: DATA offsets stay 0 as the standard asks for an empty segment
+    const qint64 dataBytes = static_cast<qint64>(m_eventCount) * m_parameterNum * FcsFormat::VALUE_SIZE;
+    const qint64 dataBegin = dataBytes > 0 ? m_dataBegin : 0;
+    const qint64 dataEnd = dataBytes > 0 ? m_dataBegin + dataBytes - 1 : 0;
+    ok = ok && patch(m_placeholders.value("$BEGINDATA"), QByteArray::number(dataBegin));
+    ok = ok && patch(m_placeholders.value("$ENDDATA"), QByteArray::number(dataEnd));
+    ok = ok && patch(m_placeholders.value("$TOT"), QByteArray::number(m_eventCount));
+    ok = ok && patch(m_placeholders.value("$ETIM"), QTime::currentTime().toString("hh:mm:ss").toLatin1());
+    const QByteArray dataOffsets = headerOffset(dataBegin) + headerOffset(dataEnd);
+    ok = ok && m_file.seek(10 + 16) && m_file.write(dataOffsets) == dataOffsets.size();
+    if (!ok) {
+        m_errorString = m_file.errorString();
+        qWarning() << "[FcsWriter] Closing" << m_file.fileName() << "failed:" << m_errorString;
+    }
+    m_file.close();
+    qDebug() << "[FcsWriter] Wrote" << m_eventCount << "events to" << m_file.fileName();
+    return ok;
+}
+
+
+bool FcsReader::open(const QString &filePath)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < FcsFormat::HEADER_SIZE) {
+        m_errorString = "FCS file too short";
+        close();
+        return false;
+    }
+    m_map = m_file.map(0, m_size);
+    if (!m_map) {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    const QByteArray header = QByteArray::fromRawData(reinterpret_cast<const char *>(m_map), FcsFormat::HEADER_SIZE);
+    if (!header.startsWith("FCS")) {
+        m_errorString = "Not an FCS file";
+        close();
+        return false;
+    }
+    auto headerField = [&header](int index) { return header.mid(10 + index * 8, 8).trimmed().toLongLong(); };
+    if (!parseText(headerField(0), headerField(1)) || !parseParameters()) {
+        close();
+        return false;
+    }
+
+    // Offsets that do not fit the header are only in TEXT
+    qint64 dataBegin = headerField(2);
+    qint64 dataEnd = headerField(3);
+    if (dataBegin == 0 && dataEnd == 0) {
+        dataBegin = keyword("$BEGINDATA").trimmed().toLongLong();
+        dataEnd = keyword("$ENDDATA").trimmed().toLongLong();
+    }
+    const quint64 total = keyword("$TOT").trimmed().toULongLong();
+    const qint64 dataBytes = (dataEnd >= dataBegin && dataBegin > 0) ? dataEnd - dataBegin + 1 : 0;
+    if (dataBegin + dataBytes > m_size) {
+        m_errorString = "FCS DATA segment beyond the end of the file";
+        close();
+        return false;
+    }
+    m_dataBegin = dataBegin;
+    m_eventCount = m_rowBytes > 0 ? qMin<quint64>(total, dataBytes / m_rowBytes) : 0;
+    mapParameters();
+    return true;
+}
+
+void FcsReader::close()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_keywords.clear();
+    m_parameters.clear();
+    m_channels.clear();
+    m_channelNames.clear();
+    m_rowBytes = 0;
+    m_dataBegin = 0;
+    m_eventCount = 0;
+}
+
+/*
+ * Keyword/value pairs between delimiters, a doubled delimiter is a literal
+ * one. Keywords are case insensitive and stored upper case.
+ */
+bool FcsReader::parseText(qint64 begin, qint64 end)
+{
+    if (begin <= 0 || end <= begin || end >= m_size) {
+        m_errorString = "Broken FCS TEXT segment offsets";
+        return false;
+    }
+    const char *text = reinterpret_cast<const char *>(m_map);
+    const char delimiter = text[begin];
+    QByteArray token;
+    QString key;
+    bool isKey = true;
+    for (qint64 i = begin + 1; i <= end; ++i) {
+        if (text[i] != delimiter) {
+            token += text[i];
+            continue;
+        }
+        if (i + 1 <= end && text[i + 1] == delimiter) {
+            token += delimiter;
+            ++i;
+            continue;
+        }
+        if (isKey) {
+            key = QString::fromUtf8(token).trimmed().toUpper();
+        } else {
+            m_keywords.insert(key, QString::fromUtf8(token));
+        }
+        isKey = !isKey;
+        token.clear();
+    }
+    if (keyword("$MODE").trimmed().toUpper() != "L" && !keyword("$MODE").isEmpty()) {
+        m_errorString = "Only list mode FCS files are supported";
+        return false;
+    }
+    return true;
+}
+
+bool FcsReader::parseParameters()
+{
+    const QString dataType = keyword("$DATATYPE").trimmed().toUpper();
+    const QString byteOrder = keyword("$BYTEORD").trimmed();
+    m_littleEndian = byteOrder.startsWith('1');
+    const int parameterNum = keyword("$PAR").trimmed().toInt();
+    if (parameterNum <= 0) {
+        m_errorString = "FCS file without parameters";
+        return false;
+    }
+
+    m_rowBytes = 0;
+    for (int i = 1; i <= parameterNum; ++i) {
+        Parameter parameter;
+        parameter.name = keyword(QString("$P%1N").arg(i)).trimmed();
+        parameter.column = -1;
+        const int bits = keyword(QString("$P%1B").arg(i)).trimmed().toInt();
+        if (dataType == "F") {
+            parameter.type = ValueType::Float;
+            parameter.bytes = 4;
+        } else if (dataType == "D") {
+            parameter.type = ValueType::Double;
+            parameter.bytes = 8;
+        } else if (dataType == "I" && (bits == 8 || bits == 16 || bits == 32 || bits == 64)) {
+            parameter.type = bits == 8 ? ValueType::UInt8 : bits == 16 ? ValueType::UInt16
+                           : bits == 32 ? ValueType::UInt32 : ValueType::UInt64;
+            parameter.bytes = bits / 8;
+        } else {
+            m_errorString = QString("Unsupported FCS data type %1 with %2 bits").arg(dataType).arg(bits);
+            return false;
+        }
+        parameter.offset = m_rowBytes;
+        m_rowBytes += parameter.bytes;
+        m_parameters.append(parameter);
+    }
+    return true;
+}
+
+/*
+ * Our files list the detector ids in SEEK_CHANNELS, other files get
+ * detector ids 1, 2, ... in order of appearance.
+ */
+void FcsReader::mapParameters()
+{
+    QVector<int> seekChannels;
+    for (const QString &id : keyword("SEEK_CHANNELS").split(',', Qt::SkipEmptyParts)) {
+        seekChannels.append(id.trimmed().toInt());
+    }
+
+    QStringList channelBases;
+    for (Parameter &parameter : m_parameters) {
+        const QString &name = parameter.name;
+        if (name.compare("Time", Qt::CaseInsensitive) == 0) {
+            parameter.column = ColumnPostTime;
+        } else if (name == "DiffTime") {
+            parameter.column = ColumnDiffTime;
+        } else if (name == "EventID") {
+            parameter.column = ColumnEventId;
+        } else if (name == "Flags") {
+            parameter.column = ColumnFlags;
+        } else if (name == "PulseValid") {
+            parameter.column = ColumnChPulseValid;
+        } else if (name.size() > 2 && name.at(name.size() - 2) == '-') {
+            const MeasurementType type = name.endsWith("-H") ? MeasurementType::Height
+                                       : name.endsWith("-W") ? MeasurementType::Width
+                                       : name.endsWith("-A") ? MeasurementType::Area : MeasurementType::Unknown;
+            if (type == MeasurementType::Unknown) {
+                continue;
+            }
+            const QString base = name.left(name.size() - 2);
+            int index = channelBases.indexOf(base);
+            if (index < 0 && channelBases.size() < EventBatch::MAX_CHANNELS) {
+                index = channelBases.size();
+                channelBases.append(base);
+            }
+            if (index >= 0) {
+                parameter.column = valueColumn(index, EventBatch::measurementIndex(type));
+            }
+        }
+    }
+
+    for (int i = 0; i < channelBases.size(); ++i) {
+        const int channelId = (seekChannels.size() == channelBases.size()) ? seekChannels.at(i) : i + 1;
+        m_channels.append(channelId);
+        m_channelNames.insert(channelId, channelBases.at(i));
+    }
+}
+
+namespace {
+
+template <typename T>
+inline qint64 readValue(const uchar *src, bool littleEndian)
+{
+    const T value = littleEndian ? qFromLittleEndian<T>(src) : qFromBigEndian<T>(src);
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::isfinite(value) ? qRound64(qBound<T>(-9.2e18, value, 9.2e18)) : 0;
+    } else {
+        return static_cast<qint64>(value);
+    }
+}
+
+template <typename T>
+void convertColumn(const uchar *src, int rowBytes, int count, bool littleEndian, void *dst, int dstBytes)
+{
+    if (dstBytes == 1) {
+        quint8 *out = static_cast<quint8 *>(dst);
+        for (int i = 0; i < count; ++i, src += rowBytes) {
+            out[i] = static_cast<quint8>(readValue<T>(src, littleEndian));
+        }
+    } else {
+        quint32 *out = static_cast<quint32 *>(dst);
+        for (int i = 0; i < count; ++i, src += rowBytes) {
+            out[i] = static_cast<quint32>(readValue<T>(src, littleEndian));
+        }
+    }
+}
+
+} // namespace
+
+bool FcsReader::readBatch(EventBatch &batch, quint64 firstRow, int count) const
+{
+    if (!m_map || firstRow > m_eventCount) {
+        return false;
+    }
+    const quint64 available = m_eventCount - firstRow;
+    const int maxCount = static_cast<int>(qMin<quint64>(available, std::numeric_limits<int>::max()));
+    count = (count < 0 || count > maxCount) ? maxCount : count;
+    batch.reset(m_channels, count);
+    batch.resize(count);
+
+    // Columns no parameter fills, PulseValid defaults to every channel valid
+    const int columnNum = columnCount(m_channels.size());
+    QVector<bool> filled(columnNum, false);
+    for (const Parameter &parameter : m_parameters) {
+        if (parameter.column >= 0) {
+            filled[parameter.column] = true;
+        }
+    }
+    for (int col = 0; col < columnNum; ++col) {
+        if (!filled.at(col)) {
+            std::memset(batchColumn(batch, col), col == ColumnChPulseValid ? 0xFF : 0,
+                        static_cast<size_t>(count) * columnValueSize(col));
+        }
+    }
+
+    const uchar *rows = m_map + m_dataBegin + firstRow * m_rowBytes;
+    for (const Parameter &parameter : m_parameters) {
+        if (parameter.column < 0) {
+            continue;
+        }
+        const uchar *src = rows + parameter.offset;
+        void *dst = batchColumn(batch, parameter.column);
+        const int dstBytes = columnValueSize(parameter.column);
+        switch (parameter.type) {
+        case ValueType::UInt8:  convertColumn<quint8>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        case ValueType::UInt16: convertColumn<quint16>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        case ValueType::UInt32: convertColumn<quint32>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        case ValueType::UInt64: convertColumn<quint64>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        case ValueType::Float:  convertColumn<float>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        case ValueType::Double: convertColumn<double>(src, m_rowBytes, count, m_littleEndian, dst, dstBytes); break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,140 @@
+#ifndef FCSFILE_H
+#define FCSFILE_H
+
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QVector>
+#include "EventBatchPool.h"
+
+
+/*
+ * FCS 3.1 list mode files. The writer stores every column as a double
+ * ($DATATYPE D), signed measurements keep their sign for other readers and
+ * every 32 bit value, including post times and event ids, is exact; float
+ * would round them above 2^24. Besides the
+ * measurements "<parameter>-H/W/A" it stores the event header fields as
+ * Time (post time us), DiffTime, EventID, Flags and PulseValid.
+ */
+namespace FcsFormat {
+constexpr char      VERSION[] = "FCS3.1";
+constexpr int       HEADER_SIZE = 58;
+constexpr char      DELIMITER = '|';
+constexpr char      CYTOMETER[] = "SeekCytometer";
+constexpr int       OFFSET_DIGITS = 20;         ///< Width of the keywords patched on close
+constexpr int       VALUE_SIZE = 8;             ///< Bytes of one double value
+}
+
+
+/**
+ * @brief Streams event batches into an FCS 3.1 file.
+ *
+ * The TEXT segment is written on open() with fixed width placeholders for
+ * $TOT, $BEGINDATA, $ENDDATA and $ETIM, rows are appended to DATA as they
+ * come and close() back-patches the header and the placeholders. Channel
+ * names come from the "detectors" array of the acquisition metadata.
+ */
+class FcsWriter
+{
+public:
+    FcsWriter() = default;
+    ~FcsWriter();
+
+    bool    open(const QString &filePath, const QVector<int> &channels, const QJsonObject &metadata);
+    bool    append(const EventBatch &batch);
+    bool    close();
+
+    bool    isOpen() const { return m_file.isOpen(); }
+    QString filePath() const { return m_file.fileName(); }
+    QString errorString() const { return m_errorString; }
+    quint64 eventCount() const { return m_eventCount; }
+
+private:
+    struct Placeholder {
+        qint64  position;       ///< Offset of the value in the file
+        int     width;
+    };
+
+    bool    writeBuffer();
+    bool    patch(const Placeholder &placeholder, const QByteArray &value);
+
+    static constexpr int BufferBytes = 1 << 20;
+
+    QFile                       m_file;
+    QVector<int>                m_channels;
+    int                         m_parameterNum = 0;
+    QByteArray                  m_buffer;           ///< Rows in FCS layout waiting for the next write
+    qint64                      m_textBegin = 0;
+    qint64                      m_textEnd = 0;
+    qint64                      m_dataBegin = 0;
+    QHash<QString, Placeholder> m_placeholders;
+    quint64                     m_eventCount = 0;
+    QString                     m_errorString;
+};
+
+
+/**
+ * @brief Memory maps an FCS 2.0/3.0/3.1 list mode file and reads it into event batches.
+ *
+ * Parameters named "<name>-H", "<name>-W" and "<name>-A" become the height,
+ * width and area columns of one channel, in order of appearance, up to
+ * EventBatch::MAX_CHANNELS. Time, DiffTime, EventID, Flags and PulseValid
+ * fill the event header columns. Files without PulseValid mark all pulses
+ * valid. Integer (8/16/32/64 bit), float and double data of either byte
+ * order are read, values are rounded to qint32.
+ */
+class FcsReader
+{
+public:
+    FcsReader() = default;
+    ~FcsReader() { close(); }
+
+    bool    open(const QString &filePath);
+    void    close();
+
+    QString errorString() const { return m_errorString; }
+    QString keyword(const QString &name) const { return m_keywords.value(name.toUpper()); }
+    const QHash<QString, QString> &keywords() const { return m_keywords; }
+    int     parameterCount() const { return m_parameters.size(); }
+    QString parameterName(int index) const { return m_parameters.at(index).name; }
+    quint64 eventCount() const { return m_eventCount; }
+
+    const QVector<int> &channels() const { return m_channels; }
+    QString channelName(int channelId) const { return m_channelNames.value(channelId); }
+
+    /**
+     * @brief Reads rows [firstRow, firstRow + count) into a batch, count < 0 reads to the end.
+     */
+    bool    readBatch(EventBatch &batch, quint64 firstRow = 0, int count = -1) const;
+
+private:
+    enum class ValueType { UInt8, UInt16, UInt32, UInt64, Float, Double };
+
+    struct Parameter {
+        QString     name;
+        ValueType   type;
+        int         bytes;
+        int         offset;         ///< Within a row
+        int         column;         ///< AcquisitionFormat column it fills, -1 to skip
+    };
+
+    bool    parseText(qint64 begin, qint64 end);
+    bool    parseParameters();
+    void    mapParameters();
+
+    QFile                       m_file;
+    const uchar                 *m_map = nullptr;
+    qint64                      m_size = 0;
+    QHash<QString, QString>     m_keywords;
+    QVector<Parameter>          m_parameters;
+    QVector<int>                m_channels;
+    QHash<int, QString>         m_channelNames;
+    bool                        m_littleEndian = true;
+    int                         m_rowBytes = 0;
+    qint64                      m_dataBegin = 0;
+    quint64                     m_eventCount = 0;
+    QString                     m_errorString;
+};
+
+#endif // FCSFILE_H
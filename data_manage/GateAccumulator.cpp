@@ -0,0 +1,168 @@
+#include "GateAccumulator.h"
+
+
+Moments Moments::fromRange(const RangeStats &range)
+{
+    Moments moments;
+    if (range.count == 0) {
+        return moments;
+    }
+    moments.count = range.count;
+    const double n = static_cast<double>(range.count);
+    for (int dim = 0; dim < 2; ++dim) {
+        moments.mean[dim] = range.origin[dim] + range.sum[dim] / n;
+        moments.m2[dim] = qMax(0.0, range.sumSq[dim] - range.sum[dim] * range.sum[dim] / n);
+    }
+    return moments;
+}
+
+void Moments::merge(const Moments &other)
+{
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    const double n = static_cast<double>(count + other.count);
+    for (int dim = 0; dim < 2; ++dim) {
+        const double delta = other.mean[dim] - mean[dim];
+        mean[dim] += delta * other.count / n;
+        m2[dim] += other.m2[dim] + delta * delta * (static_cast<double>(count) * other.count / n);
+    }
+    count += other.count;
+}
+
+void Moments::remove(const Moments &other)
+{
+    if (other.count == 0) return;
+    if (other.count >= count) {
+        *this = Moments();
+        return;
+    }
+    const double rest = static_cast<double>(count - other.count);
+    for (int dim = 0; dim < 2; ++dim) {
+        const double restMean = mean[dim] + (mean[dim] - other.mean[dim]) * other.count / rest;
+        const double delta = other.mean[dim] - restMean;
+        m2[dim] = qMax(0.0, m2[dim] - other.m2[dim] - delta * delta * (rest * other.count / count));
+        mean[dim] = restMean;
+    }
+    count -= other.count;
+}
+
+
+PopulationSummary PopulationSummary::fromStats(const PopulationStats &stats)
+{
+    PopulationSummary summary;
+    summary.moments = Moments::fromRange(stats.stats);
+    summary.quadrants = stats.quadrants;
+    summary.parentEvents = stats.parentEvents;
+    summary.totalEvents = stats.totalEvents;
+    return summary;
+}
+
+void PopulationSummary::merge(const PopulationSummary &other)
+{
+    moments.merge(other.moments);
+    quadrants.merge(other.quadrants);
+    parentEvents += other.parentEvents;
+    totalEvents += other.totalEvents;
+}
+
+void PopulationSummary::remove(const PopulationSummary &other)
+{
+    moments.remove(other.moments);
+    for (int q = 0; q < 4; ++q) {
+        quadrants.count[q] -= qMin(quadrants.count[q], other.quadrants.count[q]);
+    }
+    parentEvents -= qMin(parentEvents, other.parentEvents);
+    totalEvents -= qMin(totalEvents, other.totalEvents);
+}
+
+
+void PopulationAccumulator::setWindows(quint64 windowEvents, qint64 windowMs)
+{
+    m_windowEvents = windowEvents;
+    m_windowMs = windowMs;
+
+    // Start over from every block still kept, a larger window fills up with new events
+    m_events.first = m_firstSeq;
+    m_seconds.first = m_firstSeq;
+    rebuild(m_events);
+    rebuild(m_seconds);
+    if (!m_blocks.isEmpty()) {
+        evict(m_blocks.last().timeMs);
+    }
+}
+
+void PopulationAccumulator::add(qint64 timeMs, const PopulationStats &block)
+{
+    const PopulationSummary summary = PopulationSummary::fromStats(block);
+    m_acquisition.merge(summary);
+    m_events.summary.merge(summary);
+    m_seconds.summary.merge(summary);
+
+    const qint64 lastSeq = endSeq() - 1;
+    if (!m_blocks.isEmpty() && m_blocks.last().timeMs == timeMs && m_blocks.last().summary.totalEvents < MinBlockEvents
+        && lastSeq >= m_events.first && lastSeq >= m_seconds.first) {
+        m_blocks.last().summary.merge(summary);
+    } else {
+        m_blocks.append(Block{timeMs, summary});
+    }
+    evict(timeMs);
+}
+
+bool PopulationAccumulator::expire(qint64 timeMs)
+{
+    const qint64 first = m_seconds.first;
+    evict(timeMs);
+    return m_seconds.first != first;
+}
+
+const PopulationSummary &PopulationAccumulator::summary(StatisticsScope scope) const
+{
+    switch (scope) {
+    case StatisticsScope::LastEvents:
+        return m_events.summary;
+    case StatisticsScope::LastSeconds:
+        return m_seconds.summary;
+    case StatisticsScope::Acquisition:
+    default:
+        return m_acquisition;
+    }
+}
+
+void PopulationAccumulator::evict(qint64 timeMs)
+{
+    // The event window keeps at least windowEvents events, up to one block more
+    while (m_events.first < endSeq()
+           && m_events.summary.totalEvents - block(m_events.first).summary.totalEvents >= m_windowEvents) {
+        remove(m_events);
+    }
+    while (m_seconds.first < endSeq() && block(m_seconds.first).timeMs <= timeMs - m_windowMs) {
+        remove(m_seconds);
+    }
+
+    const qint64 keep = qMin(m_events.first, m_seconds.first);
+    while (m_firstSeq < keep) {
+        m_blocks.removeFirst();
+        ++m_firstSeq;
+    }
+}
+
+void PopulationAccumulator::remove(Window &window)
+{
+    window.summary.remove(block(window.first).summary);
+    ++window.first;
+    if (++window.removed >= endSeq() - window.first) {
+        rebuild(window);
+    }
+}
+
+void PopulationAccumulator::rebuild(Window &window)
+{
+    window.summary = PopulationSummary();
+    for (qint64 seq = window.first; seq < endSeq(); ++seq) {
+        window.summary.merge(block(seq).summary);
+    }
+    window.removed = 0;
+}
@@ -0,0 +1,110 @@
+#ifndef GATEACCUMULATOR_H
+#define GATEACCUMULATOR_H
+
+#include <QList>
+#include <QMetaType>
+#include "PopulationTree.h"
+
+
+/**
+ * @brief Mean and variance of a population on both gate axes.
+ *
+ * Blocks of events are combined with the pairwise (Chan et al.) form of
+ * Welford's update, which stays accurate over any number of events, and
+ * can be taken out again the same way, which is what the sliding windows
+ * of PopulationAccumulator need.
+ */
+struct Moments
+{
+    quint64 count = 0;
+    double  mean[2] = {0, 0};
+    double  m2[2] = {0, 0};     ///< Sum of squared deviations from the mean
+
+    static Moments fromRange(const RangeStats &range);
+
+    double variance(int dim) const { return count ? m2[dim] / count : 0.0; }
+    void merge(const Moments &other);
+    void remove(const Moments &other);
+};
+
+
+/**
+ * @brief Statistics of a population over some events, what the gate table shows.
+ */
+struct PopulationSummary
+{
+    Moments         moments;
+    QuadrantCounts  quadrants;
+    quint64         parentEvents = 0;
+    quint64         totalEvents = 0;
+
+    static PopulationSummary fromStats(const PopulationStats &stats);
+
+    double percentParent() const { return parentEvents ? 100.0 * moments.count / parentEvents : 0.0; }
+    double percentTotal() const { return totalEvents ? 100.0 * moments.count / totalEvents : 0.0; }
+    void merge(const PopulationSummary &other);
+    void remove(const PopulationSummary &other);
+};
+
+
+enum class StatisticsScope {
+    Acquisition,    ///< Every event since the gate was installed or the statistics cleared
+    LastEvents,     ///< The last events of the acquisition
+    LastSeconds,    ///< The events of the last seconds
+};
+
+Q_DECLARE_METATYPE(StatisticsScope)
+
+
+/**
+ * @brief Streaming statistics of one population in every StatisticsScope.
+ *
+ * add() takes the statistics of a block of events (one batch) and merges
+ * them into the whole acquisition summary and both sliding windows. The
+ * block summaries are kept while a window covers them, a window moves on
+ * by removing its oldest blocks from its summary, so neither adding nor
+ * evicting depends on how many events a window spans. Removal can drift
+ * in the last bits, a window that removed as many blocks as it holds is
+ * summed again from its blocks, which keeps eviction O(1) amortized.
+ */
+class PopulationAccumulator
+{
+public:
+    void    setWindows(quint64 windowEvents, qint64 windowMs);
+    void    add(qint64 timeMs, const PopulationStats &block);
+    bool    expire(qint64 timeMs);      ///< True if the seconds window moved on
+
+    const PopulationSummary &summary(StatisticsScope scope) const;
+
+private:
+    struct Block
+    {
+        qint64              timeMs;
+        PopulationSummary   summary;
+    };
+
+    struct Window
+    {
+        PopulationSummary   summary;
+        qint64              first = 0;      ///< Sequence number of the oldest block in the window
+        qint64              removed = 0;    ///< Blocks removed since the summary was last rebuilt
+    };
+
+    const Block &block(qint64 seq) const { return m_blocks.at(static_cast<int>(seq - m_firstSeq)); }
+    qint64  endSeq() const { return m_firstSeq + m_blocks.size(); }
+    void    evict(qint64 timeMs);
+    void    remove(Window &window);
+    void    rebuild(Window &window);
+
+    static constexpr quint64 MinBlockEvents = 4096;    ///< Smaller blocks of one update are joined
+
+    PopulationSummary   m_acquisition;
+    QList<Block>        m_blocks;
+    qint64              m_firstSeq = 0;
+    Window              m_events;
+    Window              m_seconds;
+    quint64             m_windowEvents = 100000;
+    qint64              m_windowMs = 10000;
+};
+
+#endif // GATEACCUMULATOR_H
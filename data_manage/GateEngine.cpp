@@ -0,0 +1,83 @@
+#include "GateEngine.h"
+
+
+GateEngine::GateEngine()
+    : m_windowEvents(100000),
+    m_windowSeconds(10)
+{
+    m_clock.start();
+}
+
+void GateEngine::setGates(const QVector<CompiledGate> &gates)
+{
+    PopulationTree tree;
+    tree.setGates(gates);
+
+    // A node keeps its statistics if its gate and every gate above it are unchanged
+    QVector<bool> kept(tree.size(), false);
+    QVector<PopulationAccumulator> accumulators(tree.size());
+    for (int node = 0; node < tree.size(); ++node) {
+        const int oldNode = m_tree.indexOf(tree.gate(node).gateId());
+        const int parentNode = tree.parent(node);
+        if (oldNode >= 0 && m_tree.gate(oldNode) == tree.gate(node) && (parentNode < 0 || kept.at(parentNode))) {
+            accumulators[node] = m_accumulators.at(oldNode);
+            kept[node] = true;
+        } else {
+            accumulators[node].setWindows(m_windowEvents, m_windowSeconds * 1000LL);
+        }
+    }
+    m_tree = tree;
+    m_accumulators = accumulators;
+}
+
+void GateEngine::setStatisticsWindows(quint64 windowEvents, int windowSeconds)
+{
+    m_windowEvents = windowEvents;
+    m_windowSeconds = windowSeconds;
+    for (PopulationAccumulator &accumulator : m_accumulators) {
+        accumulator.setWindows(m_windowEvents, m_windowSeconds * 1000LL);
+    }
+}
+
+void GateEngine::clearStatistics()
+{
+    m_accumulators.fill(PopulationAccumulator(), m_tree.size());
+    for (PopulationAccumulator &accumulator : m_accumulators) {
+        accumulator.setWindows(m_windowEvents, m_windowSeconds * 1000LL);
+    }
+}
+
+void GateEngine::process(const QVector<EventBatchPtr> &data)
+{
+    if (m_tree.isEmpty()) return;
+    const qint64 now = m_clock.elapsed();
+    for (const EventBatchPtr &batch : data) {
+        if (!batch || batch->isEmpty()) continue;
+        m_tree.evaluate(*batch);
+        m_batchStats.fill(PopulationStats(), m_tree.size());
+        m_tree.accumulate([&batch](int channelId, MeasurementType type) {
+            return batch->column(channelId, type);
+        }, m_batchStats);
+        for (int node = 0; node < m_tree.size(); ++node) {
+            m_accumulators[node].add(now, m_batchStats.at(node));
+        }
+    }
+}
+
+bool GateEngine::expire()
+{
+    const qint64 now = m_clock.elapsed();
+    bool changed = false;
+    for (PopulationAccumulator &accumulator : m_accumulators) {
+        changed |= accumulator.expire(now);
+    }
+    return changed;
+}
+
+bool GateEngine::statistics(int gateId, StatisticsScope scope, PopulationSummary &summary) const
+{
+    const int node = m_tree.indexOf(gateId);
+    if (node < 0) return false;
+    summary = m_accumulators.at(node).summary(scope);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef GATEENGINE_H
+#define GATEENGINE_H
+
+#include <QVector>
+#include <QElapsedTimer>
+#include "PopulationTree.h"
+#include "GateAccumulator.h"
+#include "EventBatchPool.h"
+
+
+/**
+ * @brief Live statistics of the worksheet populations over the acquired events.
+ *
+ * setGates() installs the compiled gates of the shown worksheet as a
+ * PopulationTree, a gate keeps what it has gathered as long as neither it
+ * nor any gate above it changed. process() evaluates the tree over the
+ * batches of a plot update, straight from the batch columns into the
+ * membership bitmaps, and adds the members of every batch to the streaming
+ * accumulator of each population. Each event is gated once, when it
+ * arrives, and the statistics cover every event in their scope, not only
+ * those the plots still show. expire() moves the time windows on and is
+ * called every frame, also when no batch arrived.
+ *
+ * Used on the GUI thread only, together with EventDataManager::processData().
+ */
+class GateEngine
+{
+public:
+    GateEngine();
+
+    void    setGates(const QVector<CompiledGate> &gates);
+    void    setStatisticsWindows(quint64 windowEvents, int windowSeconds);
+    void    clearStatistics();
+    void    process(const QVector<EventBatchPtr> &data);
+    /*
+     * Drops the blocks older than the seconds window, true if a window
+     * summary changed.
+     */
+    bool    expire();
+
+    const PopulationTree &tree() const { return m_tree; }
+    quint64 windowEvents() const { return m_windowEvents; }
+    int     windowSeconds() const { return m_windowSeconds; }
+
+    /*
+     * Statistics of the population over the scope, false if the gate is
+     * not installed.
+     */
+    bool    statistics(int gateId, StatisticsScope scope, PopulationSummary &summary) const;
+
+private:
+    PopulationTree                  m_tree;
+    QVector<PopulationAccumulator>  m_accumulators;     ///< One per tree node
+    QVector<PopulationStats>        m_batchStats;       ///< One per tree node, of the batch being added
+    quint64                         m_windowEvents;
+    int                             m_windowSeconds;
+    QElapsedTimer                   m_clock;            ///< Arrival time of the batches
+};
+
+#endif // GATEENGINE_H
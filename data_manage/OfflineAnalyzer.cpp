@@ -0,0 +1,672 @@
+#include "OfflineAnalyzer.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <limits>
+#include <numeric>
+
+
+/*
+ * A worker's view of the chunk it is on. Acquisition columns are fetched
+ * when first asked for, so a pass reads only the columns it projects.
+ */
+class OfflineAnalyzer::ChunkCursor
+{
+public:
+    explicit ChunkCursor(const OfflineAnalyzer &analyzer) : m_analyzer(analyzer) {}
+
+    bool load(int chunkIndex);
+    int  rows() const { return m_rows; }
+
+    /*
+     * Values (points) with valid pulses on the channels, in a buffer of the
+     * cursor that the next call overwrites. nullptr and count 0 if the file
+     * does not have the column.
+     */
+    const qint32 *project1D(int channel, MeasurementType type, int &count);
+    const QPoint *project2D(int channelX, MeasurementType typeX, int channelY, MeasurementType typeY, int &count);
+
+    /*
+     * Evaluates the gate over the rows of the chunk and adds its members.
+     */
+    void gate(const CompiledGate &gate, PopulationStats &stats);
+
+    /*
+     * Evaluates the population tree over the rows of the chunk and adds
+     * the members of every node to stats.
+     */
+    void populations(PopulationTree &tree, QVector<PopulationStats> &stats);
+
+private:
+    const void   *fileColumn(int column);
+    const qint32 *column(int channelId, MeasurementType type);
+    const quint8 *chPulseValid();
+
+    const OfflineAnalyzer       &m_analyzer;
+    int                         m_chunk = -1;
+    int                         m_rows = 0;
+    EventBatch                  m_batch;        ///< Rows of an FCS chunk
+    QHash<int, QByteArray>      m_buffers;      ///< Decoded acquisition columns
+    QHash<int, const void *>    m_columns;      ///< Acquisition columns of the current chunk
+    QVector<qint32>             m_values;
+    QVector<QPoint>             m_points;
+    GateBitmap                  m_bits;
+};
+
+bool OfflineAnalyzer::ChunkCursor::load(int chunkIndex)
+{
+    m_chunk = chunkIndex;
+    m_columns.clear();
+    if (m_analyzer.m_isFcs) {
+        const quint64 firstRow = static_cast<quint64>(chunkIndex) * FcsChunkRows;
+        if (!m_analyzer.m_fcsReader.readBatch(m_batch, firstRow, FcsChunkRows)) {
+            return false;
+        }
+        m_rows = m_batch.size();
+    } else {
+        m_rows = m_analyzer.m_acqReader.chunk(chunkIndex).rows;
+    }
+    return m_rows > 0;
+}
+
+const void *OfflineAnalyzer::ChunkCursor::fileColumn(int column)
+{
+    auto it = m_columns.constFind(column);
+    if (it != m_columns.cend()) {
+        return it.value();
+    }
+    const void *data = m_analyzer.m_acqReader.chunkColumn(m_chunk, column, m_buffers[column]);
+    m_columns.insert(column, data);
+    return data;
+}
+
+const qint32 *OfflineAnalyzer::ChunkCursor::column(int channelId, MeasurementType type)
+{
+    if (m_analyzer.m_isFcs) {
+        return m_batch.column(channelId, type);
+    }
+    const int col = m_analyzer.m_acqReader.valueColumn(channelId, type);
+    return col < 0 ? nullptr : static_cast<const qint32 *>(fileColumn(col));
+}
+
+const quint8 *OfflineAnalyzer::ChunkCursor::chPulseValid()
+{
+    if (m_analyzer.m_isFcs) {
+        return m_batch.chPulseValid();
+    }
+    return static_cast<const quint8 *>(fileColumn(AcquisitionFormat::ColumnChPulseValid));
+}
+
+const qint32 *OfflineAnalyzer::ChunkCursor::project1D(int channel, MeasurementType type, int &count)
+{
+    count = 0;
+    const qint32 *x = column(channel, type);
+    const quint8 *valid = chPulseValid();
+    if (!x || !valid) {
+        return nullptr;
+    }
+    m_values.resize(m_rows);
+    count = EventKernels::project1D(x, valid, EventBatch::channelBit(channel), m_rows, m_values.data());
+    return m_values.constData();
+}
+
+const QPoint *OfflineAnalyzer::ChunkCursor::project2D(int channelX, MeasurementType typeX, int channelY, MeasurementType typeY,
+                                                      int &count)
+{
+    count = 0;
+    const qint32 *x = column(channelX, typeX);
+    const qint32 *y = column(channelY, typeY);
+    const quint8 *valid = chPulseValid();
+    if (!x || !y || !valid) {
+        return nullptr;
+    }
+    m_points.resize(m_rows);
+    const quint8 mask = EventBatch::channelBit(channelX) | EventBatch::channelBit(channelY);
+    count = EventKernels::project2D(x, y, valid, mask, m_rows, m_points.data());
+    return m_points.constData();
+}
+
+void OfflineAnalyzer::ChunkCursor::gate(const CompiledGate &gate, PopulationStats &stats)
+{
+    stats.stats.origin[0] = gate.origin(0);
+    stats.stats.origin[1] = gate.origin(1);
+    const qint32 *x = column(gate.channelX(), gate.typeX());
+    const qint32 *y = gate.is1D() ? nullptr : column(gate.channelY(), gate.typeY());
+    const quint8 *valid = chPulseValid();
+    m_bits.resize(m_rows);
+    if (gate.evaluate(x, y, valid, m_rows, m_bits.words()) == 0) {
+        return;
+    }
+    gate.accumulate(x, y, m_bits.words(), m_rows, stats.stats);
+    if (gate.isQuadrant()) {
+        gate.countQuadrants(x, y, m_bits.words(), m_rows, stats.quadrants);
+    }
+}
+
+void OfflineAnalyzer::ChunkCursor::populations(PopulationTree &tree, QVector<PopulationStats> &stats)
+{
+    auto columnFn = [this](int channelId, MeasurementType type) { return column(channelId, type); };
+    tree.evaluate(m_rows, chPulseValid(), columnFn);
+    tree.accumulate(columnFn, stats);
+}
+
+
+namespace {
+
+struct PlotRange
+{
+    quint64 count = 0;
+    qint32  minX = std::numeric_limits<qint32>::max();
+    qint32  maxX = std::numeric_limits<qint32>::min();
+    qint32  minY = std::numeric_limits<qint32>::max();
+    qint32  maxY = std::numeric_limits<qint32>::min();
+
+    void add(const qint32 *values, int n) {
+        for (int i = 0; i < n; ++i) {
+            minX = qMin(minX, values[i]);
+            maxX = qMax(maxX, values[i]);
+        }
+        count += n;
+    }
+    void add(const QPoint *points, int n) {
+        for (int i = 0; i < n; ++i) {
+            minX = qMin(minX, points[i].x());
+            maxX = qMax(maxX, points[i].x());
+            minY = qMin(minY, points[i].y());
+            maxY = qMax(maxY, points[i].y());
+        }
+        count += n;
+    }
+    void merge(const PlotRange &other) {
+        count += other.count;
+        minX = qMin(minX, other.minX);
+        maxX = qMax(maxX, other.maxX);
+        minY = qMin(minY, other.minY);
+        maxY = qMax(maxY, other.maxY);
+    }
+};
+
+struct ScanPartial
+{
+    QVector<PlotRange>  ranges;     ///< Per pending plot
+    PopulationTree      tree;       ///< Worker copy, holds the bitmaps of its chunk
+    QVector<PopulationStats> populations;  ///< Per tree node
+};
+
+} // namespace
+
+
+OfflineAnalyzer::OfflineAnalyzer(QObject *parent)
+    : QThread{parent}, m_isFcs(false), m_open(false), m_cancelRequested(false)
+{
+    qRegisterMetaType<OfflineAnalysisResult>("OfflineAnalysisResult");
+    setObjectName("OfflineAnalyzer");
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+OfflineAnalyzer::~OfflineAnalyzer()
+{
+    cancel();
+}
+
+bool OfflineAnalyzer::openFile(const QString &filePath)
+{
+    closeFile();
+    m_isFcs = filePath.endsWith(".fcs", Qt::CaseInsensitive);
+    const bool ok = m_isFcs ? m_fcsReader.open(filePath) : m_acqReader.open(filePath);
+    if (!ok) {
+        m_errorString = m_isFcs ? m_fcsReader.errorString() : m_acqReader.errorString();
+        qWarning() << "[OfflineAnalyzer] Opening" << filePath << "failed:" << m_errorString;
+        return false;
+    }
+    if (!m_isFcs && m_acqReader.isRecovered()) {
+        qWarning() << "[OfflineAnalyzer]" << filePath << "was not closed, index rebuilt from the chunks";
+    }
+    m_filePath = filePath;
+    m_errorString.clear();
+    m_open = true;
+    qDebug() << "[OfflineAnalyzer] Opened" << filePath << "with" << eventCount() << "events in" << chunkCount() << "chunks";
+    return true;
+}
+
+void OfflineAnalyzer::closeFile()
+{
+    cancel();
+    m_acqReader.close();
+    m_fcsReader.close();
+    m_plotCache.clear();
+    m_filePath.clear();
+    m_open = false;
+}
+
+quint64 OfflineAnalyzer::eventCount() const
+{
+    return m_isFcs ? m_fcsReader.eventCount() : m_acqReader.eventCount();
+}
+
+const QVector<int> &OfflineAnalyzer::channels() const
+{
+    return m_isFcs ? m_fcsReader.channels() : m_acqReader.channels();
+}
+
+QVector<int> OfflineAnalyzer::allChunks() const
+{
+    QVector<int> chunks(chunkCount());
+    std::iota(chunks.begin(), chunks.end(), 0);
+    return chunks;
+}
+
+int OfflineAnalyzer::chunkCount() const
+{
+    if (!m_open) {
+        return 0;
+    }
+    if (m_isFcs) {
+        return static_cast<int>((m_fcsReader.eventCount() + FcsChunkRows - 1) / FcsChunkRows);
+    }
+    return m_acqReader.chunkCount();
+}
+
+void OfflineAnalyzer::analyze(const OfflineAnalysisRequest &request)
+{
+    if (!m_open) {
+        return;
+    }
+    cancel();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_request = request;
+    }
+    start();
+}
+
+void OfflineAnalyzer::cancel()
+{
+    m_cancelRequested.store(true, std::memory_order_relaxed);
+    wait();
+    m_cancelRequested.store(false, std::memory_order_relaxed);
+}
+
+/*
+ * Runs fn(worker, chunk, cursor) for the chunks on the pool, a worker
+ * takes the next chunk when it is done with one. progress() is called on
+ * this thread every ProgressIntervalMs meanwhile. Returns false if cancelled.
+ */
+template <typename Fn>
+bool OfflineAnalyzer::forEachChunk(const QVector<int> &chunkList, Fn &&fn, const std::function<void()> &progress)
+{
+    const int chunks = chunkList.size();
+    const int workers = qMin(m_pool.maxThreadCount(), chunks);
+    std::atomic<int> next{0};
+    std::atomic<int> failed{0};
+
+    for (int worker = 0; worker < workers; ++worker) {
+        m_pool.start([this, worker, chunks, &chunkList, &next, &failed, &fn]() {
+            ChunkCursor cursor(*this);
+            int index;
+            while (!m_cancelRequested.load(std::memory_order_relaxed)
+                   && (index = next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+                const int chunk = chunkList.at(index);
+                if (!cursor.load(chunk)) {
+                    failed.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                fn(worker, chunk, cursor);
+            }
+        });
+    }
+    while (!m_pool.waitForDone(ProgressIntervalMs)) {
+        if (progress) {
+            progress();
+        }
+    }
+
+    if (failed.load() > 0) {
+        qWarning() << "[OfflineAnalyzer] Skipped" << failed.load() << "unreadable chunks of" << m_filePath;
+    }
+    return !m_cancelRequested.load(std::memory_order_relaxed);
+}
+
+void OfflineAnalyzer::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    OfflineAnalysisRequest request;
+    {
+        QMutexLocker locker(&m_mutex);
+        request = m_request;
+    }
+
+    OfflineAnalysisResult result;
+    result.filePath = m_filePath;
+    result.eventCount = eventCount();
+
+    // Plots whose spec did not change keep their result
+    QVector<OfflinePlotSpec> pending;
+    for (const OfflinePlotSpec &spec : request.plots) {
+        auto it = m_plotCache.constFind(spec.plotId);
+        if (it != m_plotCache.cend() && it->spec == spec) {
+            result.plots.append(it.value());
+        } else if (spec.type == PlotType::HISTOGRAM_PLOT || spec.type == PlotType::SCATTER_PLOT
+                   || spec.type == PlotType::CONTOUR_PLOT) {
+            pending.append(spec);
+        }
+    }
+
+    const int workers = m_pool.maxThreadCount();
+    const int chunks = chunkCount();
+    const int plotNum = pending.size();
+    const int gateNum = request.gates.size();
+    PopulationTree tree;
+    tree.setGates(request.gates);
+
+    if (plotNum == 0 && gateNum > 0 && !tree.hasChildGates() && !m_isFcs && m_acqReader.hasSketches()) {
+        if (!analyzeGatesBySketch(request.gates, result)) {
+            return;
+        }
+        result.elapsedMs = timer.elapsed();
+        qDebug() << "[OfflineAnalyzer] Gated" << result.eventCount << "events," << gateNum << "gates in"
+                 << result.elapsedMs << "ms from chunk sketches";
+        emit analysisFinished(result);
+        return;
+    }
+
+    // Pass 1: plot ranges, scatter samples and population stats
+    QVector<int> sampleStride(plotNum, 1);
+    for (int i = 0; i < plotNum; ++i) {
+        sampleStride[i] = static_cast<int>(qMax<quint64>(1, result.eventCount / qMax(1, pending.at(i).sampleSize)));
+    }
+    QVector<ScanPartial> scan(workers, ScanPartial{QVector<PlotRange>(plotNum), tree,
+                                                   QVector<PopulationStats>(tree.size())});
+    QVector<QVector<QVector<QPoint>>> samples(plotNum);
+    for (int i = 0; i < plotNum; ++i) {
+        if (pending.at(i).type != PlotType::HISTOGRAM_PLOT) {
+            samples[i].resize(chunks);
+        }
+    }
+
+    if (plotNum + gateNum > 0) {
+        const bool done = forEachChunk(allChunks(), [&](int worker, int chunk, ChunkCursor &cursor) {
+            ScanPartial &partial = scan[worker];
+            for (int i = 0; i < plotNum; ++i) {
+                const OfflinePlotSpec &spec = pending.at(i);
+                int n;
+                if (spec.type == PlotType::HISTOGRAM_PLOT) {
+                    const qint32 *values = cursor.project1D(spec.channelX, spec.typeX, n);
+                    partial.ranges[i].add(values, n);
+                } else {
+                    const QPoint *points = cursor.project2D(spec.channelX, spec.typeX, spec.channelY, spec.typeY, n);
+                    partial.ranges[i].add(points, n);
+                    QVector<QPoint> &sample = samples[i][chunk];
+                    for (int k = 0; k < n; k += sampleStride.at(i)) {
+                        sample.append(points[k]);
+                    }
+                }
+            }
+            if (gateNum > 0) {
+                cursor.populations(partial.tree, partial.populations);
+            }
+        });
+        if (!done) {
+            return;
+        }
+    }
+
+    QVector<PlotRange> ranges(plotNum);
+    for (const ScanPartial &partial : scan) {
+        for (int i = 0; i < plotNum; ++i) {
+            ranges[i].merge(partial.ranges.at(i));
+        }
+        for (int node = 0; node < tree.size(); ++node) {
+            const PopulationStats &population = partial.populations.at(node);
+            PopulationStats &total = result.gates[tree.gate(node).gateId()];
+            total.stats.merge(population.stats);
+            total.quadrants.merge(population.quadrants);
+            total.parentEvents += population.parentEvents;
+            total.totalEvents += population.totalEvents;
+        }
+    }
+
+    // Pass 2: histogram bins over the ranges of pass 1
+    QVector<int> histograms;
+    QVector<HistoBins> bins;
+    for (int i = 0; i < plotNum; ++i) {
+        const OfflinePlotSpec &spec = pending.at(i);
+        if (spec.type != PlotType::HISTOGRAM_PLOT) {
+            continue;
+        }
+        HistoBins layout(spec.binNum);
+        if (ranges.at(i).count > 0) {
+            layout.setRange(ranges.at(i).minX, ranges.at(i).maxX, spec.isLog);
+        } else {
+            layout.setRange(0, 0, spec.isLog);
+        }
+        histograms.append(i);
+        bins.append(layout);
+    }
+    bool binsNeeded = false;
+    for (int h = 0; h < histograms.size(); ++h) {
+        binsNeeded |= ranges.at(histograms.at(h)).count > 0;
+    }
+
+    if (binsNeeded) {
+        QVector<QVector<HistoBins>> partialBins(workers, bins);
+        const bool done = forEachChunk(allChunks(), [&](int worker, int, ChunkCursor &cursor) {
+            for (int h = 0; h < histograms.size(); ++h) {
+                const OfflinePlotSpec &spec = pending.at(histograms.at(h));
+                HistoBins &histogram = partialBins[worker][h];
+                int n;
+                const qint32 *values = cursor.project1D(spec.channelX, spec.typeX, n);
+                for (int k = 0; k < n; ++k) {
+                    const int index = histogram.binIndex(values[k]);
+                    if (index >= 0) {
+                        histogram.addCount(index);
+                    }
+                }
+            }
+        });
+        if (!done) {
+            return;
+        }
+        for (const QVector<HistoBins> &partial : partialBins) {
+            for (int h = 0; h < histograms.size(); ++h) {
+                bins[h].merge(partial.at(h));
+            }
+        }
+    }
+
+    for (int i = 0; i < plotNum; ++i) {
+        OfflinePlotResult plot;
+        plot.spec = pending.at(i);
+        plot.events = ranges.at(i).count;
+        if (plot.spec.type == PlotType::HISTOGRAM_PLOT) {
+            plot.bins = bins.at(histograms.indexOf(i));
+        } else {
+            for (const QVector<QPoint> &sample : samples.at(i)) {
+                plot.sample += sample;
+            }
+            // Chunks start their stride afresh, thin the rest out evenly
+            const int sampleSize = qMax(1, plot.spec.sampleSize);
+            if (plot.sample.size() > sampleSize) {
+                QVector<QPoint> thinned(sampleSize);
+                const double step = static_cast<double>(plot.sample.size()) / sampleSize;
+                for (int k = 0; k < sampleSize; ++k) {
+                    thinned[k] = plot.sample.at(static_cast<int>(k * step));
+                }
+                plot.sample = thinned;
+            }
+        }
+        m_plotCache.insert(plot.spec.plotId, plot);
+        result.plots.append(plot);
+    }
+
+    result.elapsedMs = timer.elapsed();
+    qDebug() << "[OfflineAnalyzer] Analyzed" << result.eventCount << "events," << plotNum << "plots and" << gateNum
+             << "gates in" << result.elapsedMs << "ms on" << workers << "workers";
+    emit analysisFinished(result);
+}
+
+namespace {
+
+RangeStats gateOrigin(const CompiledGate &gate)
+{
+    RangeStats stats;
+    stats.origin[0] = gate.origin(0);
+    stats.origin[1] = gate.origin(1);
+    return stats;
+}
+
+} // namespace
+
+/*
+ * Sorts every chunk per gate into inside, outside or boundary by its
+ * sketch, chunks without sketch are boundary. Inside chunks are added
+ * exactly, boundary chunks are estimated and then scanned, the scanned
+ * ones replace their estimates. A quadrant gate holds all events, its
+ * chunks are boundary when they span the quadrant origin.
+ */
+bool OfflineAnalyzer::analyzeGatesBySketch(const QVector<CompiledGate> &gates, OfflineAnalysisResult &result)
+{
+    const int chunks = chunkCount();
+    const int gateNum = gates.size();
+
+    struct GateColumns {
+        int     columnX = -1;
+        int     columnY = -1;
+        int     pair = -1;
+        bool    transposed = false;     ///< The file keeps the pair as (y, x)
+    };
+    QVector<GateColumns> columns(gateNum);
+    for (int g = 0; g < gateNum; ++g) {
+        const CompiledGate &gate = gates.at(g);
+        GateColumns &c = columns[g];
+        c.columnX = m_acqReader.valueColumn(gate.channelX(), gate.typeX());
+        if (!gate.is1D()) {
+            c.columnY = m_acqReader.valueColumn(gate.channelY(), gate.typeY());
+            c.pair = m_acqReader.sketchPair(c.columnX, c.columnY);
+            if (c.pair < 0) {
+                c.pair = m_acqReader.sketchPair(c.columnY, c.columnX);
+                c.transposed = c.pair >= 0;
+            }
+        }
+    }
+
+    QVector<PopulationStats> inside(gateNum);
+    QVector<PopulationStats> scanned(gateNum);
+    for (int g = 0; g < gateNum; ++g) {
+        inside[g].stats = gateOrigin(gates.at(g));
+        scanned[g] = inside.at(g);
+    }
+    QVector<QVector<int>> boundary(chunks);                 ///< Gates to scan, per chunk
+    QVector<QVector<PopulationStats>> estimates(chunks);    ///< Parallel to boundary
+    QVector<int> scanList;
+
+    ColumnSketch sketchX, sketchY;
+    PairSketch pairSketch;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+        for (int g = 0; g < gateNum; ++g) {
+            const CompiledGate &gate = gates.at(g);
+            const GateColumns &c = columns.at(g);
+            PopulationStats estimate;
+            estimate.stats = gateOrigin(gate);
+            ChunkSketch::Coverage coverage = ChunkSketch::Coverage::Partial;
+            if (gate.is1D()) {
+                if (m_acqReader.columnSketch(chunk, c.columnX, sketchX)) {
+                    coverage = ChunkSketch::coverage(sketchX, gate.low().x(), gate.high().x());
+                    if (coverage == ChunkSketch::Coverage::Inside) {
+                        ChunkSketch::addInside(sketchX, inside[g].stats);
+                    } else if (coverage == ChunkSketch::Coverage::Partial) {
+                        ChunkSketch::addEstimate(sketchX, gate.low().x(), gate.high().x(), estimate.stats);
+                    }
+                }
+            } else if (c.pair >= 0) {
+                if (m_acqReader.pairSketch(chunk, c.pair, pairSketch)) {
+                    if (c.transposed) {
+                        pairSketch = pairSketch.transposed();
+                    }
+                    coverage = ChunkSketch::coverage(pairSketch, gate);
+                    PopulationStats &target = (coverage == ChunkSketch::Coverage::Inside) ? inside[g] : estimate;
+                    if (gate.isQuadrant()) {
+                        // Every event is in the gate, only the quadrant split needs the events
+                        ChunkSketch::addInside(pairSketch, target.stats);
+                        ChunkSketch::addQuadrants(pairSketch, gate, target.quadrants);
+                    } else if (coverage == ChunkSketch::Coverage::Inside) {
+                        ChunkSketch::addInside(pairSketch, target.stats);
+                    } else if (coverage == ChunkSketch::Coverage::Partial) {
+                        ChunkSketch::addEstimate(pairSketch, gate, target.stats);
+                    }
+                }
+            } else if (m_acqReader.columnSketch(chunk, c.columnX, sketchX) && m_acqReader.columnSketch(chunk, c.columnY, sketchY)) {
+                // Without pair sketch a chunk can only be ruled out
+                if (ChunkSketch::coverage(sketchX, gate.low().x(), gate.high().x()) == ChunkSketch::Coverage::Outside
+                    || ChunkSketch::coverage(sketchY, gate.low().y(), gate.high().y()) == ChunkSketch::Coverage::Outside) {
+                    coverage = ChunkSketch::Coverage::Outside;
+                } else {
+                    ChunkSketch::addEstimate(sketchX, sketchY, gate, estimate.stats);
+                }
+            }
+            if (coverage == ChunkSketch::Coverage::Partial) {
+                boundary[chunk].append(g);
+                estimates[chunk].append(estimate);
+            }
+        }
+        if (!boundary.at(chunk).isEmpty()) {
+            scanList.append(chunk);
+        }
+    }
+
+    QMutex mutex;
+    QVector<bool> chunkScanned(chunks, false);
+    int scannedNum = 0;
+    auto report = [&]() {
+        QMutexLocker locker(&mutex);
+        QVector<PopulationStats> totals(gateNum);
+        for (int g = 0; g < gateNum; ++g) {
+            totals[g] = inside.at(g);
+            totals[g].stats.merge(scanned.at(g).stats);
+            totals[g].quadrants.merge(scanned.at(g).quadrants);
+        }
+        for (int chunk : scanList) {
+            if (chunkScanned.at(chunk)) continue;
+            for (int i = 0; i < boundary.at(chunk).size(); ++i) {
+                PopulationStats &total = totals[boundary.at(chunk).at(i)];
+                total.stats.merge(estimates.at(chunk).at(i).stats);
+                total.quadrants.merge(estimates.at(chunk).at(i).quadrants);
+            }
+        }
+        for (int g = 0; g < gateNum; ++g) {
+            // Top level gates only, their parent is all events
+            totals[g].parentEvents = result.eventCount;
+            totals[g].totalEvents = result.eventCount;
+            result.gates[gates.at(g).gateId()] = totals.at(g);
+        }
+        result.progress = scanList.isEmpty() ? 1.0 : static_cast<double>(scannedNum) / scanList.size();
+    };
+    report();
+    if (!scanList.isEmpty()) {
+        emit analysisProgress(result);
+    }
+
+    const bool done = forEachChunk(scanList, [&](int, int chunk, ChunkCursor &cursor) {
+        const QVector<int> &chunkGates = boundary.at(chunk);
+        QVector<PopulationStats> exact(chunkGates.size());
+        for (int i = 0; i < chunkGates.size(); ++i) {
+            cursor.gate(gates.at(chunkGates.at(i)), exact[i]);
+        }
+        QMutexLocker locker(&mutex);
+        for (int i = 0; i < chunkGates.size(); ++i) {
+            scanned[chunkGates.at(i)].stats.merge(exact.at(i).stats);
+            scanned[chunkGates.at(i)].quadrants.merge(exact.at(i).quadrants);
+        }
+        chunkScanned[chunk] = true;
+        scannedNum++;
+    }, [&]() {
+        report();
+        emit analysisProgress(result);
+    });
+    if (!done) {
+        return false;
+    }
+    report();
+    return true;
+}
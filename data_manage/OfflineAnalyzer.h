@@ -0,0 +1,152 @@
+#ifndef OFFLINEANALYZER_H
+#define OFFLINEANALYZER_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QHash>
+#include <QMetaType>
+#include <atomic>
+#include <functional>
+#include "Plot.h"
+#include "MeasurementTypeHelper.h"
+#include "EventKernels.h"
+#include "AcquisitionFile.h"
+#include "FcsFile.h"
+#include "HistoBins.h"
+#include "PopulationTree.h"
+
+
+/**
+ * @brief What to compute for one plot of a recorded acquisition.
+ */
+struct OfflinePlotSpec
+{
+    int             plotId = 0;
+    PlotType        type = PlotType::UNKNOWN_PLOT;
+    int             channelX = 0;
+    MeasurementType typeX = MeasurementType::Height;
+    int             channelY = 0;       ///< Scatter and contour plots only
+    MeasurementType typeY = MeasurementType::Height;
+    bool            isLog = false;      ///< Histogram bins in log10 space
+    int             binNum = HistoBins::DefaultBinNum;   ///< Histogram bins
+    int             sampleSize = 60000; ///< Scatter events shown
+
+    bool operator==(const OfflinePlotSpec &other) const {
+        return plotId == other.plotId && type == other.type && channelX == other.channelX && typeX == other.typeX
+               && channelY == other.channelY && typeY == other.typeY && isLog == other.isLog
+               && binNum == other.binNum && sampleSize == other.sampleSize;
+    }
+};
+
+struct OfflineAnalysisRequest
+{
+    QVector<OfflinePlotSpec>    plots;
+    QVector<CompiledGate>       gates;
+};
+
+struct OfflinePlotResult
+{
+    OfflinePlotSpec spec;
+    quint64         events = 0;         ///< Events with valid pulses on the plot channels
+    HistoBins       bins;               ///< Histogram plots
+    QVector<QPoint> sample;             ///< Scatter and contour plots, every n-th event over the whole file
+};
+
+struct OfflineAnalysisResult
+{
+    QString                     filePath;
+    quint64                     eventCount = 0;
+    QVector<OfflinePlotResult>  plots;
+    QHash<int, PopulationStats> gates;  ///< By gate id
+    double                      progress = 1.0;     ///< Below 1 the gate stats are partly estimated
+    qint64                      elapsedMs = 0;
+};
+
+Q_DECLARE_METATYPE(OfflineAnalysisResult)
+
+
+/**
+ * @brief Recomputes plots and gate statistics over a whole recorded acquisition.
+ *
+ * openFile() maps an acquisition file (.seekacq) or an FCS file, analyze()
+ * then streams it chunk by chunk on a pool of one worker per core. Every
+ * worker takes the next chunk, reads only the columns the plots and gates
+ * need (raw acquisition columns straight from the mapping) and accumulates
+ * into its own bins and stats, which are merged once the file is done. RAM
+ * stays at a few chunks per worker whatever the file size.
+ *
+ * The gates are evaluated as a PopulationTree, so a child gate only tests
+ * the events of its parent. A first pass gathers the value range of every
+ * plot, the scatter samples and the population stats, a second pass counts the histogram bins over those
+ * ranges. Plot results are cached by spec, so after a gate change only the
+ * gate columns are read again.
+ *
+ * With every plot cached, only top level gates and chunk sketches in the
+ * file, the gates are first settled from the sketches: chunks entirely inside or outside a
+ * gate count without reading their events, the boundary chunks are
+ * estimated from the sketch bins. analysisProgress() reports these
+ * estimates at once and again while the boundary chunks are scanned.
+ *
+ * analyze() returns at once, the result arrives with analysisFinished() on
+ * the caller's thread. A new analyze() cancels the one in progress.
+ */
+class OfflineAnalyzer : public QThread
+{
+    Q_OBJECT
+public:
+    static OfflineAnalyzer &instance() {
+        static OfflineAnalyzer instance;
+        return instance;
+    }
+    OfflineAnalyzer &operator=(const OfflineAnalyzer &) = delete;
+    OfflineAnalyzer(const OfflineAnalyzer &) = delete;
+    ~OfflineAnalyzer() override;
+
+    bool    openFile(const QString &filePath);
+    void    closeFile();
+    bool    isOpen() const { return m_open; }
+    QString filePath() const { return m_filePath; }
+    QString errorString() const { return m_errorString; }
+    quint64 eventCount() const;
+    const QVector<int> &channels() const;
+
+    void    analyze(const OfflineAnalysisRequest &request);
+    void    cancel();
+
+signals:
+    void    analysisProgress(const OfflineAnalysisResult &result);
+    void    analysisFinished(const OfflineAnalysisResult &result);
+
+protected:
+    void run() override;
+
+private:
+    explicit OfflineAnalyzer(QObject *parent = nullptr);
+
+    class ChunkCursor;
+
+    int     chunkCount() const;
+    QVector<int> allChunks() const;
+    template <typename Fn>
+    bool    forEachChunk(const QVector<int> &chunks, Fn &&fn, const std::function<void()> &progress = {});
+    bool    analyzeGatesBySketch(const QVector<CompiledGate> &gates, OfflineAnalysisResult &result);
+
+    static constexpr int FcsChunkRows = 65536;
+    static constexpr int ProgressIntervalMs = 200;
+
+    AcquisitionFileReader       m_acqReader;
+    FcsReader                   m_fcsReader;
+    bool                        m_isFcs;
+    bool                        m_open;
+    QString                     m_filePath;
+    QString                     m_errorString;
+
+    QThreadPool                 m_pool;
+    QMutex                      m_mutex;
+    OfflineAnalysisRequest      m_request;          ///< Guarded by m_mutex
+    std::atomic<bool>           m_cancelRequested;
+    QHash<int, OfflinePlotResult> m_plotCache;      ///< By plot id, used by the analysis thread only
+};
+
+#endif // OFFLINEANALYZER_H
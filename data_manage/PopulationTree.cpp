@@ -0,0 +1,109 @@
+#include "PopulationTree.h"
+#include <QDebug>
+#include <algorithm>
+
+
+void PopulationTree::setGates(const QVector<CompiledGate> &gates)
+{
+    m_gates.clear();
+    m_parents.clear();
+
+    // Take a gate once its parent is placed, until no gate moves
+    QVector<bool> placed(gates.size(), false);
+    QVector<int> ids;
+    for (const CompiledGate &gate : gates) {
+        ids.append(gate.gateId());
+    }
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < gates.size(); ++i) {
+            if (placed.at(i)) continue;
+            const int parentId = gates.at(i).parentId();
+            int parentNode = -1;
+            if (parentId != 0 && ids.contains(parentId)) {
+                parentNode = indexOf(parentId);
+                if (parentNode < 0) continue;   // Parent not placed yet
+            }
+            m_gates.append(gates.at(i));
+            m_parents.append(parentNode);
+            placed[i] = true;
+            progress = true;
+        }
+    }
+    for (int i = 0; i < gates.size(); ++i) {
+        if (placed.at(i)) continue;
+        qWarning() << "[PopulationTree] Gate" << gates.at(i).gateId() << "is in a parent cycle, gating all events";
+        m_gates.append(gates.at(i));
+        m_parents.append(-1);
+    }
+
+    m_bits.resize(m_gates.size());
+    m_members.fill(0, m_gates.size());
+    m_rows = 0;
+}
+
+int PopulationTree::indexOf(int gateId) const
+{
+    for (int node = 0; node < m_gates.size(); ++node) {
+        if (m_gates.at(node).gateId() == gateId) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+bool PopulationTree::hasChildGates() const
+{
+    for (int parentNode : m_parents) {
+        if (parentNode >= 0) return true;
+    }
+    return false;
+}
+
+void PopulationTree::evaluate(int rows, const quint8 *chValid, const ColumnFn &column)
+{
+    m_rows = rows;
+    for (int node = 0; node < m_gates.size(); ++node) {
+        const CompiledGate &gate = m_gates.at(node);
+        GateBitmap &bits = m_bits[node];
+        bits.resize(rows);
+        const int parentNode = m_parents.at(node);
+        if (parentNode >= 0 && m_members.at(parentNode) == 0) {
+            std::fill(bits.words(), bits.words() + bits.wordCount(), 0);
+            m_members[node] = 0;
+            continue;
+        }
+        const qint32 *x = column(gate.channelX(), gate.typeX());
+        const qint32 *y = gate.is1D() ? nullptr : column(gate.channelY(), gate.typeY());
+        m_members[node] = gate.evaluate(x, y, chValid, rows, bits.words(),
+                                        parentNode >= 0 ? m_bits.at(parentNode).words() : nullptr);
+    }
+}
+
+void PopulationTree::evaluate(const EventBatch &batch)
+{
+    evaluate(batch.size(), batch.chPulseValid(), [&batch](int channelId, MeasurementType type) {
+        return batch.column(channelId, type);
+    });
+}
+
+void PopulationTree::accumulate(const ColumnFn &column, QVector<PopulationStats> &stats) const
+{
+    for (int node = 0; node < m_gates.size(); ++node) {
+        const CompiledGate &gate = m_gates.at(node);
+        PopulationStats &population = stats[node];
+        population.stats.origin[0] = gate.origin(0);
+        population.stats.origin[1] = gate.origin(1);
+        population.parentEvents += parentMembers(node);
+        population.totalEvents += m_rows;
+        if (m_members.at(node) == 0) continue;
+
+        const qint32 *x = column(gate.channelX(), gate.typeX());
+        const qint32 *y = gate.is1D() ? nullptr : column(gate.channelY(), gate.typeY());
+        gate.accumulate(x, y, m_bits.at(node).words(), m_rows, population.stats);
+        if (gate.isQuadrant()) {
+            gate.countQuadrants(x, y, m_bits.at(node).words(), m_rows, population.quadrants);
+        }
+    }
+}
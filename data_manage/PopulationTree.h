@@ -0,0 +1,74 @@
+#ifndef POPULATIONTREE_H
+#define POPULATIONTREE_H
+
+#include <QVector>
+#include <functional>
+#include "CompiledGate.h"
+
+
+/**
+ * @brief What a population gathered over the events it saw.
+ */
+struct PopulationStats
+{
+    RangeStats      stats;              ///< Members of the population
+    QuadrantCounts  quadrants;          ///< Quadrant gates
+    quint64         parentEvents = 0;   ///< Members of the parent population, all events for top level gates
+    quint64         totalEvents = 0;    ///< All events
+
+    double percentParent() const { return parentEvents ? 100.0 * stats.count / parentEvents : 0.0; }
+    double percentTotal() const { return totalEvents ? 100.0 * stats.count / totalEvents : 0.0; }
+};
+
+
+/**
+ * @brief The gates of a worksheet as a population hierarchy.
+ *
+ * A gate's parent_population_id names the gate whose events it splits
+ * further, 0 gates all events. setGates() orders the nodes parents first,
+ * a gate whose parent is not installed (or is part of a cycle) is taken
+ * as top level.
+ *
+ * evaluate() runs over one block of rows and leaves the membership bitmap
+ * of every node: a child gate tests only the rows its parent passed and
+ * is ANDed with the parent bitmap, so a deep gating strategy costs little
+ * more than its top level gates. A tree keeps the bitmaps of one block,
+ * threads need a copy each.
+ */
+class PopulationTree
+{
+public:
+    using ColumnFn = std::function<const qint32 *(int channelId, MeasurementType type)>;
+
+    void    setGates(const QVector<CompiledGate> &gates);
+
+    int     size() const { return m_gates.size(); }
+    bool    isEmpty() const { return m_gates.isEmpty(); }
+    const CompiledGate &gate(int node) const { return m_gates.at(node); }
+    int     parent(int node) const { return m_parents.at(node); }     ///< -1 for top level gates
+    int     indexOf(int gateId) const;
+    bool    hasChildGates() const;
+
+    void    evaluate(int rows, const quint8 *chValid, const ColumnFn &column);
+    void    evaluate(const EventBatch &batch);
+
+    // Results of the last evaluate()
+    int     rows() const { return m_rows; }
+    const GateBitmap &bits(int node) const { return m_bits.at(node); }
+    int     members(int node) const { return m_members.at(node); }
+    int     parentMembers(int node) const { return m_parents.at(node) < 0 ? m_rows : m_members.at(m_parents.at(node)); }
+
+    /*
+     * Adds the members of the last evaluate() to stats, one per node.
+     */
+    void    accumulate(const ColumnFn &column, QVector<PopulationStats> &stats) const;
+
+private:
+    QVector<CompiledGate>   m_gates;
+    QVector<int>            m_parents;
+    QVector<GateBitmap>     m_bits;
+    QVector<int>            m_members;
+    int                     m_rows = 0;
+};
+
+#endif // POPULATIONTREE_H
@@ -0,0 +1,312 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QVector>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include <limits>
+
+
+/**
+ * @brief Default weight of a queued item, used for the dropped item counter.
+ */
+template <typename T>
+struct SpscUnitWeight
+{
+    quint64 operator()(const T &) const { return 1; }
+};
+
+
+/**
+ * @brief Lock-free single producer / single consumer ring.
+ *
+ * Indices are 64-bit and only grow, slots are addressed with a power of two
+ * mask. The producer owns m_tail, the consumer claims a contiguous range by
+ * advancing m_head and gives the slots back with release(). Under the
+ * DropOldest policy the producer may also advance m_head, but only over
+ * slots the consumer has not claimed yet, so a range handed out by
+ * acquire() is never overwritten while it is being read.
+ *
+ * Weight converts an item to the unit the dropped counter is kept in, e.g.
+ * events per batch.
+ */
+template <typename T, typename Weight = SpscUnitWeight<T>>
+class SpscQueue
+{
+public:
+    enum class OverflowPolicy {
+        DropOldest,         ///< Discard unread items to make room
+        DropNewest,         ///< Reject the items that do not fit
+        Block,              ///< Wait up to the block timeout, then reject
+    };
+
+    struct Span {
+        T   *data = nullptr;
+        int size = 0;
+    };
+
+    struct ReadSpans {
+        Span first;
+        Span second;
+        int size() const { return first.size + second.size; }
+        bool isEmpty() const { return size() == 0; }
+    };
+
+    explicit SpscQueue(int capacity = DefaultCapacity, OverflowPolicy policy = OverflowPolicy::DropOldest)
+        : m_policy(policy), m_blockTimeoutMs(DefaultBlockTimeoutMs)
+    {
+        m_capacity = 1;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_mask = m_capacity - 1;
+        m_buffer.resize(m_capacity);
+        m_slots = m_buffer.data();
+    }
+
+    void setOverflowPolicy(OverflowPolicy policy, int blockTimeoutMs = DefaultBlockTimeoutMs)
+    {
+        m_policy = policy;
+        m_blockTimeoutMs = blockTimeoutMs;
+    }
+    OverflowPolicy overflowPolicy() const { return m_policy; }
+
+    // Producer side
+    int  reserve(int count, Span &first, Span &second);
+    void commit(int count);
+    int  push(const T *items, int count);
+    bool push(const T &item) { return push(&item, 1) == 1; }
+
+    // Consumer side
+    ReadSpans acquire(int maxCount = std::numeric_limits<int>::max());
+    void release();
+
+    // Must only be called while neither side is active
+    void reset();
+    void resetStatistics();
+
+    int     capacity() const { return m_capacity; }
+    int     size() const { return static_cast<int>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire)); }
+    bool    isEmpty() const { return size() == 0; }
+    int     highWaterMark() const { return m_highWater.load(std::memory_order_relaxed); }
+    quint64 droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int        DefaultCapacity = 1024;
+    static constexpr int        DefaultBlockTimeoutMs = 5;
+    static constexpr quint64    NoClaim = std::numeric_limits<quint64>::max();
+
+    quint64 readLimit() const;
+    int     freeSlots() const;
+    void    dropOldest(int count);
+    void    addDropped(quint64 weight) { m_dropped.fetch_add(weight, std::memory_order_relaxed); }
+
+    QVector<T>              m_buffer;
+    T                       *m_slots;           ///< m_buffer.data(), taken once so neither side detaches
+    int                     m_capacity;
+    quint64                 m_mask;
+    OverflowPolicy          m_policy;
+    int                     m_blockTimeoutMs;
+
+    alignas(64) std::atomic<quint64>    m_head{0};          ///< Next unread slot
+    alignas(64) std::atomic<quint64>    m_claimStart{NoClaim}; ///< First slot held by the consumer
+    quint64                             m_claimEnd = 0;     ///< Consumer only
+    alignas(64) std::atomic<quint64>    m_tail{0};          ///< Next slot to write, producer only
+    quint64                             m_reserved = 0;     ///< Producer only
+    std::atomic<int>                    m_highWater{0};
+    std::atomic<quint64>                m_dropped{0};
+};
+
+
+/*
+ * Oldest slot the producer must not overwrite. The head is loaded before the
+ * claim, and the consumer stores the claim before moving the head, so a
+ * claim made in between is always seen.
+ */
+template <typename T, typename Weight>
+inline quint64 SpscQueue<T, Weight>::readLimit() const
+{
+    quint64 head = m_head.load(std::memory_order_seq_cst);
+    quint64 claim = m_claimStart.load(std::memory_order_seq_cst);
+    return qMin(head, claim);
+}
+
+template <typename T, typename Weight>
+inline int SpscQueue<T, Weight>::freeSlots() const
+{
+    return m_capacity - static_cast<int>(m_tail.load(std::memory_order_relaxed) - readLimit());
+}
+
+template <typename T, typename Weight>
+void SpscQueue<T, Weight>::dropOldest(int count)
+{
+    const quint64 tail = m_tail.load(std::memory_order_relaxed);
+    quint64 head = m_head.load(std::memory_order_seq_cst);
+    while (true) {
+        int dropNum = qMin<quint64>(count, tail - head);
+        if (dropNum <= 0) {
+            return;
+        }
+        if (m_head.compare_exchange_weak(head, head + dropNum, std::memory_order_seq_cst)) {
+            Weight weight;
+            for (quint64 i = head; i < head + dropNum; ++i) {
+                addDropped(weight(m_slots[i & m_mask]));
+            }
+            return;
+        }
+    }
+}
+
+template <typename T, typename Weight>
+int SpscQueue<T, Weight>::reserve(int count, Span &first, Span &second)
+{
+    first = Span();
+    second = Span();
+    count = qMin(count, m_capacity);
+    if (count <= 0) {
+        return 0;
+    }
+
+    int free = freeSlots();
+    if (free < count) {
+        switch (m_policy) {
+        case OverflowPolicy::DropOldest:
+            dropOldest(count - free);
+            break;
+        case OverflowPolicy::Block: {
+            QElapsedTimer timer;
+            timer.start();
+            while (freeSlots() < count && timer.elapsed() < m_blockTimeoutMs) {
+                QThread::yieldCurrentThread();
+            }
+            break;
+        }
+        case OverflowPolicy::DropNewest:
+            break;
+        }
+        free = freeSlots();
+    }
+
+    count = qMin(count, free);
+    if (count <= 0) {
+        return 0;
+    }
+    const quint64 tail = m_tail.load(std::memory_order_relaxed);
+    const int start = static_cast<int>(tail & m_mask);
+    const int firstSize = qMin(count, m_capacity - start);
+    first.data = m_slots + start;
+    first.size = firstSize;
+    if (firstSize < count) {
+        second.data = m_slots;
+        second.size = count - firstSize;
+    }
+    m_reserved = count;
+    return count;
+}
+
+template <typename T, typename Weight>
+void SpscQueue<T, Weight>::commit(int count)
+{
+    count = qMin<quint64>(count, m_reserved);
+    m_reserved = 0;
+    if (count <= 0) {
+        return;
+    }
+    const quint64 tail = m_tail.load(std::memory_order_relaxed) + count;
+    m_tail.store(tail, std::memory_order_release);
+
+    int occupancy = static_cast<int>(tail - readLimit());
+    if (occupancy > m_highWater.load(std::memory_order_relaxed)) {
+        m_highWater.store(occupancy, std::memory_order_relaxed);
+    }
+}
+
+template <typename T, typename Weight>
+int SpscQueue<T, Weight>::push(const T *items, int count)
+{
+    Span first, second;
+    int granted = reserve(count, first, second);
+    for (int i = 0; i < first.size; ++i) {
+        first.data[i] = items[i];
+    }
+    for (int i = 0; i < second.size; ++i) {
+        second.data[i] = items[first.size + i];
+    }
+    commit(granted);
+
+    Weight weight;
+    for (int i = granted; i < count; ++i) {
+        addDropped(weight(items[i]));
+    }
+    return granted;
+}
+
+template <typename T, typename Weight>
+typename SpscQueue<T, Weight>::ReadSpans SpscQueue<T, Weight>::acquire(int maxCount)
+{
+    ReadSpans spans;
+    if (m_claimStart.load(std::memory_order_relaxed) != NoClaim) {
+        release();
+    }
+
+    quint64 head = m_head.load(std::memory_order_seq_cst);
+    while (true) {
+        const quint64 tail = m_tail.load(std::memory_order_acquire);
+        int count = static_cast<int>(qMin<quint64>(maxCount, tail - head));
+        if (count <= 0) {
+            m_claimStart.store(NoClaim, std::memory_order_seq_cst);
+            return spans;
+        }
+        m_claimStart.store(head, std::memory_order_seq_cst);
+        if (m_head.compare_exchange_strong(head, head + count, std::memory_order_seq_cst)) {
+            m_claimEnd = head + count;
+            const int start = static_cast<int>(head & m_mask);
+            const int firstSize = qMin(count, m_capacity - start);
+            spans.first.data = m_slots + start;
+            spans.first.size = firstSize;
+            if (firstSize < count) {
+                spans.second.data = m_slots;
+                spans.second.size = count - firstSize;
+            }
+            return spans;
+        }
+        // The producer dropped items under us, head now holds the new value
+    }
+}
+
+template <typename T, typename Weight>
+void SpscQueue<T, Weight>::release()
+{
+    const quint64 claim = m_claimStart.load(std::memory_order_relaxed);
+    if (claim == NoClaim) {
+        return;
+    }
+    // Let go of the payload now instead of when the slot is reused
+    for (quint64 i = claim; i < m_claimEnd; ++i) {
+        m_slots[i & m_mask] = T();
+    }
+    m_claimStart.store(NoClaim, std::memory_order_seq_cst);
+}
+
+template <typename T, typename Weight>
+void SpscQueue<T, Weight>::reset()
+{
+    m_head.store(0);
+    m_tail.store(0);
+    m_claimStart.store(NoClaim);
+    m_claimEnd = 0;
+    m_reserved = 0;
+    m_buffer.fill(T());
+    m_slots = m_buffer.data();
+    resetStatistics();
+}
+
+template <typename T, typename Weight>
+void SpscQueue<T, Weight>::resetStatistics()
+{
+    m_highWater.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+}
+
+#endif // SPSCQUEUE_H
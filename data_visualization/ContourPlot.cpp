@@ -0,0 +1,118 @@
+#include "ContourPlot.h"
+#include <QMenu>
+#include <QTransform>
+#include <algorithm>
+#include <functional>
+
+
+ContourPlot::ContourPlot(const Plot &plot, QGraphicsItem *parent)
+    : ScatterPlot(plot, parent), m_levels({0.98, 0.9, 0.75, 0.5, 0.25})
+{
+    connect(&ContourWorker::instance(), &ContourWorker::contoursReady, this, &ContourPlot::onContoursReady);
+}
+
+void ContourPlot::setLevels(const QVector<double> &levels)
+{
+    m_levels = levels;
+    std::sort(m_levels.begin(), m_levels.end(), std::greater<double>());
+    m_requestedCounts.clear();
+    publishState(true);
+}
+
+void ContourPlot::paintPlot(QPainter *painter)
+{
+    if (!painter) return;
+
+    painter->save();
+    if (!m_contours.size.isEmpty()
+        && m_contoursX.scale == m_xAxis->scaleType() && m_contoursY.scale == m_yAxis->scaleType()) {
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setClipRect(m_plotArea);
+        painter->setBrush(Qt::NoBrush);
+
+        // Bin coordinates to the plot area, outer contours in the low colours
+        const QTransform transform = frameTransform(m_contoursX, m_contoursY, QSizeF(m_contours.size));
+        const QVector<QRgb> colors = DensityGrid::colorTable(m_colorMap);
+        const int levelNum = m_contours.levels.size();
+        for (int i = 0; i < levelNum; ++i) {
+            const int colorIndex = levelNum > 1 ? i * 255 / (levelNum - 1) : 255;
+            painter->setPen(QPen(QColor(colors.at(colorIndex)), 1.2));
+            for (const QPolygonF &line : m_contours.levels.at(i).lines) {
+                painter->drawPolyline(transform.map(line));
+            }
+        }
+    }
+
+    paintRubberBand(painter);
+
+    painter->restore();
+}
+
+void ContourPlot::resetPlot()
+{
+    ScatterPlot::resetPlot();
+    m_requestedCounts.clear();
+    m_contours = ContourResult();
+}
+
+void ContourPlot::addContextMenuActions(QMenu *menu)
+{
+    menu->addSeparator();
+    addColorMapMenu(menu);
+}
+
+PlotState ContourPlot::plotState() const
+{
+    PlotState state = ScatterPlot::plotState();
+    state.gridSize = QSize(GRID_BINS, GRID_BINS);
+    state.countsOnly = true;
+    return state;
+}
+
+void ContourPlot::frameReceived(const PlotFrame &frame)
+{
+    const QVector<quint32> &counts = frame.counts;
+    quint64 total = 0;
+    for (quint32 count : counts) {
+        total += count;
+    }
+    if (total == 0) {
+        m_requestedCounts.clear();
+        m_contours = ContourResult();
+        return;
+    }
+    if (m_requestedX == frame.x && m_requestedY == frame.y && m_requestedCounts.size() == counts.size()) {
+        quint64 changed = 0;
+        for (int i = 0; i < counts.size(); ++i) {
+            const quint32 count = counts.at(i);
+            const quint32 requested = m_requestedCounts.at(i);
+            changed += count > requested ? count - requested : requested - count;
+        }
+        if (changed < RECOMPUTE_CHANGE * total) {
+            return;
+        }
+    }
+
+    m_requestedCounts = counts;
+    m_requestedX = frame.x;
+    m_requestedY = frame.y;
+    ContourRequest request;
+    request.key = reinterpret_cast<quintptr>(this);
+    request.generation = ++m_generation;
+    request.size = frame.gridSize;
+    request.counts = counts;
+    request.levels = m_levels;
+    ContourWorker::instance().request(request);
+}
+
+void ContourPlot::onContoursReady(const ContourResult &result)
+{
+    // Results of other plots, or of a request a newer one replaced
+    if (result.key != reinterpret_cast<quintptr>(this) || result.generation != m_generation) {
+        return;
+    }
+    m_contours = result;
+    m_contoursX = m_requestedX;
+    m_contoursY = m_requestedY;
+    update();
+}
@@ -0,0 +1,54 @@
+#ifndef CONTOURPLOT_H
+#define CONTOURPLOT_H
+
+#include "ScatterPlot.h"
+#include "ContourWorker.h"
+
+
+/**
+ * @brief Probability contours of the events on two axes.
+ *
+ * The events are counted into a coarse grid over the plot area, kept up
+ * to date like the density grid of a scatter plot and handed over with
+ * every frame of the layer. ContourWorker smooths the grid and traces the
+ * contours off the GUI thread, the plot draws the last contours it got.
+ * New contours are asked for only when the grid changed by a few percent
+ * of its events since the last request, or the axes moved.
+ */
+class ContourPlot : public ScatterPlot
+{
+    Q_OBJECT
+public:
+    ContourPlot(const Plot &plot, QGraphicsItem *parent = nullptr);
+
+    /**
+     * @brief Fractions of the events the contours enclose, outermost first.
+     */
+    void setLevels(const QVector<double> &levels);
+    QVector<double> levels() const { return m_levels; }
+
+protected:
+    void            paintPlot(QPainter *painter) override;
+    void            resetPlot() override;
+    void            addContextMenuActions(QMenu *menu) override;
+    PlotState       plotState() const override;
+    void            frameReceived(const PlotFrame &frame) override;
+
+private slots:
+    void            onContoursReady(const ContourResult &result);
+
+private:
+    QVector<double>     m_levels;
+    quint64             m_generation = 0;       ///< Of the last request
+    QVector<quint32>    m_requestedCounts;      ///< Grid of the last request
+    AxisState           m_requestedX;           ///< Axes the grid of the last request was counted over
+    AxisState           m_requestedY;
+    ContourResult       m_contours;             ///< Shown, in bins over m_contoursX and m_contoursY
+    AxisState           m_contoursX;
+    AxisState           m_contoursY;
+
+    static constexpr int    GRID_BINS = 128;
+    static constexpr double RECOMPUTE_CHANGE = 0.02;    ///< Changed counts, of all counts, that ask for new contours
+};
+
+#endif // CONTOURPLOT_H
@@ -0,0 +1,105 @@
+#include "DensityGrid.h"
+#include <QColor>
+#include <algorithm>
+#include <cmath>
+
+
+void DensityGrid::reset(const QSize &size)
+{
+    m_size = size.isValid() ? size : QSize(0, 0);
+    m_counts.fill(0, m_size.width() * m_size.height());
+    m_events = 0;
+    m_image = QImage(m_size, QImage::Format_ARGB32_Premultiplied);
+    m_dirty = true;
+}
+
+void DensityGrid::clear()
+{
+    m_counts.fill(0);
+    m_events = 0;
+    m_dirty = true;
+}
+
+const QImage &DensityGrid::image(ColorMap colorMap)
+{
+    if (!m_dirty && colorMap == m_imageColorMap) {
+        return m_image;
+    }
+    m_dirty = false;
+    m_imageColorMap = colorMap;
+    m_image.fill(Qt::transparent);
+    if (m_events == 0 || m_image.isNull()) {
+        return m_image;
+    }
+
+    const quint32 maxCount = *std::max_element(m_counts.cbegin(), m_counts.cend());
+    const double scale = maxCount > 1 ? 255.0 / std::log(static_cast<double>(maxCount)) : 0.0;
+    auto level = [scale](quint32 count) {
+        return scale > 0.0 ? qBound(0, static_cast<int>(std::log(static_cast<double>(count)) * scale), 255) : 255;
+    };
+
+    // Colours of the common small counts, so most pixels skip the log
+    const QVector<QRgb> table = colorTable(colorMap);
+    const int cached = static_cast<int>(qMin<quint32>(maxCount, 4096));
+    QVector<QRgb> colors(cached + 1, 0);
+    for (int count = 1; count <= cached; ++count) {
+        colors[count] = table.at(level(count));
+    }
+
+    const int width = m_size.width();
+    for (int y = 0; y < m_size.height(); ++y) {
+        const quint32 *counts = m_counts.constData() + y * width;
+        QRgb *line = reinterpret_cast<QRgb *>(m_image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const quint32 count = counts[x];
+            if (count == 0) continue;
+            line[x] = count <= static_cast<quint32>(cached) ? colors.at(count) : table.at(level(count));
+        }
+    }
+    return m_image;
+}
+
+QString DensityGrid::colorMapName(ColorMap colorMap)
+{
+    switch (colorMap) {
+    case Viridis:
+        return "Viridis";
+    case Jet:
+        return "Jet";
+    case Grey:
+        return "Grey";
+    default:
+        return "Unknown";
+    }
+}
+
+QVector<QRgb> DensityGrid::colorTable(ColorMap colorMap)
+{
+    QVector<QColor> stops;
+    switch (colorMap) {
+    case Jet:
+        stops = {QColor(0, 0, 143), QColor(0, 0, 255), QColor(0, 255, 255), QColor(255, 255, 0), QColor(255, 0, 0), QColor(128, 0, 0)};
+        break;
+    case Grey:
+        stops = {QColor(190, 190, 190), QColor(0, 0, 0)};
+        break;
+    case Viridis:
+    default:
+        stops = {QColor(68, 1, 84), QColor(59, 82, 139), QColor(33, 145, 140), QColor(94, 201, 98), QColor(253, 231, 37)};
+        break;
+    }
+
+    QVector<QRgb> table(256);
+    const int segments = stops.size() - 1;
+    for (int i = 0; i < 256; ++i) {
+        const double t = i / 255.0 * segments;
+        const int s = qMin(static_cast<int>(t), segments - 1);
+        const double f = t - s;
+        const QColor &a = stops.at(s);
+        const QColor &b = stops.at(s + 1);
+        table[i] = qRgb(qRound(a.red() + (b.red() - a.red()) * f),
+                        qRound(a.green() + (b.green() - a.green()) * f),
+                        qRound(a.blue() + (b.blue() - a.blue()) * f));
+    }
+    return table;
+}
@@ -0,0 +1,62 @@
+#ifndef DENSITYGRID_H
+#define DENSITYGRID_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+
+/**
+ * @brief Event counts per plot pixel, drawn as one image through a colour map.
+ *
+ * add() and remove() move a single count, so a plot keeps the grid up to
+ * date with the events that arrive and those that age out of its buffer.
+ * image() colours the counts on a log scale from the lowest to the highest
+ * count, empty pixels stay transparent. Drawing costs one pass over the
+ * pixels, whatever the number of events.
+ */
+class DensityGrid
+{
+public:
+    enum ColorMap {
+        Viridis,
+        Jet,
+        Grey,
+    };
+
+    void    reset(const QSize &size);
+    void    clear();
+    QSize   size() const { return m_size; }
+    bool    isEmpty() const { return m_events == 0; }
+
+    void    add(int x, int y) {
+        if (x < 0 || y < 0 || x >= m_size.width() || y >= m_size.height()) return;
+        m_counts[y * m_size.width() + x]++;
+        m_events++;
+        m_dirty = true;
+    }
+    void    remove(int x, int y) {
+        if (x < 0 || y < 0 || x >= m_size.width() || y >= m_size.height()) return;
+        quint32 &count = m_counts[y * m_size.width() + x];
+        if (count == 0) return;
+        count--;
+        m_events--;
+        m_dirty = true;
+    }
+
+    const QVector<quint32> &counts() const { return m_counts; }
+    const QImage &image(ColorMap colorMap);
+
+    static QString colorMapName(ColorMap colorMap);
+    static QVector<QRgb> colorTable(ColorMap colorMap);     ///< 256 colours, low to high
+
+private:
+    QSize               m_size;
+    QVector<quint32>    m_counts;       ///< Row major, row 0 at the top
+    quint64             m_events = 0;
+    QImage              m_image;
+    bool                m_dirty = true;
+    ColorMap            m_imageColorMap = Viridis;
+};
+
+#endif // DENSITYGRID_H
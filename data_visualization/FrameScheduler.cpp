@@ -0,0 +1,195 @@
+#include "FrameScheduler.h"
+#include "PlotBase.h"
+#include "WorkSheetScene.h"
+#include <algorithm>
+#include <cmath>
+
+
+FrameScheduler::FrameScheduler(QObject *parent)
+    : QObject{parent}, m_targetFps(DEFAULT_FPS), m_budgetFraction(0.5), m_intervalMs(1000 / DEFAULT_FPS)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_frameTimes.reserve(FRAME_HISTORY);
+    connect(&m_timer, &QTimer::timeout, this, &FrameScheduler::onTimeout);
+}
+
+void FrameScheduler::setTargetFps(int fps)
+{
+    m_targetFps = qBound(MIN_FPS, fps, 1000);
+    m_intervalMs = 1000 / m_targetFps;
+    if (m_timer.isActive()) {
+        m_timer.setInterval(m_intervalMs);
+    }
+}
+
+void FrameScheduler::setBudgetFraction(double fraction)
+{
+    m_budgetFraction = qBound(0.05, fraction, 1.0);
+}
+
+void FrameScheduler::setScene(WorkSheetScene *scene)
+{
+    if (m_scene == scene) return;
+    const bool active = m_timer.isActive();
+    if (active) setPaced(false);
+    m_scene = scene;
+    m_lastRequest.clear();
+    m_presented.clear();
+    m_lastFrameNs = -1;
+    m_nextPlot = 0;
+    if (active) setPaced(true);
+}
+
+void FrameScheduler::start()
+{
+    m_intervalMs = 1000 / m_targetFps;
+    m_frameTimes.clear();
+    m_frameTimeIndex = 0;
+    m_reportFrames = 0;
+    m_skippedPlots = 0;
+    m_decimatedPlots = 0;
+    m_reportTimer.start();
+    setPaced(true);
+    m_timer.start(m_intervalMs);
+}
+
+/*
+ * Plots go back to asking for frames and repainting on their own, with
+ * whatever they still held back.
+ */
+void FrameScheduler::stop()
+{
+    m_timer.stop();
+    setPaced(false);
+    m_presented.clear();
+    m_lastFrameNs = -1;
+}
+
+void FrameScheduler::setPaced(bool paced)
+{
+    if (!m_scene) return;
+    for (PlotBase *plot : m_scene->plots()) {
+        plot->setPaced(paced);
+    }
+}
+
+void FrameScheduler::onTimeout()
+{
+    // The plots repainted by the last frame have been painted since, which completes its time
+    if (m_lastFrameNs >= 0) {
+        qint64 frameNs = m_lastFrameNs;
+        for (const QPointer<PlotBase> &plot : std::as_const(m_presented)) {
+            if (plot) frameNs += plot->paintCost();
+        }
+        recordFrame(frameNs);
+    }
+    m_presented.clear();
+    m_lastFrameNs = -1;
+
+    QElapsedTimer timer;
+    timer.start();
+    ++m_frameIndex;
+    const QList<PlotBase*> plots = m_scene ? m_scene->plots() : QList<PlotBase*>();
+    for (PlotBase *plot : plots) {
+        plot->setPaced(true);           // Plots added since the last frame
+    }
+    emit frameStarted();
+
+    // Plots with new data ask their layer for a frame, layers slower than a frame only every few frames
+    bool worked = false;
+    const qint64 intervalNs = m_intervalMs * 1000000LL;
+    QHash<PlotBase*, quint64> lastRequest;
+    for (PlotBase *plot : plots) {
+        quint64 last = m_lastRequest.value(plot, 0);
+        if (plot->hasPendingData()) {
+            const qint64 every = qBound<qint64>(1, (plot->renderCost() + intervalNs - 1) / intervalNs, MAX_DECIMATION);
+            if (m_frameIndex - last >= static_cast<quint64>(every)) {
+                plot->requestFrame();
+                last = m_frameIndex;
+                worked = true;
+            } else {
+                m_decimatedPlots++;
+            }
+        }
+        lastRequest.insert(plot, last);
+    }
+    m_lastRequest.swap(lastRequest);
+
+    // Repaint the plots with a new frame while the budget lasts, the first one put off leads the next frame
+    const qint64 budgetNs = static_cast<qint64>(intervalNs * m_budgetFraction);
+    const int plotNum = plots.size();
+    qint64 paintNs = 0;
+    int firstSkipped = -1;
+    for (int i = 0; i < plotNum; ++i) {
+        const int index = (m_nextPlot + i) % plotNum;
+        PlotBase *plot = plots.at(index);
+        if (!plot->hasNewFrame()) continue;
+        if (!m_presented.isEmpty() && timer.nsecsElapsed() + paintNs + plot->paintCost() > budgetNs) {
+            if (firstSkipped < 0) firstSkipped = index;
+            m_skippedPlots++;
+            continue;
+        }
+        paintNs += plot->paintCost();
+        plot->presentFrame();
+        m_presented.append(plot);
+    }
+    m_nextPlot = firstSkipped >= 0 ? firstSkipped : 0;
+
+    if (worked || !m_presented.isEmpty()) {
+        m_lastFrameNs = timer.nsecsElapsed();
+    }
+    if (m_reportTimer.elapsed() >= 1000) {
+        report();
+    }
+}
+
+void FrameScheduler::recordFrame(qint64 frameNs)
+{
+    if (m_frameTimes.size() < FRAME_HISTORY) {
+        m_frameTimes.append(frameNs);
+    } else {
+        m_frameTimes[m_frameTimeIndex] = frameNs;
+        m_frameTimeIndex = (m_frameTimeIndex + 1) % FRAME_HISTORY;
+    }
+    m_reportFrames++;
+}
+
+/*
+ * Reports the last second and adapts the interval: frames over the budget
+ * of the current interval stretch it, frames well within it bring the
+ * target rate back.
+ */
+void FrameScheduler::report()
+{
+    FrameStatistics stats;
+    const qint64 elapsed = m_reportTimer.elapsed();
+    stats.fps = elapsed > 0 ? m_reportFrames * 1000.0 / elapsed : 0.0;
+
+    QVector<qint64> times = m_frameTimes;
+    std::sort(times.begin(), times.end());
+    auto percentile = [&times](double p) {
+        return times.isEmpty() ? 0.0 : times.at(qMin(times.size() - 1, static_cast<int>(p * times.size()))) / 1e6;
+    };
+    stats.frameMs50 = percentile(0.50);
+    stats.frameMs95 = percentile(0.95);
+    stats.frameMs99 = percentile(0.99);
+
+    if (m_reportFrames > 0) {
+        const double budgetMs = m_intervalMs * m_budgetFraction;
+        if (stats.frameMs95 > budgetMs) {
+            m_intervalMs = qMin(static_cast<int>(std::ceil(m_intervalMs * 1.25)), 1000 / MIN_FPS);
+        } else if (stats.frameMs95 < budgetMs / 2) {
+            m_intervalMs = qMax(static_cast<int>(m_intervalMs / 1.25), 1000 / m_targetFps);
+        }
+        m_timer.setInterval(m_intervalMs);
+    }
+    stats.intervalMs = m_intervalMs;
+    stats.skippedPlots = m_skippedPlots;
+    stats.decimatedPlots = m_decimatedPlots;
+    emit statisticsUpdated(stats);
+
+    m_reportFrames = 0;
+    m_skippedPlots = 0;
+    m_decimatedPlots = 0;
+    m_reportTimer.restart();
+}
@@ -0,0 +1,96 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QHash>
+#include <QVector>
+
+class PlotBase;
+class WorkSheetScene;
+
+
+struct FrameStatistics
+{
+    double  fps = 0.0;              ///< Frames that had work, per second
+    double  frameMs50 = 0.0;        ///< GUI thread time per frame, percentiles over the recent frames
+    double  frameMs95 = 0.0;
+    double  frameMs99 = 0.0;
+    int     intervalMs = 0;         ///< Frame interval the pacing settled on
+    int     skippedPlots = 0;       ///< Repaints put off to a later frame, since the last report
+    int     decimatedPlots = 0;     ///< Frame requests held back for slow layers, since the last report
+};
+
+
+/**
+ * @brief Paces the live refresh of a worksheet's plots.
+ *
+ * Every frame, frameStarted() lets the owner hand the new events to the
+ * plots, then the plots with new data ask their layers for a frame and
+ * the plots with a finished frame are repainted. Plots only take part
+ * when something changed. A frame keeps to a time budget on the GUI
+ * thread: repaints that do not fit are put off to the next frame, taking
+ * turns so every plot gets its share, and a plot whose layer renders
+ * slower than the frame rate asks for frames only every few frames. When
+ * frames keep running over the budget, the interval grows towards
+ * MIN_FPS, and shrinks back to the target rate once they fit again.
+ *
+ * statisticsUpdated() reports the achieved rate and frame time
+ * percentiles once a second.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameScheduler(QObject *parent = nullptr);
+
+    void    setTargetFps(int fps);
+    int     targetFps() const { return m_targetFps; }
+    void    setBudgetFraction(double fraction);     ///< Of the target frame interval
+    void    setScene(WorkSheetScene *scene);
+
+    void    start();
+    void    stop();
+    bool    isActive() const { return m_timer.isActive(); }
+
+signals:
+    void    frameStarted();         ///< Connected directly, runs inside the frame
+    void    statisticsUpdated(const FrameStatistics &stats);
+
+private slots:
+    void    onTimeout();
+
+private:
+    void    setPaced(bool paced);
+    void    recordFrame(qint64 frameNs);
+    void    report();
+    qint64  targetIntervalNs() const { return 1000000000LL / m_targetFps; }
+
+    QTimer                  m_timer;
+    int                     m_targetFps;
+    double                  m_budgetFraction;
+    int                     m_intervalMs;           ///< Current, between the target rate and MIN_FPS
+    QPointer<WorkSheetScene>    m_scene;
+
+    quint64                 m_frameIndex = 0;
+    QHash<PlotBase*, quint64>   m_lastRequest;      ///< Frame a plot last asked its layer for a frame
+    int                     m_nextPlot = 0;         ///< First plot to repaint, after an over budget frame
+    QVector<QPointer<PlotBase>> m_presented;        ///< Repainted by the last frame, their paint time is known now
+    qint64                  m_lastFrameNs = -1;     ///< GUI time of the last frame before painting, -1 if idle
+
+    QVector<qint64>         m_frameTimes;           ///< Recent frames, a ring of FRAME_HISTORY
+    int                     m_frameTimeIndex = 0;
+    QElapsedTimer           m_reportTimer;
+    int                     m_reportFrames = 0;
+    int                     m_skippedPlots = 0;
+    int                     m_decimatedPlots = 0;
+
+    static constexpr int    DEFAULT_FPS = 30;
+    static constexpr int    MIN_FPS = 5;
+    static constexpr int    MAX_DECIMATION = 8;     ///< Longest a plot with new data waits for a frame request, in frames
+    static constexpr int    FRAME_HISTORY = 120;
+};
+
+#endif // FRAMESCHEDULER_H
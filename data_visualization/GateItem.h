@@ -22,6 +22,7 @@ public:
     void    setGateName(const QString &name) { m_gate.setName(name); }
     void    setGateId(int id) { m_gate.setId(id);}
     void    setGateColor(const QColor &color) { m_gate.setColor(color); }
+    void    setGateParentId(int parentId) { m_gate.setParentId(parentId); }
     QColor  getGateColor() const { return m_gate.color(); }
 
     virtual void        updateGatePreview(const QPointF &point) = 0;
@@ -0,0 +1,226 @@
+#ifndef HISTOBINS_H
+#define HISTOBINS_H
+
+#include <QList>
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ * @brief Fixed number of bins over the data range, in log10 space for log axes.
+ *
+ * updateBins() lays the bins over [min, max] and counts a data set in one
+ * go. setRange(), binIndex() and merge() split that into steps, so several
+ * threads can count parts of a data set into copies of the same layout and
+ * merge them afterwards. addCount() and removeCount() keep the bins up to
+ * date with a sliding data set while fits() says the layout still holds it.
+ *
+ * The bin number is the channel count of the histogram, unrelated to the
+ * width it is drawn at. On log layouts setRange() keeps the real-space
+ * lower edge of every bin, binIndex() looks values up in that table
+ * instead of taking a log per value.
+ */
+class HistoBins
+{
+public:
+    static constexpr int DefaultBinNum = 512;
+
+    explicit HistoBins(int num = DefaultBinNum) {
+        m_binNum = qMax(1, num);
+        m_maxValue = 0;
+        m_maxValid = true;
+        m_isLog = false;
+        bins.resize(m_binNum);
+        bins.fill(0);
+    }
+
+    int binValue(int index) const {
+        return (index >= 0 && index < m_binNum) ? bins.at(index) : 0;
+    }
+
+    int binNum() const {
+        return m_binNum;
+    }
+
+    qreal binStep() const {
+        return m_binStep;
+    }
+
+    qreal binStart() const {
+        return m_binStart;
+    }
+
+    qreal binEnd() const {
+        return m_binEnd;
+    }
+
+    // Return real-space boundaries (for setting axis range)
+    qreal realBinStart() const {
+        return m_isLog ? std::pow(10.0, m_binStart) : m_binStart;
+    }
+
+    qreal realBinEnd() const {
+        return m_isLog ? std::pow(10.0, m_binEnd) : m_binEnd;
+    }
+
+    // Real-space lower edge of a bin, binNum() gives the upper edge of the last one
+    qreal realBinEdge(int index) const {
+        if (index <= 0) return realBinStart();
+        if (index >= m_binNum) return realBinEnd();
+        return m_isLog ? m_logEdges.at(index - 1) : m_binStart + index * m_binStep;
+    }
+
+    int maxBinVal() const {
+        if (!m_maxValid) {
+            m_maxValue = 0;
+            for (int count : bins) {
+                m_maxValue = qMax(m_maxValue, count);
+            }
+            m_maxValid = true;
+        }
+        return m_maxValue;
+    }
+
+    bool isLog() const {
+        return m_isLog;
+    }
+
+    /*
+     * Lays the bins over [min, max] and clears them. A margin widens the
+     * layout by that fraction of its span on each side, in binning space.
+     */
+    void setRange(int min, int max, bool isLog = false, qreal margin = 0.0) {
+        if (min > max) return;
+        m_isLog = isLog;
+        span(min, max, isLog, m_binStart, m_binEnd);
+        const qreal pad = (m_binEnd - m_binStart) * margin;
+        m_binStart -= pad;
+        m_binEnd += pad;
+        if (isLog && m_binStart < 0) {
+            m_binStart = 0;
+        }
+        m_binStep = (m_binEnd - m_binStart) / m_binNum;
+
+        m_logEdges.clear();
+        if (isLog) {
+            m_logEdges.resize(m_binNum - 1);
+            for (int i = 1; i < m_binNum; ++i) {
+                m_logEdges[i - 1] = std::pow(10.0, m_binStart + i * m_binStep);
+            }
+        }
+
+        bins.fill(0);
+        m_maxValue = 0;
+        m_maxValid = true;
+    }
+
+    /*
+     * Whether the layout still suits data over [min, max]: it holds the
+     * data, and the data is not lost in a layout more than twice its span.
+     */
+    bool fits(int min, int max, bool isLog) const {
+        if (min > max || isLog != m_isLog) return false;
+        qreal start, end;
+        span(min, max, isLog, start, end);
+        return start >= m_binStart && end <= m_binEnd && 2 * (end - start) >= m_binEnd - m_binStart;
+    }
+
+    /*
+     * Bin of a value, values outside the range go to the first or last bin,
+     * -1 for values a log axis cannot show.
+     */
+    int binIndex(int val) const {
+        int index;
+        if (m_isLog) {
+            if (val <= 0) {
+                return -1;
+            }
+            index = std::upper_bound(m_logEdges.cbegin(), m_logEdges.cend(), static_cast<double>(val)) - m_logEdges.cbegin();
+        } else {
+            index = (val - m_binStart) / m_binStep;
+        }
+        if (index < 0) index = 0;
+        if (index >= m_binNum) {
+            index = m_binNum - 1;
+        }
+        return index;
+    }
+
+    void addCount(int index, int count = 1) {
+        int &cnt = bins[index];
+        cnt += count;
+        if (m_maxValid) {
+            m_maxValue = qMax(m_maxValue, cnt);
+        }
+    }
+
+    void removeCount(int index, int count = 1) {
+        int &cnt = bins[index];
+        if (m_maxValid && cnt == m_maxValue) {
+            m_maxValid = false;
+        }
+        cnt = qMax(0, cnt - count);
+    }
+
+    /*
+     * Adds the counts of bins laid out by the same setRange() call.
+     */
+    void merge(const HistoBins &other) {
+        if (other.m_binNum != m_binNum) return;
+        for (int i = 0; i < m_binNum; ++i) {
+            if (other.bins.at(i)) {
+                addCount(i, other.bins.at(i));
+            }
+        }
+    }
+
+    void updateBins(int min, int max, const QList<int> &data, bool isLog = false, qreal margin = 0.0) {
+        if (min > max) return;
+        setRange(min, max, isLog, margin);
+
+        for (const int &val : data) {
+            const int index = binIndex(val);
+            if (index >= 0) {
+                addCount(index);
+            }
+        }
+    }
+
+
+private:
+    /*
+     * Binning space interval for [min, max], at least one value per bin wide
+     * and centred on the data.
+     */
+    void span(int min, int max, bool isLog, qreal &start, qreal &end) const {
+        qreal range = static_cast<qreal>(max) - min;
+        if (range < m_binNum)
+            range = m_binNum;
+
+        qreal realStart = (static_cast<qreal>(min) + max) / 2.0 - range / 2.0;
+        qreal realEnd = realStart + range;
+
+        if (isLog) {
+            if (realStart <= 0) realStart = 1;
+            if (realEnd <= realStart) realEnd = realStart * 10;
+            start = std::log10(realStart);
+            end = std::log10(realEnd);
+        } else {
+            start = realStart;
+            end = realEnd;
+        }
+    }
+
+    QList<int> bins;
+    QList<double> m_logEdges;   // real-space lower edges of bins 1..n-1 when m_isLog
+    qreal   m_binStart = 0;   // in log10 space when m_isLog
+    qreal   m_binEnd = 0;     // in log10 space when m_isLog
+    qreal   m_binStep = 1;    // in log10 space when m_isLog
+    int     m_binNum;
+    mutable int     m_maxValue;
+    mutable bool    m_maxValid;   // false once the highest bin lost counts
+    bool    m_isLog;
+};
+
+#endif // HISTOBINS_H
@@ -0,0 +1,136 @@
+#include "HistogramLayer.h"
+#include <QPainter>
+
+
+HistogramLayer::HistogramLayer(int channel, MeasurementType type)
+    : m_channel(channel), m_type(type), m_data(DEFAULT_DATA_LENGTH)
+{
+}
+
+void HistogramLayer::addEvents(const QVector<EventBatchPtr> &data)
+{
+    const quint8 validMask = EventBatch::channelBit(m_channel);
+
+    int eventNum = 0;
+    for (const EventBatchPtr &batch : data) {
+        eventNum += batch->size();
+    }
+    QVector<int> values(eventNum);
+    int count = 0;
+    for (const EventBatchPtr &batch : data) {
+        const qint32 *xData = batch->column(m_channel, m_type);
+        if (!xData) continue;
+        count += EventKernels::project1D(xData, batch->chPulseValid(), validMask, batch->size(), values.data() + count);
+    }
+    values.resize(count);
+    addValues(values);
+}
+
+void HistogramLayer::addValues(const QVector<int> &data)
+{
+    if (data.isEmpty()) return;
+    QVector<int> aged;
+    m_data.writeMultiple(data, &aged);
+
+    int min, max;
+    m_data.getMinMax(min, max);
+    if (!m_binsValid || !m_bins.fits(min, max, m_bins.isLog())) {
+        m_binsValid = false;
+        return;
+    }
+
+    // Same layout, count the new values in and the aged ones out
+    for (int val : data) {
+        const int index = m_bins.binIndex(val);
+        if (index >= 0) m_bins.addCount(index);
+    }
+    for (int val : aged) {
+        const int index = m_bins.binIndex(val);
+        if (index >= 0) m_bins.removeCount(index);
+    }
+}
+
+void HistogramLayer::setBins(const HistoBins &bins)
+{
+    m_data.clear();
+    m_bins = bins;
+    m_binsValid = false;
+}
+
+void HistogramLayer::clear()
+{
+    m_data.clear();
+    m_bins = HistoBins(m_bins.binNum());
+    m_binsValid = false;
+}
+
+/*
+ * Lays the bins out again over the buffered data and counts all of it. The
+ * layout gets some room on both sides, so the data can drift a little
+ * before the next full pass.
+ */
+void HistogramLayer::rebin(int binNum, bool isLog)
+{
+    if (binNum != m_bins.binNum()) {
+        m_bins = HistoBins(binNum);
+    }
+    int min, max;
+    m_data.getMinMax(min, max);
+    m_bins.updateBins(min, max, m_data.readAll(), isLog, 0.05);
+    m_binsValid = true;
+}
+
+PlotFrame HistogramLayer::render(const PlotState &state)
+{
+    // Bins set from outside have no data to count again, they are drawn as they are
+    const bool isLog = (state.x.scale == CustomAxis::Logarithmic);
+    const int binNum = state.binNum > 0 ? state.binNum : m_bins.binNum();
+    if (!m_data.isEmpty() && (!m_binsValid || binNum != m_bins.binNum() || isLog != m_bins.isLog())) {
+        rebin(binNum, isLog);
+    }
+
+    PlotFrame frame;
+    frame.autoRange = state.autoRange && (!m_data.isEmpty() || m_bins.maxBinVal() > 0);
+    if (frame.autoRange) {
+        frame.x = AxisState::valid(m_bins.realBinStart(), m_bins.realBinEnd(), state.x.scale);
+        frame.y = AxisState::valid(0.0, m_bins.maxBinVal() * 1.1, state.y.scale);
+    } else {
+        frame.x = state.x;
+        frame.y = state.y;
+    }
+    if (state.size.isEmpty()) {
+        return frame;
+    }
+
+    frame.image = QImage(state.size, QImage::Format_ARGB32_Premultiplied);
+    frame.image.fill(Qt::transparent);
+    QPainter painter(&frame.image);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(Qt::blue);
+
+    // One bar per bin, at least a pixel wide so narrow bins stay visible
+    const qreal width = state.size.width();
+    const qreal height = state.size.height();
+    qreal left = frame.x.ratio(m_bins.realBinEdge(0)) * width;
+    for (int i = 0; i < m_bins.binNum(); i++) {
+        const qreal right = frame.x.ratio(m_bins.realBinEdge(i + 1)) * width;
+        const int binVal = m_bins.binValue(i);
+        const qreal x0 = qMax(left, 0.0);
+        const qreal x1 = qMin(qMax(right, x0 + 1.0), width);
+        left = right;
+        if (binVal == 0 || x1 <= x0) {
+            continue;
+        }
+
+        qreal yTop = (1.0 - frame.y.ratio(binVal)) * height;
+
+        if (yTop >= height) {
+            continue;
+        } else if (yTop < 0) {
+            yTop = 0;
+        }
+
+        painter.drawRect(QRectF(QPointF(x0, yTop), QPointF(x1, height)));
+    }
+    return frame;
+}
@@ -0,0 +1,41 @@
+#ifndef HISTOGRAMLAYER_H
+#define HISTOGRAMLAYER_H
+
+#include "PlotLayer.h"
+#include "ChartBuffer.h"
+#include "HistoBins.h"
+#include "MeasurementTypeHelper.h"
+
+
+/**
+ * @brief Histogram of the recent events of one channel.
+ *
+ * The bins follow the ring of recent values incrementally, counting new
+ * values in and aged ones out. They are laid out again over the ring only
+ * when the data no longer fits the layout, or the channel count or the
+ * axis scale changed. setBins() shows bins counted elsewhere instead.
+ */
+class HistogramLayer : public PlotLayer
+{
+public:
+    HistogramLayer(int channel, MeasurementType type);
+
+    void        addEvents(const QVector<EventBatchPtr> &data) override;
+    void        addValues(const QVector<int> &data);
+    void        setBins(const HistoBins &bins);
+    void        clear() override;
+    PlotFrame   render(const PlotState &state) override;
+
+private:
+    void        rebin(int binNum, bool isLog);
+
+    static constexpr int DEFAULT_DATA_LENGTH = 60000;
+
+    int                 m_channel;
+    MeasurementType     m_type;
+    ChartBuffer<int>    m_data;
+    HistoBins           m_bins;
+    bool                m_binsValid = false;    ///< m_bins counts exactly the values in m_data
+};
+
+#endif // HISTOGRAMLAYER_H
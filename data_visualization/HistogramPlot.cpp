@@ -1,10 +1,13 @@
 #include "HistogramPlot.h"
 
 #include <QPainter>
+#include <QMenu>
+#include <QActionGroup>
 #include "AddGateButtonItem.h"
+#include "HistogramLayer.h"
 
 HistogramPlot::HistogramPlot(const Plot &plot, QGraphicsItem *parent)
-    : PlotBase(plot, parent), m_data(DEFAULT_DATA_LENGTH)
+    : PlotBase(plot, parent)
 {
     m_xAxis->setRange(0, 10000);
     m_yAxis->setRange(0, 100);
@@ -15,7 +18,7 @@ HistogramPlot::HistogramPlot(const Plot &plot, QGraphicsItem *parent)
     m_xAxis->setAxisName(plot.axisXName());
     m_yAxis->setAxisName("Count");
 
-    m_bins = HistoBins(m_plotArea.width());
+    attachLayer(std::make_shared<HistogramLayer>(plot.axisXDetectorId(), plot.xMeasurementType()));
 
     // Gate button: histogram only supports interval gate
     auto *intervalBtn = new AddGateButtonItem(GateType::IntervalGate, this);
@@ -27,17 +30,15 @@ HistogramPlot::HistogramPlot(const Plot &plot, QGraphicsItem *parent)
 void HistogramPlot::updateData(const QVector<int> &data)
 {
     if (data.isEmpty()) return;
-    m_data.writeMultiple(data);
-
-    m_data.getMinMax(m_xMinVal, m_xMaxVal);
-    const bool isLog = m_xAxis->isLog();
-    m_bins.updateBins(m_xMinVal, m_xMaxVal, m_data.readAll(), isLog);
+    postEdit([data](PlotLayer &layer) { static_cast<HistogramLayer &>(layer).addValues(data); });
+    publishState(true);
+}
 
-    if (!m_axisUnlocked) {
-        m_xAxis->setRange(m_bins.realBinStart(), m_bins.realBinEnd());
-        m_yAxis->setRange(0.0, m_bins.maxBinVal() * 1.1);
-    }
-    update();
+void HistogramPlot::setBins(const HistoBins &bins)
+{
+    m_binNum = bins.binNum();
+    postEdit([bins](PlotLayer &layer) { static_cast<HistogramLayer &>(layer).setBins(bins); });
+    publishState(true);
 }
 
 
@@ -49,33 +50,8 @@ void HistogramPlot::paintPlot(QPainter *painter)
     if (!painter) return;
 
     painter->save();
-    painter->setPen(Qt::blue);
-
-
-    for (int i = 0; i < m_plotArea.width(); i++) {
-        double xVal = mapXAxisToValue(i + m_plotArea.left());
-
-        int binVal = m_bins.getBinValue(xVal);
-        if (binVal == 0) {
-            continue;
-        }
-
-        qreal yTop = mapValueToYAixs(binVal);
-
-        if (yTop >= m_plotArea.bottom()) {
-            continue;
-        } else if (yTop < m_plotArea.top()) {
-            yTop = m_plotArea.top();
-        }
-
-        qreal x = m_plotArea.left() + i;
-        painter->drawLine(
-            QPointF(x, m_plotArea.bottom()),
-            QPointF(x, yTop)
-            );
-
-    }
 
+    paintFrame(painter);
 
     // ---------- 框选 ----------
     if (m_dragMode == DragRubberBand) {
@@ -95,26 +71,46 @@ void HistogramPlot::paintPlot(QPainter *painter)
 
 void HistogramPlot::resetPlot()
 {
-    m_data.clear();
+    postEdit([](PlotLayer &layer) { layer.clear(); });
+    publishState(true);
 }
 
 void HistogramPlot::autoAdjustAxisRange()
 {
-    m_data.getMinMax(m_xMinVal, m_xMaxVal);
-    m_xAxis->setRange(m_xMinVal, m_xMaxVal);
-    m_yAxis->setRange(0, m_bins.maxBinVal() * 1.1);
-    update();
+    requestFit();
 }
 
 void HistogramPlot::changeAxisType(CustomAxis::ScaleType type)
 {
     m_xAxis->setScaleType(type);
-    if (!m_data.isEmpty()) {
-        const bool isLog = m_xAxis->isLog();
-        m_bins.updateBins(m_xMinVal, m_xMaxVal, m_data.readAll(), isLog);
-        m_xAxis->setRange(m_bins.realBinStart(), m_bins.realBinEnd());
-        m_yAxis->setRange(0.0, m_bins.maxBinVal() * 1.1);
-    }
+    requestFit();
+    emit axisTypeChanged();
+}
+
+void HistogramPlot::setBinNum(int num)
+{
+    if (num == m_binNum) return;
+    m_binNum = num;
     update();
 }
 
+PlotState HistogramPlot::plotState() const
+{
+    PlotState state = PlotBase::plotState();
+    state.binNum = m_binNum;
+    return state;
+}
+
+void HistogramPlot::addContextMenuActions(QMenu *menu)
+{
+    menu->addSeparator();
+    QMenu *binMenu = menu->addMenu(tr("Channels"));
+    QActionGroup *binGroup = new QActionGroup(binMenu);
+    for (int num : {256, 512, 1024}) {
+        QAction *action = binMenu->addAction(QString::number(num));
+        action->setCheckable(true);
+        action->setChecked(num == m_binNum);
+        binGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, num]() { setBinNum(num); });
+    }
+}
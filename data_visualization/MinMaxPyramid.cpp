@@ -0,0 +1,130 @@
+#include "MinMaxPyramid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+MinMaxPyramid::MinMaxPyramid(int capacity)
+{
+    reset(capacity);
+}
+
+void MinMaxPyramid::reset(int capacity)
+{
+    capacity = qMax(0, capacity);
+    m_samples.fill(0.0f, capacity);
+    m_min.clear();
+    m_max.clear();
+    for (int count = capacity; count > 1; ) {
+        count = (count + 1) / 2;
+        m_min.append(QVector<float>(count, 0.0f));
+        m_max.append(QVector<float>(count, 0.0f));
+    }
+    m_size = 0;
+}
+
+void MinMaxPyramid::clear()
+{
+    m_size = 0;
+}
+
+int MinMaxPyramid::write(int start, const float *values, int count, float scale)
+{
+    const int cap = capacity();
+    if (cap == 0) return 0;
+    int pos = start % cap;
+    while (count > 0) {
+        const int n = qMin(count, cap - pos);
+        float *dst = m_samples.data() + pos;
+        for (int i = 0; i < n; i++) {
+            dst[i] = values[i] * scale;
+        }
+        m_size = qMax(m_size, pos + n);
+        updateLevels(pos, pos + n);
+        values += n;
+        count -= n;
+        pos = (pos + n) % cap;
+    }
+    return pos;
+}
+
+/*
+ * Blocks past the written samples may hold stale values, range() never
+ * reads a block that is not entirely inside [0, size).
+ */
+void MinMaxPyramid::updateLevels(int from, int to)
+{
+    const float *lowerMin = m_samples.constData();
+    const float *lowerMax = m_samples.constData();
+    int lowerCount = m_samples.size();
+    for (int level = 0; level < m_min.size(); level++) {
+        from >>= 1;
+        to = ((to - 1) >> 1) + 1;
+        float *mins = m_min[level].data();
+        float *maxs = m_max[level].data();
+        for (int j = from; j < to; j++) {
+            const int a = 2 * j;
+            const int b = qMin(a + 1, lowerCount - 1);
+            mins[j] = std::min(lowerMin[a], lowerMin[b]);
+            maxs[j] = std::max(lowerMax[a], lowerMax[b]);
+        }
+        lowerMin = mins;
+        lowerMax = maxs;
+        lowerCount = m_min[level].size();
+    }
+}
+
+void MinMaxPyramid::range(int from, int to, float &min, float &max) const
+{
+    min = std::numeric_limits<float>::max();
+    max = std::numeric_limits<float>::lowest();
+    from = qMax(0, from);
+    to = qMin(m_size, to);
+
+    // Bottom up, the unaligned block at either end is taken and the rest moves a level up
+    for (int level = 0; from < to; level++) {
+        const float *mins = level == 0 ? m_samples.constData() : m_min.at(level - 1).constData();
+        const float *maxs = level == 0 ? m_samples.constData() : m_max.at(level - 1).constData();
+        if (from & 1) {
+            min = std::min(min, mins[from]);
+            max = std::max(max, maxs[from]);
+            from++;
+        }
+        if (to & 1) {
+            to--;
+            min = std::min(min, mins[to]);
+            max = std::max(max, maxs[to]);
+        }
+        from >>= 1;
+        to >>= 1;
+    }
+}
+
+void MinMaxPyramid::decimate(double xMin, double xMax, int columns, QVector<QPointF> &points) const
+{
+    points.clear();
+    const int from = qMax(0, static_cast<int>(std::floor(xMin)));
+    const int to = qMin(m_size, static_cast<int>(std::ceil(xMax)) + 1);
+    if (from >= to || columns <= 0) return;
+
+    const double perColumn = (xMax - xMin) / columns;
+    if (perColumn <= 2.0) {
+        points.reserve(to - from);
+        for (int i = from; i < to; i++) {
+            points.append(QPointF(i, m_samples.at(i)));
+        }
+        return;
+    }
+
+    points.reserve(2 * columns);
+    for (int c = 0; c < columns; c++) {
+        const int a = qMax(from, static_cast<int>(std::floor(xMin + c * perColumn)));
+        const int b = qMin(to, static_cast<int>(std::floor(xMin + (c + 1) * perColumn)));
+        if (a >= b) continue;
+        float min, max;
+        range(a, b, min, max);
+        const qreal x = (a + b - 1) / 2.0;
+        points.append(QPointF(x, min));
+        points.append(QPointF(x, max));
+    }
+}
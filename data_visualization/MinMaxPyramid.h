@@ -0,0 +1,53 @@
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include <QPointF>
+#include <QVector>
+
+
+/**
+ * @brief A ring of samples with the min and max of every aligned block of 2^k samples.
+ *
+ * The samples keep their position in the ring, a sweep overwrites them in
+ * place. Level k holds the min and max of the blocks of 2^k samples, a
+ * write updates the blocks above the written samples only. range() takes
+ * the extremes of any run of samples from O(log n) blocks, so decimate()
+ * reduces a view of the ring to one min/max pair per pixel column in
+ * O(columns log n), however many samples the view spans.
+ */
+class MinMaxPyramid
+{
+public:
+    explicit MinMaxPyramid(int capacity = 0);
+
+    void    reset(int capacity);
+    void    clear();
+    int     capacity() const { return m_samples.size(); }
+    int     size() const { return m_size; }             ///< Positions [0, size) hold samples
+    float   sample(int index) const { return m_samples.at(index); }
+
+    /*
+     * Writes count values times scale from position start on, wrapping at
+     * the capacity. Returns the position after the last one written.
+     */
+    int     write(int start, const float *values, int count, float scale = 1.0f);
+
+    void    range(int from, int to, float &min, float &max) const;
+
+    /*
+     * Points to draw positions [xMin, xMax] across columns pixels: the
+     * samples themselves while there are at most two per column, else a
+     * min and a max per column, at the middle of its samples.
+     */
+    void    decimate(double xMin, double xMax, int columns, QVector<QPointF> &points) const;
+
+private:
+    void    updateLevels(int from, int to);
+
+    QVector<float>          m_samples;
+    QVector<QVector<float>> m_min;      ///< Level k + 1, block j covers samples [j << (k + 1), (j + 1) << (k + 1))
+    QVector<QVector<float>> m_max;
+    int                     m_size = 0;
+};
+
+#endif // MINMAXPYRAMID_H
@@ -9,12 +9,15 @@
 #include <QImage>
 #include <QApplication>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <cmath>
 
 
 #include <QGraphicsSceneWheelEvent>
 
 #include "GateItem.h"
 #include "WorkSheetScene.h"
+#include "PlotRenderPool.h"
 
 #include "AxisLockButtonItem.h"
 #include "SaveImageButtonItem.h"
@@ -62,6 +65,15 @@ PlotBase::PlotBase(const Plot &plot, QGraphicsItem *parent)
     setAcceptHoverEvents(true);
 
     updateLayout();
+
+    connect(&PlotRenderPool::instance(), &PlotRenderPool::frameReady, this, &PlotBase::onFrameReady);
+}
+
+PlotBase::~PlotBase()
+{
+    if (m_layerKey) {
+        PlotRenderPool::instance().removeLayer(m_layerKey);
+    }
 }
 
 void PlotBase::setBoundingRect(const QRectF &rect)
@@ -315,6 +327,8 @@ void PlotBase::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
         });
     }
 
+    addContextMenuActions(&menu);
+
     QAction *selectedAction = menu.exec(event->screenPos());
 
     event->accept();
@@ -508,6 +522,8 @@ void PlotBase::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
     if (!painter) {
         return;
     }
+    QElapsedTimer paintTimer;
+    paintTimer.start();
 
     painter->save();
     painter->setRenderHint(QPainter::Antialiasing);
@@ -520,11 +536,14 @@ void PlotBase::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
     painter->drawRect(m_boundingRect);
     painter->restore();
 
+    publishState();
+
     paintTitle(painter);
     paintAxis(painter);
     paintPlot(painter);
 
     drawCursorValue(painter);
+    m_paintNs = paintTimer.nsecsElapsed();
 }
 
 void PlotBase::drawCursorValue(QPainter *painter)
@@ -786,3 +805,135 @@ void PlotBase::zoomAxis(CustomAxis *axis, double center, double factor)
 //     return false;
 // }
 
+void PlotBase::addEvents(const QVector<EventBatchPtr> &data)
+{
+    if (data.isEmpty()) return;
+    postEdit([data](PlotLayer &layer) { layer.addEvents(data); });
+    if (m_paced) {
+        m_dataPending = true;
+    } else {
+        publishState(true);
+    }
+}
+
+void PlotBase::setPaced(bool paced)
+{
+    if (m_paced == paced) return;
+    m_paced = paced;
+    if (!paced) {
+        if (m_dataPending) requestFrame();
+        if (m_frameNew) presentFrame();
+    }
+}
+
+void PlotBase::requestFrame()
+{
+    m_dataPending = false;
+    publishState(true);
+}
+
+void PlotBase::presentFrame()
+{
+    m_frameNew = false;
+    update();
+}
+
+void PlotBase::attachLayer(const std::shared_ptr<PlotLayer> &layer)
+{
+    m_layerKey = PlotRenderPool::instance().addLayer(layer);
+}
+
+void PlotBase::postEdit(const std::function<void(PlotLayer &)> &edit)
+{
+    PlotRenderPool::instance().edit(m_layerKey, edit);
+}
+
+/*
+ * What the layer needs to draw the plot as it is now. Unlocked axes keep
+ * their range, unless a fit is pending.
+ */
+PlotState PlotBase::plotState() const
+{
+    PlotState state;
+    state.size = QSize(static_cast<int>(std::ceil(m_plotArea.width())), static_cast<int>(std::ceil(m_plotArea.height())));
+    state.x = AxisState::of(m_xAxis);
+    state.y = AxisState::of(m_yAxis);
+    state.autoRange = !m_axisUnlocked || m_fitPending;
+    return state;
+}
+
+/*
+ * Asks the layer for a frame when the plot state changed since the last
+ * one, or always when forced, e.g. after new data.
+ */
+void PlotBase::publishState(bool force)
+{
+    const PlotState state = plotState();
+    if (!force && m_statePublished && state == m_publishedState) {
+        return;
+    }
+    m_publishedState = state;
+    m_statePublished = true;
+    PlotRenderPool::instance().render(m_layerKey, state);
+}
+
+void PlotBase::requestFit()
+{
+    m_fitPending = true;
+    update();
+}
+
+void PlotBase::onFrameReady(quint64 key)
+{
+    if (key != m_layerKey) return;
+    PlotFrame frame;
+    if (!PlotRenderPool::instance().takeFrame(key, frame)) return;
+
+    // Fitted axes are taken over, unless the user unlocked them or switched the scale meanwhile
+    if (frame.autoRange && (!m_axisUnlocked || m_fitPending)
+        && frame.x.scale == m_xAxis->scaleType() && frame.y.scale == m_yAxis->scaleType()) {
+        m_xAxis->setRange(frame.x.min, frame.x.max);
+        m_yAxis->setRange(frame.y.min, frame.y.max);
+        m_fitPending = false;
+    }
+    m_frame = frame;
+    frameReceived(m_frame);
+    if (m_paced) {
+        m_frameNew = true;
+    } else {
+        update();
+    }
+}
+
+/*
+ * Maps [0, width] x [0, height] drawn over the axes x and y, row 0 at the
+ * top, into the plot area at the current axes. An older frame is shifted
+ * and stretched into place until the next one arrives.
+ */
+QTransform PlotBase::frameTransform(const AxisState &x, const AxisState &y, const QSizeF &size) const
+{
+    const AxisState currentX = AxisState::of(m_xAxis);
+    const AxisState currentY = AxisState::of(m_yAxis);
+    const double spanX = currentX.position(currentX.max) - currentX.position(currentX.min);
+    const double spanY = currentY.position(currentY.max) - currentY.position(currentY.min);
+    const double ax = (x.position(x.min) - currentX.position(currentX.min)) / spanX;
+    const double bx = (x.position(x.max) - x.position(x.min)) / spanX;
+    const double ay = (y.position(y.min) - currentY.position(currentY.min)) / spanY;
+    const double by = (y.position(y.max) - y.position(y.min)) / spanY;
+    const qreal width = m_plotArea.width();
+    const qreal height = m_plotArea.height();
+    return QTransform(width * bx / size.width(), 0, 0, height * by / size.height(),
+                      m_plotArea.left() + width * ax, m_plotArea.bottom() - height * (ay + by));
+}
+
+void PlotBase::paintFrame(QPainter *painter)
+{
+    if (m_frame.image.isNull() || m_frame.x.scale != m_xAxis->scaleType() || m_frame.y.scale != m_yAxis->scaleType()) {
+        return;
+    }
+    painter->save();
+    painter->setClipRect(m_plotArea);
+    painter->setTransform(frameTransform(m_frame.x, m_frame.y, m_frame.image.size()), true);
+    painter->drawImage(QPointF(0, 0), m_frame.image);
+    painter->restore();
+}
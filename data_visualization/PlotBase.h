@@ -2,16 +2,23 @@
 #define PLOTBASE_H
 
 #include <QGraphicsObject>
+#include <QTransform>
+#include <functional>
+#include <memory>
 #include "CustomAxis.h"
 #include "Plot.h"
 #include "Gate.h"
+#include "PlotLayer.h"
 // #include "AxisLockButtonItem.h"
 
+class QMenu;
+
 class PlotBase : public QGraphicsObject
 {
     Q_OBJECT
 public:
     explicit PlotBase(const Plot &plot, QGraphicsItem *parent = nullptr);
+    ~PlotBase() override;
 
     void setBoundingRect(const QRectF &rect);
     void setTitle(const QString &title);
@@ -72,8 +79,25 @@ public:
 
     void saveToImage();
 
+    /**
+     * @brief Hands new events to the plot's layer and asks for a frame with them.
+     */
+    void addEvents(const QVector<EventBatchPtr> &data);
+
+    /**
+     * @brief Leaves frame requests after new data, and repaints after new frames, to a FrameScheduler.
+     */
+    void setPaced(bool paced);
+    bool hasPendingData() const { return m_dataPending; }
+    void requestFrame();
+    bool hasNewFrame() const { return m_frameNew; }
+    void presentFrame();
+    qint64 paintCost() const { return m_paintNs; }          ///< Of the last paint()
+    qint64 renderCost() const { return m_frame.renderNs; }   ///< Of the last frame
+
 signals:
     void deleteRequested(PlotBase *plot);
+    void axisTypeChanged();         ///< Gates on the plot are tested on the new scale
 
 protected:
 
@@ -93,8 +117,20 @@ protected:
     void paintTitle(QPainter *painter);;
     void paintAxis(QPainter *painter);
     void contextMenuEvent(QGraphicsSceneContextMenuEvent *event) override;
+    virtual void addContextMenuActions(QMenu *menu) { Q_UNUSED(menu); }
 
     virtual void paintPlot(QPainter *painter) = 0;
+
+    // The layer drawing the plot on the render workers, attached once by the constructor
+    void attachLayer(const std::shared_ptr<PlotLayer> &layer);
+    void postEdit(const std::function<void(PlotLayer &)> &edit);
+    virtual PlotState plotState() const;
+    void publishState(bool force = false);
+    void requestFit();
+    virtual void frameReceived(const PlotFrame &frame) { Q_UNUSED(frame); }
+    QTransform frameTransform(const AxisState &x, const AxisState &y, const QSizeF &size) const;
+    void paintFrame(QPainter *painter);
+
     QRectF boundingRect() const override;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
@@ -123,8 +159,23 @@ protected:
     bool    m_showCursorValue = false;
     QPointF m_cursorValue;
 
+    PlotFrame   m_frame;                ///< Latest frame from the layer
+
     static constexpr qreal PLOT_MARGIN = 10.0;
     static constexpr qreal TITLE_MARGIN = 10.0;
+
+private slots:
+    void onFrameReady(quint64 key);
+
+private:
+    quint64     m_layerKey = 0;
+    PlotState   m_publishedState;       ///< Last state sent to the layer
+    bool        m_statePublished = false;
+    bool        m_fitPending = false;   ///< Fit unlocked axes to the data with the next frame
+    bool        m_paced = false;
+    bool        m_dataPending = false;  ///< Paced, the layer got data no frame was asked for yet
+    bool        m_frameNew = false;     ///< Paced, a frame arrived that was not repainted yet
+    qint64      m_paintNs = 0;
 };
 
 
@@ -0,0 +1,29 @@
+#include "PlotLayer.h"
+
+
+AxisState AxisState::of(const CustomAxis *axis)
+{
+    AxisState state;
+    state.min = axis->minValue();
+    state.max = axis->maxValue();
+    state.scale = axis->scaleType();
+    return state;
+}
+
+/*
+ * A range the axis can map, a log axis starts above zero like CustomAxis does.
+ */
+AxisState AxisState::valid(double min, double max, CustomAxis::ScaleType scale)
+{
+    AxisState state;
+    state.scale = scale;
+    if (scale == CustomAxis::Logarithmic) {
+        min = qMax(min, 1e-1);
+        if (max <= min) max = min * 10;
+    } else if (max <= min) {
+        max = min + 10;
+    }
+    state.min = min;
+    state.max = max;
+    return state;
+}
@@ -0,0 +1,94 @@
+#ifndef PLOTLAYER_H
+#define PLOTLAYER_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+#include <cmath>
+#include "CustomAxis.h"
+#include "DensityGrid.h"
+#include "EventBatchPool.h"
+#include "EventKernels.h"
+
+
+/**
+ * @brief Range and scale of one axis, mapped the way CustomAxis maps it.
+ */
+struct AxisState
+{
+    double                  min = 0;
+    double                  max = 10;
+    CustomAxis::ScaleType   scale = CustomAxis::Linear;
+
+    static AxisState of(const CustomAxis *axis);
+    static AxisState valid(double min, double max, CustomAxis::ScaleType scale);
+
+    // Position along the axis, linear in the plot area: the value or its log10
+    double  position(double value) const { return scale == CustomAxis::Logarithmic ? std::log10(value) : value; }
+    double  ratio(double value) const { return (position(value) - position(min)) / (position(max) - position(min)); }
+
+    bool operator==(const AxisState &other) const {
+        return min == other.min && max == other.max && scale == other.scale;
+    }
+    bool operator!=(const AxisState &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief What a plot shows, published by the plot for the render workers.
+ */
+struct PlotState
+{
+    QSize       size;                   ///< Plot area, in pixels
+    AxisState   x;
+    AxisState   y;
+    bool        autoRange = true;       ///< The layer fits the axes to its data, x and y are unused
+    int         binNum = 0;             ///< Histogram channels
+    bool        densityMode = true;     ///< Scatter events as a density raster, else as points
+    DensityGrid::ColorMap colorMap = DensityGrid::Viridis;
+    QSize       gridSize;               ///< Density grid cells, empty for one per pixel
+    bool        countsOnly = false;     ///< The frame carries the grid counts instead of an image
+
+    bool operator==(const PlotState &other) const {
+        return size == other.size && autoRange == other.autoRange
+               && (autoRange || (x == other.x && y == other.y))
+               && x.scale == other.x.scale && y.scale == other.y.scale && binNum == other.binNum
+               && densityMode == other.densityMode && colorMap == other.colorMap
+               && gridSize == other.gridSize && countsOnly == other.countsOnly;
+    }
+    bool operator!=(const PlotState &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief A plot layer drawn by a render worker.
+ */
+struct PlotFrame
+{
+    QImage              image;          ///< Plot area sized, over the x and y ranges below
+    AxisState           x;              ///< Axes the frame was drawn with
+    AxisState           y;
+    bool                autoRange = false;  ///< x and y were fitted to the data
+    QSize               gridSize;       ///< Of counts
+    QVector<quint32>    counts;         ///< Density grid, row major, when the state asked for counts only
+    qint64              renderNs = 0;   ///< Time the layer took to draw it
+};
+
+
+/**
+ * @brief Data of one plot and how it is drawn, owned by the render workers.
+ *
+ * A layer keeps the events of its plot and whatever is counted from them.
+ * PlotRenderPool calls it from one worker thread at a time, events are
+ * projected and counted as they arrive, render() draws the counts for a
+ * published plot state.
+ */
+class PlotLayer
+{
+public:
+    virtual ~PlotLayer() = default;
+
+    virtual void        addEvents(const QVector<EventBatchPtr> &data) = 0;
+    virtual void        clear() = 0;
+    virtual PlotFrame   render(const PlotState &state) = 0;
+};
+
+#endif // PLOTLAYER_H
@@ -0,0 +1,125 @@
+#include "PlotRenderPool.h"
+#include <QThread>
+#include <QElapsedTimer>
+
+
+PlotRenderPool::PlotRenderPool(QObject *parent)
+    : QObject{parent}
+{
+    // Leave a core to the GUI and the UDP receive threads
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 2));
+    m_pool.setObjectName("PlotRenderPool");
+}
+
+PlotRenderPool::~PlotRenderPool()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_entries.clear();
+    }
+    m_pool.waitForDone();
+}
+
+quint64 PlotRenderPool::addLayer(const std::shared_ptr<PlotLayer> &layer)
+{
+    QMutexLocker locker(&m_mutex);
+    const quint64 key = m_nextKey++;
+    m_entries[key].layer = layer;
+    return key;
+}
+
+/*
+ * A worker still running the layer finishes with its own reference and drops the frame.
+ */
+void PlotRenderPool::removeLayer(quint64 key)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(key);
+}
+
+void PlotRenderPool::edit(quint64 key, const Edit &edit)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return;
+    it->edits.append(edit);
+    scheduleLocked(key, *it);
+}
+
+void PlotRenderPool::render(quint64 key, const PlotState &state)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) return;
+    it->state = state;
+    it->stateDirty = true;
+    scheduleLocked(key, *it);
+}
+
+bool PlotRenderPool::takeFrame(quint64 key, PlotFrame &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || !it->frameReady) return false;
+    frame = std::move(it->frame);
+    it->frame = PlotFrame();
+    it->frameReady = false;
+    return true;
+}
+
+void PlotRenderPool::scheduleLocked(quint64 key, Entry &entry)
+{
+    if (entry.running) return;
+    entry.running = true;
+    m_pool.start([this, key]() { run(key); });
+}
+
+/*
+ * Works off what was posted for the layer, including what arrives meanwhile,
+ * then gives the layer up.
+ */
+void PlotRenderPool::run(quint64 key)
+{
+    forever {
+        std::shared_ptr<PlotLayer> layer;
+        QVector<Edit> edits;
+        PlotState state;
+        bool renderState = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) return;
+            if (it->edits.isEmpty() && !it->stateDirty) {
+                it->running = false;
+                return;
+            }
+            layer = it->layer;
+            edits.swap(it->edits);
+            state = it->state;
+            renderState = it->stateDirty;
+            it->stateDirty = false;
+        }
+
+        for (const Edit &edit : std::as_const(edits)) {
+            edit(*layer);
+        }
+        if (!renderState) continue;
+        QElapsedTimer timer;
+        timer.start();
+        PlotFrame frame = layer->render(state);
+        frame.renderNs = timer.nsecsElapsed();
+
+        bool notify = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) return;
+            notify = !it->frameReady;
+            it->frame = std::move(frame);
+            it->frameReady = true;
+        }
+        if (notify) {
+            emit frameReady(key);
+        }
+    }
+}
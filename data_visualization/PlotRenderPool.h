@@ -0,0 +1,69 @@
+#ifndef PLOTRENDERPOOL_H
+#define PLOTRENDERPOOL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QHash>
+#include <functional>
+#include <memory>
+#include "PlotLayer.h"
+
+
+/**
+ * @brief Runs the plot layers on worker threads and hands their frames to the plots.
+ *
+ * Every plot adds its layer and gets a key for it. Edits, like the events
+ * of an update, run on the layer in the order they were posted, and a
+ * render() asks for a frame of the published plot state. A layer is run
+ * by one worker at a time; a state published while it is busy replaces
+ * the one still waiting, so a slow layer skips the intermediate states
+ * rather than queueing them. Only the latest finished frame of a layer is
+ * kept, frameReady() tells its plot to take it, at most once until taken.
+ */
+class PlotRenderPool : public QObject
+{
+    Q_OBJECT
+public:
+    static PlotRenderPool &instance() {
+        static PlotRenderPool instance;
+        return instance;
+    }
+    PlotRenderPool &operator=(const PlotRenderPool &) = delete;
+    PlotRenderPool(const PlotRenderPool &) = delete;
+    ~PlotRenderPool() override;
+
+    using Edit = std::function<void(PlotLayer &)>;
+
+    quint64 addLayer(const std::shared_ptr<PlotLayer> &layer);
+    void    removeLayer(quint64 key);
+    void    edit(quint64 key, const Edit &edit);
+    void    render(quint64 key, const PlotState &state);
+    bool    takeFrame(quint64 key, PlotFrame &frame);
+
+signals:
+    void    frameReady(quint64 key);
+
+private:
+    explicit PlotRenderPool(QObject *parent = nullptr);
+
+    struct Entry {
+        std::shared_ptr<PlotLayer>  layer;
+        QVector<Edit>   edits;              ///< In posting order
+        PlotState       state;
+        bool            stateDirty = false; ///< state waits for a render
+        bool            running = false;    ///< A worker has the layer
+        PlotFrame       frame;              ///< Latest finished, not taken yet
+        bool            frameReady = false;
+    };
+
+    void    scheduleLocked(quint64 key, Entry &entry);
+    void    run(quint64 key);
+
+    QThreadPool             m_pool;
+    QMutex                  m_mutex;
+    QHash<quint64, Entry>   m_entries;      ///< Guarded by m_mutex
+    quint64                 m_nextKey = 1;  ///< Guarded by m_mutex
+};
+
+#endif // PLOTRENDERPOOL_H
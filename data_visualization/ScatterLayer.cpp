@@ -0,0 +1,158 @@
+#include "ScatterLayer.h"
+#include <QPainter>
+#include <cmath>
+
+
+ScatterLayer::ScatterLayer(int channelX, MeasurementType typeX, int channelY, MeasurementType typeY)
+    : m_channelX(channelX), m_typeX(typeX), m_channelY(channelY), m_typeY(typeY), m_data(DEFAULT_DATA_LENGTH)
+{
+}
+
+void ScatterLayer::addEvents(const QVector<EventBatchPtr> &data)
+{
+    const quint8 validMask = EventBatch::channelBit(m_channelX) | EventBatch::channelBit(m_channelY);
+
+    int eventNum = 0;
+    for (const EventBatchPtr &batch : data) {
+        eventNum += batch->size();
+    }
+    QVector<QPoint> points(eventNum);
+    int count = 0;
+    for (const EventBatchPtr &batch : data) {
+        const qint32 *xData = batch->column(m_channelX, m_typeX);
+        const qint32 *yData = batch->column(m_channelY, m_typeY);
+        if (!xData || !yData) continue;
+        count += EventKernels::project2D(xData, yData, batch->chPulseValid(), validMask, batch->size(), points.data() + count);
+    }
+    points.resize(count);
+    addPoints(points);
+}
+
+void ScatterLayer::addPoints(const QVector<QPoint> &data)
+{
+    if (data.isEmpty()) return;
+    QVector<QPoint> aged;
+    m_data.writeMultiple(data, m_densityValid ? &aged : nullptr);
+
+    // Count the new events into the grid and take out the aged ones, render() checks the mapping
+    if (m_densityValid) {
+        int x, y;
+        for (const QPoint &point : data) {
+            if (densityCell(point, x, y)) m_density.add(x, y);
+        }
+        for (const QPoint &point : aged) {
+            if (densityCell(point, x, y)) m_density.remove(x, y);
+        }
+    }
+}
+
+void ScatterLayer::clear()
+{
+    m_data.clear();
+    m_density.clear();
+    m_fitValid = false;
+}
+
+PlotFrame ScatterLayer::render(const PlotState &state)
+{
+    PlotFrame frame;
+    QPoint bottomLeft, topRight;
+    frame.autoRange = state.autoRange && m_data.getMinMax(bottomLeft, topRight);
+    if (frame.autoRange) {
+        frame.x = fitAxis(bottomLeft.x(), topRight.x(), state.x.scale, m_fitX);
+        frame.y = fitAxis(bottomLeft.y(), topRight.y(), state.y.scale, m_fitY);
+        m_fitX = frame.x;
+        m_fitY = frame.y;
+        m_fitValid = true;
+    } else {
+        frame.x = state.x;
+        frame.y = state.y;
+    }
+    if (state.size.isEmpty()) {
+        return frame;
+    }
+
+    if (!state.densityMode && !state.countsOnly) {
+        m_densityValid = false;
+        frame.image = paintPoints(state.size, frame.x, frame.y);
+        return frame;
+    }
+
+    DensityMapping mapping;
+    mapping.gridSize = state.gridSize.isEmpty() ? state.size : state.gridSize;
+    mapping.x = frame.x;
+    mapping.y = frame.y;
+    if (!m_densityValid || mapping != m_densityMapping) {
+        rebuildDensity(mapping);
+    }
+    if (state.countsOnly) {
+        frame.gridSize = m_density.size();
+        frame.counts = m_density.counts();
+    } else {
+        frame.image = m_density.image(state.colorMap);
+    }
+    return frame;
+}
+
+/*
+ * The last fit stays while it holds the padded data and is at most twice
+ * its span (in axis positions), a new fit leaves REFIT_PADDING of room.
+ */
+AxisState ScatterLayer::fitAxis(double low, double high, CustomAxis::ScaleType scale, const AxisState &last) const
+{
+    const double span = high - low;
+    const AxisState fit = AxisState::valid(low - span * FIT_PADDING, high + span * FIT_PADDING, scale);
+    if (m_fitValid && last.scale == scale && last.min <= fit.min && last.max >= fit.max
+        && 2 * (fit.position(fit.max) - fit.position(fit.min)) >= last.position(last.max) - last.position(last.min)) {
+        return last;
+    }
+    return AxisState::valid(low - span * REFIT_PADDING, high + span * REFIT_PADDING, scale);
+}
+
+bool ScatterLayer::densityCell(const QPoint &point, int &x, int &y) const
+{
+    if ((m_densityMapping.x.scale == CustomAxis::Logarithmic && point.x() <= 0)
+        || (m_densityMapping.y.scale == CustomAxis::Logarithmic && point.y() <= 0)) {
+        return false;
+    }
+    x = static_cast<int>(std::floor(m_densityMapping.x.ratio(point.x()) * m_densityMapping.gridSize.width()));
+    y = static_cast<int>(std::floor((1.0 - m_densityMapping.y.ratio(point.y())) * m_densityMapping.gridSize.height()));
+    return true;
+}
+
+void ScatterLayer::rebuildDensity(const DensityMapping &mapping)
+{
+    m_densityMapping = mapping;
+    m_density.reset(mapping.gridSize);
+    int x, y;
+    for (const QPoint &point : m_data.readAll()) {
+        if (densityCell(point, x, y)) m_density.add(x, y);
+    }
+    m_densityValid = true;
+}
+
+QImage ScatterLayer::paintPoints(const QSize &size, const AxisState &xAxis, const AxisState &yAxis)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(Qt::blue);
+
+    const bool xLog = (xAxis.scale == CustomAxis::Logarithmic);
+    const bool yLog = (yAxis.scale == CustomAxis::Logarithmic);
+    const QRectF area(QPointF(0, 0), QSizeF(size));
+
+    for (const QPoint &point : m_data.readAll()) {
+        if ((xLog && point.x() <= 0) ||
+            (yLog && point.y() <= 0))
+            continue;
+
+        const QPointF pDraw(xAxis.ratio(point.x()) * size.width(), (1.0 - yAxis.ratio(point.y())) * size.height());
+        if (!area.contains(pDraw)) {
+            continue;
+        }
+        painter.drawPoint(pDraw);
+    }
+    return image;
+}
@@ -0,0 +1,84 @@
+#ifndef SCATTERLAYER_H
+#define SCATTERLAYER_H
+
+#include <QPoint>
+#include "PlotLayer.h"
+#include "ChartBuffer.h"
+#include "MeasurementTypeHelper.h"
+
+struct PointMinMax {
+    QPoint min(const QPoint& a, const QPoint& b) const {
+        QPoint p;
+        p.setX(a.x() > b.x() ? b.x() : a.x());
+        p.setY(a.y() > b.y() ? b.y() : a.y());
+        return p;
+    }
+
+    QPoint max(const QPoint& a, const QPoint& b) const {
+        QPoint p;
+        p.setX(a.x() < b.x() ? b.x() : a.x());
+        p.setY(a.y() < b.y() ? b.y() : a.y());
+        return p;
+    }
+
+    bool equal(const QPoint &a, const QPoint &b) const {
+        return (a.x() == b.x()) || (a.y() == b.y());
+    }
+};
+
+
+/**
+ * @brief Recent events on two channels, as a density raster, points or grid counts.
+ *
+ * The density grid follows the ring of recent events incrementally while
+ * the mapping of events to cells stays the same, and is counted again over
+ * the ring when the axes, the plot size or the grid size change. A fitted
+ * range is kept while it still holds the data and is at most twice as wide,
+ * so auto range does not recount the grid on every frame.
+ */
+class ScatterLayer : public PlotLayer
+{
+public:
+    ScatterLayer(int channelX, MeasurementType typeX, int channelY, MeasurementType typeY);
+
+    void        addEvents(const QVector<EventBatchPtr> &data) override;
+    void        addPoints(const QVector<QPoint> &data);
+    void        clear() override;
+    PlotFrame   render(const PlotState &state) override;
+
+private:
+    // What places an event on a cell of the density grid
+    struct DensityMapping {
+        QSize       gridSize;
+        AxisState   x;
+        AxisState   y;
+
+        bool operator==(const DensityMapping &other) const {
+            return gridSize == other.gridSize && x == other.x && y == other.y;
+        }
+        bool operator!=(const DensityMapping &other) const { return !(*this == other); }
+    };
+
+    bool        densityCell(const QPoint &point, int &x, int &y) const;
+    void        rebuildDensity(const DensityMapping &mapping);
+    QImage      paintPoints(const QSize &size, const AxisState &xAxis, const AxisState &yAxis);
+    AxisState   fitAxis(double low, double high, CustomAxis::ScaleType scale, const AxisState &last) const;
+
+    static constexpr int DEFAULT_DATA_LENGTH = 60000;
+    static constexpr double FIT_PADDING = 0.05;         ///< Of the data span, on each side
+    static constexpr double REFIT_PADDING = 0.15;       ///< Room a new fit leaves for the data to grow
+
+    int                 m_channelX;
+    MeasurementType     m_typeX;
+    int                 m_channelY;
+    MeasurementType     m_typeY;
+    ChartBuffer<QPoint, PointMinMax>    m_data;
+    DensityGrid         m_density;          ///< Counts of the events in m_data
+    DensityMapping      m_densityMapping;   ///< Mapping m_density was counted with
+    bool                m_densityValid = false;
+    AxisState           m_fitX;             ///< Last fitted ranges
+    AxisState           m_fitY;
+    bool                m_fitValid = false;
+};
+
+#endif // SCATTERLAYER_H
@@ -1,9 +1,12 @@
 #include "ScatterPlot.h"
 #include <QMarginsF>
 #include "AddGateButtonItem.h"
+#include <QMenu>
+#include <QActionGroup>
+#include "ScatterLayer.h"
 
 ScatterPlot::ScatterPlot(const Plot &plot, QGraphicsItem *parent)
-    : PlotBase(plot, parent), m_data(DEFAULT_DATA_LENGTH)
+    : PlotBase(plot, parent)
 {
     m_xAxis->setRange(0, 10000);
     m_yAxis->setRange(0, 10000);
@@ -14,6 +17,9 @@ ScatterPlot::ScatterPlot(const Plot &plot, QGraphicsItem *parent)
     m_xAxis->setAxisName(plot.axisXName());
     m_yAxis->setAxisName(plot.axisYName());
 
+    attachLayer(std::make_shared<ScatterLayer>(plot.axisXDetectorId(), plot.xMeasurementType(),
+                                               plot.axisYDetectorId(), plot.yMeasurementType()));
+
     // Gate buttons: scatter plot supports rectangle, polygon, ellipse, quadrant gates
     qreal btnX = m_boundingRect.left() + 10;
     qreal btnY = m_boundingRect.top() + 5;
@@ -36,24 +42,17 @@ ScatterPlot::ScatterPlot(const Plot &plot, QGraphicsItem *parent)
 void ScatterPlot::updateData(const QVector<QPoint> &data)
 {
     if (data.isEmpty()) return;
-    m_data.writeMultiple(data);
-
-    if (!m_axisUnlocked) {
-        QPoint bottomLeft, topRight;
-        if (m_data.getMinMax(bottomLeft, topRight)) {
-            qreal dataXMin = bottomLeft.x();
-            qreal dataXMax = topRight.x();
-            qreal dataYMin = bottomLeft.y();
-            qreal dataYMax = topRight.y();
-
-            qreal xPadding = (dataXMax - dataXMin) * 0.05;
-            qreal yPadding = (dataYMax - dataYMin) * 0.05;
-            m_xAxis->setRange(dataXMin - xPadding, dataXMax + xPadding);
-            m_yAxis->setRange(dataYMin - yPadding, dataYMax + yPadding);
-        }
-    }
+    postEdit([data](PlotLayer &layer) { static_cast<ScatterLayer &>(layer).addPoints(data); });
+    publishState(true);
+}
 
-    update();
+void ScatterPlot::setData(const QVector<QPoint> &data)
+{
+    postEdit([data](PlotLayer &layer) {
+        layer.clear();
+        static_cast<ScatterLayer &>(layer).addPoints(data);
+    });
+    publishState(true);
 }
 
 
@@ -62,26 +61,15 @@ void ScatterPlot::paintPlot(QPainter *painter)
     if (!painter) return;
 
     painter->save();
-    painter->setRenderHint(QPainter::Antialiasing, true);
-    painter->setPen(Qt::blue);
-
-    const bool xLog = (m_xAxis->scaleType() == CustomAxis::Logarithmic);
-    const bool yLog = (m_yAxis->scaleType() == CustomAxis::Logarithmic);
-
-    for (const QPoint &point : m_data.readAll()) {
-
-        if ((xLog && point.x() <= 0) ||
-            (yLog && point.y() <= 0))
-            continue;
+    paintFrame(painter);
 
+    paintRubberBand(painter);
 
-        QPointF pDraw = mapPointToPlotArea(point);
-        if (!m_plotArea.contains(pDraw)) {
-            continue;
-        }
-        painter->drawPoint(mapPointToPlotArea(point));
-    }
+    painter->restore();
+}
 
+void ScatterPlot::paintRubberBand(QPainter *painter)
+{
     if (m_dragMode == DragRubberBand) {
         QRectF rect(m_rubberStartPos, m_rubberEndPos);
         rect = rect.normalized();
@@ -93,21 +81,17 @@ void ScatterPlot::paintPlot(QPainter *painter)
 
         painter->drawRect(rect);
     }
-
-    painter->restore();
 }
 
 void ScatterPlot::resetPlot()
 {
-    m_data.clear();
+    postEdit([](PlotLayer &layer) { layer.clear(); });
+    publishState(true);
 }
 
 void ScatterPlot::autoAdjustAxisRange()
 {
-    QPoint topRight, bottomLeft;
-    m_data.getMinMax(bottomLeft, topRight);
-    m_xAxis->setRange(bottomLeft.x(), topRight.x());
-    m_yAxis->setRange(bottomLeft.y(), topRight.y());
+    requestFit();
 }
 
 void ScatterPlot::changeAxisType(CustomAxis::ScaleType type)
@@ -115,5 +99,52 @@ void ScatterPlot::changeAxisType(CustomAxis::ScaleType type)
     m_xAxis->setScaleType(type);
     m_yAxis->setScaleType(type);
     update();
+    emit axisTypeChanged();
 }
 
+void ScatterPlot::setDensityMode(bool density)
+{
+    if (m_densityMode == density) return;
+    m_densityMode = density;
+    update();
+}
+
+void ScatterPlot::setColorMap(DensityGrid::ColorMap colorMap)
+{
+    m_colorMap = colorMap;
+    update();
+}
+
+PlotState ScatterPlot::plotState() const
+{
+    PlotState state = PlotBase::plotState();
+    state.densityMode = m_densityMode;
+    state.colorMap = m_colorMap;
+    return state;
+}
+
+void ScatterPlot::addContextMenuActions(QMenu *menu)
+{
+    menu->addSeparator();
+    QAction *densityAction = menu->addAction(tr("Density Mode"));
+    densityAction->setCheckable(true);
+    densityAction->setChecked(m_densityMode);
+    connect(densityAction, &QAction::toggled, this, &ScatterPlot::setDensityMode);
+
+    QMenu *colorMenu = addColorMapMenu(menu);
+    colorMenu->setEnabled(m_densityMode);
+}
+
+QMenu *ScatterPlot::addColorMapMenu(QMenu *menu)
+{
+    QMenu *colorMenu = menu->addMenu(tr("Color Map"));
+    QActionGroup *colorGroup = new QActionGroup(colorMenu);
+    for (DensityGrid::ColorMap colorMap : {DensityGrid::Viridis, DensityGrid::Jet, DensityGrid::Grey}) {
+        QAction *action = colorMenu->addAction(DensityGrid::colorMapName(colorMap));
+        action->setCheckable(true);
+        action->setChecked(colorMap == m_colorMap);
+        colorGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, colorMap]() { setColorMap(colorMap); });
+    }
+    return colorMenu;
+}
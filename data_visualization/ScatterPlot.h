@@ -6,37 +6,28 @@
 #include "PlotBase.h"
 #include <QFont>
 #include <QFontMetrics>
-#include "ChartBuffer.h"
+#include "DensityGrid.h"
 
 #include <QPoint>
 
-struct PointMinMax {
-    QPoint min(const QPoint& a, const QPoint& b) const {
-        QPoint p;
-        p.setX(a.x() > b.x() ? b.x() : a.x());
-        p.setY(a.y() > b.y() ? b.y() : a.y());
-        return p;
-    }
-
-    QPoint max(const QPoint& a, const QPoint& b) const {
-        QPoint p;
-        p.setX(a.x() < b.x() ? b.x() : a.x());
-        p.setY(a.y() < b.y() ? b.y() : a.y());
-        return p;
-    }
-
-    bool equal(const QPoint &a, const QPoint &b) const {
-        return (a.x() == b.x()) || (a.y() == b.y());
-    }
-};
-
 class ScatterPlot : public PlotBase
 {
     Q_OBJECT
 public:
     ScatterPlot(const Plot &plot, QGraphicsItem *parent = nullptr);
 
-    QVector<QPoint> readAllData() { return m_data.readAll(); }
+    /**
+     * @brief Replaces the shown events, e.g. by a sample of a recorded acquisition.
+     */
+    void setData(const QVector<QPoint> &data);
+
+    /**
+     * @brief Draws the events as a density raster (default) instead of one point per event.
+     */
+    void setDensityMode(bool density);
+    bool isDensityMode() const { return m_densityMode; }
+    void setColorMap(DensityGrid::ColorMap colorMap);
+    DensityGrid::ColorMap colorMap() const { return m_colorMap; }
 
 public slots:
     void updateData(const QVector<QPoint> &data);
@@ -46,10 +37,16 @@ protected:
     void            resetPlot() override;
     void autoAdjustAxisRange() override;
     void changeAxisType(CustomAxis::ScaleType type) override;
+    void addContextMenuActions(QMenu *menu) override;
+
+    PlotState       plotState() const override;
+    void            paintRubberBand(QPainter *painter);
+    QMenu          *addColorMapMenu(QMenu *menu);
+
+    DensityGrid::ColorMap   m_colorMap = DensityGrid::Viridis;
 
 private:
-    ChartBuffer<QPoint, PointMinMax>     m_data;
-    static constexpr int    DEFAULT_DATA_LENGTH = 60000;
+    bool                    m_densityMode = true;
 };
 
 
@@ -51,7 +51,7 @@ WaveformView::WaveformView(QWidget *parent)
 
     waveform = new Waveform;
     waveform->setTitle("Waveform");
-    waveform->setAnimationOptions(QChart::SeriesAnimations);
+    waveform->setAnimationOptions(QChart::NoAnimation);
     waveform->legend()->hide();
     waveform->setTheme(QChart::ChartThemeBlueIcy);
     waveform->addAxis(axisX, Qt::AlignBottom);
@@ -59,6 +59,9 @@ WaveformView::WaveformView(QWidget *parent)
 
     setChart(waveform);
     m_maxWaveLength = 65536;
+    for (int ch = CHANNEL_START; ch < CHANNEL_NUM; ch++) {
+        m_waveBuffer[ch].reset(m_maxWaveLength);
+    }
     for (int ch = CHANNEL_START; ch < CHANNEL_NUM; ch++) {
         auto *series = new QLineSeries();
         QPen pen;
@@ -107,6 +110,10 @@ WaveformView::WaveformView(QWidget *parent)
                               "border-radius: 5px; "
                               "padding: 5px;");
     coordLabel->hide();
+
+    // Zoom, pan and resize change what a pixel column spans
+    connect(axisX, &QValueAxis::rangeChanged, this, &WaveformView::updateAllSeries);
+    connect(waveform, &QChart::plotAreaChanged, this, &WaveformView::updateAllSeries);
 }
 
 WaveformView::~WaveformView()
@@ -116,6 +123,7 @@ WaveformView::~WaveformView()
 void WaveformView::enableChannel(SAMPLE_CHANNEL ch)
 {
     waveSeries[channelInt(ch)]->setVisible(true);
+    updateSeries(channelInt(ch));
 }
 
 void WaveformView::disableChannel(SAMPLE_CHANNEL ch)
@@ -150,44 +158,45 @@ void WaveformView::pauseGraph()
     m_pauseWave = true;
 }
 
-void WaveformView::addSeriesData(const QList<int> &data)
+/*
+ * The samples arrive demultiplexed, sign extended and in the display unit,
+ * only the ring of samples per channel is updated here. The series get the
+ * decimated view of it.
+ */
+void WaveformView::addSeriesData(const WaveformBlock &data)
 {
-    // int ch = channelInt(channel);
-    // if (m_pauseWave == true) return;
-    // int len = data.length();
-    // int startIndex = m_bufferIndex[ch];
+    if (m_pauseWave) return;
 
-    // for (int i = 0; i < len; i++) {
-    //     int bufferPos = (startIndex + i) % m_maxWaveLength;
-    //     qreal val = m_showVoltage ? data.at(i) * AD_TO_MV : data.at(i);
-    //     if (m_waveBuffer[ch].length() < m_maxWaveLength) {
-    //         m_waveBuffer[ch].append(QPointF(bufferPos, val));
-    //     } else {
-    //         m_waveBuffer[ch][bufferPos].setY(val);
-    //     }
-    // }
-    // m_bufferIndex[ch] = (startIndex + len) % m_maxWaveLength;
-    // waveSeries[ch]->replace(m_waveBuffer[ch]);
+    // A block decoded before the display mode changed still has the old unit
+    float unitScale = 1.0f;
+    if (data.inMillivolts != m_showVoltage) {
+        unitScale = m_showVoltage ? WaveformDecoder::AD_TO_MV : 1.0f / WaveformDecoder::AD_TO_MV;
+    }
 
-    if (m_pauseWave) return;
-    int len = data.length();
-    for (int i = 0; i < len; i++) {
-        int ch = data.at(i)  >> 24;
-        if (ch < CHANNEL_START || ch >= CHANNEL_NUM) continue;
-
-        int val_raw = ((data.at(i) << 14) >> 14);   // Expand signed bit
-        qreal val = m_showVoltage ? val_raw * AD_TO_MV : val_raw;
-        if (m_waveBuffer[ch].length() < m_maxWaveLength) {
-            m_waveBuffer[ch].append(QPointF(m_bufferIndex[ch], val));
-        } else {
-            m_waveBuffer[ch][m_bufferIndex[ch]].setY(val);
-        }
-        m_bufferIndex[ch] =  (m_bufferIndex[ch] + 1) % m_maxWaveLength;
+    for (int ch = CHANNEL_START; ch < CHANNEL_NUM; ch++) {
+        if (!(data.channelMask & (0x01 << ch))) continue;
+        const QVector<float> &values = data.values[ch];
+        m_bufferIndex[ch] = m_waveBuffer[ch].write(m_bufferIndex[ch], values.constData(), values.size(), unitScale);
+        updateSeries(ch);
     }
+}
+
+/*
+ * Hands the series the samples in the x range, reduced to a min/max pair
+ * per pixel column once there are more samples than columns.
+ */
+void WaveformView::updateSeries(int ch)
+{
+    if (!waveSeries[ch]->isVisible()) return;
+    const int columns = qMax(1, qRound(waveform->plotArea().width()));
+    m_waveBuffer[ch].decimate(axisX->min(), axisX->max(), columns, m_seriesPoints);
+    waveSeries[ch]->replace(m_seriesPoints);
+}
+
+void WaveformView::updateAllSeries()
+{
     for (int ch = CHANNEL_START; ch < CHANNEL_NUM; ch++) {
-        if (waveSeries[ch]->isVisible()) {
-            waveSeries[ch]->replace(m_waveBuffer[ch]);
-        }
+        updateSeries(ch);
     }
 }
 
@@ -215,10 +224,10 @@ void WaveformView::saveWaveformData(QString &filePath)
         for (int i = 0; i < 65535; i++) {
             for (int ch = CHANNEL_START; ch < CHANNEL_NUM; ch++) {
                 if (waveSeries[ch]->isVisible()) {
-                    if (waveSeries[ch]->count() < i+1) {
+                    if (m_waveBuffer[ch].size() < i+1) {
                         val = 0;
                     } else {
-                        val = waveSeries[ch]->at(i).y();
+                        val = m_waveBuffer[ch].sample(i);
                     }
                     stream << QString::number(val, 'f', 2);
                     stream << " ,";
@@ -359,10 +368,6 @@ void WaveformView::mouseReleaseEvent(QMouseEvent *event)
     if (m_isTouching)
         m_isTouching = false;
 
-    // Because we disabled animations when touch event was detected
-    // we must put them back on.
-    chart()->setAnimationOptions(QChart::SeriesAnimations);
-
     if (event->button() == Qt::LeftButton) {
         if (dragFunc == DRAG_FUNC_SELC && rubberBand) {
             QRectF selectedRect = rubberBand->geometry();
@@ -5,6 +5,8 @@
 #include <QChartView>
 #include <QObject>
 #include "Waveform.h"
+#include "WaveformDecoder.h"
+#include "MinMaxPyramid.h"
 
 
 enum class SAMPLE_CHANNEL : unsigned char {
@@ -66,7 +68,7 @@ public:
     void clearChannel(SAMPLE_CHANNEL ch);
     void resetRange();
     void changeDragFunc(DragFunc func);
-    void addSeriesData(const QList<int> &data);
+    void addSeriesData(const WaveformBlock &data);
 
     void snapAPicture(QString &imgPath);
     void saveWaveformData(QString &filePath);
@@ -114,12 +116,15 @@ private:
 
 
     void updateThresholdLine();
+    void updateSeries(int ch);
+    void updateAllSeries();
     Waveform            *waveform;
     QValueAxis          *axisX;
     QValueAxis          *axisY;
     QList<QLineSeries*>  waveSeries;
-    QVector<QPointF>    m_waveBuffer[CHANNEL_NUM];
+    MinMaxPyramid       m_waveBuffer[CHANNEL_NUM];     ///< Full resolution samples, the series only get what the view shows
     int                 m_bufferIndex[CHANNEL_NUM] = {0};
+    QVector<QPointF>    m_seriesPoints;
     int                 m_maxWaveLength;
 
     QRubberBand         *rubberBand;
@@ -3,6 +3,7 @@
 #include "GateItemFactory.h"
 #include "HistogramPlot.h"
 #include "ScatterPlot.h"
+#include "ContourPlot.h"
 #include "PlotsDAO.h"
 #include "GatesDAO.h"
 #include <QMessageBox>
@@ -49,6 +50,7 @@ void WorkSheetScene::finishDrawingGate(bool ok)
         QMessageBox::warning(WorkSheetWidget::instance(), tr("Insert Gate Failed!"), tr("Insert Gate Failed"));
     } else {
         m_gateItems.append(m_gateItem);
+        emit gatesChanged();
         QMessageBox::information(WorkSheetWidget::instance(), tr("Insert Gate Ok!"), tr("Insert Gate Ok"));
     }
     m_gateItem = nullptr;
@@ -65,6 +67,7 @@ PlotBase *WorkSheetScene::addNewPlot(PlotType plotType, const Plot &plot)
     << "Y Axis: " << plot.axisYDetectorId() << MeasurementTypeHelper::measurementTypeToString(plot.yMeasurementType());
     HistogramPlot *histogramPlot = nullptr;
     ScatterPlot *scatterPlot = nullptr;
+    ContourPlot *contourPlot = nullptr;
     PlotBase *plotBase = nullptr;
     switch (plotType) {
     case PlotType::HISTOGRAM_PLOT:
@@ -84,10 +87,19 @@ PlotBase *WorkSheetScene::addNewPlot(PlotType plotType, const Plot &plot)
         }
         break;
     case PlotType::CONTOUR_PLOT:
+        contourPlot = new ContourPlot(plot);
+        if (contourPlot) {
+            plotBase = contourPlot;
+            addItem(contourPlot);
+            m_plots.append(static_cast<PlotBase*>(contourPlot));
+        }
         break;
     default:
         break;
     }
+    if (plotBase) {
+        connect(plotBase, &PlotBase::axisTypeChanged, this, &WorkSheetScene::gatesChanged);
+    }
     m_plots.last()->setPos(((m_plots.size()-1) % 3) * Plot::defaultPlotSize, ((m_plots.size()-1) / 3) * Plot::defaultPlotSize);
     update();
     return plotBase;
@@ -101,6 +113,7 @@ void WorkSheetScene::addNewGate(GateType gateType, const Gate &gate, PlotBase *p
 
     m_gateItems.append(gateItem);
     update();
+    emit gatesChanged();
 }
 
 void WorkSheetScene::resetPlots()
@@ -211,6 +224,7 @@ void WorkSheetScene::onDeleteGate(GateItem *gate)
         m_gateItems.removeOne(gate);
         GatesModel::instance()->removeGate(gate->gate());
         gate->deleteLater();
+        emit gatesChanged();
     }
 }
 
@@ -222,6 +236,7 @@ void WorkSheetScene::removeGateItem(int gateId)
             GateItem *item = m_gateItems.takeAt(i);
             removeItem(item);
             item->deleteLater();
+            emit gatesChanged();
             break;
         }
     }
@@ -45,6 +45,7 @@ protected:
 
 signals:
     void finishedDrawingGate(GateItem *gateItem);
+    void gatesChanged();            ///< A gate item was added or removed, or the scale of a plot with gates changed
 
 public slots:
     void onDeletePlot(PlotBase *plot);
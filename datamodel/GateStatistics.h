@@ -14,6 +14,28 @@ struct GateStatistics
     double cvX = 0.0;
     double cvY = 0.0;
     bool is1D = true; // true for IntervalGate (histogram), false for 2D gates
+    bool estimated = false; // partly estimated from chunk sketches of a recorded file
+    bool isQuadrant = false;
+    int quadrantCount[4] = {0, 0, 0, 0}; // lower left, lower right, upper left, upper right
+    double percentParent = 0.0; // of the parent population, all events for top level gates
+    double percentTotal = 0.0;  // of all events
+
+    QString countString() const {
+        QString text = QString::number(count);
+        if (isQuadrant) {
+            text = QString("UL %1  UR %2  LL %3  LR %4").arg(quadrantCount[2]).arg(quadrantCount[3])
+                       .arg(quadrantCount[0]).arg(quadrantCount[1]);
+        }
+        return estimated ? "~" + text : text;
+    }
+
+    QString percentParentString() const {
+        return QString("%1%").arg(percentParent, 0, 'f', 2);
+    }
+
+    QString percentTotalString() const {
+        return QString("%1%").arg(percentTotal, 0, 'f', 2);
+    }
 
     QString meanString() const {
         if (count == 0) return "-";
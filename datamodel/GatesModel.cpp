@@ -53,9 +53,19 @@ QVariant GatesModel::data(const QModelIndex &index, int role) const
             return gate.pointsString();
         case GateColumn::CountColumn: {
             auto it = m_statistics.find(gate.id());
-            if (it != m_statistics.end()) return it->count;
+            if (it != m_statistics.end()) return (it->estimated || it->isQuadrant) ? QVariant(it->countString()) : QVariant(it->count);
             return 0;
         }
+        case GateColumn::PercentParentColumn: {
+            auto it = m_statistics.find(gate.id());
+            if (it != m_statistics.end()) return it->percentParentString();
+            return "-";
+        }
+        case GateColumn::PercentTotalColumn: {
+            auto it = m_statistics.find(gate.id());
+            if (it != m_statistics.end()) return it->percentTotalString();
+            return "-";
+        }
         case GateColumn::MeanColumn: {
             auto it = m_statistics.find(gate.id());
             if (it != m_statistics.end()) return it->meanString();
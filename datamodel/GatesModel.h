@@ -23,6 +23,8 @@ public:
         YAxisColumn,
         GatePointsColumn,
         CountColumn,
+        PercentParentColumn,
+        PercentTotalColumn,
         MeanColumn,
         StdDevColumn,
         CVColumn,
@@ -66,7 +68,7 @@ private:
     QList<Gate> m_gateList;
     QHash<int, GateStatistics> m_statistics; // gateId -> statistics
     GatesDAO gatesDao;
-    const QStringList m_headerData = {"ID", "WorkSheetID", "Name", "Type", "Color", "X Axis", "Y Axis", "Points", "Count", "Mean", "StdDev", "CV"};
+    const QStringList m_headerData = {"ID", "WorkSheetID", "Name", "Type", "Color", "X Axis", "Y Axis", "Points", "Count", "%Parent", "%Total", "Mean", "StdDev", "CV"};
 
     QMutex m_mutex;
 };
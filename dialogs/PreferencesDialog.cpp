@@ -0,0 +1,195 @@
+#include "PreferencesDialog.h"
+#include "AppSettings.h"
+#include <QVBoxLayout>
+#include <QFormLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QDialogButtonBox>
+#include <QThread>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QHostAddress>
+
+
+PreferencesDialog::PreferencesDialog(QWidget *parent)
+    : QDialog{parent}
+{
+    initDialog();
+    readSettings();
+}
+
+void PreferencesDialog::initDialog()
+{
+    setWindowTitle(tr("Preferences"));
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addWidget(createNetworkGroup());
+    mainLayout->addWidget(createAcquisitionGroup());
+    mainLayout->addWidget(createCaptureGroup());
+    mainLayout->addWidget(createDisplayGroup());
+    mainLayout->addWidget(buttonBox);
+    setLayout(mainLayout);
+
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &PreferencesDialog::onAccepted);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &PreferencesDialog::reject);
+}
+
+QWidget *PreferencesDialog::createNetworkGroup()
+{
+    QGroupBox *group = new QGroupBox(tr("Network"), this);
+
+    socAddressEdit = new QLineEdit(group);
+    socPortSpin = new QSpinBox(group);
+    socPortSpin->setRange(1, 65535);
+    localAddressEdit = new QLineEdit(group);
+    localPortSpin = new QSpinBox(group);
+    localPortSpin->setRange(1, 65535);
+
+    receiveCpuSpin = new QSpinBox(group);
+    receiveCpuSpin->setRange(-1, QThread::idealThreadCount() - 1);
+    receiveCpuSpin->setSpecialValueText(tr("Any"));
+
+    receivePrioritySpin = new QSpinBox(group);
+    receivePrioritySpin->setRange(0, 99);
+    receivePrioritySpin->setSpecialValueText(tr("Normal"));
+
+    QFormLayout *layout = new QFormLayout(group);
+    layout->addRow(tr("SoC address"), socAddressEdit);
+    layout->addRow(tr("SoC port"), socPortSpin);
+    layout->addRow(tr("Local address"), localAddressEdit);
+    layout->addRow(tr("Local port"), localPortSpin);
+    layout->addRow(tr("Receive thread CPU"), receiveCpuSpin);
+    layout->addRow(tr("Receive thread real-time priority"), receivePrioritySpin);
+    layout->addRow(new QLabel(tr("Network settings take effect after a restart."), group));
+    group->setLayout(layout);
+    return group;
+}
+
+QWidget *PreferencesDialog::createAcquisitionGroup()
+{
+    QGroupBox *group = new QGroupBox(tr("Acquisition Files"), this);
+
+    exportCsvCheck = new QCheckBox(tr("Export pulsedata.csv when an acquisition stops"), group);
+    writeFcsCheck = new QCheckBox(tr("Write events.fcs during the acquisition"), group);
+    compressionCombo = new QComboBox(group);
+    compressionCombo->addItem(tr("None"), QVariant::fromValue(static_cast<int>(ColumnCodec::Mode::None)));
+    compressionCombo->addItem(tr("Fast"), QVariant::fromValue(static_cast<int>(ColumnCodec::Mode::Fast)));
+    compressionCombo->addItem(tr("Strong"), QVariant::fromValue(static_cast<int>(ColumnCodec::Mode::Strong)));
+    compressionCombo->setToolTip(tr("Fast bit packs the event columns, strong also tries zlib on columns that do not pack."));
+
+    QFormLayout *layout = new QFormLayout(group);
+    layout->addRow(exportCsvCheck);
+    layout->addRow(writeFcsCheck);
+    layout->addRow(tr("Acquisition file compression"), compressionCombo);
+    group->setLayout(layout);
+    return group;
+}
+
+QWidget *PreferencesDialog::createCaptureGroup()
+{
+    QGroupBox *group = new QGroupBox(tr("Datagram Capture"), this);
+
+    captureCheck = new QCheckBox(tr("Record received datagrams with each acquisition"), group);
+    replayFileEdit = new QLineEdit(group);
+    replayFileEdit->setPlaceholderText(tr("Receive from the SoC"));
+    QPushButton *browseButton = new QPushButton(tr("Browse..."), group);
+    QHBoxLayout *replayLayout = new QHBoxLayout();
+    replayLayout->addWidget(replayFileEdit);
+    replayLayout->addWidget(browseButton);
+
+    replaySpeedSpin = new QDoubleSpinBox(group);
+    replaySpeedSpin->setRange(0, 1000);
+    replaySpeedSpin->setSingleStep(0.5);
+    replaySpeedSpin->setSuffix(" x");
+    replaySpeedSpin->setSpecialValueText(tr("As fast as possible"));
+
+    QFormLayout *layout = new QFormLayout(group);
+    layout->addRow(captureCheck);
+    layout->addRow(tr("Replay file"), replayLayout);
+    layout->addRow(tr("Replay speed"), replaySpeedSpin);
+    group->setLayout(layout);
+
+    connect(browseButton, &QPushButton::clicked, this, &PreferencesDialog::browseReplayFile);
+    return group;
+}
+
+QWidget *PreferencesDialog::createDisplayGroup()
+{
+    QGroupBox *group = new QGroupBox(tr("Display"), this);
+
+    frameRateSpin = new QSpinBox(group);
+    frameRateSpin->setRange(5, 120);
+    frameRateSpin->setSuffix(" fps");
+
+    QFormLayout *layout = new QFormLayout(group);
+    layout->addRow(tr("Live plot refresh rate"), frameRateSpin);
+    group->setLayout(layout);
+    return group;
+}
+
+void PreferencesDialog::readSettings()
+{
+    AppSettings &settings = AppSettings::instance();
+    socAddressEdit->setText(settings.socAddress());
+    socPortSpin->setValue(settings.socPort());
+    localAddressEdit->setText(settings.localAddress());
+    localPortSpin->setValue(settings.localPort());
+    receiveCpuSpin->setValue(settings.receiveCpu());
+    receivePrioritySpin->setValue(settings.receivePriority());
+
+    exportCsvCheck->setChecked(settings.exportCsv());
+    writeFcsCheck->setChecked(settings.writeFcs());
+    compressionCombo->setCurrentIndex(compressionCombo->findData(static_cast<int>(settings.compression())));
+
+    captureCheck->setChecked(settings.captureDatagrams());
+    replayFileEdit->setText(settings.replayFile());
+    replaySpeedSpin->setValue(settings.replaySpeed());
+
+    frameRateSpin->setValue(settings.frameRate());
+}
+
+void PreferencesDialog::writeSettings()
+{
+    AppSettings &settings = AppSettings::instance();
+    settings.setSocAddress(socAddressEdit->text().trimmed());
+    settings.setSocPort(socPortSpin->value());
+    settings.setLocalAddress(localAddressEdit->text().trimmed());
+    settings.setLocalPort(localPortSpin->value());
+    settings.setReceiveCpu(receiveCpuSpin->value());
+    settings.setReceivePriority(receivePrioritySpin->value());
+
+    settings.setExportCsv(exportCsvCheck->isChecked());
+    settings.setWriteFcs(writeFcsCheck->isChecked());
+    settings.setCompression(static_cast<ColumnCodec::Mode>(compressionCombo->currentData().toInt()));
+
+    settings.setCaptureDatagrams(captureCheck->isChecked());
+    settings.setReplayFile(replayFileEdit->text().trimmed());
+    settings.setReplaySpeed(replaySpeedSpin->value());
+
+    settings.setFrameRate(frameRateSpin->value());
+}
+
+void PreferencesDialog::onAccepted()
+{
+    for (QLineEdit *edit : {socAddressEdit, localAddressEdit}) {
+        if (QHostAddress(edit->text().trimmed()).isNull()) {
+            QMessageBox::warning(this, tr("Preferences"), tr("%1 is not a valid IP address.").arg(edit->text()));
+            edit->setFocus();
+            return;
+        }
+    }
+    writeSettings();
+    accept();
+}
+
+void PreferencesDialog::browseReplayFile()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Replay File"), replayFileEdit->text(),
+                                                    tr("Datagram Capture (*.seekcap)"));
+    if (!filePath.isEmpty()) {
+        replayFileEdit->setText(filePath);
+    }
+}
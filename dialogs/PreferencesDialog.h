@@ -0,0 +1,52 @@
+#ifndef PREFERENCESDIALOG_H
+#define PREFERENCESDIALOG_H
+
+#include <QDialog>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QComboBox>
+
+
+/**
+ * @brief Edits the AppSettings options, written back when the dialog is accepted.
+ */
+class PreferencesDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit PreferencesDialog(QWidget *parent = nullptr);
+
+private:
+    void            initDialog();
+    QWidget        *createNetworkGroup();
+    QWidget        *createAcquisitionGroup();
+    QWidget        *createCaptureGroup();
+    QWidget        *createDisplayGroup();
+    void            readSettings();
+    void            writeSettings();
+
+    QLineEdit       *socAddressEdit;
+    QSpinBox        *socPortSpin;
+    QLineEdit       *localAddressEdit;
+    QSpinBox        *localPortSpin;
+    QSpinBox        *receiveCpuSpin;
+    QSpinBox        *receivePrioritySpin;
+
+    QCheckBox       *exportCsvCheck;
+    QCheckBox       *writeFcsCheck;
+    QComboBox       *compressionCombo;
+
+    QCheckBox       *captureCheck;
+    QLineEdit       *replayFileEdit;
+    QDoubleSpinBox  *replaySpeedSpin;
+
+    QSpinBox        *frameRateSpin;
+
+private slots:
+    void            onAccepted();
+    void            browseReplayFile();
+};
+
+#endif // PREFERENCESDIALOG_H
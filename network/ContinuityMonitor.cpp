@@ -0,0 +1,253 @@
+#include "ContinuityMonitor.h"
+#include <QDateTime>
+
+
+QJsonObject LossReport::toJson() const
+{
+    QJsonObject frames;
+    frames["received"] = static_cast<qint64>(framesReceived);
+    frames["lost"] = static_cast<qint64>(framesLost);
+    frames["reordered"] = static_cast<qint64>(framesReordered);
+    frames["duplicated"] = static_cast<qint64>(framesDuplicated);
+    frames["sequenceRestarts"] = static_cast<qint64>(sequenceRestarts);
+    frames["resyncs"] = static_cast<qint64>(frameResyncs);
+    frames["kernelDrops"] = static_cast<qint64>(kernelDrops);
+
+    QJsonObject events;
+    events["received"] = static_cast<qint64>(eventsReceived);
+    events["lost"] = static_cast<qint64>(eventsLost);
+    events["reordered"] = static_cast<qint64>(eventsReordered);
+    events["duplicated"] = static_cast<qint64>(eventsDuplicated);
+    events["invalid"] = static_cast<qint64>(invalidEvents);
+    quint64 expected = eventsReceived + eventsLost;
+    events["lossRatio"] = expected > 0 ? static_cast<double>(eventsLost) / expected : 0.0;
+
+    QJsonObject report;
+    report["frames"] = frames;
+    report["events"] = events;
+    return report;
+}
+
+
+ContinuityMonitor::ContinuityMonitor()
+    : m_hasSequence(false), m_lastSequence(0), m_sequenceSeen(0), m_hasEventId(false), m_lastEventId(0),
+    m_invalidPending(0), m_windowReceived(0), m_windowLostBase(0),
+    m_hasKernelDropsBase(false), m_kernelDropsBase(0), m_hasFrameResyncsBase(false), m_frameResyncsBase(0),
+    m_resetPending(false), m_framesReceived(0), m_framesLost(0), m_framesReordered(0), m_framesDuplicated(0),
+    m_sequenceRestarts(0), m_eventsReceived(0), m_eventsLost(0), m_eventsReordered(0), m_eventsDuplicated(0),
+    m_invalidEvents(0), m_kernelDrops(0), m_frameResyncs(0), m_lossPerSecond(0), m_lossRatio(0), m_windowUpdatedMs(0)
+{
+    m_windowTimer.start();
+}
+
+void ContinuityMonitor::reset()
+{
+    m_framesReceived = 0;
+    m_framesLost = 0;
+    m_framesReordered = 0;
+    m_framesDuplicated = 0;
+    m_sequenceRestarts = 0;
+    m_eventsReceived = 0;
+    m_eventsLost = 0;
+    m_eventsReordered = 0;
+    m_eventsDuplicated = 0;
+    m_invalidEvents = 0;
+    m_kernelDrops = 0;
+    m_frameResyncs = 0;
+    m_lossPerSecond = 0;
+    m_lossRatio = 0;
+    m_resetPending = true;
+}
+
+void ContinuityMonitor::applyPendingReset()
+{
+    if (!m_resetPending.exchange(false)) {
+        return;
+    }
+    m_hasSequence = false;
+    m_sequenceSeen = 0;
+    m_hasEventId = false;
+    m_invalidPending = 0;
+    m_hasKernelDropsBase = false;
+    m_hasFrameResyncsBase = false;
+    m_windowReceived = 0;
+    m_windowLostBase = 0;
+    m_windowTimer.restart();
+}
+
+void ContinuityMonitor::updateWindow()
+{
+    qint64 elapsed = m_windowTimer.elapsed();
+    if (elapsed < WINDOW_MS) {
+        return;
+    }
+    quint64 lostTotal = m_eventsLost.load(std::memory_order_relaxed);
+    quint64 lost = lostTotal > m_windowLostBase ? lostTotal - m_windowLostBase : 0;
+    m_lossPerSecond = lost * 1000.0 / elapsed;
+    m_lossRatio = (lost + m_windowReceived) > 0 ? static_cast<double>(lost) / (lost + m_windowReceived) : 0.0;
+    m_windowUpdatedMs = QDateTime::currentMSecsSinceEpoch();
+    m_windowLostBase = lostTotal;
+    m_windowReceived = 0;
+    m_windowTimer.restart();
+}
+
+void ContinuityMonitor::recordFrame(quint16 sequence)
+{
+    applyPendingReset();
+    m_framesReceived.fetch_add(1, std::memory_order_relaxed);
+    if (!m_hasSequence) {
+        m_hasSequence = true;
+        m_lastSequence = sequence;
+        m_sequenceSeen = 1;
+        return;
+    }
+
+    quint16 ahead = static_cast<quint16>(sequence - m_lastSequence);
+    if (ahead == 0) {
+        m_framesDuplicated.fetch_add(1, std::memory_order_relaxed);
+    } else if (ahead < 0x8000) {
+        if (ahead > 1) {
+            m_framesLost.fetch_add(ahead - 1, std::memory_order_relaxed);
+        }
+        m_sequenceSeen = (ahead < SEQUENCE_WINDOW) ? ((m_sequenceSeen << ahead) | 1) : 1;
+        m_lastSequence = sequence;
+    } else {
+        quint16 behind = static_cast<quint16>(m_lastSequence - sequence);
+        if (behind >= SEQUENCE_RESTART_DISTANCE) {
+            // The SoC started counting again, e.g. after a reboot
+            m_sequenceRestarts.fetch_add(1, std::memory_order_relaxed);
+            m_lastSequence = sequence;
+            m_sequenceSeen = 1;
+        } else if (behind < SEQUENCE_WINDOW && (m_sequenceSeen & (quint64(1) << behind))) {
+            m_framesDuplicated.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // Late frame, it was counted as lost when the later one arrived
+            m_framesReordered.fetch_add(1, std::memory_order_relaxed);
+            if (behind < SEQUENCE_WINDOW) {
+                m_sequenceSeen |= (quint64(1) << behind);
+                if (m_framesLost.load(std::memory_order_relaxed) > 0) {
+                    m_framesLost.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+    updateWindow();
+}
+
+void ContinuityMonitor::recordEvents(const quint32 *eventIds, int count)
+{
+    applyPendingReset();
+    if (count <= 0) {
+        return;
+    }
+    quint64 lost = 0;
+    quint64 reordered = 0;
+    quint64 duplicated = 0;
+    int i = 0;
+    if (!m_hasEventId) {
+        m_hasEventId = true;
+        m_lastEventId = eventIds[0] & EVENT_ID_MASK;
+        i = 1;
+    }
+    quint32 last = m_lastEventId;
+    for (; i < count; ++i) {
+        const quint32 id = eventIds[i] & EVENT_ID_MASK;
+        const quint32 ahead = (id - last) & EVENT_ID_MASK;
+        if (ahead == 1) {
+            last = id;
+        } else if (ahead == 0) {
+            duplicated++;
+        } else if (ahead < (EVENT_ID_MASK + 1) / 2) {
+            lost += ahead - 1;
+            last = id;
+        } else {
+            reordered++;
+        }
+    }
+    m_lastEventId = last;
+
+    // The ids of dropped invalid events are missing as well, they are not lost on the link
+    const quint64 invalid = qMin(lost, m_invalidPending);
+    lost -= invalid;
+    m_invalidPending -= invalid;
+
+    m_eventsReceived.fetch_add(count, std::memory_order_relaxed);
+    m_windowReceived += count;
+    if (duplicated) {
+        m_eventsDuplicated.fetch_add(duplicated, std::memory_order_relaxed);
+    }
+    if (reordered) {
+        m_eventsReordered.fetch_add(reordered, std::memory_order_relaxed);
+    }
+    // A late event fills a gap counted before
+    quint64 lostTotal = m_eventsLost.load(std::memory_order_relaxed) + lost;
+    lostTotal = lostTotal > reordered ? lostTotal - reordered : 0;
+    m_eventsLost.store(lostTotal, std::memory_order_relaxed);
+    updateWindow();
+}
+
+void ContinuityMonitor::recordInvalidEvents(int count)
+{
+    applyPendingReset();
+    if (count > 0) {
+        m_invalidEvents.fetch_add(count, std::memory_order_relaxed);
+        m_invalidPending += count;
+    }
+}
+
+void ContinuityMonitor::setKernelDrops(quint64 drops)
+{
+    applyPendingReset();
+    if (!m_hasKernelDropsBase) {
+        m_hasKernelDropsBase = true;
+        m_kernelDropsBase = drops;
+    }
+    m_kernelDrops.store(drops - m_kernelDropsBase, std::memory_order_relaxed);
+}
+
+void ContinuityMonitor::setFrameResyncs(quint64 resyncs)
+{
+    applyPendingReset();
+    if (!m_hasFrameResyncsBase) {
+        m_hasFrameResyncsBase = true;
+        m_frameResyncsBase = resyncs;
+    }
+    m_frameResyncs.store(resyncs - m_frameResyncsBase, std::memory_order_relaxed);
+}
+
+double ContinuityMonitor::eventLossPerSecond() const
+{
+    // Without new data the last window goes stale instead of showing an old rate
+    if (QDateTime::currentMSecsSinceEpoch() - m_windowUpdatedMs.load() > 2 * WINDOW_MS) {
+        return 0;
+    }
+    return m_lossPerSecond.load(std::memory_order_relaxed);
+}
+
+double ContinuityMonitor::eventLossRatio() const
+{
+    if (QDateTime::currentMSecsSinceEpoch() - m_windowUpdatedMs.load() > 2 * WINDOW_MS) {
+        return 0;
+    }
+    return m_lossRatio.load(std::memory_order_relaxed);
+}
+
+LossReport ContinuityMonitor::report() const
+{
+    LossReport report;
+    report.framesReceived = m_framesReceived.load(std::memory_order_relaxed);
+    report.framesLost = m_framesLost.load(std::memory_order_relaxed);
+    report.framesReordered = m_framesReordered.load(std::memory_order_relaxed);
+    report.framesDuplicated = m_framesDuplicated.load(std::memory_order_relaxed);
+    report.sequenceRestarts = m_sequenceRestarts.load(std::memory_order_relaxed);
+    report.eventsReceived = m_eventsReceived.load(std::memory_order_relaxed);
+    report.eventsLost = m_eventsLost.load(std::memory_order_relaxed);
+    report.eventsReordered = m_eventsReordered.load(std::memory_order_relaxed);
+    report.eventsDuplicated = m_eventsDuplicated.load(std::memory_order_relaxed);
+    report.invalidEvents = m_invalidEvents.load(std::memory_order_relaxed);
+    report.kernelDrops = m_kernelDrops.load(std::memory_order_relaxed);
+    report.frameResyncs = m_frameResyncs.load(std::memory_order_relaxed);
+    report.eventLossPerSecond = eventLossPerSecond();
+    report.eventLossRatio = eventLossRatio();
+    return report;
+}
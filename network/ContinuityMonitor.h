@@ -0,0 +1,122 @@
+#ifndef CONTINUITYMONITOR_H
+#define CONTINUITYMONITOR_H
+
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <atomic>
+
+
+/**
+ * @brief Totals of ContinuityMonitor at one point in time.
+ */
+struct LossReport
+{
+    quint64 framesReceived = 0;
+    quint64 framesLost = 0;             ///< Missing frame sequence numbers
+    quint64 framesReordered = 0;        ///< Frames that arrived after a later one
+    quint64 framesDuplicated = 0;
+    quint64 sequenceRestarts = 0;       ///< Sequence jumped back too far to be a reorder
+    quint64 eventsReceived = 0;
+    quint64 eventsLost = 0;             ///< Missing event ids
+    quint64 eventsReordered = 0;
+    quint64 eventsDuplicated = 0;
+    quint64 invalidEvents = 0;          ///< Events dropped by the decoder on a magic mismatch
+    quint64 kernelDrops = 0;            ///< Datagrams dropped by the socket queue (SO_RXQ_OVFL)
+    quint64 frameResyncs = 0;           ///< Times the frame scanner lost the frame boundary
+    double  eventLossPerSecond = 0;     ///< Events lost in the last second
+    double  eventLossRatio = 0;         ///< Lost / (lost + received) in the last second
+
+    QJsonObject toJson() const;
+};
+
+
+/**
+ * @brief Checks frame sequence and event id continuity on the receive path.
+ *
+ * The record functions are called by the receive thread only. Totals are
+ * atomics, so the status bar and the sorting panel read them from the GUI
+ * thread through report() or the accessors.
+ *
+ * Frame sequences are 16-bit. A window of the last 64 sequences tells a
+ * late frame, which is taken back out of the lost count, from a duplicate.
+ * Event ids are 20-bit and wrap around, an id going backwards is counted as
+ * reordered and also reduces the lost count. Events the decoder dropped as
+ * invalid leave a gap in the ids too, the gaps they explain are counted as
+ * invalid only, not as lost. recordInvalidEvents() goes before the
+ * recordEvents() of the same frame.
+ */
+class ContinuityMonitor
+{
+public:
+    static ContinuityMonitor &instance() {
+        static ContinuityMonitor instance;
+        return instance;
+    }
+    ContinuityMonitor(const ContinuityMonitor &) = delete;
+    ContinuityMonitor &operator=(const ContinuityMonitor &) = delete;
+
+    /**
+     * @brief Clears the totals, the receive thread drops its tracking state on the next record.
+     */
+    void reset();
+
+    // Receive thread
+    void recordFrame(quint16 sequence);
+    void recordEvents(const quint32 *eventIds, int count);
+    void recordInvalidEvents(int count);
+    void setKernelDrops(quint64 drops);
+    void setFrameResyncs(quint64 resyncs);
+
+    // Any thread
+    LossReport report() const;
+    quint64 eventsLost() const { return m_eventsLost.load(std::memory_order_relaxed); }
+    quint64 framesLost() const { return m_framesLost.load(std::memory_order_relaxed); }
+    double  eventLossPerSecond() const;
+    double  eventLossRatio() const;
+
+    static constexpr quint32 EVENT_ID_MASK = 0x000FFFFF;
+
+private:
+    ContinuityMonitor();
+
+    void applyPendingReset();
+    void updateWindow();
+
+    static constexpr int    SEQUENCE_WINDOW = 64;
+    static constexpr int    SEQUENCE_RESTART_DISTANCE = 1024;
+    static constexpr qint64 WINDOW_MS = 1000;
+
+    // Receive thread state
+    bool                    m_hasSequence;
+    quint16                 m_lastSequence;
+    quint64                 m_sequenceSeen;         ///< Bit i set: m_lastSequence - i was received
+    bool                    m_hasEventId;
+    quint32                 m_lastEventId;
+    quint64                 m_invalidPending;       ///< Invalid events no id gap has accounted for yet
+    quint64                 m_windowReceived;
+    quint64                 m_windowLostBase;
+    bool                    m_hasKernelDropsBase;   ///< Kernel drop and resync counters are cumulative,
+    quint64                 m_kernelDropsBase;      ///< the values at the reset are subtracted
+    bool                    m_hasFrameResyncsBase;
+    quint64                 m_frameResyncsBase;
+    QElapsedTimer           m_windowTimer;
+
+    std::atomic<bool>       m_resetPending;
+    std::atomic<quint64>    m_framesReceived;
+    std::atomic<quint64>    m_framesLost;
+    std::atomic<quint64>    m_framesReordered;
+    std::atomic<quint64>    m_framesDuplicated;
+    std::atomic<quint64>    m_sequenceRestarts;
+    std::atomic<quint64>    m_eventsReceived;
+    std::atomic<quint64>    m_eventsLost;
+    std::atomic<quint64>    m_eventsReordered;
+    std::atomic<quint64>    m_eventsDuplicated;
+    std::atomic<quint64>    m_invalidEvents;
+    std::atomic<quint64>    m_kernelDrops;
+    std::atomic<quint64>    m_frameResyncs;
+    std::atomic<double>     m_lossPerSecond;
+    std::atomic<double>     m_lossRatio;
+    std::atomic<qint64>     m_windowUpdatedMs;      ///< Wall clock of the last window, rates expire after it
+};
+
+#endif // CONTINUITYMONITOR_H
@@ -0,0 +1,283 @@
+#include "DatagramCapture.h"
+#include <QDateTime>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+
+DatagramRecorder::DatagramRecorder(int bufferBytes, QObject *parent)
+    : QThread{parent}, m_ring(bufferBytes, SpscQueue<char>::OverflowPolicy::DropNewest),
+    m_recording(false), m_stopRequested(false), m_writeError(false), m_recorded(0), m_dropped(0), m_written(0)
+{
+    setObjectName("DatagramRecorder");
+}
+
+DatagramRecorder::~DatagramRecorder()
+{
+    stopRecording();
+}
+
+bool DatagramRecorder::startRecording(const QString &filePath)
+{
+    stopRecording();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "[DatagramRecorder] Open capture file failed:" << filePath << m_file.errorString();
+        return false;
+    }
+
+    char header[DatagramCaptureHeader::FILE_HEADER_SIZE] = {};
+    std::memcpy(header, DatagramCaptureHeader::MAGIC, sizeof(DatagramCaptureHeader::MAGIC));
+    qToLittleEndian<quint32>(DatagramCaptureHeader::VERSION, header + 8);
+    qToLittleEndian<quint32>(DatagramCaptureHeader::FILE_HEADER_SIZE, header + 12);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 16);
+    if (m_file.write(header, sizeof(header)) != sizeof(header)) {
+        qWarning() << "[DatagramRecorder] Write capture header failed:" << filePath << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // Datagrams recorded after the last stop are still in the ring
+    while (!m_ring.acquire().isEmpty()) {
+        m_ring.release();
+    }
+    m_recorded = 0;
+    m_dropped = 0;
+    m_written = sizeof(header);
+    m_stopRequested = false;
+    m_writeError = false;
+    m_clock.start();
+    m_recording.store(true, std::memory_order_release);
+    start(QThread::LowPriority);
+    qDebug() << "[DatagramRecorder] Recording datagrams to" << filePath;
+    return true;
+}
+
+void DatagramRecorder::stopRecording()
+{
+    if (!m_recording.exchange(false)) {
+        return;
+    }
+    m_stopRequested = true;
+    wait();
+    m_file.close();
+    qDebug() << "[DatagramRecorder] Recorded" << m_recorded.load() << "datagrams," << m_dropped.load()
+             << "dropped," << m_written.load() << "bytes to" << m_file.fileName();
+}
+
+void DatagramRecorder::record(const char *data, int size, const QHostAddress &sender, quint16 senderPort)
+{
+    if (!m_recording.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (m_writeError.load(std::memory_order_relaxed)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char header[DatagramCaptureHeader::RECORD_HEADER_SIZE] = {};
+    qToLittleEndian<quint64>(m_clock.nsecsElapsed(), header);
+    qToLittleEndian<quint32>(size, header + 8);
+    qToLittleEndian<quint32>(sender.toIPv4Address(), header + 12);
+    qToLittleEndian<quint16>(senderPort, header + 16);
+
+    // A record is either written completely or not at all
+    const int total = static_cast<int>(sizeof(header)) + size;
+    SpscQueue<char>::Span first, second;
+    if (m_ring.reserve(total, first, second) < total) {
+        m_ring.commit(0);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto copy = [&](const char *src, int length, int offset) {
+        const int inFirst = qBound(0, first.size - offset, length);
+        if (inFirst > 0) {
+            std::memcpy(first.data + offset, src, inFirst);
+        }
+        if (inFirst < length) {
+            std::memcpy(second.data + offset + inFirst - first.size, src + inFirst, length - inFirst);
+        }
+    };
+    copy(header, sizeof(header), 0);
+    copy(data, size, sizeof(header));
+    m_ring.commit(total);
+    m_recorded.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Writes what is in the ring to the file, returns false if it was empty or
+ * the write failed. After a failure the ring is only emptied.
+ */
+bool DatagramRecorder::drain()
+{
+    SpscQueue<char>::ReadSpans spans = m_ring.acquire();
+    if (spans.isEmpty()) {
+        return false;
+    }
+    if (!m_writeError.load(std::memory_order_relaxed)) {
+        bool ok = m_file.write(spans.first.data, spans.first.size) == spans.first.size;
+        if (ok && spans.second.size > 0) {
+            ok = m_file.write(spans.second.data, spans.second.size) == spans.second.size;
+        }
+        if (ok) {
+            m_written.fetch_add(spans.size(), std::memory_order_relaxed);
+        } else {
+            qWarning() << "[DatagramRecorder] Write capture file failed, recording stopped:" << m_file.fileName() << m_file.errorString();
+            m_writeError.store(true, std::memory_order_release);
+        }
+    }
+    m_ring.release();
+    return !m_writeError.load(std::memory_order_relaxed);
+}
+
+void DatagramRecorder::run()
+{
+    while (!m_stopRequested.load(std::memory_order_acquire)) {
+        if (!drain()) {
+            msleep(2);
+        }
+    }
+    while (drain()) {
+    }
+    if (!m_writeError.load(std::memory_order_relaxed) && !m_file.flush()) {
+        qWarning() << "[DatagramRecorder] Flush capture file failed:" << m_file.fileName() << m_file.errorString();
+        m_writeError.store(true, std::memory_order_release);
+    }
+}
+
+
+bool DatagramCaptureReader::open(const QString &filePath)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < DatagramCaptureHeader::FILE_HEADER_SIZE) {
+        m_errorString = "Capture file too short";
+        close();
+        return false;
+    }
+    m_map = m_file.map(0, m_size);
+    if (!m_map) {
+        m_errorString = m_file.errorString();
+        close();
+        return false;
+    }
+
+    const char *header = reinterpret_cast<const char *>(m_map);
+    if (std::memcmp(header, DatagramCaptureHeader::MAGIC, sizeof(DatagramCaptureHeader::MAGIC)) != 0
+        || qFromLittleEndian<quint32>(header + 8) != DatagramCaptureHeader::VERSION) {
+        m_errorString = "Not a datagram capture file";
+        close();
+        return false;
+    }
+    m_startWallClockMs = qFromLittleEndian<qint64>(header + 16);
+    m_offset = qFromLittleEndian<quint32>(header + 12);
+    return true;
+}
+
+void DatagramCaptureReader::close()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_offset = 0;
+}
+
+bool DatagramCaptureReader::next(DatagramRecord &record)
+{
+    if (!m_map || m_offset + DatagramCaptureHeader::RECORD_HEADER_SIZE > m_size) {
+        return false;
+    }
+    const char *header = reinterpret_cast<const char *>(m_map + m_offset);
+    const qint64 length = qFromLittleEndian<quint32>(header + 8);
+    if (m_offset + DatagramCaptureHeader::RECORD_HEADER_SIZE + length > m_size) {
+        // Truncated by a crash while recording
+        return false;
+    }
+    record.timestampNs = qFromLittleEndian<quint64>(header);
+    record.size = static_cast<int>(length);
+    record.sender = QHostAddress(qFromLittleEndian<quint32>(header + 12));
+    record.senderPort = qFromLittleEndian<quint16>(header + 16);
+    record.data = header + DatagramCaptureHeader::RECORD_HEADER_SIZE;
+    m_offset += DatagramCaptureHeader::RECORD_HEADER_SIZE + length;
+    return true;
+}
+
+
+DatagramReplayer::DatagramReplayer(QObject *parent)
+    : QThread{parent}, m_speed(1.0), m_stopRequested(false), m_datagrams(0), m_bytes(0)
+{
+    setObjectName("DatagramReplayer");
+}
+
+DatagramReplayer::~DatagramReplayer()
+{
+    stop();
+}
+
+bool DatagramReplayer::open(const QString &filePath, double speed)
+{
+    stop();
+    m_speed = qMax(0.0, speed);
+    m_stopRequested = false;
+    if (!m_reader.open(filePath)) {
+        qWarning() << "[DatagramReplayer] Open capture failed:" << filePath << m_reader.errorString();
+        return false;
+    }
+    return true;
+}
+
+void DatagramReplayer::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stopRequested = true;
+    wait();
+}
+
+void DatagramReplayer::run()
+{
+    m_datagrams = 0;
+    m_bytes = 0;
+    m_reader.rewind();
+
+    QElapsedTimer clock;
+    clock.start();
+    DatagramRecord record;
+    bool first = true;
+    quint64 firstTimestamp = 0;
+    while (!m_stopRequested.load(std::memory_order_relaxed) && m_reader.next(record)) {
+        if (first) {
+            firstTimestamp = record.timestampNs;
+            first = false;
+        }
+        if (m_speed > 0) {
+            // Sleep through long gaps, spin through the short ones to keep bursts intact
+            const qint64 due = static_cast<qint64>((record.timestampNs - firstTimestamp) / m_speed);
+            qint64 wait = due - clock.nsecsElapsed();
+            while (wait > 0 && !m_stopRequested.load(std::memory_order_relaxed)) {
+                if (wait > 2000000) {
+                    usleep(static_cast<unsigned long>((wait - 1000000) / 1000));
+                } else {
+                    yieldCurrentThread();
+                }
+                wait = due - clock.nsecsElapsed();
+            }
+        }
+        if (m_handler) {
+            m_handler(record.data, record.size, record.sender, record.senderPort);
+        }
+        m_datagrams.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(record.size, std::memory_order_relaxed);
+    }
+    emit replayFinished(m_datagrams.load(), m_bytes.load(), clock.elapsed());
+}
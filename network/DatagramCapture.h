@@ -0,0 +1,161 @@
+#ifndef DATAGRAMCAPTURE_H
+#define DATAGRAMCAPTURE_H
+
+#include <QThread>
+#include <QFile>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+#include "SpscQueue.h"
+
+
+/*
+ * Capture file layout, all fields little endian:
+ *   File header (32 bytes): magic "SEEKCAP\0" | version u32 | header size u32
+ *                           | start wall clock ms since epoch i64 | reserved u64
+ *   Record (24 bytes + payload): timestamp ns since capture start u64 | length u32
+ *                           | sender IPv4 u32 | sender port u16 | flags u16 | reserved u32
+ *                           | datagram bytes
+ * Timestamps come from the monotonic clock, the wall clock in the header
+ * only anchors them.
+ */
+struct DatagramCaptureHeader
+{
+    static constexpr char    MAGIC[8] = {'S', 'E', 'E', 'K', 'C', 'A', 'P', '\0'};
+    static constexpr quint32 VERSION = 1;
+    static constexpr int     FILE_HEADER_SIZE = 32;
+    static constexpr int     RECORD_HEADER_SIZE = 24;
+};
+
+
+/**
+ * @brief One datagram of a capture, payload points into the mapped file.
+ */
+struct DatagramRecord
+{
+    quint64     timestampNs = 0;
+    const char  *data = nullptr;
+    int         size = 0;
+    QHostAddress sender;
+    quint16     senderPort = 0;
+};
+
+
+/**
+ * @brief Journals received datagrams to an append-only capture file.
+ *
+ * record() is called on the receive thread and only copies the datagram
+ * into a lock-free byte ring, the file is written by the recorder's own
+ * thread. When the ring is full the datagram is not recorded and counted
+ * in droppedDatagrams(), the receive path is never slowed down by the disk.
+ * After a write error the recording stops writing, hasWriteError() is set
+ * and the datagrams that follow count as dropped.
+ */
+class DatagramRecorder : public QThread
+{
+    Q_OBJECT
+public:
+    explicit DatagramRecorder(int bufferBytes = DefaultBufferBytes, QObject *parent = nullptr);
+    ~DatagramRecorder() override;
+
+    bool    startRecording(const QString &filePath);
+    void    stopRecording();
+    bool    isRecording() const { return m_recording.load(std::memory_order_acquire); }
+    QString filePath() const { return m_file.fileName(); }
+
+    // Receive thread
+    void    record(const char *data, int size, const QHostAddress &sender, quint16 senderPort);
+
+    quint64 recordedDatagrams() const { return m_recorded.load(std::memory_order_relaxed); }
+    quint64 droppedDatagrams() const { return m_dropped.load(std::memory_order_relaxed); }
+    quint64 writtenBytes() const { return m_written.load(std::memory_order_relaxed); }
+    bool    hasWriteError() const { return m_writeError.load(std::memory_order_acquire); }
+
+protected:
+    void run() override;
+
+private:
+    bool    drain();
+
+    static constexpr int DefaultBufferBytes = 64 << 20;
+
+    SpscQueue<char>         m_ring;
+    QFile                   m_file;
+    QElapsedTimer           m_clock;
+    std::atomic<bool>       m_recording;
+    std::atomic<bool>       m_stopRequested;
+    std::atomic<bool>       m_writeError;       ///< The file could not be written, later datagrams are dropped
+    std::atomic<quint64>    m_recorded;
+    std::atomic<quint64>    m_dropped;
+    std::atomic<quint64>    m_written;
+};
+
+
+/**
+ * @brief Reads a capture file written by DatagramRecorder, the file is memory mapped.
+ */
+class DatagramCaptureReader
+{
+public:
+    DatagramCaptureReader() = default;
+    ~DatagramCaptureReader() { close(); }
+
+    bool    open(const QString &filePath);
+    void    close();
+    bool    next(DatagramRecord &record);
+    void    rewind() { m_offset = DatagramCaptureHeader::FILE_HEADER_SIZE; }
+
+    QString errorString() const { return m_errorString; }
+    qint64  startWallClockMs() const { return m_startWallClockMs; }
+    qint64  fileSize() const { return m_size; }
+
+private:
+    QFile       m_file;
+    const uchar *m_map = nullptr;
+    qint64      m_size = 0;
+    qint64      m_offset = 0;
+    qint64      m_startWallClockMs = 0;
+    QString     m_errorString;
+};
+
+
+/**
+ * @brief Feeds a capture file to a datagram handler on its own thread.
+ *
+ * speed 1 keeps the recorded timing, N plays N times faster and 0 replays
+ * as fast as the handler takes the datagrams.
+ */
+class DatagramReplayer : public QThread
+{
+    Q_OBJECT
+public:
+    using DatagramHandler = std::function<void(const char *data, int size, const QHostAddress &sender, quint16 senderPort)>;
+
+    explicit DatagramReplayer(QObject *parent = nullptr);
+    ~DatagramReplayer() override;
+
+    bool    open(const QString &filePath, double speed);
+    void    setDatagramHandler(const DatagramHandler &handler) { m_handler = handler; }
+    void    stop();
+    QString errorString() const { return m_reader.errorString(); }
+
+    quint64 replayedDatagrams() const { return m_datagrams.load(std::memory_order_relaxed); }
+    quint64 replayedBytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+signals:
+    void replayFinished(quint64 datagrams, quint64 bytes, qint64 elapsedMs);
+
+protected:
+    void run() override;
+
+private:
+    DatagramCaptureReader   m_reader;
+    DatagramHandler         m_handler;
+    double                  m_speed;
+    std::atomic<bool>       m_stopRequested;
+    std::atomic<quint64>    m_datagrams;
+    std::atomic<quint64>    m_bytes;
+};
+
+#endif // DATAGRAMCAPTURE_H
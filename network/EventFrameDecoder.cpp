@@ -0,0 +1,58 @@
+#include "EventFrameDecoder.h"
+#include <QtEndian>
+
+
+EventFrameDecoder::EventFrameDecoder(const QVector<int> &enabledChannels)
+{
+    setEnabledChannels(enabledChannels);
+}
+
+void EventFrameDecoder::setEnabledChannels(const QVector<int> &channels)
+{
+    setEnabledChannels(channels, EventKernels::table(channels.size()));
+}
+
+void EventFrameDecoder::setEnabledChannels(const QVector<int> &channels, const EventKernels::Table &kernels)
+{
+    m_enabledChannels = channels;
+    m_eventWords = EventData::eventWordCount(channels.size());
+    m_decodeKernel = (kernels.channelNum == 0 || kernels.channelNum == channels.size())
+                         ? kernels.decode : EventKernels::table(channels.size()).decode;
+}
+
+void EventFrameDecoder::wordsFromBigEndian(const void *src, int wordCount, quint32 *dst)
+{
+    // Qt swaps whole arrays with SSSE3/AVX2 shuffles when the CPU supports it
+    qFromBigEndian<quint32>(src, wordCount, dst);
+}
+
+EventFrameStats EventFrameDecoder::decode(const char *data, int size, EventBatch &output)
+{
+    EventFrameStats stats;
+    const int eventBytes = eventByteSize();
+    const int eventNum = size / eventBytes;
+    stats.totalEvents = eventNum;
+    stats.trailingBytes = size - eventNum * eventBytes;
+    if (eventNum < 1) {
+        return stats;
+    }
+
+    const int wordCount = eventNum * m_eventWords;
+    if (m_words.size() < wordCount) {
+        m_words.resize(wordCount);
+    }
+    wordsFromBigEndian(data, wordCount, m_words.data());
+
+    if (output.enabledChannels() != m_enabledChannels) {
+        output.reset(m_enabledChannels, eventNum);
+    }
+    const int row = output.size();
+    output.resize(row + eventNum);
+
+    EventDecodeTarget target{output.eventIdData(), output.diffTimeData(), output.postTimeData(),
+                             output.flagData(), output.chPulseValidData(), output.columnData(0, 0),
+                             output.capacity(), row};
+    m_decodeKernel(m_words.constData(), eventNum, m_enabledChannels.size(), target, stats);
+    output.resize(target.row);
+    return stats;
+}
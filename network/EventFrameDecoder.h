@@ -0,0 +1,58 @@
+#ifndef EVENTFRAMEDECODER_H
+#define EVENTFRAMEDECODER_H
+
+#include <QVector>
+#include "EventData.h"
+#include "EventBatch.h"
+#include "EventKernels.h"
+
+
+/**
+ * @brief Bulk decoder for the payload of CMD_PULSE_DATA frames.
+ *
+ * The payload is walked in place: all big endian words of the frame are
+ * byte swapped in one call into a scratch buffer which is kept between
+ * frames, then every event is checked for HEAD_MAGIC/TAIL_MAGIC and its
+ * header bit fields are unpacked in the same pass straight into the columns
+ * of an EventBatch. The pass runs in the EventKernels instance for the
+ * enabled channel count.
+ *
+ * Event layout (32-bit big endian words):
+ *   [Head Magic] [Header] [Diff Time] [Post Time]
+ *   [(Peak | Width | Area) * Enabled Channel Num] [Tail Magic]
+ */
+class EventFrameDecoder
+{
+public:
+    explicit EventFrameDecoder(const QVector<int> &enabledChannels = QVector<int>());
+
+    void setEnabledChannels(const QVector<int> &channels);
+    void setEnabledChannels(const QVector<int> &channels, const EventKernels::Table &kernels);
+    const QVector<int> &enabledChannels() const { return m_enabledChannels; }
+
+    int eventWordCount() const { return m_eventWords; }
+    int eventByteSize() const { return m_eventWords * static_cast<int>(sizeof(quint32)); }
+
+    /**
+     * @brief Decodes all whole events in the payload.
+     * @param data Pointer to the payload of one frame.
+     * @param size Payload size in bytes.
+     * @param output Valid events are appended as rows. The batch is reset if
+     *        its channel layout differs from the decoder's.
+     * @return Valid/invalid counts and sort statistics of this frame.
+     */
+    EventFrameStats decode(const char *data, int size, EventBatch &output);
+
+    /**
+     * @brief Converts wordCount big endian words to host order in bulk.
+     */
+    static void wordsFromBigEndian(const void *src, int wordCount, quint32 *dst);
+
+private:
+    QVector<int>        m_enabledChannels;
+    int                 m_eventWords;
+    EventKernels::DecodeFn m_decodeKernel;
+    QVector<quint32>    m_words;            ///< Host order scratch buffer, grows only
+};
+
+#endif // EVENTFRAMEDECODER_H
@@ -2,15 +2,24 @@
 #include "DataManager.h"
 #include "DetectorSettingsModel.h"
 #include "EventDataManager.h"
+#include "ContinuityMonitor.h"
+#include "AppSettings.h"
+#include <QMetaMethod>
+#include <QThread>
 
 UdpCommClient::UdpCommClient(QObject *parent)
     : QObject{parent}, m_udpSocket{new QUdpSocket(this)}, m_remotePort(0),
     m_sequenceCounter(0), m_sequenceValLast(0), m_sequenceReceived(0), m_sequenceReceivedLast(0),
-    m_timerInterval(2000), m_commLostCounter(0), m_connected(false)
+    m_timerInterval(2000), m_commLostCounter(0), m_connected(false), m_receiveEngine(nullptr), m_resyncCount(0),
+    m_recorder(nullptr), m_replayer(nullptr), m_replaying(false),
+    m_socketInFlight(0)
 {
     qRegisterMetaType<EventData>("EventData");
     qRegisterMetaType<QList<EventData>>("QList<EventData>");
     qRegisterMetaType<QList<EventData>*>("QList<EventData>*");
+    qRegisterMetaType<EventBatch>("EventBatch");
+    qRegisterMetaType<EventBatchPtr>("EventBatchPtr");
+    qRegisterMetaType<WaveformBlock>("WaveformBlock");
     connect(m_udpSocket, &QUdpSocket::readyRead, this, &UdpCommClient::onReadyRead);
 
     m_handshakeTimer = new QTimer();
@@ -19,11 +28,28 @@ UdpCommClient::UdpCommClient(QObject *parent)
 
     connect(m_handshakeTimer, &QTimer::timeout, this, &UdpCommClient::onHandshakeTimerTimeout);
 
-    m_remoteAddress = QHostAddress("192.168.8.10");
-    m_remotePort = 5001;
-    m_localAddress = QHostAddress("192.168.8.35");
-    m_localPort = 8080;
+    // Loopback addresses in the preferences run against the SoC simulator
+    const AppSettings &settings = AppSettings::instance();
+    m_remoteAddress = QHostAddress(settings.socAddress());
+    m_remotePort = settings.socPort();
+    m_localAddress = QHostAddress(settings.localAddress());
+    m_localPort = settings.localPort();
+}
+
+UdpCommClient::~UdpCommClient()
+{
+    if (m_receiveEngine) {
+        m_receiveEngine->stop();
+    }
+    stopReplay();
+    stopRecording();
+    delete m_replayer;
+    delete m_recorder.load();
+}
 
+UdpReceiveStats UdpCommClient::receiveStats() const
+{
+    return m_receiveEngine ? m_receiveEngine->stats() : UdpReceiveStats();
 }
 
 void UdpCommClient::startUdpClient()
@@ -41,6 +67,24 @@ void UdpCommClient::startUdpClient()
 
 void UdpCommClient::doInitialize()
 {
+#if ENABLE_RECVMMSG_ENGINE
+    m_receiveEngine = new UdpReceiveEngine(m_receiveConfig, this);
+    m_receiveEngine->setDatagramHandler([this](const char *data, int size, const QHostAddress &sender, quint16 senderPort) {
+        receiveDatagram(data, size, sender, senderPort);
+    });
+    if (m_receiveEngine->open(m_localAddress, m_localPort)) {
+        qDebug() << "[UdpCommClient] Receive engine bound on"
+                 << m_localAddress.toString() << ":" << m_localPort
+                 << "receive buffer" << m_receiveEngine->receiveBufferSize() << "bytes";
+        m_receiveEngine->start();
+        return;
+    }
+    qWarning() << "[UdpCommClient] Receive engine unavailable, falling back to QUdpSocket:"
+               << m_receiveEngine->errorString();
+    delete m_receiveEngine;
+    m_receiveEngine = nullptr;
+#endif
+
     bool bindOk = m_udpSocket->bind(m_localAddress, m_localPort, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
     if (!bindOk) {
         qWarning() << "[UdpCommClient] Failed to bind on"
@@ -56,6 +100,13 @@ void UdpCommClient::doInitialize()
 bool UdpCommClient::sendFrame(CommCmdType commandType, const QByteArray &data)
 {
     QByteArray frame = UdpCommFrame::packFrame(++m_sequenceCounter, commandType, data);
+    if (m_receiveEngine) {
+        if (m_receiveEngine->sendTo(frame, m_remoteAddress, m_remotePort) != frame.size()) {
+            qWarning() << "[UdpCommClient] Failed to send frame!";
+            return false;
+        }
+        return true;
+    }
     qint64 bytesSent = m_udpSocket->writeDatagram(frame, m_remoteAddress, m_remotePort);
     if (bytesSent != frame.size()) {
         qWarning() << "[UdpCommClient] Failed to send frame!"
@@ -238,39 +289,154 @@ void UdpCommClient::onReadyRead()
         quint16 senderPort = 0;
         m_udpSocket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
 
-        m_receiveBuffer.append(datagram);
+        receiveDatagram(datagram.constData(), datagram.size(), sender, senderPort);
+    }
+}
 
-        // Try to parse frames in a loop, because there may be multiple frames or partial frames
-        while (true) {
-            QByteArray oneFrame;
-            if (!UdpCommFrame::tryParseFrame(m_receiveBuffer, oneFrame)) {
-                break;
-            }
-            // We got a complete, valid frame
-            quint16 sequence = UdpCommFrame::getSequence(oneFrame);
-            m_sequenceReceived = sequence;
-
-            CommCmdType cmdType = UdpCommFrame::getCommandType(oneFrame);
-            QByteArray dataField = UdpCommFrame::getDataField(oneFrame);
-
-            // Emit signal to notify listeners
-            emit frameReceived(sequence, cmdType, dataField, sender, senderPort);
-            switch (cmdType) {
-                case CommCmdType::CMD_HAND_SHAKE:
-                    parseHandshakeFrame(dataField);
-                    break;
-                case CommCmdType::CMD_PULSE_DATA:
-                    // parseSampleData(dataField);
-                    parseEventData(dataField);
-                    break;
-                case CommCmdType::CMD_WAVEFORM_DATA:
-                    parseWaveformFrame(dataField);
-                    break;
-                default:
-                    break;
+void UdpCommClient::receiveDatagram(const char *data, int size, const QHostAddress &sender, quint16 senderPort)
+{
+    // Paired with startReplay(): either the replay sees this datagram in flight, or this sees the replay
+    m_socketInFlight.fetch_add(1);
+    if (m_replaying.load()) {
+        m_socketInFlight.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    DatagramRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+    if (recorder) {
+        recorder->record(data, size, sender, senderPort);
+    }
+    processDatagram(data, size, sender, senderPort);
+    m_socketInFlight.fetch_sub(1, std::memory_order_release);
+}
+
+bool UdpCommClient::startRecording(const QString &filePath)
+{
+    DatagramRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+    if (!recorder) {
+        recorder = new DatagramRecorder();
+        m_recorder.store(recorder, std::memory_order_release);
+    }
+    return recorder->startRecording(filePath);
+}
+
+void UdpCommClient::stopRecording()
+{
+    DatagramRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+    if (!recorder) {
+        return;
+    }
+    recorder->stopRecording();
+    if (recorder->hasWriteError()) {
+        qWarning() << "[UdpCommClient] Capture file" << recorder->filePath() << "could not be written, it ends early";
+    }
+    if (recorder->droppedDatagrams() != 0) {
+        qWarning() << "[UdpCommClient] Capture missed" << recorder->droppedDatagrams() << "datagrams, the disk could not keep up";
+    }
+}
+
+bool UdpCommClient::startReplay(const QString &filePath, double speed)
+{
+    // The replayer is a child of this client, so it is created on the client thread
+    if (QThread::currentThread() != thread()) {
+        if (!thread()->isRunning()) {
+            qWarning() << "[UdpCommClient] Client thread is not running, replay not started";
+            return false;
+        }
+        bool ok = false;
+        QMetaObject::invokeMethod(this, [this, &ok, filePath, speed]() {
+            ok = startReplay(filePath, speed);
+        }, Qt::BlockingQueuedConnection);
+        return ok;
+    }
+    if (!m_replayer) {
+        m_replayer = new DatagramReplayer(this);
+        // The replay thread is the only one feeding the parser while it runs
+        m_replayer->setDatagramHandler([this](const char *data, int size, const QHostAddress &sender, quint16 senderPort) {
+            processDatagram(data, size, sender, senderPort);
+        });
+        connect(m_replayer, &DatagramReplayer::replayFinished, this, [this](quint64 datagrams, quint64 bytes, qint64 elapsedMs) {
+            // Queued, a replay started since then keeps the socket off
+            if (!m_replayer->isRunning()) {
+                m_replaying = false;
             }
+            qDebug() << "[UdpCommClient] Replayed" << datagrams << "datagrams," << bytes << "bytes in" << elapsedMs << "ms";
+            emit replayFinished(datagrams, bytes, elapsedMs);
+        });
+    }
+    // The socket stops feeding the parser, and a datagram already in it is let through, before the replay starts
+    m_replaying.store(true);
+    while (m_socketInFlight.load(std::memory_order_acquire) != 0) {
+        QThread::yieldCurrentThread();
+    }
+    if (!m_replayer->open(filePath, speed)) {
+        m_replaying = false;
+        return false;
+    }
+    m_replayer->start();
+    return true;
+}
+
+void UdpCommClient::stopReplay()
+{
+    if (QThread::currentThread() != thread() && thread()->isRunning()) {
+        QMetaObject::invokeMethod(this, &UdpCommClient::stopReplay, Qt::BlockingQueuedConnection);
+        return;
+    }
+    if (m_replayer) {
+        m_replayer->stop();
+    }
+    m_replaying = false;
+}
+
+void UdpCommClient::processDatagram(const char *data, int size, const QHostAddress &sender, quint16 senderPort)
+{
+    m_frameScanner.append(data, size);
+
+    // There may be multiple frames or partial frames in the buffer
+    FrameView view;
+    ContinuityMonitor &monitor = ContinuityMonitor::instance();
+    while (m_frameScanner.next(view)) {
+        m_sequenceReceived = view.sequence;
+        monitor.recordFrame(view.sequence);
+
+        // The payload is parsed in place, it is only copied for the signal
+        QByteArray dataField = QByteArray::fromRawData(m_frameScanner.data() + view.dataOffset, view.dataLength);
+        if (isSignalConnected(QMetaMethod::fromSignal(&UdpCommClient::frameReceived))) {
+            emit frameReceived(view.sequence, view.cmdType, QByteArray(dataField.constData(), dataField.size()), sender, senderPort);
+        }
+        switch (view.cmdType) {
+            case CommCmdType::CMD_HAND_SHAKE:
+                parseHandshakeFrame(dataField);
+                break;
+            case CommCmdType::CMD_PULSE_DATA:
+                // parseSampleData(dataField);
+                parseEventData(dataField);
+                break;
+            case CommCmdType::CMD_WAVEFORM_DATA:
+                parseWaveformFrame(dataField);
+                break;
+            default:
+                break;
         }
     }
+    m_frameScanner.compact();
+
+    monitor.setFrameResyncs(m_frameScanner.resyncCount());
+    if (m_receiveEngine) {
+        monitor.setKernelDrops(m_receiveEngine->stats().kernelDrops);
+    }
+
+    const quint64 resyncs = m_frameScanner.resyncCount();
+    if (resyncs != m_resyncCount.load(std::memory_order_relaxed)) {
+        m_resyncCount.store(resyncs, std::memory_order_relaxed);
+        qWarning() << "[UdpCommClient] Frame stream resynchronized," << resyncs << "times,"
+                   << m_frameScanner.discardedBytes() << "bytes discarded in total";
+    }
+}
+
+quint64 UdpCommClient::frameResyncCount() const
+{
+    return m_resyncCount.load(std::memory_order_relaxed);
 }
 
 void UdpCommClient::parseHandshakeFrame(const QByteArray &data)
@@ -289,59 +455,32 @@ void UdpCommClient::parseHandshakeFrame(const QByteArray &data)
 */
 void UdpCommClient::parseEventData(const QByteArray &data)
 {
-    int channelSize = EventDataManager::instance().enabledChannels().size();
-    int eventSize = channelSize * 3 + 5;
-    int eventByteSize = eventSize * 4;
-    int eventNum = data.size() / eventByteSize;
-
-    if (eventNum < 1) {
-        qWarning() << QString("Received Event Data Frame is too short, expected atleast %d bytes, but %d byte actually").arg(eventByteSize).arg(data.size());
-        return;
+    const QVector<int> &channels = EventDataManager::instance().enabledChannels();
+    if (channels != m_eventDecoder.enabledChannels()) {
+        m_eventDecoder.setEnabledChannels(channels, EventDataManager::instance().kernels());
     }
 
-
-    QVector<EventData> eventDataBuffer;
-    int enableSortNum = 0;
-    int sortedNum = 0;
-    int timeSpanBuff = 0;
-    int validEventNum = 0;
-
-    for (int i = 0; i < eventNum; i++) {
-        EventData eventData(EventDataManager::instance().enabledChannels(), data.mid(i * eventByteSize, eventByteSize));
-        if (!eventData.isValidEvent()) {
-            continue;
-        }
-        validEventNum++;
-        if (eventData.isEnabledSort()) {
-            enableSortNum++;
-        }
-        if (eventData.isRealSorted()) {
-            sortedNum++;
-        }
-
-        timeSpanBuff += eventData.getDiffTimeUs();
-        eventDataBuffer.append(eventData);
+    if (data.size() < m_eventDecoder.eventByteSize()) {
+        qWarning() << QString("Received Event Data Frame is too short, expected atleast %1 bytes, but %2 byte actually").arg(m_eventDecoder.eventByteSize()).arg(data.size());
+        return;
     }
 
+    // Filled once here, then shared read-only by every consumer until it returns to the pool
+    std::shared_ptr<EventBatch> eventBatch = EventBatchPool::instance().acquire(channels, data.size() / m_eventDecoder.eventByteSize());
+    EventFrameStats stats = m_eventDecoder.decode(data.constData(), data.size(), *eventBatch);
 
+    ContinuityMonitor::instance().recordInvalidEvents(stats.invalidEvents);
+    ContinuityMonitor::instance().recordEvents(eventBatch->eventIds(), eventBatch->size());
 
-
-    if (eventNum != validEventNum) {
-        qDebug() << "Received " << eventNum << " Events Data" << validEventNum << "Valid" << data.first(4) << data.last(4);
+    if (stats.invalidEvents != 0) {
+        qDebug() << "Received " << stats.totalEvents << " Events Data" << stats.validEvents << "Valid" << data.first(4) << data.last(4);
     }
 
-    // QDataStream stream(data);
-
-    // while (!stream.atEnd()) {
-    //     EventData eventData(EventDataManager::instance().enabledChannels(), stream);
-    //     eventDataBuffer.append(eventData);
-    // }
-
-    if (validEventNum == 0) {
+    if (stats.validEvents == 0) {
         return;
     }
-    double timeSpan = (double)timeSpanBuff / validEventNum;
-    emit eventDataReady(eventDataBuffer, enableSortNum, sortedNum, timeSpan);
+    double timeSpan = (double)stats.diffTimeSum / stats.validEvents;
+    emit eventDataReady(eventBatch, stats.enableSortNum, stats.sortedNum, timeSpan);
 }
 
 void UdpCommClient::parseSampleData(const QByteArray &data)
@@ -406,40 +545,18 @@ void UdpCommClient::parseSampleData(const QByteArray &data)
 
 void UdpCommClient::parseWaveformFrame(const QByteArray &data)
 {
-    // QVector<QVector<int>> waveform;
-    // QDataStream stream(data);
-    // int numWaveforms = 0;
-    // quint16 enabledChannels = 0;
-    // stream >> numWaveforms;
-    // stream >> enabledChannels;
-    // QList<int> enabledChannelsList;
-    // for (int i = 0; i < 8; ++i) {
-    //     if (enabledChannels & (1 << i)) {
-    //         enabledChannelsList.push_back(i);
-    //     }
-    // }
-    // waveform.resize(numWaveforms);
-    // for (int i = 0; i < numWaveforms; i++) {
-    //     waveform[i].resize(enabledChannelsList.size());
-    // }
-    // int expectedDataLength = numWaveforms * enabledChannelsList.size() * sizeof(int);
-    // if (data.size() != expectedDataLength + sizeof(int) + sizeof(quint16)) {
-    //     qWarning() << "[UdpCommClient] Incorrect waveform data length!";
-    //     return;
-    // }
-
-    // for (int i = 0; i < numWaveforms; i++) {
-    //     for (int j = 0; j < enabledChannelsList.size(); j++) {
-    //         stream >> waveform[i][j];
-    //     }
-    // }
-    QVector<int> waveform;
-    QDataStream stream(data);
-    while (!stream.atEnd()) {
-        int value;
-        stream >> value;
-        waveform.append(value);
+    // Decoded and split by channel here, the GUI only appends the blocks
+    WaveformBlock block;
+    if (m_waveformDecoder.decode(data.constData(), data.size(), block) == 0) {
+        return;
+    }
+    if (block.invalidSamples != 0) {
+        qDebug() << "[UdpCommClient]" << block.invalidSamples << "waveform samples with invalid channel";
     }
+    emit waveformDataReceived(block);
+}
 
-    emit waveformDataReceived(waveform);
+void UdpCommClient::setWaveformMillivolts(bool enabled)
+{
+    m_waveformDecoder.setScaleToMillivolts(enabled);
 }
@@ -9,6 +9,12 @@
 #include "Gate.h"
 #include <QTimer>
 #include "EventData.h"
+#include "EventBatchPool.h"
+#include "EventFrameDecoder.h"
+#include "UdpReceiveEngine.h"
+#include "DatagramCapture.h"
+#include "WaveformDecoder.h"
+#include <atomic>
 
 using SampleData = QVector<QVector<int>>;
 
@@ -25,9 +31,42 @@ class UdpCommClient : public QObject
     Q_OBJECT
 public:
     explicit UdpCommClient(QObject *parent = nullptr);
+    ~UdpCommClient();
 
     void     startUdpClient();
 
+    /**
+     * @brief Settings of the recvmmsg receive engine, must be set before doInitialize() runs.
+     */
+    void     setReceiveConfig(const UdpReceiveConfig &config) { m_receiveConfig = config; }
+
+    /**
+     * @brief Counters of the recvmmsg receive engine, all zero on the QUdpSocket path.
+     */
+    UdpReceiveStats receiveStats() const;
+
+    /**
+     * @brief Number of times the frame scanner lost the frame boundary and searched for the next header.
+     */
+    quint64 frameResyncCount() const;
+
+    /**
+     * @brief Journals every received datagram to a capture file until stopRecording().
+     */
+    bool startRecording(const QString &filePath);
+    void stopRecording();
+
+    /**
+     * @brief Feeds a capture file through the frame parser instead of the socket.
+     * @param speed 1 for the recorded timing, N for N times faster, 0 for as fast as possible.
+     *
+     * Datagrams arriving on the socket are ignored while the replay runs.
+     * Both may be called from any thread, they block until the client thread
+     * has run them.
+     */
+    bool startReplay(const QString &filePath, double speed);
+    void stopReplay();
+
 
 public slots:
     /**
@@ -62,6 +101,11 @@ public slots:
 
     bool sendDisableDetector(int id);
 
+    /**
+     * @brief Makes the waveform decoder scale samples to mV, may be called from any thread.
+     */
+    void setWaveformMillivolts(bool enabled);
+
 private slots:
     void onHandshakeTimerTimeout();
 
@@ -81,9 +125,11 @@ signals:
                        quint16 senderPort);
 
     void sampleDataReady(QVector<SampleData> data);
-    void eventDataReady(QVector<EventData> data, int enableSortNum, int sortedNum, double timeSpan);
+    void eventDataReady(const EventBatchPtr &data, int enableSortNum, int sortedNum, double timeSpan);
     void handshakeReceived(const QHostAddress &sender, quint16 senderPort);
-    void waveformDataReceived(const QVector<int> &data);
+    void waveformDataReceived(const WaveformBlock &data);
+
+    void replayFinished(quint64 datagrams, quint64 bytes, qint64 elapsedMs);
 
     void udpCommEstablished();
     void udpCommLost();
@@ -103,7 +149,7 @@ private:
     quint16         m_remotePort;           ///< The remote port to send data
     QHostAddress    m_localAddress;         ///< The local address to bind to
     quint16         m_localPort;            ///< The local port
-    QByteArray      m_receiveBuffer;        ///< A buffer to accumulate incoming data
+    FrameScanner    m_frameScanner;         ///< Accumulates incoming data and finds the frames in it
 
     quint16         m_sequenceCounter;      ///< Sequence counter that increments for each frame sent
     quint16         m_sequenceValLast;      ///< Sequence value in last timer interrupt
@@ -112,9 +158,32 @@ private:
     bool            m_connected;            ///< Communication state with SoC
 
 
-    quint16         m_sequenceReceived;     ///< Sequence value received from SoC
+    std::atomic<quint16> m_sequenceReceived; ///< Sequence value received from SoC, written by the receive thread
     quint16         m_sequenceReceivedLast; ///< Sequence value received from SoC in last time
     QTimer          *m_handshakeTimer;      ///< Timer for handshake frame
+    EventFrameDecoder m_eventDecoder;       ///< Bulk decoder for pulse data frames
+    WaveformDecoder m_waveformDecoder;      ///< Bulk decoder for waveform frames
+    UdpReceiveEngine *m_receiveEngine;      ///< Owns the socket when the recvmmsg engine is in use
+    UdpReceiveConfig m_receiveConfig;       ///< Applied to the receive engine in doInitialize()
+    std::atomic<quint64> m_resyncCount;     ///< Frame scanner resyncs, published for other threads
+    std::atomic<DatagramRecorder *> m_recorder; ///< Created on the first recording, kept until destruction
+    DatagramReplayer *m_replayer;           ///< Created on the first replay
+    std::atomic<bool> m_replaying;          ///< Socket datagrams are dropped while set
+    std::atomic<int> m_socketInFlight;      ///< Socket datagrams between the m_replaying check and the parser's end
+
+    /**
+     * @brief Entry point of the socket and receive engine datagrams, records them and feeds the parser.
+     */
+    void receiveDatagram(const char *data, int size, const QHostAddress &sender, quint16 senderPort);
+
+
+    /**
+     * @brief Feeds one datagram to the frame scanner and dispatches the complete frames.
+     *
+     * Called by onReadyRead() on the QUdpSocket path, or on the receive engine
+     * thread, never by both.
+     */
+    void processDatagram(const char *data, int size, const QHostAddress &sender, quint16 senderPort);
 
 
     void parseHandshakeFrame(const QByteArray &data);
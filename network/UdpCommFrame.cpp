@@ -1,4 +1,9 @@
 #include "UdpCommFrame.h"
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRAME_CHECKSUM_SSE2 1
+#endif
 
 
 UdpCommFrame::UdpCommFrame() {}
@@ -6,21 +11,39 @@ UdpCommFrame::UdpCommFrame() {}
 
 quint16 UdpCommFrame::checkSum(const QByteArray &frameWithoutCheckSum)
 {
-    quint16 sum = 0;
-    for (int i = 0; i < frameWithoutCheckSum.size(); ++i) {
-        sum += static_cast<quint8>(frameWithoutCheckSum.at(i));
+    return checkSum(frameWithoutCheckSum.constData(), frameWithoutCheckSum.size());
+}
+
+quint16 UdpCommFrame::checkSum(const char *data, int size)
+{
+    const quint8 *bytes = reinterpret_cast<const quint8*>(data);
+    quint32 sum = 0;
+    int i = 0;
+#ifdef FRAME_CHECKSUM_SSE2
+    // _mm_sad_epu8 against zero adds 8 bytes into each 64-bit lane
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    sum = static_cast<quint32>(_mm_cvtsi128_si32(acc)) + static_cast<quint32>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; i < size; ++i) {
+        sum += bytes[i];
     }
-    return sum;
+    return static_cast<quint16>(sum);
 }
 
 
-QByteArray UdpCommFrame::packFrame(quint16 sequence, CommCmdType cmdType, const QByteArray &data)
+QByteArray UdpCommFrame::packFrame(quint16 sequence, CommCmdType cmdType, const QByteArray &data, quint8 header)
 {
     // Frame layout:
     // [0xA5 | 0x5A(1B)] + [sequence (2B)] + [commandType (2B)]
     // + [dataLen (2B)] + [data (N B)] + [checkSum (2B)]
     QByteArray frame;
-    frame.append(FRAME_HEADER_TO_SOC);
+    frame.reserve(data.size() + FRAME_MIN_SIZE);
+    frame.append(static_cast<char>(header));
     frame.append(static_cast<char>((sequence >> 8) & 0xFF));
     frame.append(static_cast<char>(sequence & 0xFF));
     frame.append(static_cast<char>((static_cast<quint8>(cmdType) >> 8) & 0xFF));
@@ -36,48 +59,56 @@ QByteArray UdpCommFrame::packFrame(quint16 sequence, CommCmdType cmdType, const
 
 bool UdpCommFrame::verifyFrame(const QByteArray &frame)
 {
-    if (frame.size() < 9) {
+    return verifyFrame(frame.constData(), frame.size());
+}
+
+bool UdpCommFrame::verifyFrame(const char *frame, int size)
+{
+    if (size < FRAME_MIN_SIZE) {
         return false;
     }
-    if (frame.at(0) != FRAME_HEADER_FROM_SOC) {
+    if (static_cast<quint8>(frame[0]) != FRAME_HEADER_FROM_SOC) {
         return false;
     }
-    quint16 dataLen = (static_cast<quint8>(frame.at(5)) << 8) | static_cast<quint8>(frame.at(6));
-    if (frame.size() != dataLen + 9) {
+    quint16 dataLen = (static_cast<quint8>(frame[5]) << 8) | static_cast<quint8>(frame[6]);
+    if (size != dataLen + FRAME_MIN_SIZE) {
         return false;
     }
-    quint16 checksum = (static_cast<quint8>(frame.at(dataLen + 7)) << 8) | static_cast<quint8>(frame.at(dataLen + 8));
-    QByteArray frameWithoutChecksum = frame.left(dataLen + 7);
-    return checkSum(frameWithoutChecksum) == checksum;
+    quint16 checksum = (static_cast<quint8>(frame[dataLen + 7]) << 8) | static_cast<quint8>(frame[dataLen + 8]);
+    return checkSum(frame, dataLen + FRAME_HEAD_SIZE) == checksum;
 }
 
 bool UdpCommFrame::tryParseFrame(QByteArray &buffer, QByteArray &frame)
 {
-    if (buffer.size() < 9) {
-        return false;
-    }
-    if (buffer.at(0) != FRAME_HEADER_FROM_SOC) {
-        buffer.remove(0, 1);
-        return false;
-    }
-    quint16 dataLen = (static_cast<quint8>(buffer.at(5)) << 8) | static_cast<quint8>(buffer.at(6));
-    int expectedSize = 1 + 2 + 2 + 2 + dataLen + 2;
-    // If we haven't received enough bytes for a complete frame, wait for more data
-    if (buffer.size() < expectedSize) {
-        return false;
-    }
-    // Extract one frame
-    QByteArray oneFrame = buffer.left(expectedSize);
-    // Verify the frame
-    if (!verifyFrame(oneFrame)) {
-        // If verification fails, remove one byte and retry
-        buffer.remove(0, 1);
-        return false;
+    // Skip straight to the next candidate header instead of one byte at a time
+    int start = 0;
+    while (buffer.size() - start >= FRAME_MIN_SIZE) {
+        const char *data = buffer.constData() + start;
+        const void *header = std::memchr(data, FRAME_HEADER_FROM_SOC, buffer.size() - start);
+        if (!header) {
+            start = buffer.size();
+            break;
+        }
+        start += static_cast<int>(static_cast<const char*>(header) - data);
+        if (buffer.size() - start < FRAME_MIN_SIZE) {
+            break;
+        }
+        data = buffer.constData() + start;
+        quint16 dataLen = (static_cast<quint8>(data[5]) << 8) | static_cast<quint8>(data[6]);
+        int expectedSize = dataLen + FRAME_MIN_SIZE;
+        // If we haven't received enough bytes for a complete frame, wait for more data
+        if (buffer.size() - start < expectedSize) {
+            break;
+        }
+        if (verifyFrame(data, expectedSize)) {
+            frame = buffer.mid(start, expectedSize);
+            buffer.remove(0, start + expectedSize);
+            return true;
+        }
+        start++;
     }
-    // If valid, set 'frame' and remove those bytes from 'buffer'
-    frame = oneFrame;
-    buffer.remove(0, expectedSize);
-    return true;
+    buffer.remove(0, start);
+    return false;
 }
 
 quint16 UdpCommFrame::getSequence(const QByteArray &frame)
@@ -97,6 +128,92 @@ QByteArray UdpCommFrame::getDataField(const QByteArray &frame)
 }
 
 
+void FrameScanner::append(const char *data, int size)
+{
+    m_buffer.append(data, size);
+}
 
+void FrameScanner::discard(int size)
+{
+    if (!m_inResync) {
+        m_inResync = true;
+        m_resyncs++;
+    }
+    m_discardedBytes += size;
+    m_cursor += size;
+}
 
+bool FrameScanner::next(FrameView &view)
+{
+    const char *base = m_buffer.constData();
+    while (true) {
+        const int available = m_buffer.size() - m_cursor;
+        if (available < UdpCommFrame::FRAME_MIN_SIZE) {
+            return false;
+        }
+        const char *frame = base + m_cursor;
+        if (static_cast<quint8>(frame[0]) != UdpCommFrame::FRAME_HEADER_FROM_SOC) {
+            const void *header = std::memchr(frame, UdpCommFrame::FRAME_HEADER_FROM_SOC, available);
+            discard(header ? static_cast<int>(static_cast<const char*>(header) - frame) : available);
+            continue;
+        }
+
+        // The command high byte is always zero, a cheap test before the checksum
+        if (frame[3] != 0) {
+            discard(1);
+            continue;
+        }
+        const int dataLen = (static_cast<quint8>(frame[5]) << 8) | static_cast<quint8>(frame[6]);
+        const int frameSize = dataLen + UdpCommFrame::FRAME_MIN_SIZE;
+        if (available < frameSize) {
+            // The SoC never splits a frame across datagrams, so while resyncing
+            // a candidate running past the buffered bytes is not a frame start
+            if (m_inResync) {
+                discard(1);
+                continue;
+            }
+            // Wait for the rest of the frame
+            return false;
+        }
+        const quint16 checksum = (static_cast<quint8>(frame[dataLen + 7]) << 8) | static_cast<quint8>(frame[dataLen + 8]);
+        if (UdpCommFrame::checkSum(frame, dataLen + UdpCommFrame::FRAME_HEAD_SIZE) != checksum) {
+            // Not a frame start after all, search from the next byte
+            discard(1);
+            continue;
+        }
+
+        view.offset = m_cursor;
+        view.length = frameSize;
+        view.sequence = (static_cast<quint8>(frame[1]) << 8) | static_cast<quint8>(frame[2]);
+        view.cmdType = static_cast<CommCmdType>((static_cast<quint8>(frame[3]) << 8) | static_cast<quint8>(frame[4]));
+        view.dataOffset = m_cursor + UdpCommFrame::FRAME_HEAD_SIZE;
+        view.dataLength = dataLen;
+        m_cursor += frameSize;
+        m_inResync = false;
+        m_frames++;
+        return true;
+    }
+}
 
+void FrameScanner::compact()
+{
+    if (m_cursor == 0) {
+        return;
+    }
+    if (m_cursor >= m_buffer.size()) {
+        m_buffer.resize(0);         // keeps the capacity for the next datagram
+    } else {
+        m_buffer.remove(0, m_cursor);
+    }
+    m_cursor = 0;
+}
+
+void FrameScanner::reset()
+{
+    m_buffer.clear();
+    m_cursor = 0;
+    m_inResync = false;
+    m_frames = 0;
+    m_resyncs = 0;
+    m_discardedBytes = 0;
+}
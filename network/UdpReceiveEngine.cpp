@@ -0,0 +1,303 @@
+#include "UdpReceiveEngine.h"
+#include <QDebug>
+
+#if ENABLE_RECVMMSG_ENGINE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+
+UdpReceiveEngine::UdpReceiveEngine(const UdpReceiveConfig &config, QObject *parent)
+    : QThread{parent}, m_config(config), m_socket(-1), m_receiveBufferSize(0), m_stopRequested(false),
+    m_datagrams(0), m_bytes(0), m_syscalls(0), m_truncated(0), m_kernelDrops(0)
+{
+    m_config.batchSize = qMax(1, m_config.batchSize);
+    m_config.slotSize = qBound(512, m_config.slotSize, 65536);
+    setObjectName("UdpReceiveEngine");
+}
+
+UdpReceiveEngine::~UdpReceiveEngine()
+{
+    stop();
+    close();
+}
+
+bool UdpReceiveEngine::isSupported()
+{
+#if ENABLE_RECVMMSG_ENGINE
+    return true;
+#else
+    return false;
+#endif
+}
+
+UdpReceiveStats UdpReceiveEngine::stats() const
+{
+    UdpReceiveStats stats;
+    stats.datagrams = m_datagrams.load(std::memory_order_relaxed);
+    stats.bytes = m_bytes.load(std::memory_order_relaxed);
+    stats.syscalls = m_syscalls.load(std::memory_order_relaxed);
+    stats.truncated = m_truncated.load(std::memory_order_relaxed);
+    stats.kernelDrops = m_kernelDrops.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void UdpReceiveEngine::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stopRequested = true;
+    wait();
+}
+
+#if ENABLE_RECVMMSG_ENGINE
+
+bool UdpReceiveEngine::open(const QHostAddress &localAddress, quint16 localPort)
+{
+    close();
+
+    m_socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0) {
+        m_errorString = QString("socket() failed: %1").arg(strerror(errno));
+        return false;
+    }
+
+    int one = 1;
+    ::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (m_config.receiveBufferBytes > 0) {
+        int size = m_config.receiveBufferBytes;
+        ::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        socklen_t len = sizeof(m_receiveBufferSize);
+        ::getsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &m_receiveBufferSize, &len);
+        // The kernel reports twice the usable size, and caps requests at rmem_max
+        if (m_receiveBufferSize < size) {
+            if (::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == 0) {
+                ::getsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &m_receiveBufferSize, &len);
+            } else {
+                qWarning() << "[UdpReceiveEngine] SO_RCVBUF limited to" << m_receiveBufferSize
+                           << "bytes, raise net.core.rmem_max to get" << size;
+            }
+        }
+    }
+
+    if (::setsockopt(m_socket, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) != 0) {
+        qWarning() << "[UdpReceiveEngine] SO_RXQ_OVFL not available, kernel drops are not counted";
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(localPort);
+    addr.sin_addr.s_addr = localAddress.isNull() ? htonl(INADDR_ANY) : htonl(localAddress.toIPv4Address());
+    if (::bind(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        m_errorString = QString("bind() failed: %1").arg(strerror(errno));
+        close();
+        return false;
+    }
+
+    const int batch = m_config.batchSize;
+    const int controlSize = CMSG_SPACE(sizeof(quint32));
+    m_slab.resize(batch * m_config.slotSize);
+    m_control.resize(batch * controlSize);
+    m_headers.resize(batch * sizeof(mmsghdr));
+    m_iovecs.resize(batch * sizeof(iovec));
+    m_addresses.resize(batch * sizeof(sockaddr_in));
+    m_errorString.clear();
+    m_stopRequested = false;
+    return true;
+}
+
+void UdpReceiveEngine::close()
+{
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+qint64 UdpReceiveEngine::sendTo(const QByteArray &data, const QHostAddress &address, quint16 port)
+{
+    if (m_socket < 0) {
+        return -1;
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(address.toIPv4Address());
+    return ::sendto(m_socket, data.constData(), data.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+void UdpReceiveEngine::applyThreadSettings()
+{
+    if (m_config.cpuAffinity >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(m_config.cpuAffinity, &cpus);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ret != 0) {
+            qWarning() << "[UdpReceiveEngine] Failed to pin receive thread to CPU" << m_config.cpuAffinity << strerror(ret);
+        }
+    }
+    if (m_config.realtimePriority > 0) {
+        sched_param param;
+        param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), m_config.realtimePriority,
+                                      sched_get_priority_max(SCHED_FIFO));
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0) {
+            qWarning() << "[UdpReceiveEngine] Failed to set SCHED_FIFO priority" << param.sched_priority << strerror(ret);
+        }
+    }
+}
+
+/*
+ * Drains the socket with non-blocking recvmmsg calls. Returns the number of
+ * datagrams received, or -1 on a socket error.
+ */
+int UdpReceiveEngine::receiveBatch()
+{
+    const int batch = m_config.batchSize;
+    const int slotSize = m_config.slotSize;
+    const int controlSize = CMSG_SPACE(sizeof(quint32));
+    mmsghdr *headers = reinterpret_cast<mmsghdr*>(m_headers.data());
+    iovec *iovecs = reinterpret_cast<iovec*>(m_iovecs.data());
+    sockaddr_in *addresses = reinterpret_cast<sockaddr_in*>(m_addresses.data());
+    char *slab = m_slab.data();
+    char *control = m_control.data();
+
+    int total = 0;
+    while (!m_stopRequested) {
+        // recvmmsg overwrites the lengths, so the headers are refreshed for every call
+        for (int i = 0; i < batch; ++i) {
+            iovecs[i].iov_base = slab + i * slotSize;
+            iovecs[i].iov_len = slotSize;
+            msghdr &hdr = headers[i].msg_hdr;
+            hdr.msg_name = &addresses[i];
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_iov = &iovecs[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control + i * controlSize;
+            hdr.msg_controllen = controlSize;
+            hdr.msg_flags = 0;
+            headers[i].msg_len = 0;
+        }
+
+        int count = ::recvmmsg(m_socket, headers, batch, MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return total;
+            }
+            qWarning() << "[UdpReceiveEngine] recvmmsg failed:" << strerror(errno);
+            return -1;
+        }
+        if (count == 0) {
+            return total;
+        }
+        m_syscalls.fetch_add(1, std::memory_order_relaxed);
+
+        quint64 bytes = 0;
+        int delivered = 0;
+        for (int i = 0; i < count; ++i) {
+            msghdr &hdr = headers[i].msg_hdr;
+            for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    quint32 drops;
+                    std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                    m_kernelDrops.store(drops, std::memory_order_relaxed);
+                }
+            }
+            if (hdr.msg_flags & MSG_TRUNC) {
+                m_truncated.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            const int size = static_cast<int>(headers[i].msg_len);
+            bytes += size;
+            delivered++;
+            if (m_handler) {
+                QHostAddress sender(reinterpret_cast<const sockaddr*>(&addresses[i]));
+                m_handler(slab + i * slotSize, size, sender, ntohs(addresses[i].sin_port));
+            }
+        }
+        m_datagrams.fetch_add(delivered, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        total += count;
+
+        if (count < batch) {
+            return total;
+        }
+    }
+    return total;
+}
+
+void UdpReceiveEngine::run()
+{
+    applyThreadSettings();
+
+    pollfd pfd;
+    pfd.fd = m_socket;
+    pfd.events = POLLIN;
+    while (!m_stopRequested) {
+        pfd.revents = 0;
+        int ret = ::poll(&pfd, 1, m_config.pollTimeoutMs);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "[UdpReceiveEngine] poll failed:" << strerror(errno);
+            break;
+        }
+        if (ret == 0) {
+            continue;
+        }
+        if (receiveBatch() < 0) {
+            break;
+        }
+    }
+}
+
+#else
+
+bool UdpReceiveEngine::open(const QHostAddress &localAddress, quint16 localPort)
+{
+    Q_UNUSED(localAddress);
+    Q_UNUSED(localPort);
+    m_errorString = "recvmmsg receive engine is not enabled in this build";
+    return false;
+}
+
+void UdpReceiveEngine::close()
+{
+}
+
+qint64 UdpReceiveEngine::sendTo(const QByteArray &data, const QHostAddress &address, quint16 port)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    return -1;
+}
+
+void UdpReceiveEngine::applyThreadSettings()
+{
+}
+
+int UdpReceiveEngine::receiveBatch()
+{
+    return -1;
+}
+
+void UdpReceiveEngine::run()
+{
+}
+
+#endif
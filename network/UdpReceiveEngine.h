@@ -0,0 +1,103 @@
+#ifndef UDPRECEIVEENGINE_H
+#define UDPRECEIVEENGINE_H
+
+#include <QThread>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+
+/**
+ * @brief Settings of UdpReceiveEngine, applied when the socket is opened.
+ */
+struct UdpReceiveConfig
+{
+    int     batchSize = 64;                 ///< Datagrams per recvmmsg call
+    int     slotSize = 65536;               ///< Bytes reserved per datagram in the slab
+    int     receiveBufferBytes = 16 << 20;  ///< SO_RCVBUF request, 0 keeps the system default
+    int     cpuAffinity = -1;               ///< CPU to pin the receive thread to, -1 for none
+    int     realtimePriority = 0;           ///< SCHED_FIFO priority, 0 keeps the normal scheduler
+    int     pollTimeoutMs = 100;            ///< Upper bound on the time stop() waits for the thread
+};
+
+
+/**
+ * @brief Counters of UdpReceiveEngine, safe to read from any thread.
+ */
+struct UdpReceiveStats
+{
+    quint64 datagrams = 0;          ///< Datagrams handed to the handler, truncated ones excluded
+    quint64 bytes = 0;              ///< Payload bytes handed to the handler
+    quint64 syscalls = 0;           ///< recvmmsg calls returning data
+    quint64 truncated = 0;          ///< Datagrams larger than a slab slot, dropped
+    quint64 kernelDrops = 0;        ///< Socket queue overflows reported by SO_RXQ_OVFL
+};
+
+
+/**
+ * @brief Linux receive engine owning a UDP socket on a dedicated thread.
+ *
+ * Datagrams are pulled batchSize at a time with recvmmsg() into a slab that
+ * is allocated once in open(), and handed to the handler in place. The
+ * handler runs on the receive thread and must not keep the pointer. Sending
+ * goes through the same socket with sendto(), which may be called from any
+ * thread.
+ *
+ * Only available when built with ENABLE_RECVMMSG_ENGINE, elsewhere open()
+ * fails and the caller falls back to QUdpSocket.
+ */
+class UdpReceiveEngine : public QThread
+{
+    Q_OBJECT
+public:
+    using DatagramHandler = std::function<void(const char *data, int size, const QHostAddress &sender, quint16 senderPort)>;
+
+    explicit UdpReceiveEngine(const UdpReceiveConfig &config = UdpReceiveConfig(), QObject *parent = nullptr);
+    ~UdpReceiveEngine() override;
+
+    static bool isSupported();
+
+    void setDatagramHandler(const DatagramHandler &handler) { m_handler = handler; }
+    const UdpReceiveConfig &config() const { return m_config; }
+
+    bool    open(const QHostAddress &localAddress, quint16 localPort);
+    void    close();
+    void    stop();
+    bool    isOpen() const { return m_socket >= 0; }
+    QString errorString() const { return m_errorString; }
+    int     receiveBufferSize() const { return m_receiveBufferSize; }
+
+    qint64  sendTo(const QByteArray &data, const QHostAddress &address, quint16 port);
+
+    UdpReceiveStats stats() const;
+
+protected:
+    void run() override;
+
+private:
+    void applyThreadSettings();
+    int  receiveBatch();
+
+    UdpReceiveConfig        m_config;
+    DatagramHandler         m_handler;
+    int                     m_socket;
+    int                     m_receiveBufferSize;
+    QString                 m_errorString;
+    std::atomic<bool>       m_stopRequested;
+
+    QByteArray              m_slab;             ///< batchSize * slotSize payload bytes
+    QByteArray              m_control;          ///< Per message control buffer for SO_RXQ_OVFL
+    QByteArray              m_headers;          ///< struct mmsghdr[batchSize]
+    QByteArray              m_iovecs;           ///< struct iovec[batchSize]
+    QByteArray              m_addresses;        ///< struct sockaddr_in[batchSize]
+
+    std::atomic<quint64>    m_datagrams;
+    std::atomic<quint64>    m_bytes;
+    std::atomic<quint64>    m_syscalls;
+    std::atomic<quint64>    m_truncated;
+    std::atomic<quint64>    m_kernelDrops;
+};
+
+#endif // UDPRECEIVEENGINE_H
@@ -0,0 +1,55 @@
+#include "WaveformDecoder.h"
+#include "EventFrameDecoder.h"
+
+
+int WaveformDecoder::decode(const char *data, int size, WaveformBlock &output)
+{
+    const int sampleNum = size / static_cast<int>(sizeof(quint32));
+    output = WaveformBlock();
+    if (sampleNum < 1) {
+        return 0;
+    }
+    const bool millivolts = scaleToMillivolts();
+    output.inMillivolts = millivolts;
+
+    if (m_words.size() < sampleNum) {
+        m_words.resize(sampleNum);
+        m_scaled.resize(sampleNum);
+    }
+    EventFrameDecoder::wordsFromBigEndian(data, sampleNum, m_words.data());
+
+    // Sign extension of the low 18 bits and scaling, GCC vectorizes it at -O3 (Release), not at -O2
+    const quint32 *words = m_words.constData();
+    float *scaled = m_scaled.data();
+    const float scale = millivolts ? AD_TO_MV : 1.0f;
+    for (int i = 0; i < sampleNum; ++i) {
+        const qint32 value = static_cast<qint32>(words[i] << 14) >> 14;
+        scaled[i] = static_cast<float>(value) * scale;
+    }
+
+    // Channels are interleaved, every channel gets at most sampleNum samples
+    float *out[WaveformBlock::CHANNEL_NUM];
+    int count[WaveformBlock::CHANNEL_NUM] = {0};
+    for (int ch = 0; ch < WaveformBlock::CHANNEL_NUM; ++ch) {
+        out[ch] = nullptr;
+    }
+    for (int i = 0; i < sampleNum; ++i) {
+        const quint32 ch = words[i] >> 24;
+        if (ch >= static_cast<quint32>(WaveformBlock::CHANNEL_NUM)) {
+            output.invalidSamples++;
+            continue;
+        }
+        if (!out[ch]) {
+            output.values[ch].resize(sampleNum);
+            out[ch] = output.values[ch].data();
+            output.channelMask |= (0x01 << ch);
+        }
+        out[ch][count[ch]++] = scaled[i];
+    }
+    for (int ch = 0; ch < WaveformBlock::CHANNEL_NUM; ++ch) {
+        if (out[ch]) {
+            output.values[ch].resize(count[ch]);
+        }
+    }
+    return sampleNum - output.invalidSamples;
+}
@@ -0,0 +1,60 @@
+#ifndef WAVEFORMDECODER_H
+#define WAVEFORMDECODER_H
+
+#include <QVector>
+#include <QMetaType>
+#include <atomic>
+
+
+/**
+ * @brief Samples of one CMD_WAVEFORM_DATA frame, split by channel.
+ *
+ * values[ch] holds the samples of channel ch in arrival order, already sign
+ * extended and, if inMillivolts is set, scaled by WaveformDecoder::AD_TO_MV.
+ * The arrays are implicitly shared, the block crosses threads without a copy.
+ */
+struct WaveformBlock
+{
+    static constexpr int CHANNEL_NUM = 8;
+
+    QVector<float>  values[CHANNEL_NUM];
+    quint8          channelMask = 0;        ///< Bit ch set: values[ch] is not empty
+    bool            inMillivolts = false;
+    int             invalidSamples = 0;     ///< Samples with a channel id out of range
+};
+
+Q_DECLARE_METATYPE(WaveformBlock)
+
+
+/**
+ * @brief Bulk decoder for the payload of CMD_WAVEFORM_DATA frames.
+ *
+ * Sample word (32-bit big endian): [channel (8 bit)] [unused (6 bit)] [18-bit signed value]
+ *
+ * The frame is byte swapped in one call, the 18-bit values are sign extended
+ * and scaled in one branch free pass over all samples, and only the
+ * demultiplexing touches the samples one by one.
+ */
+class WaveformDecoder
+{
+public:
+    static constexpr float AD_TO_MV = 5000.0f / 131072.0f;
+
+    WaveformDecoder() = default;
+
+    void setScaleToMillivolts(bool enabled) { m_millivolts.store(enabled, std::memory_order_relaxed); }
+    bool scaleToMillivolts() const { return m_millivolts.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Decodes all whole sample words of the payload into output.
+     * @return Number of samples decoded.
+     */
+    int decode(const char *data, int size, WaveformBlock &output);
+
+private:
+    QVector<quint32>    m_words;            ///< Host order scratch buffer, grows only
+    QVector<float>      m_scaled;           ///< Sign extended and scaled samples, grows only
+    std::atomic<bool>   m_millivolts{false};    ///< Set from the GUI thread
+};
+
+#endif // WAVEFORMDECODER_H
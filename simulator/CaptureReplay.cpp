@@ -0,0 +1,89 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QDebug>
+#include "DatagramCapture.h"
+#include "UdpCommFrame.h"
+#include "EventFrameDecoder.h"
+#include "ContinuityMonitor.h"
+
+
+/*
+ * Replays a capture of the SoC stream through the same FrameScanner and
+ * EventFrameDecoder the client uses, to benchmark parser changes against
+ * recorded instrument traffic. The channel layout is not part of the
+ * capture and has to match the detector settings of the recording.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("SeekCaptureReplay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a datagram capture through the frame parser and event decoder.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file written by the datagram recorder.");
+    QCommandLineOption speedOption("speed", "1 for the recorded timing, N for N times faster, 0 for maximum speed.", "factor", "0");
+    QCommandLineOption channelsOption("channels", "Enabled detector ids of the recording, comma separated.", "ids", "0,1,2,3");
+    QCommandLineOption loopOption("loop", "Replay the capture this many times.", "count", "1");
+    parser.addOptions({speedOption, channelsOption, loopOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    QVector<int> channels;
+    for (const QString &id : parser.value(channelsOption).split(',', Qt::SkipEmptyParts)) {
+        channels.append(id.trimmed().toInt());
+    }
+
+    FrameScanner scanner;
+    EventFrameDecoder decoder(channels);
+    EventBatch batch(channels, 1024);
+    ContinuityMonitor &monitor = ContinuityMonitor::instance();
+    monitor.reset();
+
+    quint64 frames = 0;
+    quint64 events = 0;
+    DatagramReplayer replayer;
+    replayer.setDatagramHandler([&](const char *data, int size, const QHostAddress &, quint16) {
+        scanner.append(data, size);
+        FrameView view;
+        while (scanner.next(view)) {
+            frames++;
+            monitor.recordFrame(view.sequence);
+            if (view.cmdType != CommCmdType::CMD_PULSE_DATA) {
+                continue;
+            }
+            batch.clear();
+            EventFrameStats stats = decoder.decode(scanner.data() + view.dataOffset, view.dataLength, batch);
+            monitor.recordInvalidEvents(stats.invalidEvents);
+            monitor.recordEvents(batch.eventIds(), batch.size());
+            events += stats.validEvents;
+        }
+        scanner.compact();
+    });
+
+    const QString capture = parser.positionalArguments().constFirst();
+    const int loops = qMax(1, parser.value(loopOption).toInt());
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < loops; ++i) {
+        if (!replayer.open(capture, parser.value(speedOption).toDouble())) {
+            qCritical() << "Failed to open" << capture << replayer.errorString();
+            return 1;
+        }
+        replayer.start();
+        replayer.wait();
+    }
+    const double seconds = qMax<qint64>(1, clock.nsecsElapsed()) / 1e9;
+    monitor.setFrameResyncs(scanner.resyncCount());
+
+    qInfo().noquote() << QString("%1 frames, %2 events in %3 s: %4 events/s, %5 frames/s")
+                             .arg(frames).arg(events).arg(seconds, 0, 'f', 3)
+                             .arg(events / seconds, 0, 'f', 0).arg(frames / seconds, 0, 'f', 0);
+    qInfo().noquote() << QJsonDocument(monitor.report().toJson()).toJson(QJsonDocument::Indented);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "SimScenario.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+
+static SimDistribution readDistribution(const QJsonValue &value, const SimDistribution &fallback)
+{
+    if (!value.isObject()) {
+        return fallback;
+    }
+    QJsonObject obj = value.toObject();
+    SimDistribution dist;
+    dist.mean = obj.value("mean").toDouble(fallback.mean);
+    dist.stdDev = obj.value("stdDev").toDouble(fallback.stdDev);
+    return dist;
+}
+
+static SimPopulation readPopulation(const QJsonObject &obj)
+{
+    SimPopulation population;
+    population.name = obj.value("name").toString("P");
+    population.weight = qMax(0.0, obj.value("weight").toDouble(1.0));
+    population.defaultHeight = readDistribution(obj.value("height"), population.defaultHeight);
+    population.defaultWidth = readDistribution(obj.value("width"), population.defaultWidth);
+    population.defaultArea = readDistribution(obj.value("area"), population.defaultArea);
+
+    QJsonObject channels = obj.value("channels").toObject();
+    for (auto it = channels.begin(); it != channels.end(); ++it) {
+        bool ok = false;
+        int id = it.key().toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+        QJsonObject ch = it.value().toObject();
+        population.height.insert(id, readDistribution(ch.value("height"), population.defaultHeight));
+        population.width.insert(id, readDistribution(ch.value("width"), population.defaultWidth));
+        population.area.insert(id, readDistribution(ch.value("area"), population.defaultArea));
+    }
+    return population;
+}
+
+bool SimScenario::load(const QString &filePath, QString *errorString)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!doc.isObject()) {
+        if (errorString) {
+            *errorString = parseError.errorString();
+        }
+        return false;
+    }
+
+    QJsonObject root = doc.object();
+    name = root.value("name").toString(name);
+    eventRate = qMax(0.0, root.value("eventRate").toDouble(eventRate));
+    eventsPerFrame = qMax(1, root.value("eventsPerFrame").toInt(eventsPerFrame));
+    eventPoolSize = qMax(1, root.value("eventPoolSize").toInt(eventPoolSize));
+    noise = root.value("noise").toDouble(noise);
+    diffTimeUs = readDistribution(root.value("diffTimeUs"), diffTimeUs);
+    eventIntervalUs = root.value("eventIntervalUs").toDouble(eventIntervalUs);
+    pulseValidRatio = root.value("pulseValidRatio").toDouble(pulseValidRatio);
+
+    if (root.value("channels").isArray()) {
+        channels.clear();
+        for (const QJsonValue &ch : root.value("channels").toArray()) {
+            channels.append(ch.toInt());
+        }
+    }
+
+    QJsonObject sort = root.value("sort").toObject();
+    sortEnableRatio = sort.value("enableRatio").toDouble(sortEnableRatio);
+    sortedRatio = sort.value("sortedRatio").toDouble(sortedRatio);
+
+    populations.clear();
+    for (const QJsonValue &value : root.value("populations").toArray()) {
+        populations.append(readPopulation(value.toObject()));
+    }
+    if (populations.isEmpty()) {
+        populations.append(SimPopulation());
+    }
+
+    QJsonObject waveform = root.value("waveform").toObject();
+    waveformSamplesPerFrame = qBound(1, waveform.value("samplesPerFrame").toInt(waveformSamplesPerFrame), 16000);
+    waveformPulseHeight = waveform.value("pulseHeight").toDouble(waveformPulseHeight);
+    waveformBaselineNoise = waveform.value("baselineNoise").toDouble(waveformBaselineNoise);
+
+    QJsonObject faultObj = root.value("faults").toObject();
+    faults.frameDropRate = faultObj.value("frameDropRate").toDouble(0);
+    faults.frameDuplicateRate = faultObj.value("frameDuplicateRate").toDouble(0);
+    faults.frameReorderRate = faultObj.value("frameReorderRate").toDouble(0);
+    faults.frameCorruptRate = faultObj.value("frameCorruptRate").toDouble(0);
+    faults.garbageRate = faultObj.value("garbageRate").toDouble(0);
+    faults.badMagicRate = faultObj.value("badMagicRate").toDouble(0);
+    faults.eventIdGapRate = faultObj.value("eventIdGapRate").toDouble(0);
+    return true;
+}
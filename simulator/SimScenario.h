@@ -0,0 +1,96 @@
+#ifndef SIMSCENARIO_H
+#define SIMSCENARIO_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+
+
+/**
+ * @brief Normal distribution of one measurement, in AD units.
+ */
+struct SimDistribution
+{
+    double mean = 0;
+    double stdDev = 0;
+};
+
+
+/**
+ * @brief One cell population, measurement distributions per detector id.
+ */
+struct SimPopulation
+{
+    QString name;
+    double  weight = 1.0;
+    QMap<int, SimDistribution> height;
+    QMap<int, SimDistribution> width;
+    QMap<int, SimDistribution> area;
+    SimDistribution defaultHeight{20000, 2000};
+    SimDistribution defaultWidth{40, 5};
+    SimDistribution defaultArea{400000, 40000};
+};
+
+
+/**
+ * @brief Fault injection rates, all probabilities in [0, 1].
+ */
+struct SimFaults
+{
+    double frameDropRate = 0;       ///< Frame is built but not sent
+    double frameDuplicateRate = 0;  ///< Frame is sent twice
+    double frameReorderRate = 0;    ///< Frame is held back and sent after the next one
+    double frameCorruptRate = 0;    ///< One random byte of the frame is flipped
+    double garbageRate = 0;         ///< Random bytes are sent in front of the frame
+    double badMagicRate = 0;        ///< Per event, the head magic is broken
+    double eventIdGapRate = 0;      ///< Per event, one event id is skipped
+};
+
+
+/**
+ * @brief Scenario file of the SoC simulator.
+ *
+ * JSON layout, every key is optional:
+ * {
+ *   "name": "two populations",
+ *   "eventRate": 100000,            events per second while acquiring
+ *   "eventsPerFrame": 256,          capped to what fits into one frame
+ *   "eventPoolSize": 65536,         pre-generated events, cycled while streaming
+ *   "channels": [1, 2, 3, 4],       detector ids, used until detector settings arrive
+ *   "noise": 200,                   extra gaussian noise on every measurement
+ *   "diffTimeUs": {"mean": 60, "stdDev": 5},
+ *   "eventIntervalUs": 0,           post time step, 0 derives it from the rate
+ *   "sort": {"enableRatio": 0.6, "sortedRatio": 0.9},
+ *   "pulseValidRatio": 1.0,
+ *   "populations": [
+ *     {"name": "P1", "weight": 0.7,
+ *      "height": {"mean": 30000, "stdDev": 2000},
+ *      "channels": {"1": {"height": {...}, "width": {...}, "area": {...}}}}
+ *   ],
+ *   "waveform": {"samplesPerFrame": 4096, "pulseHeight": 30000, "baselineNoise": 100},
+ *   "faults": {"frameDropRate": 0.001, ...}
+ * }
+ */
+struct SimScenario
+{
+    QString     name = "default";
+    double      eventRate = 10000;
+    int         eventsPerFrame = 256;
+    int         eventPoolSize = 65536;
+    QVector<int> channels{1, 2, 3, 4};
+    double      noise = 0;
+    SimDistribution diffTimeUs{60, 5};
+    double      eventIntervalUs = 0;
+    double      sortEnableRatio = 0.6;
+    double      sortedRatio = 0.9;
+    double      pulseValidRatio = 1.0;
+    QVector<SimPopulation> populations;
+    int         waveformSamplesPerFrame = 4096;
+    double      waveformPulseHeight = 30000;
+    double      waveformBaselineNoise = 100;
+    SimFaults   faults;
+
+    bool load(const QString &filePath, QString *errorString = nullptr);
+};
+
+#endif // SIMSCENARIO_H
@@ -0,0 +1,423 @@
+#include "SocSimulator.h"
+#include <QDataStream>
+#include <QtEndian>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+constexpr quint32 HEAD_MAGIC = 0x55AA55AA;
+constexpr quint32 TAIL_MAGIC = 0xAA55AA55;
+constexpr quint32 EVENT_ID_MASK = 0x000FFFFF;
+constexpr quint32 ENABLE_SORT_BIT = 0x00100000;
+constexpr quint32 SORTED_BIT = 0x00200000;
+constexpr quint32 VALID_MEASURE_BIT = 0x00400000;
+constexpr int     DETECTOR_SETTING_BYTES = 9;
+constexpr int     MAX_PAYLOAD_BYTES = 65000;        // keeps a frame inside one datagram
+constexpr int     STREAM_TICK_MS = 1;
+
+// Detector ids start at 1, the SoC reports detector n in pulse valid bit n - 1
+quint8 detectorBit(int detectorId)
+{
+    return (detectorId >= 1 && detectorId <= 8) ? static_cast<quint8>(0x01 << (detectorId - 1)) : 0;
+}
+}
+
+
+SocSimulator::SocSimulator(const SimScenario &scenario, QObject *parent)
+    : QObject{parent}, m_scenario(scenario), m_socket(new QUdpSocket(this)),
+    m_clientAddress("192.168.8.35"), m_clientPort(8080), m_clientFixed(false),
+    m_state(State::Idle), m_channels(scenario.channels), m_sequence(0), m_eventId(0), m_postTimeUs(0),
+    m_poolIndex(0), m_eventWords(0), m_eventsPerFrame(1),
+    m_streamTimer(new QTimer(this)), m_waveformTimer(new QTimer(this)), m_reportTimer(new QTimer(this)),
+    m_eventsDue(0), m_eventsSent(0), m_framesSent(0), m_bytesSent(0), m_lastEventsSent(0), m_lastBytesSent(0),
+    m_waveformChannels(0), m_waveformPhase(0), m_random(std::random_device{}())
+{
+    connect(m_socket, &QUdpSocket::readyRead, this, &SocSimulator::onReadyRead);
+
+    m_streamTimer->setTimerType(Qt::PreciseTimer);
+    m_streamTimer->setInterval(STREAM_TICK_MS);
+    connect(m_streamTimer, &QTimer::timeout, this, &SocSimulator::onStreamTimer);
+    connect(m_waveformTimer, &QTimer::timeout, this, &SocSimulator::onWaveformTimer);
+
+    m_reportTimer->setInterval(1000);
+    connect(m_reportTimer, &QTimer::timeout, this, &SocSimulator::onReportTimer);
+
+    buildEventPool();
+}
+
+bool SocSimulator::bind(const QHostAddress &address, quint16 port)
+{
+    if (!m_socket->bind(address, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)) {
+        qWarning() << "[SocSimulator] Failed to bind on" << address.toString() << ":" << port << m_socket->errorString();
+        return false;
+    }
+    // Bursts at high rates overflow the default send buffer
+    m_socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, 8 << 20);
+    qInfo() << "[SocSimulator] Listening on" << address.toString() << ":" << port << "scenario" << m_scenario.name;
+    return true;
+}
+
+void SocSimulator::setClient(const QHostAddress &address, quint16 port)
+{
+    m_clientAddress = address;
+    m_clientPort = port;
+    m_clientFixed = true;
+}
+
+void SocSimulator::setEventRate(double eventsPerSecond)
+{
+    m_scenario.eventRate = qMax(0.0, eventsPerSecond);
+}
+
+bool SocSimulator::chance(double probability)
+{
+    if (probability <= 0) {
+        return false;
+    }
+    return std::generate_canonical<double, 32>(m_random) < probability;
+}
+
+double SocSimulator::gaussian(const SimDistribution &dist)
+{
+    return dist.mean + dist.stdDev * m_normal(m_random);
+}
+
+/*
+ * Pre-generates eventPoolSize events for the current channel layout. The
+ * measurement words are stored big endian, ready to be copied into frames.
+ */
+void SocSimulator::buildEventPool()
+{
+    const int channelNum = m_channels.size();
+    const int poolSize = m_scenario.eventPoolSize;
+    m_eventWords = channelNum * 3 + 5;
+    m_eventsPerFrame = qBound(1, m_scenario.eventsPerFrame, MAX_PAYLOAD_BYTES / (m_eventWords * 4));
+    m_pool.resize(poolSize * channelNum * 3);
+    m_poolValid.resize(poolSize);
+    m_poolDiffTime.resize(poolSize);
+    m_poolIndex = 0;
+
+    double weightSum = 0;
+    for (const SimPopulation &p : m_scenario.populations) {
+        weightSum += p.weight;
+    }
+
+    quint8 enabledMask = 0;
+    for (int ch : m_channels) {
+        enabledMask |= detectorBit(ch);
+    }
+
+    SimDistribution noise{0, m_scenario.noise};
+    for (int i = 0; i < poolSize; ++i) {
+        double pick = std::generate_canonical<double, 32>(m_random) * weightSum;
+        int popIndex = 0;
+        while (popIndex < m_scenario.populations.size() - 1 && pick > m_scenario.populations.at(popIndex).weight) {
+            pick -= m_scenario.populations.at(popIndex).weight;
+            popIndex++;
+        }
+        const SimPopulation &pop = m_scenario.populations.at(popIndex);
+
+        quint32 *words = m_pool.data() + i * channelNum * 3;
+        quint8 valid = enabledMask;
+        for (int c = 0; c < channelNum; ++c) {
+            int ch = m_channels.at(c);
+            qint32 h = qRound(gaussian(pop.height.value(ch, pop.defaultHeight)) + gaussian(noise));
+            qint32 w = qRound(gaussian(pop.width.value(ch, pop.defaultWidth)));
+            qint32 a = qRound(gaussian(pop.area.value(ch, pop.defaultArea)) + gaussian(noise));
+            words[c * 3 + 0] = qToBigEndian<quint32>(qMax(0, h));
+            words[c * 3 + 1] = qToBigEndian<quint32>(qMax(1, w));
+            words[c * 3 + 2] = qToBigEndian<quint32>(qMax(0, a));
+            if (!chance(1.0 - m_scenario.pulseValidRatio)) {
+                continue;
+            }
+            valid &= ~detectorBit(ch);
+        }
+        m_poolValid[i] = valid;
+        m_poolDiffTime[i] = static_cast<quint32>(qMax(1.0, gaussian(m_scenario.diffTimeUs)));
+    }
+    qInfo() << "[SocSimulator] Event pool:" << poolSize << "events," << channelNum << "channels,"
+            << m_eventsPerFrame << "events per frame";
+}
+
+void SocSimulator::startAcquisition(State state)
+{
+    m_state = state;
+    m_streamClock.start();
+    m_eventsDue = 0;
+    m_eventsSent = 0;
+    m_framesSent = 0;
+    m_bytesSent = 0;
+    m_lastEventsSent = 0;
+    m_lastBytesSent = 0;
+    m_streamTimer->start();
+    m_reportTimer->start();
+    qInfo() << "[SocSimulator] Start" << (state == State::Sorting ? "sorting" : "acquisition")
+            << "at" << m_scenario.eventRate << "events/s to" << m_clientAddress.toString() << ":" << m_clientPort;
+}
+
+void SocSimulator::stopAcquisition()
+{
+    if (m_state == State::Idle) {
+        return;
+    }
+    m_state = State::Idle;
+    m_streamTimer->stop();
+    m_reportTimer->stop();
+    if (!m_heldFrame.isEmpty()) {
+        m_socket->writeDatagram(m_heldFrame, m_clientAddress, m_clientPort);
+        m_heldFrame.clear();
+    }
+    qInfo() << "[SocSimulator] Stop, sent" << m_eventsSent << "events in" << m_framesSent << "frames";
+    emit acquisitionStopped();
+}
+
+void SocSimulator::onReadyRead()
+{
+    while (m_socket->hasPendingDatagrams()) {
+        QByteArray datagram;
+        datagram.resize(m_socket->pendingDatagramSize());
+        QHostAddress sender;
+        quint16 senderPort = 0;
+        m_socket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+
+        // Commands from the host are one frame per datagram with the 0xA5 header
+        const char *frame = datagram.constData();
+        if (datagram.size() < UdpCommFrame::FRAME_MIN_SIZE
+            || static_cast<quint8>(frame[0]) != UdpCommFrame::FRAME_HEADER_TO_SOC) {
+            continue;
+        }
+        int dataLen = (static_cast<quint8>(frame[5]) << 8) | static_cast<quint8>(frame[6]);
+        if (datagram.size() < dataLen + UdpCommFrame::FRAME_MIN_SIZE) {
+            continue;
+        }
+        quint16 checksum = (static_cast<quint8>(frame[dataLen + 7]) << 8) | static_cast<quint8>(frame[dataLen + 8]);
+        if (UdpCommFrame::checkSum(frame, dataLen + UdpCommFrame::FRAME_HEAD_SIZE) != checksum) {
+            qWarning() << "[SocSimulator] Checksum error in command frame";
+            continue;
+        }
+        if (!m_clientFixed) {
+            m_clientAddress = sender;
+            m_clientPort = senderPort;
+        }
+        CommCmdType cmd = static_cast<CommCmdType>((static_cast<quint8>(frame[3]) << 8) | static_cast<quint8>(frame[4]));
+        handleFrame(cmd, datagram.mid(UdpCommFrame::FRAME_HEAD_SIZE, dataLen));
+    }
+}
+
+void SocSimulator::handleFrame(CommCmdType cmd, const QByteArray &data)
+{
+    switch (cmd) {
+    case CommCmdType::CMD_HAND_SHAKE:
+        break;
+    case CommCmdType::CMD_DETECTOR_SETTINGS:
+        handleDetectorSettings(data);
+        break;
+    case CommCmdType::CMD_ACQUIRE_START:
+        startAcquisition(State::Acquiring);
+        break;
+    case CommCmdType::CMD_SORTING_START:
+        startAcquisition(State::Sorting);
+        break;
+    case CommCmdType::CMD_ACQUIRE_STOP:
+    case CommCmdType::CMD_SORTING_STOP:
+        stopAcquisition();
+        break;
+    case CommCmdType::CMD_GATE_SETTINGS:
+        handleGateSettings(data);
+        break;
+    case CommCmdType::CMD_WAVEFORM_DATA:
+        handleWaveformRequest(data);
+        break;
+    default:
+        qInfo() << "[SocSimulator] Command" << static_cast<int>(cmd) << "with" << data.size() << "bytes";
+        break;
+    }
+
+    // Every command is answered with a handshake carrying the current state
+    QByteArray state;
+    state.append(static_cast<char>(m_state));
+    sendFrame(CommCmdType::CMD_HAND_SHAKE, state);
+}
+
+void SocSimulator::handleDetectorSettings(const QByteArray &data)
+{
+    QVector<int> channels;
+    QDataStream stream(data);
+    for (int i = 0; i + DETECTOR_SETTING_BYTES <= data.size(); i += DETECTOR_SETTING_BYTES) {
+        qint8 id, height, width, area, thresholdEnabled;
+        qint32 threshold;
+        stream >> id >> height >> width >> area >> thresholdEnabled >> threshold;
+        channels.append(id);
+    }
+    qInfo() << "[SocSimulator] Detector settings, channels" << channels;
+    if (!channels.isEmpty() && channels != m_channels) {
+        m_channels = channels;
+        buildEventPool();
+    }
+}
+
+void SocSimulator::handleGateSettings(const QByteArray &data)
+{
+    if (data.size() < 5) {
+        qWarning() << "[SocSimulator] Gate settings too short";
+        return;
+    }
+    int pointNum = (data.size() - 5) / 8;
+    qInfo() << "[SocSimulator] Gate settings, type" << static_cast<int>(data.at(0))
+            << "x detector" << static_cast<int>(data.at(1)) << "y detector" << static_cast<int>(data.at(2))
+            << pointNum << "points";
+}
+
+void SocSimulator::handleWaveformRequest(const QByteArray &data)
+{
+    if (data.size() < 3) {
+        return;
+    }
+    bool enabled = data.at(0) != 0;
+    m_waveformChannels = static_cast<quint8>(data.at(1));
+    int interval = qMax(10, static_cast<int>(static_cast<quint8>(data.at(2))));
+    if (enabled && m_waveformChannels != 0) {
+        m_waveformTimer->start(interval);
+    } else {
+        m_waveformTimer->stop();
+    }
+    qInfo() << "[SocSimulator] Waveform" << (enabled ? "on" : "off") << "channel mask" << m_waveformChannels;
+}
+
+void SocSimulator::onStreamTimer()
+{
+    const double elapsedSec = m_streamClock.nsecsElapsed() / 1e9;
+    quint64 target = static_cast<quint64>(m_scenario.eventRate * elapsedSec);
+    // Do not try to catch up more than 100 ms after a stall
+    const quint64 maxBacklog = static_cast<quint64>(m_scenario.eventRate * 0.1) + m_eventsPerFrame;
+    if (target > m_eventsDue + maxBacklog) {
+        m_eventsDue = target - maxBacklog;
+    }
+    while (m_eventsDue + m_eventsPerFrame <= target) {
+        sendPulseFrame(m_eventsPerFrame);
+        m_eventsDue += m_eventsPerFrame;
+    }
+}
+
+void SocSimulator::sendPulseFrame(int eventNum)
+{
+    const int channelWords = m_eventWords - 5;
+    const int eventBytes = m_eventWords * 4;
+    const double intervalUs = m_scenario.eventIntervalUs > 0 ? m_scenario.eventIntervalUs
+                                                             : (m_scenario.eventRate > 0 ? 1e6 / m_scenario.eventRate : 100);
+    const bool sorting = (m_state == State::Sorting);
+    const int poolSize = m_poolValid.size();
+
+    QByteArray payload(eventNum * eventBytes, Qt::Uninitialized);
+    char *out = payload.data();
+    for (int i = 0; i < eventNum; ++i, out += eventBytes) {
+        const int idx = m_poolIndex;
+        m_poolIndex = (m_poolIndex + 1) % poolSize;
+
+        if (chance(m_scenario.faults.eventIdGapRate)) {
+            m_eventId++;
+        }
+        quint32 header = (m_eventId++ & EVENT_ID_MASK) | VALID_MEASURE_BIT
+                         | (static_cast<quint32>(m_poolValid.at(idx)) << 24);
+        if (sorting && chance(m_scenario.sortEnableRatio)) {
+            header |= ENABLE_SORT_BIT;
+            if (chance(m_scenario.sortedRatio)) {
+                header |= SORTED_BIT;
+            }
+        }
+        m_postTimeUs += intervalUs;
+
+        const quint32 head = chance(m_scenario.faults.badMagicRate) ? 0xDEADBEEF : HEAD_MAGIC;
+        qToBigEndian<quint32>(head, out);
+        qToBigEndian<quint32>(header, out + 4);
+        qToBigEndian<quint32>(m_poolDiffTime.at(idx), out + 8);
+        qToBigEndian<quint32>(static_cast<quint32>(static_cast<quint64>(m_postTimeUs)), out + 12);
+        std::memcpy(out + 16, m_pool.constData() + idx * channelWords, channelWords * 4);
+        qToBigEndian<quint32>(TAIL_MAGIC, out + 16 + channelWords * 4);
+    }
+    m_eventsSent += eventNum;
+    sendFrame(CommCmdType::CMD_PULSE_DATA, payload);
+}
+
+void SocSimulator::onWaveformTimer()
+{
+    QVector<int> channels;
+    for (int ch = 0; ch < 8; ++ch) {
+        if (m_waveformChannels & (0x01 << ch)) {
+            channels.append(ch);
+        }
+    }
+    if (channels.isEmpty()) {
+        return;
+    }
+
+    // Gaussian pulses every 256 samples on a noisy baseline, 18-bit signed samples
+    const int samples = m_scenario.waveformSamplesPerFrame / channels.size();
+    SimDistribution baseline{0, m_scenario.waveformBaselineNoise};
+    QByteArray payload(samples * channels.size() * 4, Qt::Uninitialized);
+    char *out = payload.data();
+    for (int s = 0; s < samples; ++s) {
+        double t = std::fmod(m_waveformPhase + s, 256.0) - 128.0;
+        double pulse = m_scenario.waveformPulseHeight * std::exp(-(t * t) / 200.0);
+        for (int ch : channels) {
+            qint32 value = qBound(-131072, qRound(pulse / (ch + 1) + gaussian(baseline)), 131071);
+            quint32 word = (static_cast<quint32>(ch) << 24) | (static_cast<quint32>(value) & 0x3FFFF);
+            qToBigEndian<quint32>(word, out);
+            out += 4;
+        }
+    }
+    m_waveformPhase = std::fmod(m_waveformPhase + samples, 256.0);
+    sendFrame(CommCmdType::CMD_WAVEFORM_DATA, payload);
+}
+
+void SocSimulator::sendFrame(CommCmdType cmd, const QByteArray &data)
+{
+    sendDatagram(UdpCommFrame::packFrame(++m_sequence, cmd, data, UdpCommFrame::FRAME_HEADER_FROM_SOC));
+}
+
+void SocSimulator::sendDatagram(QByteArray frame)
+{
+    const SimFaults &faults = m_scenario.faults;
+    if (chance(faults.frameDropRate)) {
+        return;
+    }
+    if (chance(faults.frameCorruptRate)) {
+        int pos = std::uniform_int_distribution<int>(0, frame.size() - 1)(m_random);
+        frame[pos] = static_cast<char>(frame.at(pos) ^ 0x5A);
+    }
+    if (chance(faults.garbageRate)) {
+        QByteArray garbage(std::uniform_int_distribution<int>(1, 64)(m_random), Qt::Uninitialized);
+        for (char &c : garbage) {
+            c = static_cast<char>(m_random());
+        }
+        frame.prepend(garbage);
+    }
+    if (m_heldFrame.isEmpty() && chance(faults.frameReorderRate)) {
+        m_heldFrame = frame;
+        return;
+    }
+
+    int copies = chance(faults.frameDuplicateRate) ? 2 : 1;
+    for (int i = 0; i < copies; ++i) {
+        if (m_socket->writeDatagram(frame, m_clientAddress, m_clientPort) == frame.size()) {
+            m_framesSent++;
+            m_bytesSent += frame.size();
+        }
+    }
+    if (!m_heldFrame.isEmpty()) {
+        m_socket->writeDatagram(m_heldFrame, m_clientAddress, m_clientPort);
+        m_heldFrame.clear();
+    }
+}
+
+void SocSimulator::onReportTimer()
+{
+    quint64 events = m_eventsSent - m_lastEventsSent;
+    quint64 bytes = m_bytesSent - m_lastBytesSent;
+    m_lastEventsSent = m_eventsSent;
+    m_lastBytesSent = m_bytesSent;
+    qInfo().noquote() << QString("[SocSimulator] %1 events/s, %2 MB/s, %3 frames total")
+                             .arg(events).arg(bytes / 1e6, 0, 'f', 1).arg(m_framesSent);
+}
@@ -0,0 +1,100 @@
+#ifndef SOCSIMULATOR_H
+#define SOCSIMULATOR_H
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <random>
+#include "SimScenario.h"
+#include "UdpCommFrame.h"
+
+
+/**
+ * @brief Simulates the cytometer SoC on a UDP port.
+ *
+ * Answers the commands of UdpCommClient and streams CMD_PULSE_DATA and
+ * CMD_WAVEFORM_DATA frames while acquiring, at the event rate of the
+ * scenario. Events are pre-generated into a pool once per channel layout
+ * and cycled, only the header words change per event, so the rate is
+ * limited by the socket rather than by the random generator.
+ */
+class SocSimulator : public QObject
+{
+    Q_OBJECT
+public:
+    enum class State : quint8 {
+        Idle = 0,
+        Acquiring = 1,
+        Sorting = 2,
+    };
+
+    explicit SocSimulator(const SimScenario &scenario, QObject *parent = nullptr);
+
+    bool bind(const QHostAddress &address, quint16 port);
+    void setClient(const QHostAddress &address, quint16 port);
+    void setEventRate(double eventsPerSecond);
+    void startAcquisition(State state);
+    void stopAcquisition();
+
+signals:
+    void acquisitionStopped();
+
+private slots:
+    void onReadyRead();
+    void onStreamTimer();
+    void onWaveformTimer();
+    void onReportTimer();
+
+private:
+    void handleFrame(CommCmdType cmd, const QByteArray &data);
+    void handleDetectorSettings(const QByteArray &data);
+    void handleGateSettings(const QByteArray &data);
+    void handleWaveformRequest(const QByteArray &data);
+
+    void buildEventPool();
+    void sendPulseFrame(int eventNum);
+    void sendFrame(CommCmdType cmd, const QByteArray &data);
+    void sendDatagram(QByteArray frame);
+    bool chance(double probability);
+    double gaussian(const SimDistribution &dist);
+
+    SimScenario         m_scenario;
+    QUdpSocket          *m_socket;
+    QHostAddress        m_clientAddress;
+    quint16             m_clientPort;
+    bool                m_clientFixed;
+
+    State               m_state;
+    QVector<int>        m_channels;
+    quint16             m_sequence;
+    quint32             m_eventId;
+    double              m_postTimeUs;       ///< Fractional, below 1 us per event the steps still add up
+
+    QVector<quint32>    m_pool;             ///< Big endian measurement words, eventPoolSize events
+    QVector<quint8>     m_poolValid;        ///< Pulse valid bits per pooled event
+    QVector<quint32>    m_poolDiffTime;
+    int                 m_poolIndex;
+    int                 m_eventWords;
+    int                 m_eventsPerFrame;
+    QByteArray          m_heldFrame;        ///< Frame held back by the reorder fault
+
+    QTimer              *m_streamTimer;
+    QTimer              *m_waveformTimer;
+    QTimer              *m_reportTimer;
+    QElapsedTimer       m_streamClock;
+    quint64             m_eventsDue;
+    quint64             m_eventsSent;
+    quint64             m_framesSent;
+    quint64             m_bytesSent;
+    quint64             m_lastEventsSent;
+    quint64             m_lastBytesSent;
+    quint8              m_waveformChannels;
+    double              m_waveformPhase;
+
+    std::mt19937        m_random;
+    std::normal_distribution<double> m_normal;
+};
+
+#endif // SOCSIMULATOR_H
@@ -0,0 +1,65 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QDebug>
+#include "SocSimulator.h"
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("SeekSocSimulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Simulates the cytometer SoC over UDP for load tests of SeekCytometer.");
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "UDP port to listen on.", "port", "5001");
+    QCommandLineOption bindOption("bind", "Address to bind.", "address", "127.0.0.1");
+    QCommandLineOption clientOption("client", "Fixed client address, otherwise the sender of the last command.", "host:port");
+    QCommandLineOption scenarioOption("scenario", "Scenario JSON file.", "file");
+    QCommandLineOption rateOption("rate", "Events per second, overrides the scenario.", "events");
+    QCommandLineOption startOption("start", "Start streaming without waiting for CMD_ACQUIRE_START.");
+    QCommandLineOption durationOption("duration", "Stop streaming and quit after the given seconds.", "seconds");
+    parser.addOptions({portOption, bindOption, clientOption, scenarioOption, rateOption, startOption, durationOption});
+    parser.process(app);
+
+    SimScenario scenario;
+    if (parser.isSet(scenarioOption)) {
+        QString error;
+        if (!scenario.load(parser.value(scenarioOption), &error)) {
+            qCritical() << "Failed to load scenario" << parser.value(scenarioOption) << error;
+            return 1;
+        }
+    }
+    if (scenario.populations.isEmpty()) {
+        scenario.populations.append(SimPopulation());
+    }
+
+    SocSimulator simulator(scenario);
+    if (parser.isSet(rateOption)) {
+        simulator.setEventRate(parser.value(rateOption).toDouble());
+    }
+    if (parser.isSet(clientOption)) {
+        QString client = parser.value(clientOption);
+        int sep = client.lastIndexOf(':');
+        if (sep <= 0) {
+            qCritical() << "Client must be given as host:port";
+            return 1;
+        }
+        simulator.setClient(QHostAddress(client.left(sep)), client.mid(sep + 1).toUShort());
+    }
+    if (!simulator.bind(QHostAddress(parser.value(bindOption)), parser.value(portOption).toUShort())) {
+        return 1;
+    }
+
+    if (parser.isSet(startOption)) {
+        simulator.startAcquisition(SocSimulator::State::Acquiring);
+    }
+    if (parser.isSet(durationOption)) {
+        QTimer::singleShot(qRound(parser.value(durationOption).toDouble() * 1000), &app, [&simulator, &app]() {
+            simulator.stopAcquisition();
+            app.quit();
+        });
+    }
+    return app.exec();
+}
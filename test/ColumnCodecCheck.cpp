@@ -0,0 +1,166 @@
+#include <QVector>
+#include <QDebug>
+#include <random>
+#include <algorithm>
+#include "ColumnCodec.h"
+
+
+namespace {
+
+int failures = 0;
+
+/*
+ * Encodes values, checks the codec picked when expected is not Raw and
+ * decodes the payload back. Raw payloads are the values themselves.
+ */
+template <typename T>
+void roundTrip(const char *name, const QVector<T> &values, bool isSigned, ColumnCodec::Mode mode,
+               ColumnCodec::Codec expected)
+{
+    QByteArray payload;
+    const ColumnCodec::Codec codec = ColumnCodec::encode(values.constData(), values.size(), sizeof(T), isSigned, mode, payload);
+    if (codec != expected) {
+        qWarning() << "[ColumnCodecCheck]" << name << "picked" << ColumnCodec::codecName(codec)
+                   << "instead of" << ColumnCodec::codecName(expected);
+        failures++;
+    }
+    if (codec == ColumnCodec::Raw) {
+        payload = QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * sizeof(T));
+    }
+
+    QVector<T> decoded(values.size() + 1, T(0x5a));
+    const bool ok = ColumnCodec::decode(codec, reinterpret_cast<const uchar *>(payload.constData()), payload.size(),
+                                        values.size(), sizeof(T), decoded.data());
+    if (!ok || !std::equal(values.cbegin(), values.cend(), decoded.cbegin()) || decoded.last() != T(0x5a)) {
+        qWarning() << "[ColumnCodecCheck]" << name << "count" << values.size() << "does not round trip";
+        failures++;
+    }
+
+    // A payload cut short must be rejected, not read past its end
+    if (codec != ColumnCodec::Raw && codec != ColumnCodec::Zlib && !payload.isEmpty()
+        && ColumnCodec::decode(codec, reinterpret_cast<const uchar *>(payload.constData()), payload.size() - 1,
+                               values.size(), sizeof(T), decoded.data())) {
+        qWarning() << "[ColumnCodecCheck]" << name << "count" << values.size() << "decodes a truncated payload";
+        failures++;
+    }
+}
+
+} // namespace
+
+
+/*
+ * Encode/decode round trips of every acquisition file column codec, over
+ * empty, single, partial and full blocks and the 0 and 32 bit widths.
+ * Returns non zero on any mismatch, for ctest.
+ */
+int main()
+{
+    using ColumnCodec::Mode;
+    std::mt19937 rng(20240607);
+    const int counts[] = {1, 2, 127, 128, 129, 300, 1024};
+
+    // Empty chunk, nothing to encode in any mode
+    for (Mode mode : {Mode::None, Mode::Fast, Mode::Strong}) {
+        roundTrip("empty u32", QVector<quint32>(), false, mode, ColumnCodec::Raw);
+        roundTrip("empty u8", QVector<quint8>(), false, mode, ColumnCodec::Raw);
+    }
+
+    for (int count : counts) {
+        // A block costs 16 bytes per bit of width whatever its fill, one or
+        // two values stay raw
+        const bool packs = count > 2;
+
+        // Raw, compression off
+        QVector<quint32> random(count);
+        for (quint32 &value : random) {
+            value = rng();
+        }
+        roundTrip("raw", random, false, Mode::None, ColumnCodec::Raw);
+
+        // DeltaPack, monotonic event ids and timestamps
+        QVector<quint32> ids(count);
+        quint32 id = 0xffffff00u;
+        for (quint32 &value : ids) {
+            id += 1 + rng() % 3;
+            value = id;
+        }
+        roundTrip("delta", ids, false, Mode::Fast, packs ? ColumnCodec::DeltaPack : ColumnCodec::Raw);
+
+        // ForPack, unordered measurements clustering far from zero
+        QVector<quint32> cluster(count);
+        for (quint32 &value : cluster) {
+            value = 1000000 + rng() % 256;
+        }
+        roundTrip("for", cluster, false, Mode::Fast, packs ? ColumnCodec::ForPack : ColumnCodec::Raw);
+
+        // ForPack over signed values, the block minimum is negative
+        QVector<qint32> signedCluster(count);
+        for (qint32 &value : signedCluster) {
+            value = -200 + static_cast<qint32>(rng() % 400);
+        }
+        roundTrip("for signed", signedCluster, true, Mode::Fast, packs ? ColumnCodec::ForPack : ColumnCodec::Raw);
+
+        // Width 0, constant column
+        roundTrip("width 0", QVector<quint32>(count, 0x12345678u), false, Mode::Fast,
+                  packs ? ColumnCodec::DeltaPack : ColumnCodec::Raw);
+
+        // RunLength, flags in long runs
+        QVector<quint8> flags(count);
+        for (int i = 0; i < count; ++i) {
+            flags[i] = static_cast<quint8>((i / 50) & 1 ? 0x03 : 0x01);
+        }
+        roundTrip("run length", flags, false, Mode::Fast, packs ? ColumnCodec::RunLength : ColumnCodec::Raw);
+
+        // 8 bit noise stays raw
+        QVector<quint8> noise(count);
+        for (quint8 &value : noise) {
+            value = static_cast<quint8>(rng());
+        }
+        roundTrip("u8 noise", noise, false, Mode::Fast, ColumnCodec::Raw);
+    }
+
+    // Width 32, one full width block followed by constant blocks. The
+    // 0 to 0xffffffff range and the 0x7fffffff step need all 32 bits in
+    // both packed codecs, the constant blocks still make packing pay
+    for (int count : {300, 1024}) {
+        QVector<quint32> mixed(count, 7u);
+        for (int i = 0; i < ColumnCodec::BLOCK_SIZE; ++i) {
+            mixed[i] = rng();
+        }
+        mixed[0] = 0;
+        mixed[1] = 0x80000000u;
+        mixed[2] = 0xffffffffu;
+        for (Mode mode : {Mode::Fast, Mode::Strong}) {
+            QByteArray payload;
+            ColumnCodec::encode(mixed.constData(), count, 4, false, mode, payload);
+            if (static_cast<quint8>(payload.at(0)) != 32) {
+                qWarning() << "[ColumnCodecCheck] width 32 block packed at" << static_cast<quint8>(payload.at(0)) << "bits";
+                failures++;
+            }
+            roundTrip("width 32", mixed, false, mode, ColumnCodec::DeltaPack);
+        }
+    }
+
+    // Zlib, full width values the integer codecs cannot shrink but that repeat
+    QVector<quint32> pattern(16);
+    for (quint32 &value : pattern) {
+        value = rng();
+    }
+    pattern[0] = 0;
+    pattern[1] = 0xffffffffu;
+    for (int count : {300, 1024}) {
+        QVector<quint32> repeated(count);
+        for (int i = 0; i < count; ++i) {
+            repeated[i] = pattern.at(i % pattern.size());
+        }
+        roundTrip("zlib", repeated, false, Mode::Fast, ColumnCodec::Raw);
+        roundTrip("zlib", repeated, false, Mode::Strong, ColumnCodec::Zlib);
+    }
+
+    if (failures) {
+        qWarning() << "[ColumnCodecCheck]" << failures << "failures";
+        return 1;
+    }
+    qInfo() << "[ColumnCodecCheck] all codecs round trip";
+    return 0;
+}
@@ -91,25 +91,30 @@ void TestDataGenerator::generateTestData()
 
 void TestDataGenerator::generateEventData()
 {
-    QVector<EventData> eventData;
+    const QVector<int> &channels = EventDataManager::instance().enabledChannels();
+    std::shared_ptr<EventBatch> eventBatch = EventBatchPool::instance().acquire(channels, m_dataCount);
+    eventBatch->resize(m_dataCount);
     int enableSortNum = 0;
     int sortedNum = 0;
-    int distTime = 0;
     int timeBuff = 0;
-    int validCh = 0;
-    for (int ch : EventDataManager::instance().enabledChannels()) {
-        validCh |= (1 << ch);
+    quint8 validCh = 0;
+    for (int ch : channels) {
+        validCh |= EventBatch::channelBit(ch);
     }
+
+    double mean = (m_dataMax  + m_dataMin)  / 2;
+    double stddev = (m_dataMax - m_dataMin) / 6;
+    int noiseLimit = mean / 10;
     for (int count = 0; count < m_dataCount; count++) {
         m_eventId++;
-        EventData event(EventDataManager::instance().enabledChannels());
-        event.setEventId(m_eventId);
+        eventBatch->eventIdData()[count] = m_eventId;
+        quint8 flag = EventBatch::FlagValidSpeed;
         int val = QRandomGenerator::global()->bounded(0, 100);
         if (val > 30) {
-            event.setEnableSort(true);
+            flag |= EventBatch::FlagEnableSort;
             enableSortNum++;
             if (val > 45) {
-                event.setSorted(true);
+                flag |= EventBatch::FlagSorted;
                 sortedNum++;
             }
         }
@@ -117,23 +122,22 @@ void TestDataGenerator::generateEventData()
         int distTime =  QRandomGenerator::global()->bounded(30, 90);
         m_currentTime += timeSpan;
         timeBuff += distTime;
-        event.setPostTimeUs(m_currentTime);
-        event.setDiffTimeUs(distTime);
-        event.setValidSpeedMeasure(true);
-        event.setValidChPulse(validCh);
-
-        double mean = (m_dataMax  + m_dataMin)  / 2;
-        double stddev = (m_dataMax - m_dataMin) / 6;
-        int noiseLimit = mean / 10;
-        for (int ch : EventDataManager::instance().enabledChannels()) {
-            for (MeasurementType type : MeasurementTypeHelper::measurementTypeList()) {
-                event.setData(ch, type, generateGaussianWithNoise(mean, stddev, -noiseLimit, noiseLimit, m_dataMin, m_dataMax));
+        eventBatch->postTimeData()[count] = m_currentTime;
+        eventBatch->diffTimeData()[count] = distTime;
+        eventBatch->flagData()[count] = flag;
+        eventBatch->chPulseValidData()[count] = validCh;
+    }
+
+    for (int i = 0; i < channels.size(); i++) {
+        for (int m = 0; m < EventBatch::MEASUREMENT_NUM; m++) {
+            qint32 *column = eventBatch->columnData(i, m);
+            for (int count = 0; count < m_dataCount; count++) {
+                column[count] = generateGaussianWithNoise(mean, stddev, -noiseLimit, noiseLimit, m_dataMin, m_dataMax);
             }
         }
-        eventData.append(event);
     }
 
-    emit eventDataGenerated(eventData, enableSortNum, sortedNum, (double)timeBuff / m_dataCount);
+    emit eventDataGenerated(eventBatch, enableSortNum, sortedNum, (double)timeBuff / m_dataCount);
 }
 
 void TestDataGenerator::stopGenerateData()
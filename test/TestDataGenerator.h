@@ -8,6 +8,7 @@
 
 #include "DataManager.h"
 #include "EventData.h"
+#include "EventBatchPool.h"
 // class DetectorData
 // {
 // public:
@@ -63,7 +64,7 @@ public:
 
 signals:
     void testDataGenerated(const QVector<SampleData> &generatedData);
-    void eventDataGenerated(const QVector<EventData> &eventData, int enableSortNum, int sortedNum, double timeSpan);
+    void eventDataGenerated(const EventBatchPtr &eventBatch, int enableSortNum, int sortedNum, double timeSpan);
 
 private slots:
     void generateTestData();
@@ -1,6 +1,7 @@
 #include "CustomStatusBar.h"
 #include <QDateTime>
 #include "User.h"
+#include "ContinuityMonitor.h"
 CustomStatusBar::CustomStatusBar()
 {
     initStatusBar();
@@ -18,9 +19,11 @@ void CustomStatusBar::initStatusBar()
     lblCurrTime = new QLabel(this);
     lblConnectInfo = new QLabel(tr("Not connected to server"), this);
     lblCurrentUser = new QLabel(User::loginUser().name(), this);
+    lblLossInfo = new QLabel(this);
     connectLed = new StatusIndicator(this);
 
 
+    addPermanentWidget(lblLossInfo);
     addPermanentWidget(lblCurrTime);
     addPermanentWidget(lblCurrentUser);
     addWidget(connectLed);
@@ -30,9 +33,24 @@ void CustomStatusBar::initStatusBar()
     timerSecond->setInterval(1000);
     connect(timerSecond, &QTimer::timeout, this, [this](){
         lblCurrTime->setText(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss"));
+        updateLossInfo();
     });
 
     #ifndef DEBUG_MODE
         timerSecond->start();
     #endif
 }
+
+void CustomStatusBar::updateLossInfo()
+{
+    const ContinuityMonitor &monitor = ContinuityMonitor::instance();
+    quint64 lost = monitor.eventsLost();
+    if (lost == 0 && monitor.framesLost() == 0) {
+        lblLossInfo->clear();
+        return;
+    }
+    lblLossInfo->setText(tr("Lost events: %1 (%2 / s, %3%)")
+                             .arg(lost)
+                             .arg(monitor.eventLossPerSecond(), 0, 'f', 1)
+                             .arg(monitor.eventLossRatio() * 100.0, 0, 'f', 2));
+}
@@ -21,9 +21,11 @@ private:
     QLabel *lblCurrTime;
     QLabel *lblConnectInfo;
     QLabel *lblCurrentUser;
+    QLabel *lblLossInfo;
     QTimer *timerSecond;
     StatusIndicator *connectLed;
     void initStatusBar();
+    void updateLossInfo();
 };
 
 #endif // CUSTOMSTATUSBAR_H
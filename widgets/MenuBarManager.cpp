@@ -1,6 +1,7 @@
 #include "MenuBarManager.h"
 #include <QMessageBox>
 #include "UserManageDialog.h"
+#include "PreferencesDialog.h"
 
 MenuBarManager::MenuBarManager(QMainWindow *parent) : QObject(parent), mainWindow(parent) {
     menuBar = new QMenuBar(parent);
@@ -46,10 +47,14 @@ void MenuBarManager::createEditMenu() {
     cutAction = new QAction("Cut", mainWindow);
     copyAction = new QAction("Copy", mainWindow);
     pasteAction = new QAction("Paste", mainWindow);
+    preferencesAction = new QAction("Preferences...", mainWindow);
 
     editMenu->addAction(cutAction);
     editMenu->addAction(copyAction);
     editMenu->addAction(pasteAction);
+    editMenu->addSeparator();
+    editMenu->addAction(preferencesAction);
+    connect(preferencesAction, &QAction::triggered, this, &MenuBarManager::openPreferencesDialog);
 }
 
 void MenuBarManager::createViewMenu() {
@@ -170,3 +175,9 @@ void MenuBarManager::openUserManageDialog()
     UserManageDialog dialog(mainWindow);
     dialog.exec();
 }
+
+void MenuBarManager::openPreferencesDialog()
+{
+    PreferencesDialog dialog(mainWindow);
+    dialog.exec();
+}
@@ -37,6 +37,7 @@ private:
     QAction *cutAction;
     QAction *copyAction;
     QAction *pasteAction;
+    QAction *preferencesAction;
     QAction *zoomInAction;
     QAction *zoomOutAction;
     QAction *runExpAction;
@@ -69,6 +70,7 @@ private slots:
     void saveFile();
     void runExperiment();
     void openUserManageDialog();
+    void openPreferencesDialog();
 };
 
 #endif // MENUBARMANAGER_H
@@ -7,6 +7,7 @@
 #include "GatesModel.h"
 #include "CytometerController.h"
 #include "EventDataManager.h"
+#include "ContinuityMonitor.h"
 
 SortingWidget::SortingWidget(const QString &tilte, QWidget *parent)
     : QDockWidget{tilte, parent}, updateTimer(new QTimer(this))
@@ -86,6 +87,8 @@ void SortingWidget::initSortingWidget()
     lblDiscardRatio = new QLabel("0.00%", this);
     lblSortTime = new QLabel("0 s", this);
     lblCellSpeed = new QLabel("0 m/s", this);
+    lblLostEvents = new QLabel("0", this);
+    lblLossRate = new QLabel("0 / s", this);
     // progressSort = new QProgressBar(this);
 
 
@@ -115,6 +118,11 @@ void SortingWidget::initSortingWidget()
 
     statusLayout->addWidget(new QLabel(tr("Cell Speed"), this), 4, 0);
     statusLayout->addWidget(lblCellSpeed, 4, 1);
+    statusLayout->addWidget(new QLabel(tr("Lost Events"), this), 4, 2);
+    statusLayout->addWidget(lblLostEvents, 4, 3);
+
+    statusLayout->addWidget(new QLabel(tr("Loss Rate"), this), 5, 0);
+    statusLayout->addWidget(lblLossRate, 5, 1);
 
     // statusLayout->addWidget(new QLabel(tr("Sort Efficiency"), this), 3, 0);
     // statusLayout->addWidget(lblSortEfficiency, 3, 1);
@@ -162,6 +170,8 @@ void SortingWidget::resetSortingStatus()
     lblSortRatio->setText("0.00%");
     lblDiscardRatio->setText("0.00%");
     lblCellSpeed->setText("0 m/s");
+    lblLostEvents->setText("0");
+    lblLossRate->setText("0 / s");
 }
 
 int SortingWidget::calculateCoe(int measureDist, int sortDist)
@@ -263,6 +273,10 @@ void SortingWidget::updateDisplay()
     lblSortRatio->setText(QString::asprintf("%.2f %%", sortRatio));
     lblDiscardRatio->setText(QString::asprintf("%.2f %%", discardRatio));
     lblCellSpeed->setText(QString::asprintf("%.2f m/s", speed));
+
+    const ContinuityMonitor &monitor = ContinuityMonitor::instance();
+    lblLostEvents->setText(QString::number(monitor.eventsLost()));
+    lblLossRate->setText(QString::asprintf("%.1f / s (%.2f %%)", monitor.eventLossPerSecond(), monitor.eventLossRatio() * 100.0));
 }
 
 
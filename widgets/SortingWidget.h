@@ -93,6 +93,8 @@ private:
     QLabel          *lblSortRatio;
     QLabel          *lblCellSpeed;
     QLabel          *lblDiscardRatio;
+    QLabel          *lblLostEvents;
+    QLabel          *lblLossRate;
 
 
     // QProgressBar    *progressSort;
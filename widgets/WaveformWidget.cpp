@@ -142,6 +142,7 @@ void WaveformWidget::initDockWidget()
             waveView->setDisplayMode(false);
             btnChangeAxis->setText(tr("Voltage Mode"));
         }
+        emit displayModeChanged(waveView->isShowVoltage());
     });
 
     connect(btnSaveData, &QPushButton::clicked, this, [this](){
@@ -183,7 +184,7 @@ WaveformWidget::~WaveformWidget()
     deleteLater();
 }
 
-void WaveformWidget::onReceivedWaveform(const QList<int> &data)
+void WaveformWidget::onReceivedWaveform(const WaveformBlock &data)
 {
     waveView->addSeriesData(data);
 }
@@ -24,9 +24,10 @@ signals:
     // void enableWaveform(bool en);
     // void waveformChannelsChanged(int);
     void waveformStateChanged(bool en, int channels, int interval);
+    void displayModeChanged(bool showVoltage);
 
 public slots:
-    void onReceivedWaveform(const QList<int> &data);
+    void onReceivedWaveform(const WaveformBlock &data);
 
 
 private slots:
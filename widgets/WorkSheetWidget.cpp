@@ -17,13 +17,50 @@
 #include "HistogramPlot.h"
 #include "ScatterPlot.h"
 #include <QSplitter>
+#include <QLabel>
+#include <QFileDialog>
 #include <cmath>
+#include "AppSettings.h"
+
+namespace {
+
+GateStatistics gateStatistics(const PopulationSummary &population, const Gate &gate)
+{
+    const Moments &moments = population.moments;
+    const bool is1D = gate.gateType() == GateType::IntervalGate;
+    GateStatistics stats;
+    stats.is1D = is1D;
+    stats.count = static_cast<int>(moments.count);
+    stats.percentParent = population.percentParent();
+    stats.percentTotal = population.percentTotal();
+    if (gate.gateType() == GateType::QuadrantGate) {
+        stats.isQuadrant = true;
+        for (int q = 0; q < 4; ++q) {
+            stats.quadrantCount[q] = static_cast<int>(population.quadrants.count[q]);
+        }
+    }
+    if (moments.count > 0) {
+        stats.meanX = moments.mean[0];
+        stats.stdDevX = std::sqrt(moments.variance(0));
+        stats.cvX = (stats.meanX != 0.0) ? (stats.stdDevX / std::abs(stats.meanX)) * 100.0 : 0.0;
+        if (!is1D) {
+            stats.meanY = moments.mean[1];
+            stats.stdDevY = std::sqrt(moments.variance(1));
+            stats.cvY = (stats.meanY != 0.0) ? (stats.stdDevY / std::abs(stats.meanY)) * 100.0 : 0.0;
+        }
+    }
+    return stats;
+}
+
+} // namespace
 
 WorkSheetWidget::WorkSheetWidget(const QString &title, QWidget *parent)
     : QDockWidget{title, parent},
-    m_updateTimer(new QTimer(this)),
     m_active(false),
-    m_updateInterval(1000),
+    m_recorded(false),
+    m_frameScheduler(new FrameScheduler(this)),
+    m_gatesDirty(true),
+    m_statisticsDirty(false),
     tableView(new QTableView(this)),
     m_model(GatesModel::instance())
 {
@@ -32,17 +69,28 @@ WorkSheetWidget::WorkSheetWidget(const QString &title, QWidget *parent)
 
 void WorkSheetWidget::setActive(bool active)
 {
-    setActive(active, m_updateInterval);
+    setActive(active, m_frameScheduler->targetFps());
 }
 
-void WorkSheetWidget::setActive(bool active, int interval)
+void WorkSheetWidget::setActive(bool active, int targetFps)
 {
     m_active = active;
-    m_updateInterval = interval;
+    m_frameScheduler->setTargetFps(targetFps);
     if (m_active) {
-        m_updateTimer->start(m_updateInterval);
+        // Live events replace the recorded ones
+        if (m_recorded) {
+            m_recorded = false;
+            OfflineAnalyzer::instance().closeFile();
+        }
+        m_frameScheduler->setScene(currentWorkSheetScene);
+        m_frameScheduler->start();
     } else {
-        m_updateTimer->stop();
+        m_frameScheduler->stop();
+        frameStatsLabel->clear();
+        if (m_statisticsDirty) {
+            updateGateStatistics();
+            m_statisticsDirty = false;
+        }
     }
 }
 
@@ -56,6 +104,49 @@ void WorkSheetWidget::resetPlots()
     currentWorkSheetScene->resetPlots();
 }
 
+bool WorkSheetWidget::openRecordedData(const QString &filePath)
+{
+    if (m_active) {
+        QMessageBox::warning(this, tr("Open Data"), tr("Stop the acquisition before opening recorded data."));
+        return false;
+    }
+    if (!OfflineAnalyzer::instance().openFile(filePath)) {
+        QMessageBox::warning(this, tr("Open Data"), tr("Cannot open %1:\n%2").arg(filePath, OfflineAnalyzer::instance().errorString()));
+        return false;
+    }
+    m_recorded = true;
+    analyzeRecordedData();
+    return true;
+}
+
+/*
+ * Specs of the current worksheet's plots and gates, the analyzer reuses
+ * the plot results that did not change, so this is cheap after a gate edit.
+ */
+void WorkSheetWidget::analyzeRecordedData()
+{
+    if (!m_recorded || !currentWorkSheetScene) {
+        return;
+    }
+    OfflineAnalysisRequest request;
+    for (PlotBase *plot : currentWorkSheetScene->plots()) {
+        OfflinePlotSpec spec;
+        spec.plotId = plot->plotId();
+        spec.type = plot->plotType();
+        spec.channelX = plot->axisXDetectorId();
+        spec.typeX = plot->xMeasurementType();
+        spec.channelY = plot->axisYDetectorId();
+        spec.typeY = plot->yMeasurementType();
+        spec.isLog = plot->xAxis()->isLog();
+        if (HistogramPlot *histPlot = dynamic_cast<HistogramPlot*>(plot)) {
+            spec.binNum = histPlot->binNum();
+        }
+        request.plots.append(spec);
+    }
+    request.gates = compiledGates();
+    OfflineAnalyzer::instance().analyze(request);
+}
+
 
 
 
@@ -73,7 +164,10 @@ void WorkSheetWidget::addWorkSheetView(int worksheetId)
     tabWidget->addTab(workSheetView, workSheet.name());
     currentWorkSheetView = workSheetView;
     currentWorkSheetScene = workSheetView->scene();
+    m_frameScheduler->setScene(currentWorkSheetScene);
     connect(currentWorkSheetScene, &WorkSheetScene::finishedDrawingGate, this, &WorkSheetWidget::onFinishedDrawingGate);
+    connect(currentWorkSheetScene, &WorkSheetScene::gatesChanged, this, [this]() { m_gatesDirty = true; });
+    m_gatesDirty = true;
     m_model->resetGateModel(worksheetId);
 
     // for (const Gate& gate : GatesDAO().fetchGates(worksheetId)) {
@@ -118,6 +212,19 @@ void WorkSheetWidget::onFinishedDrawingGate(GateItem *gateItem)
             gateItem->setGateColor(defaultColor);
         }
 
+        // Parent population, the new gate only splits the events of that gate
+        const QList<Gate> &gates = m_model->getGateList();
+        if (!gates.isEmpty()) {
+            QStringList populations = {tr("All Events")};
+            for (const Gate &gate : gates) {
+                populations.append(gate.name());
+            }
+            QString parentName = QInputDialog::getItem(this, tr("Select Parent Population"), tr("Gate the events of"),
+                                                       populations, 0, false, &ok);
+            const int parentIndex = ok ? populations.indexOf(parentName) : 0;
+            gateItem->setGateParentId(parentIndex > 0 ? gates.at(parentIndex - 1).id() : 0);
+        }
+
         int gateId = m_model->addGate(gateItem->gate());
         if (gateId > 0) {
             gateItem->setGateId(gateId);
@@ -126,6 +233,9 @@ void WorkSheetWidget::onFinishedDrawingGate(GateItem *gateItem)
     }
 
     currentWorkSheetScene->finishDrawingGate(addGateOk);
+    if (addGateOk) {
+        analyzeRecordedData();
+    }
 }
 
 void WorkSheetWidget::initDockWidget()
@@ -142,10 +252,12 @@ void WorkSheetWidget::initDockWidget()
     actionPrint = new QAction("Print", this);
     actionSavePDF = new QAction("Save PDF", this);
     actionSelect = new QAction("Select", this);
+    actionOpenData = new QAction("Open Data", this);
 
     toolBar->addAction(actionPrint);
     toolBar->addAction(actionSavePDF);
     toolBar->addAction(actionSelect);
+    toolBar->addAction(actionOpenData);
     toolBar->addSeparator();
 
     QActionGroup *plotGroup = new QActionGroup(this);
@@ -184,10 +296,19 @@ void WorkSheetWidget::initDockWidget()
 
 
     // Buttons below the table
+    const GateEngine &engine = EventDataManager::instance().gateEngine();
+    statsScopeBox = new QComboBox(this);
+    statsScopeBox->addItem(tr("Whole Acquisition"), QVariant::fromValue(StatisticsScope::Acquisition));
+    statsScopeBox->addItem(tr("Last %1 Events").arg(engine.windowEvents()), QVariant::fromValue(StatisticsScope::LastEvents));
+    statsScopeBox->addItem(tr("Last %1 s").arg(engine.windowSeconds()), QVariant::fromValue(StatisticsScope::LastSeconds));
     btnUpdateStats = new QPushButton(tr("Update Statistics"), this);
     btnDeleteGate = new QPushButton(tr("Delete Gate"), this);
     QHBoxLayout *btnLayout = new QHBoxLayout();
+    btnLayout->addWidget(new QLabel(tr("Statistics of"), this));
+    btnLayout->addWidget(statsScopeBox);
     btnLayout->addStretch();
+    frameStatsLabel = new QLabel(this);
+    btnLayout->addWidget(frameStatsLabel);
     btnLayout->addWidget(btnUpdateStats);
     btnLayout->addWidget(btnDeleteGate);
 
@@ -213,9 +334,20 @@ void WorkSheetWidget::initDockWidget()
     setWidget(mainWidget);
     connect(tabWidget, &QTabWidget::currentChanged, this, &WorkSheetWidget::onCurrentTabChanged);
     connect(plotGroup, &QActionGroup::triggered, this, &WorkSheetWidget::addNewPlot);
-    connect(m_updateTimer, &QTimer::timeout, this, &WorkSheetWidget::onUpdateTimerTimeout);
+    connect(m_frameScheduler, &FrameScheduler::frameStarted, this, &WorkSheetWidget::onFrameStarted, Qt::DirectConnection);
+    connect(m_frameScheduler, &FrameScheduler::statisticsUpdated, this, &WorkSheetWidget::onFrameStatistics);
+    m_frameScheduler->setTargetFps(AppSettings::instance().frameRate());
+    connect(&AppSettings::instance(), &AppSettings::frameRateChanged, m_frameScheduler, &FrameScheduler::setTargetFps);
     connect(btnUpdateStats, &QPushButton::clicked, this, &WorkSheetWidget::onUpdateStatisticsClicked);
+    connect(statsScopeBox, &QComboBox::currentIndexChanged, this, [this]() {
+        if (!m_recorded) {
+            updateGateStatistics();
+        }
+    });
     connect(btnDeleteGate, &QPushButton::clicked, this, &WorkSheetWidget::onDeleteGateClicked);
+    connect(actionOpenData, &QAction::triggered, this, &WorkSheetWidget::onOpenDataTriggered);
+    connect(&OfflineAnalyzer::instance(), &OfflineAnalyzer::analysisProgress, this, &WorkSheetWidget::onAnalysisProgress);
+    connect(&OfflineAnalyzer::instance(), &OfflineAnalyzer::analysisFinished, this, &WorkSheetWidget::onAnalysisFinished);
 
 }
 
@@ -227,6 +359,7 @@ void WorkSheetWidget::addPlot(PlotType plotType)
         int plotId = PlotsDAO().insertPlot(plot);
         if (plotId > 0) {
             currentWorkSheetScene->addNewPlot(plotType, plot);
+            analyzeRecordedData();
         }
     }
 }
@@ -236,7 +369,10 @@ void WorkSheetWidget::onCurrentTabChanged(int index)
     currentWorkSheetView = qobject_cast<WorkSheetView*>(tabWidget->widget(index));
     if (currentWorkSheetView) {
         currentWorkSheetScene = currentWorkSheetView->scene();
+        m_frameScheduler->setScene(currentWorkSheetScene);
+        m_gatesDirty = true;
         m_model->resetGateModel(currentWorkSheetView->worksheetId());
+        analyzeRecordedData();
     }
 }
 
@@ -250,117 +386,88 @@ void WorkSheetWidget::addNewPlot(QAction *action)
 }
 
 
-void WorkSheetWidget::onUpdateTimerTimeout()
+/*
+ * The data work of a live frame. Gates are compiled again only after the
+ * scene reported a change and handed to the engine only when they differ,
+ * the statistics table follows at most every STATISTICS_INTERVAL_MS.
+ */
+void WorkSheetWidget::onFrameStarted()
 {
+    if (!currentWorkSheetScene) return;
+
+    if (m_gatesDirty) {
+        m_gatesDirty = false;
+        const QVector<CompiledGate> gates = compiledGates();
+        if (gates != m_compiledGates) {
+            m_compiledGates = gates;
+            EventDataManager::instance().gateEngine().setGates(m_compiledGates);
+            m_statisticsDirty = true;
+        }
+    }
     // DataManager::instance().processData(currentWorkSheetScene->plots());
-    EventDataManager::instance().processData(currentWorkSheetScene->plots());
-    updateGateStatistics();
+    if (EventDataManager::instance().processData(currentWorkSheetScene->plots())) {
+        m_statisticsDirty = true;
+    }
+    // The seconds window also empties while no events arrive
+    if (EventDataManager::instance().gateEngine().expire()) {
+        m_statisticsDirty = true;
+    }
+
+    if (m_statisticsDirty && (!m_statisticsTimer.isValid() || m_statisticsTimer.elapsed() >= STATISTICS_INTERVAL_MS)) {
+        updateGateStatistics();
+        m_statisticsDirty = false;
+        m_statisticsTimer.start();
+    }
+}
+
+void WorkSheetWidget::onFrameStatistics(const FrameStatistics &stats)
+{
+    frameStatsLabel->setText(tr("%1 fps, frame %2 / %3 / %4 ms (p50 / p95 / p99)")
+                                 .arg(stats.fps, 0, 'f', 1)
+                                 .arg(stats.frameMs50, 0, 'f', 1)
+                                 .arg(stats.frameMs95, 0, 'f', 1)
+                                 .arg(stats.frameMs99, 0, 'f', 1));
+}
+
+QVector<CompiledGate> WorkSheetWidget::compiledGates() const
+{
+    QVector<CompiledGate> gates;
+    if (!currentWorkSheetScene) {
+        return gates;
+    }
+    for (GateItem *gateItem : currentWorkSheetScene->gates()) {
+        // Tested in the space the gate is drawn in
+        const PlotBase *plot = gateItem->parentPlot();
+        CompiledGate gate(gateItem->gate(), plot && plot->xAxis()->isLog(), plot && plot->yAxis()->isLog());
+        if (gate.isValid()) {
+            gates.append(gate);
+        }
+    }
+    return gates;
 }
 
 void WorkSheetWidget::updateGateStatistics()
 {
     if (!currentWorkSheetScene) return;
 
-    const QList<GateItem*> &gateItems = currentWorkSheetScene->gates();
-    if (gateItems.isEmpty()) return;
-
-    for (GateItem *gateItem : gateItems) {
+    const GateEngine &engine = EventDataManager::instance().gateEngine();
+    for (GateItem *gateItem : currentWorkSheetScene->gates()) {
         const Gate &gate = gateItem->gate();
-        PlotBase *plot = gateItem->parentPlot();
-        if (!plot) continue;
-
-        GateStatistics stats;
-
-        if (gate.gateType() == GateType::IntervalGate) {
-            // 1D gate on histogram
-            stats.is1D = true;
-            HistogramPlot *histPlot = dynamic_cast<HistogramPlot*>(plot);
-            if (!histPlot) continue;
-
-            const QList<QPoint> &pts = gate.points();
-            if (pts.size() < 2) continue;
-            int gateMin = qMin(pts[0].x(), pts[1].x());
-            int gateMax = qMax(pts[0].x(), pts[1].x());
-
-            QVector<int> allData = histPlot->readAllData();
-            double sumX = 0.0;
-            int count = 0;
-
-            for (int val : allData) {
-                if (val >= gateMin && val <= gateMax) {
-                    sumX += val;
-                    count++;
-                }
-            }
-
-            stats.count = count;
-            if (count > 0) {
-                stats.meanX = sumX / count;
-
-                double sumSqDiffX = 0.0;
-                for (int val : allData) {
-                    if (val >= gateMin && val <= gateMax) {
-                        double diff = val - stats.meanX;
-                        sumSqDiffX += diff * diff;
-                    }
-                }
-                stats.stdDevX = std::sqrt(sumSqDiffX / count);
-                stats.cvX = (stats.meanX != 0.0) ? (stats.stdDevX / std::abs(stats.meanX)) * 100.0 : 0.0;
-            }
-        } else {
-            // 2D gate (Rectangle, etc.)
-            stats.is1D = false;
-            ScatterPlot *scatPlot = dynamic_cast<ScatterPlot*>(plot);
-            if (!scatPlot) continue;
-
-            const QList<QPoint> &pts = gate.points();
-            if (pts.size() < 2) continue;
-
-            int gateMinX, gateMaxX, gateMinY, gateMaxY;
-            gate.getGateRange(gateMinX, gateMaxX, gateMinY, gateMaxY);
-
-            QVector<QPoint> allData = scatPlot->readAllData();
-            double sumX = 0.0, sumY = 0.0;
-            int count = 0;
-
-            for (const QPoint &pt : allData) {
-                if (pt.x() >= gateMinX && pt.x() <= gateMaxX &&
-                    pt.y() >= gateMinY && pt.y() <= gateMaxY) {
-                    sumX += pt.x();
-                    sumY += pt.y();
-                    count++;
-                }
-            }
+        const StatisticsScope scope = statsScopeBox->currentData().value<StatisticsScope>();
+        PopulationSummary population;
+        if (!engine.statistics(gate.id(), scope, population)) continue;
 
-            stats.count = count;
-            if (count > 0) {
-                stats.meanX = sumX / count;
-                stats.meanY = sumY / count;
-
-                double sumSqDiffX = 0.0, sumSqDiffY = 0.0;
-                for (const QPoint &pt : allData) {
-                    if (pt.x() >= gateMinX && pt.x() <= gateMaxX &&
-                        pt.y() >= gateMinY && pt.y() <= gateMaxY) {
-                        double diffX = pt.x() - stats.meanX;
-                        double diffY = pt.y() - stats.meanY;
-                        sumSqDiffX += diffX * diffX;
-                        sumSqDiffY += diffY * diffY;
-                    }
-                }
-                stats.stdDevX = std::sqrt(sumSqDiffX / count);
-                stats.stdDevY = std::sqrt(sumSqDiffY / count);
-                stats.cvX = (stats.meanX != 0.0) ? (stats.stdDevX / std::abs(stats.meanX)) * 100.0 : 0.0;
-                stats.cvY = (stats.meanY != 0.0) ? (stats.stdDevY / std::abs(stats.meanY)) * 100.0 : 0.0;
-            }
-        }
-
-        m_model->updateGateStatistics(gate.id(), stats);
+        m_model->updateGateStatistics(gate.id(), gateStatistics(population, gate));
     }
 }
 
 void WorkSheetWidget::onUpdateStatisticsClicked()
 {
-    updateGateStatistics();
+    if (m_recorded) {
+        analyzeRecordedData();
+    } else {
+        updateGateStatistics();
+    }
 }
 
 void WorkSheetWidget::onDeleteGateClicked()
@@ -391,3 +498,52 @@ void WorkSheetWidget::onDeleteGateClicked()
     // Remove from model (and database)
     m_model->removeGate(row);
 }
+
+void WorkSheetWidget::onOpenDataTriggered()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Open Recorded Data"), EventDataManager::instance().dataSaveDirectory(),
+                                                    tr("Acquisition Files (*.seekacq *.fcs);;All Files (*)"));
+    if (!filePath.isEmpty()) {
+        openRecordedData(filePath);
+    }
+}
+
+void WorkSheetWidget::onAnalysisFinished(const OfflineAnalysisResult &result)
+{
+    if (!m_recorded || !currentWorkSheetScene || result.filePath != OfflineAnalyzer::instance().filePath()) {
+        return;
+    }
+    // Plots and gates may have been removed while the analysis ran
+    for (PlotBase *plot : currentWorkSheetScene->plots()) {
+        for (const OfflinePlotResult &plotResult : result.plots) {
+            if (plotResult.spec.plotId != plot->plotId()) continue;
+            if (HistogramPlot *histPlot = dynamic_cast<HistogramPlot*>(plot)) {
+                histPlot->setBins(plotResult.bins);
+            } else if (ScatterPlot *scatPlot = dynamic_cast<ScatterPlot*>(plot)) {
+                scatPlot->setData(plotResult.sample);
+            }
+        }
+    }
+    updateRecordedGateStatistics(result);
+}
+
+void WorkSheetWidget::onAnalysisProgress(const OfflineAnalysisResult &result)
+{
+    if (!m_recorded || !currentWorkSheetScene || result.filePath != OfflineAnalyzer::instance().filePath()) {
+        return;
+    }
+    updateRecordedGateStatistics(result);
+}
+
+void WorkSheetWidget::updateRecordedGateStatistics(const OfflineAnalysisResult &result)
+{
+    for (GateItem *gateItem : currentWorkSheetScene->gates()) {
+        const Gate &gate = gateItem->gate();
+        auto it = result.gates.constFind(gate.id());
+        if (it != result.gates.cend()) {
+            GateStatistics stats = gateStatistics(PopulationSummary::fromStats(it.value()), gate);
+            stats.estimated = result.progress < 1.0;
+            m_model->updateGateStatistics(gate.id(), stats);
+        }
+    }
+}
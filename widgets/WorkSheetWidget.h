@@ -5,12 +5,16 @@
 #include <QAction>
 #include <QTabWidget>
 #include "WorkSheetView.h"
-#include <QTimer>
+#include <QElapsedTimer>
+#include <QLabel>
 
 #include "GatesModel.h"
 #include "GateStatistics.h"
 #include <QTableView>
 #include <QPushButton>
+#include <QComboBox>
+#include "OfflineAnalyzer.h"
+#include "FrameScheduler.h"
 
 class WorkSheetWidget : public QDockWidget
 {
@@ -24,11 +28,16 @@ public:
 
 
     void setActive(bool active);
-    void setActive(bool active, int interval);
+    void setActive(bool active, int targetFps);
     bool isActive() const;
 
     void resetPlots();
 
+    /**
+     * @brief Shows a recorded acquisition, plots and gate statistics cover all of its events.
+     */
+    bool openRecordedData(const QString &filePath);
+
 public slots:
     void addWorkSheetView(int worksheetId);
     void onFinishedDrawingGate(GateItem *gateItem);
@@ -38,11 +47,16 @@ private slots:
 
     void addNewPlot(QAction *action);
 
-    void onUpdateTimerTimeout();
+    void onFrameStarted();
+    void onFrameStatistics(const FrameStatistics &stats);
 
     void onUpdateStatisticsClicked();
     void onDeleteGateClicked();
 
+    void onOpenDataTriggered();
+    void onAnalysisProgress(const OfflineAnalysisResult &result);
+    void onAnalysisFinished(const OfflineAnalysisResult &result);
+
 private:
     explicit WorkSheetWidget(const QString &title, QWidget *parent = nullptr);
     WorkSheetWidget &operator=(const WorkSheetWidget &) = delete;
@@ -52,11 +66,15 @@ private:
     void initDockWidget();
     void addPlot(PlotType type);
     void updateGateStatistics();
+    QVector<CompiledGate> compiledGates() const;
+    void analyzeRecordedData();
+    void updateRecordedGateStatistics(const OfflineAnalysisResult &result);
 
     // General actions
     QAction *actionPrint;
     QAction *actionSavePDF;
     QAction *actionSelect;
+    QAction *actionOpenData;
 
     // Actions for plots
     QAction *actionNewHistogram;
@@ -67,8 +85,12 @@ private:
     WorkSheetView *currentWorkSheetView;
     WorkSheetScene *currentWorkSheetScene;
     bool        m_active;
-    QTimer      *m_updateTimer;
-    int         m_updateInterval;
+    bool        m_recorded;         ///< Plots show the file opened by openRecordedData()
+    FrameScheduler  *m_frameScheduler;      ///< Paces the live refresh of the current worksheet
+    QVector<CompiledGate>   m_compiledGates;    ///< Given to the gate engine, set again only when they change
+    bool            m_gatesDirty;           ///< The gates of the current worksheet may differ from m_compiledGates
+    bool            m_statisticsDirty;      ///< Events arrived since the statistics table was updated
+    QElapsedTimer   m_statisticsTimer;      ///< Since the statistics table was updated
 
     QList<int>  m_activedWorksheetId;
 
@@ -76,9 +98,12 @@ private:
     QTableView *tableView;
     GatesModel *m_model;
 
+    QComboBox   *statsScopeBox;
+    QLabel      *frameStatsLabel;
     QPushButton *btnUpdateStats;
     QPushButton *btnDeleteGate;
 
+    static constexpr int STATISTICS_INTERVAL_MS = 250;     ///< Shortest time between statistics table updates
 };
 
 #endif // WORKSHEETWIDGET_H